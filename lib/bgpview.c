@@ -25,7 +25,11 @@
  */
 
 #include <assert.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "config.h"
 
@@ -41,6 +45,7 @@
 
 #include "bgpstream_utils_pfx.h"
 #include "bgpview.h"
+#include "bgpview_slab.h"
 
 /** Information about a prefix as seen from a peer */
 typedef struct bwv_pfx_peerinfo {
@@ -81,14 +86,60 @@ KHASH_INIT(bwv_peerid_pfx_peerinfo_ext, uint16_t, bwv_pfx_peerinfo_ext_t, 1,
 	   kh_int_hash_func, kh_int_hash_equal)
 typedef khash_t(bwv_peerid_pfx_peerinfo_ext) bwv_peerid_pfx_peerinfo_ext_t;
 
+/** Sorted vector of pfx-peer infos
+ *
+ * Used in place of the per-prefix hash tables when the view uses the
+ * BGPVIEW_PFX_PEER_LAYOUT_VECTOR layout. Peer IDs and peer infos are kept in
+ * two parallel arrays sorted by peer ID, both allocated in the same block as
+ * this header.
+ */
+typedef struct bwv_pfx_peervec {
+
+  /** Sorted array of peer IDs */
+  bgpstream_peer_id_t *ids;
+
+  /** Array of peer infos (either bwv_pfx_peerinfo_t or
+   * bwv_pfx_peerinfo_ext_t, depending on view->disable_extended) */
+  uint8_t *infos;
+
+  /** Number of pfx-peers in the vector */
+  uint16_t size;
+
+  /** Number of pfx-peers that the vector has space for */
+  uint16_t alloc;
+
+} bwv_pfx_peervec_t;
+
+/** Number of pfx-peer vector size classes that are allocated from slabs.
+ * Class c holds vectors with space for 2^c pfx-peers, larger vectors are
+ * allocated directly with malloc */
+#define BWV_PEERVEC_SLAB_CLASSES 13
+
+/** Approximate size of each chunk allocated by a pfx-peer vector slab */
+#define BWV_PEERVEC_SLAB_CHUNK_BYTES (256 * 1024)
+
+/** Number of prefix info records allocated in each slab chunk */
+#define BWV_PFXINFO_SLAB_CHUNK_OBJS 4096
+
 #define BWV_PFX_PEERINFO_SIZE(view)                                            \
   (((view)->disable_extended) ? sizeof(bwv_pfx_peerinfo_t)                     \
                               : sizeof(bwv_pfx_peerinfo_ext_t))
 
+#define BWV_PFX_PEERS_ARE_VEC(view)                                            \
+  ((view)->pfx_peer_layout == BGPVIEW_PFX_PEER_LAYOUT_VECTOR)
+
+#define BWV_PEERVEC_GET_PEER(view, vec, k)                                     \
+  ((bwv_pfx_peerinfo_t *)((vec)->infos + ((k)*BWV_PFX_PEERINFO_SIZE(view))))
+
 #define BWV_PFX_GET_PEER_PTR(view, pfxinfo, k)                                 \
-  (((view)->disable_extended)                                                  \
-     ? &BWV_PFX_GET_PEER(pfxinfo, k)                                           \
-     : (bwv_pfx_peerinfo_t *)&BWV_PFX_GET_PEER_EXT(pfxinfo, k))
+  (BWV_PFX_PEERS_ARE_VEC(view)                                                 \
+     ? BWV_PEERVEC_GET_PEER(view, (pfxinfo)->peers_vec, k)                     \
+     : ((view)->disable_extended)                                              \
+         ? &BWV_PFX_GET_PEER(pfxinfo, k)                                       \
+         : (bwv_pfx_peerinfo_t *)&BWV_PFX_GET_PEER_EXT(pfxinfo, k))
+
+#define BWV_PFX_GET_PEER_EXT_PTR(view, pfxinfo, k)                             \
+  ((bwv_pfx_peerinfo_ext_t *)BWV_PFX_GET_PEER_PTR(view, pfxinfo, k))
 
 #define BWV_PFX_GET_PEER(pfxinfo, k)                                           \
   kh_val(pfxinfo->peers_min, k)
@@ -104,18 +155,28 @@ typedef khash_t(bwv_peerid_pfx_peerinfo_ext) bwv_peerid_pfx_peerinfo_ext_t;
 
 #define ASSERT_BWV_PFX_PEERINFO_EXT(view) assert(view->disable_extended == 0)
 
+#define RETURN_IF_FROZEN(view, ret)                                            \
+  do {                                                                         \
+    if ((view)->frozen != 0) {                                                 \
+      fprintf(stderr, "ERROR: Frozen views cannot be modified\n");             \
+      return ret;                                                              \
+    }                                                                          \
+  } while (0)
+
 /** Value for a prefix in the v4pfxs and v6pfxs tables */
 typedef struct bwv_peerid_pfxinfo {
 
   /** Table of peers
    *
    * must select either peers_min or peers_ext
-   * depending on view->disable_extended
+   * depending on view->disable_extended, or peers_vec if the view uses the
+   * vector layout
    */
   union {
     void *peers_generic;
     bwv_peerid_pfx_peerinfo_t *peers_min;
     bwv_peerid_pfx_peerinfo_ext_t *peers_ext;
+    bwv_pfx_peervec_t *peers_vec;
   };
 
   /** The number of peers in the peers list that currently observe this
@@ -131,15 +192,73 @@ typedef struct bwv_peerid_pfxinfo {
   /** Generic pointer to store per-pfx information on consumers */
   void *user;
 
+  /** Epoch of the view in which this prefix was last (re-)validated. If this
+   *  is not the current epoch, the prefix (and all of its pfx-peers) are
+   *  INVALID, regardless of the state field */
+  uint8_t epoch;
+
+  /** Number of views that reference this prefix. Shared prefixes must be
+   *  copied before they are modified */
+  uint16_t refcnt;
+
 } __attribute__((packed)) bwv_peerid_pfxinfo_t;
 
+/** Get the state of a prefix, taking the epoch of the view into account */
+#define BWV_PFX_STATE(view, pfxinfo)                                           \
+  (((pfxinfo)->epoch == (view)->epoch) ? (pfxinfo)->state                      \
+                                       : BGPVIEW_FIELD_INVALID)
+
 /** @todo: add documentation ? */
 
 /************ map from prefix -> peers [-> prefix info] ************/
 
+#ifdef WITH_PACKED_V4PFX_KEYS
+
+/** Key of the v4pfxs table: the address (in host byte order) and mask length
+    of the prefix packed into 64 bits, so that keys are hashed and compared as
+    integers, and sort in (address, mask) order */
+typedef uint64_t bwv_v4pfx_key_t;
+
+/** Get the v4pfxs table key of a v4 prefix */
+#define BWV_V4PFX_KEY(pfx)                                                     \
+  ((((uint64_t)ntohl((pfx)->address.addr.s_addr)) << 8) | (pfx)->mask_len)
+
+/** Get the v4 prefix of a v4pfxs table key */
+static inline bgpstream_ipv4_pfx_t bwv_v4pfx_key_unpack(bwv_v4pfx_key_t key)
+{
+  bgpstream_ipv4_pfx_t pfx;
+
+  memset(&pfx, 0, sizeof(pfx));
+  pfx.mask_len = key & 0xff;
+  pfx.address.version = BGPSTREAM_ADDR_VERSION_IPV4;
+  pfx.address.addr.s_addr = htonl((uint32_t)(key >> 8));
+  return pfx;
+}
+
+/* keys differ mostly in their middle bits, so (fibonacci) hash them into the
+   low bits that khash uses to pick a bucket */
+#define bwv_v4pfx_key_hash(key)                                                \
+  (khint32_t)(((key)*UINT64_C(0x9E3779B97F4A7C15)) >> 32)
+
+KHASH_INIT(bwv_v4pfx_peerid_pfxinfo, bwv_v4pfx_key_t, bwv_peerid_pfxinfo_t *,
+           1, bwv_v4pfx_key_hash, kh_int64_hash_equal)
+
+#else
+
+typedef bgpstream_ipv4_pfx_t bwv_v4pfx_key_t;
+
+#define BWV_V4PFX_KEY(pfx) (*(pfx))
+
+#define bwv_v4pfx_key_unpack(key) (key)
+
 KHASH_INIT(bwv_v4pfx_peerid_pfxinfo, bgpstream_ipv4_pfx_t,
            bwv_peerid_pfxinfo_t *, 1, bgpstream_ipv4_pfx_hash_val,
            bgpstream_ipv4_pfx_equal_val)
+
+#endif
+
+/** Get the v4 prefix of bucket k of the v4pfxs table of a view */
+#define BWV_V4PFX(view, k) bwv_v4pfx_key_unpack(kh_key((view)->v4pfxs, (k)))
 typedef khash_t(bwv_v4pfx_peerid_pfxinfo) bwv_v4pfx_peerid_pfxinfo_t;
 
 KHASH_INIT(bwv_v6pfx_peerid_pfxinfo, bgpstream_ipv6_pfx_t,
@@ -164,13 +283,324 @@ typedef struct bwv_peerinfo {
   /** Generic pointer to store information related to the peer */
   void *user;
 
+  /** Epoch of the view in which this peer was last (re-)validated. If this is
+   *  not the current epoch, the peer is INVALID, regardless of the state
+   *  field */
+  uint8_t epoch;
+
 } bwv_peerinfo_t;
 
+/** Get the state of a peer, taking the epoch of the view into account */
+#define BWV_PEER_STATE(view, peerinfo)                                         \
+  (((peerinfo).epoch == (view)->epoch) ? (peerinfo).state                      \
+                                       : BGPVIEW_FIELD_INVALID)
+
 KHASH_INIT(bwv_peerid_peerinfo, bgpstream_peer_id_t, bwv_peerinfo_t, 1,
            kh_int_hash_func, kh_int_hash_equal)
 
+/** Copy the contents of the src hash table into the (empty) dst hash table
+ *  without re-hashing. ret is set to -1 if an allocation fails */
+#define BWV_KH_COPY(name, dst, src, ret)                                       \
+  do {                                                                         \
+    (ret) = 0;                                                                 \
+    if ((src)->n_buckets > 0) {                                                \
+      if (kh_resize(name, (dst), (src)->n_buckets) < 0) {                      \
+        (ret) = -1;                                                            \
+        break;                                                                 \
+      }                                                                        \
+      memcpy((dst)->flags, (src)->flags,                                       \
+             __ac_fsize((src)->n_buckets) * sizeof(khint32_t));                \
+      memcpy((dst)->keys, (src)->keys,                                         \
+             (src)->n_buckets * sizeof(*(src)->keys));                         \
+      memcpy((dst)->vals, (src)->vals,                                         \
+             (src)->n_buckets * sizeof(*(src)->vals));                         \
+    }                                                                          \
+    (dst)->size = (src)->size;                                                 \
+    (dst)->n_occupied = (src)->n_occupied;                                     \
+    (dst)->upper_bound = (src)->upper_bound;                                   \
+  } while (0)
+
 /************ bgpview ************/
 
+/** Per-view allocator for prefix records
+ *
+ * Views that share prefix records (i.e., a view and its snapshots) also share
+ * the allocator that the records came from.
+ */
+typedef struct bwv_allocator {
+
+  /** Slab that prefix info records are allocated from (created on demand) */
+  bgpview_slab_t *pfxinfo_slab;
+
+  /** Slabs that pfx-peer vectors are allocated from, one per size class
+      (created on demand) */
+  bgpview_slab_t *peervec_slabs[BWV_PEERVEC_SLAB_CLASSES];
+
+  /** Number of views using this allocator */
+  int refcnt;
+
+} bwv_allocator_t;
+
+/** Tables swept (in order) by the incremental garbage collector */
+typedef enum {
+  BWV_GC_PHASE_DONE = 0,
+  BWV_GC_PHASE_V4PFXS = 1,
+  BWV_GC_PHASE_V6PFXS = 2,
+  BWV_GC_PHASE_PEERINFO = 3,
+} bwv_gc_phase_t;
+
+/** Address-sorted index of the buckets of a prefix table
+ *
+ * The index is built on demand (by sorted iterators) and is invalidated
+ * whenever a prefix is inserted into, or deleted from, the table, or the table
+ * may have been rehashed (any of which may move prefixes to different
+ * buckets).
+ */
+typedef struct bwv_pfx_index {
+
+  /** Buckets of the table that hold a prefix, in (address, mask) order */
+  khiter_t *buckets;
+
+  /** Keys of the table, in the same order as the buckets (used to check that
+      a bucket still holds the prefix it was indexed for) */
+  void *keys;
+
+  /** Number of buckets in the index */
+  uint32_t cnt;
+
+  /** Number of buckets allocated */
+  uint32_t alloc_cnt;
+
+  /** Does the index reflect the current content of the table? */
+  int valid;
+
+} bwv_pfx_index_t;
+
+/** Peers of a prefix whose pfx-peers changed since the journal mark */
+typedef struct bwv_journal_peers {
+
+  /** IDs of the peers, sorted */
+  bgpstream_peer_id_t *ids;
+
+  /** Number of peers in the ids array */
+  uint32_t cnt;
+
+  /** Number of peers allocated in the ids array */
+  uint32_t alloc;
+
+} bwv_journal_peers_t;
+
+KHASH_INIT(bwv_v4pfx_journal, bgpstream_ipv4_pfx_t, bwv_journal_peers_t, 1,
+           bgpstream_ipv4_pfx_hash_val, bgpstream_ipv4_pfx_equal_val)
+
+KHASH_INIT(bwv_v6pfx_journal, bgpstream_ipv6_pfx_t, bwv_journal_peers_t, 1,
+           bgpstream_ipv6_pfx_hash_val, bgpstream_ipv6_pfx_equal_val)
+
+KHASH_INIT(bwv_peerid_journal, bgpstream_peer_id_t, char, 0, kh_int_hash_func,
+           kh_int_hash_equal)
+
+/** Journal of the prefixes, pfx-peers and peers that changed since a mark */
+typedef struct bwv_journal {
+
+  /** Changed v4 prefixes (and their changed pfx-peers) */
+  khash_t(bwv_v4pfx_journal) *v4pfxs;
+
+  /** Changed v6 prefixes (and their changed pfx-peers) */
+  khash_t(bwv_v6pfx_journal) *v6pfxs;
+
+  /** Changed peers */
+  khash_t(bwv_peerid_journal) *peers;
+
+  /** Does the journal hold every change since the mark? (Cleared when the
+      view is cleared, or if the journal could not be updated) */
+  int complete;
+
+} bwv_journal_t;
+
+/** An origin ASN of a prefix, and the number of active pfx-peers whose AS
+    path ends with it */
+typedef struct bwv_origin_cnt {
+
+  /** Origin ASN */
+  uint32_t asn;
+
+  /** Number of active pfx-peers with this origin */
+  uint32_t cnt;
+
+} bwv_origin_cnt_t;
+
+/** Distinct origin ASNs of the active pfx-peers of a prefix */
+typedef struct bwv_pfx_origins {
+
+  /** Array of origins (unsorted, most prefixes have only one) */
+  bwv_origin_cnt_t *origins;
+
+  /** Number of origins in the array */
+  uint16_t cnt;
+
+  /** Number of origins allocated in the array */
+  uint16_t alloc;
+
+} bwv_pfx_origins_t;
+
+KHASH_INIT(bwv_v4pfx_origins, bgpstream_ipv4_pfx_t, bwv_pfx_origins_t, 1,
+           bgpstream_ipv4_pfx_hash_val, bgpstream_ipv4_pfx_equal_val)
+
+KHASH_INIT(bwv_v6pfx_origins, bgpstream_ipv6_pfx_t, bwv_pfx_origins_t, 1,
+           bgpstream_ipv6_pfx_hash_val, bgpstream_ipv6_pfx_equal_val)
+
+KHASH_INIT(bwv_v4pfx_set, bgpstream_ipv4_pfx_t, char, 0,
+           bgpstream_ipv4_pfx_hash_val, bgpstream_ipv4_pfx_equal_val)
+
+KHASH_INIT(bwv_v6pfx_set, bgpstream_ipv6_pfx_t, char, 0,
+           bgpstream_ipv6_pfx_hash_val, bgpstream_ipv6_pfx_equal_val)
+
+/** Prefixes originated by an origin ASN */
+typedef struct bwv_origin_pfxs {
+
+  /** Set of v4 prefixes (NULL until the origin has a v4 prefix) */
+  khash_t(bwv_v4pfx_set) *v4pfxs;
+
+  /** Set of v6 prefixes (NULL until the origin has a v6 prefix) */
+  khash_t(bwv_v6pfx_set) *v6pfxs;
+
+} bwv_origin_pfxs_t;
+
+KHASH_INIT(bwv_origin_pfxs, uint32_t, bwv_origin_pfxs_t, 1, kh_int_hash_func,
+           kh_int_hash_equal)
+
+/** Secondary index from origin ASNs to the prefixes they originate, built from
+    the active pfx-peers of a view */
+typedef struct bwv_origin_index {
+
+  /** Origins of the v4 prefixes */
+  khash_t(bwv_v4pfx_origins) *v4pfxs;
+
+  /** Origins of the v6 prefixes */
+  khash_t(bwv_v6pfx_origins) *v6pfxs;
+
+  /** Prefixes of each origin */
+  khash_t(bwv_origin_pfxs) *origins;
+
+  /** v4 prefixes with more than one origin */
+  khash_t(bwv_v4pfx_set) *v4moas;
+
+  /** v6 prefixes with more than one origin */
+  khash_t(bwv_v6pfx_set) *v6moas;
+
+  /** Does the index reflect the view? (Cleared if the view is bulk copied
+      into, or if the index could not be updated. The index is rebuilt when it
+      is next used) */
+  int valid;
+
+} bwv_origin_index_t;
+
+/** Value of a /24 slot of the IPv4 LPM table that has a sub-table */
+#define BWV_LPM_V4_GROUP 0xff
+
+/** Sub-table of the IPv4 LPM table for a /24 that contains prefixes longer
+    than /24 */
+typedef struct bwv_lpm_v4group {
+
+  /** Length + 1 of the longest active prefix covering each address of the
+      /24 (0 if there is none) */
+  uint8_t lens[256];
+
+  /** Length + 1 of the longest active prefix of length 24 or shorter covering
+      the /24 (i.e. the value of the slot without the sub-table) */
+  uint8_t base;
+
+  /** Number of active prefixes longer than /24 in the /24 */
+  uint16_t long_cnt;
+
+} bwv_lpm_v4group_t;
+
+KHASH_INIT(bwv_lpm_v4groups, uint32_t, bwv_lpm_v4group_t *, 1,
+           kh_int_hash_func, kh_int_hash_equal)
+
+/** Longest-prefix-match index of the active prefixes of a view */
+typedef struct bwv_lpm_index {
+
+  /** DIR-24-8 style table with one slot per /24: length + 1 of the longest
+      active prefix covering the /24 (0 if there is none), or
+      BWV_LPM_V4_GROUP if the /24 has a sub-table */
+  uint8_t *v4tbl;
+
+  /** Sub-tables of the /24s that contain prefixes longer than /24 */
+  khash_t(bwv_lpm_v4groups) *v4groups;
+
+  /** Number of active v4 prefixes of each length */
+  uint32_t v4len_cnt[32 + 1];
+
+  /** Number of active v6 prefixes of each length (v6 lookups probe the
+      prefix table once for each length that is in use) */
+  uint32_t v6len_cnt[128 + 1];
+
+  /** Does the index reflect the view? (Cleared if the view is bulk copied
+      into, or if the index could not be updated. The index is rebuilt when it
+      is next used) */
+  int valid;
+
+} bwv_lpm_index_t;
+
+/** Buckets of a prefix table that hold a prefix a peer has a valid pfx-peer
+    on. These are kept as a list while that is smaller than a bitmap over all
+    buckets of the table, so that the index of a peer takes memory in
+    proportion to its pfx-peers */
+typedef struct bwv_peer_bkts {
+
+  /** Buckets, in no particular order (sorted when compacted). Removing a
+      pfx-peer does not remove its bucket, so a bucket may be listed more than
+      once, or no longer hold a pfx-peer of the peer */
+  khiter_t *list;
+
+  /** Number of buckets in list */
+  uint32_t cnt;
+
+  /** Number of allocated elements in list */
+  uint32_t alloc;
+
+  /** Number of pfx-peers removed since the list was last compacted */
+  uint32_t removed;
+
+  /** Bit k is set if the peer has a valid pfx-peer on the prefix in bucket k
+      (NULL while the buckets are listed) */
+  uint64_t *bits;
+
+} bwv_peer_bkts_t;
+
+/** Prefixes of a peer */
+typedef struct bwv_peer_pfxs {
+
+  /** Buckets of the v4pfxs table */
+  bwv_peer_bkts_t v4;
+
+  /** Buckets of the v6pfxs table */
+  bwv_peer_bkts_t v6;
+
+} bwv_peer_pfxs_t;
+
+/** Per-peer prefix index of a view */
+typedef struct bwv_peer_index {
+
+  /** Prefixes of each peer (indexed by peer ID) */
+  bwv_peer_pfxs_t *peers;
+
+  /** Number of allocated elements in peers */
+  uint32_t peers_alloc;
+
+  /** Number of buckets of the v4pfxs and v6pfxs tables when the index was
+      (re)built, i.e. the number of bits in each v4 and v6 bitmap */
+  khint_t v4_nbits;
+  khint_t v6_nbits;
+
+  /** Does the index reflect the view? (Cleared if the view is bulk copied
+      into, or if a prefix table may have been rehashed, which moves prefixes
+      to other buckets. The index is rebuilt when it is next used) */
+  int valid;
+
+} bwv_peer_index_t;
+
 // TODO: documentation
 struct bgpview {
 
@@ -230,6 +660,12 @@ struct bgpview {
   /** State of the view */
   bgpview_field_state_t state;
 
+  /** Current epoch of the view. bgpview_clear moves the view to a new epoch,
+   *  which implicitly invalidates all prefixes and peers stamped with an older
+   *  epoch. Stale records are reset when they are re-added, or freed by
+   *  bgpview_gc */
+  uint8_t epoch;
+
   /** Generic pointer to store information related to the view */
   void *user;
 
@@ -238,11 +674,74 @@ struct bgpview {
    */
   int disable_extended;
 
+  /** How the per-prefix peer tables are stored */
+  bgpview_pfx_peer_layout_t pfx_peer_layout;
+
+  /** Allocator for prefix info records and pfx-peer vectors (shared with
+      snapshots of this view) */
+  bwv_allocator_t *alloc;
+
   uint8_t need_gc_v4pfxs;
   uint8_t need_gc_v6pfxs;
   uint8_t need_gc_peerinfo;
+
+  /** Table that the incremental garbage collector is currently sweeping */
+  bwv_gc_phase_t gc_phase;
+
+  /** Position of the incremental garbage collector in the current table */
+  khiter_t gc_it;
+
+  /** Incremented whenever a prefix or peer table may have been rehashed
+      (which moves its entries to different buckets, even if the table keeps
+      its size) */
+  uint64_t rehash_gen;
+
+  /** Value of rehash_gen when the sweep of the current table started (if it
+      changes, the sweep is restarted) */
+  uint64_t gc_rehash_gen;
+
+  /** Cumulative garbage collector statistics */
+  bgpview_gc_stats_t gc_stats;
+
+  /** Address-sorted index of the v4 prefix table */
+  bwv_pfx_index_t v4pfxs_index;
+
+  /** Address-sorted index of the v6 prefix table */
+  bwv_pfx_index_t v6pfxs_index;
+
+  /** Is this a read-only view created by bgpview_freeze? */
+  int frozen;
+
+  /** Block that holds the prefix records, pfx-peer vectors and pfx-peer
+      cells of a frozen view */
+  void *frozen_arena;
+
+  /** Memory-mapped snapshot image that holds the prefix table buckets and
+      pfx-peers of a view created by bgpview_snapshot_map (NULL otherwise) */
+  uint8_t *image;
+
+  /** Length of the mapped image */
+  size_t image_len;
+
+  /** Journal of changes since the last mark (NULL if disabled) */
+  bwv_journal_t *journal;
+
+  /** Origin ASN index (NULL if disabled) */
+  bwv_origin_index_t *origin_index;
+
+  /** Longest-prefix-match index (NULL if disabled) */
+  bwv_lpm_index_t *lpm_index;
+
+  /** Per-peer prefix index (NULL if disabled) */
+  bwv_peer_index_t *peer_index;
 };
 
+/** Index of the IPv4 bucket range of an iterator partition */
+#define BWV_PART_V4 0
+/** Index of the IPv6 bucket range of an iterator partition */
+#define BWV_PART_V6 1
+#define BWV_PART_VERSION_CNT 2
+
 struct bgpview_iter {
 
   /** Pointer to the view instance we are iterating over */
@@ -259,6 +758,59 @@ struct bgpview_iter {
   /** Current pfx (the pfx it is valid if != kh_end of the appropriate version
       table */
   khiter_t pfx_it;
+  /** Is this iterator restricted to a partition of the prefix tables? */
+  int pfx_part;
+  /** First bucket of the v4 and v6 prefix tables in the partition */
+  khiter_t pfx_part_begin[BWV_PART_VERSION_CNT];
+  /** Bucket after the last bucket of the v4 and v6 prefix tables in the
+      partition (used in place of kh_end) */
+  khiter_t pfx_part_end[BWV_PART_VERSION_CNT];
+  /** Are prefixes iterated in address order (using the sorted index)? */
+  int pfx_sorted;
+  /** Position of the current pfx in the sorted index */
+  uint32_t pfx_sorted_idx;
+
+  /** The IP version of the journal table that is currently iterated */
+  bgpstream_addr_version_t journal_version_ptr;
+  /** IP version(s) of the changed prefixes to iterate (as version_filter) */
+  int journal_version_filter;
+  /** Current changed prefix in the journal */
+  khiter_t journal_pfx_it;
+  /** Current changed peer in the journal */
+  khiter_t journal_peer_it;
+
+  /** The IP version of the indexed prefix set that is currently iterated */
+  bgpstream_addr_version_t index_version_ptr;
+  /** v4 prefix set of the origin index that is iterated */
+  khash_t(bwv_v4pfx_set) *index_v4pfxs;
+  /** v6 prefix set of the origin index that is iterated */
+  khash_t(bwv_v6pfx_set) *index_v6pfxs;
+  /** Current prefix in the indexed prefix set */
+  khiter_t index_pfx_it;
+
+  /** Address whose covering prefixes are iterated (the version is 0 once
+      there are no more covering prefixes) */
+  bgpstream_ip_addr_t lpm_addr;
+  /** Length of the current covering prefix */
+  int lpm_len;
+
+  /** Peer whose pfx-peers are iterated */
+  bgpstream_peer_id_t peer_pfx_id;
+  /** Version of the prefix table whose buckets are scanned (0 once there are
+      no more pfx-peers of the peer) */
+  int peer_pfx_version;
+  /** Version(s) of the pfx-peers of the peer to iterate over (0 for all) */
+  int peer_pfx_version_filter;
+  /** Bucket of the prefix table at which the scan is (or, if the peer index
+      lists the buckets of the peer, position in that list) */
+  khiter_t peer_pfx_bucket;
+  /** Is the scan guided by the peer index? */
+  int peer_pfx_indexed;
+
+#ifdef WITH_PACKED_V4PFX_KEYS
+  /** Current v4 prefix, unpacked from its v4pfxs table key */
+  bgpstream_ipv4_pfx_t v4pfx;
+#endif
   /** State mask used for prefix iteration */
   uint8_t pfx_state_mask;
 
@@ -279,1797 +831,6842 @@ struct bgpview_iter {
 
 /* ========== PRIVATE FUNCTIONS ========== */
 
-static void peerinfo_reset(bwv_peerinfo_t *v)
-{
-  v->state = BGPVIEW_FIELD_INVALID;
-  v->v4_pfx_cnt[BGPVIEW_FIELD_INACTIVE] = 0;
-  v->v4_pfx_cnt[BGPVIEW_FIELD_ACTIVE] = 0;
-  v->v6_pfx_cnt[BGPVIEW_FIELD_INACTIVE] = 0;
-  v->v6_pfx_cnt[BGPVIEW_FIELD_ACTIVE] = 0;
-}
+/* ==================== CHANGE JOURNAL ==================== */
 
-static void peerinfo_destroy_user(bgpview_t *view)
+static void journal_reset(bwv_journal_t *journal)
 {
   khiter_t k;
-  if (view->peer_user_destructor == NULL) {
-    return;
+
+  for (k = kh_begin(journal->v4pfxs); k != kh_end(journal->v4pfxs); ++k) {
+    if (kh_exist(journal->v4pfxs, k)) {
+      free(kh_val(journal->v4pfxs, k).ids);
+    }
   }
-  for (k = kh_begin(view->peerinfo); k != kh_end(view->peerinfo); ++k) {
-    if (!kh_exist(view->peerinfo, k) ||
-        (kh_value(view->peerinfo, k).user == NULL)) {
-      continue;
+  for (k = kh_begin(journal->v6pfxs); k != kh_end(journal->v6pfxs); ++k) {
+    if (kh_exist(journal->v6pfxs, k)) {
+      free(kh_val(journal->v6pfxs, k).ids);
     }
-    view->peer_user_destructor(kh_value(view->peerinfo, k).user);
-    kh_value(view->peerinfo, k).user = NULL;
   }
+  kh_clear(bwv_v4pfx_journal, journal->v4pfxs);
+  kh_clear(bwv_v6pfx_journal, journal->v6pfxs);
+  kh_clear(bwv_peerid_journal, journal->peers);
+
+  journal->complete = 1;
 }
 
-static bwv_peerid_pfxinfo_t *peerid_pfxinfo_create(void)
+static void journal_destroy(bwv_journal_t *journal)
 {
-  bwv_peerid_pfxinfo_t *v;
-
-  if ((v = malloc_zero(sizeof(bwv_peerid_pfxinfo_t))) == NULL) {
-    return NULL;
+  if (journal == NULL) {
+    return;
   }
-  v->state = BGPVIEW_FIELD_INVALID;
-
-  /* all other fields are memset to 0 */
-
-  return v;
+  if (journal->v4pfxs != NULL && journal->v6pfxs != NULL &&
+      journal->peers != NULL) {
+    journal_reset(journal);
+  }
+  if (journal->v4pfxs != NULL) {
+    kh_destroy(bwv_v4pfx_journal, journal->v4pfxs);
+  }
+  if (journal->v6pfxs != NULL) {
+    kh_destroy(bwv_v6pfx_journal, journal->v6pfxs);
+  }
+  if (journal->peers != NULL) {
+    kh_destroy(bwv_peerid_journal, journal->peers);
+  }
+  free(journal);
 }
 
-static int peerid_pfxinfo_insert(bgpview_iter_t *iter,
-                                 bwv_peerid_pfxinfo_t *v,
-                                 bgpstream_peer_id_t peerid,
-                                 bgpstream_as_path_store_path_id_t path_id)
+/* add a peer to the (sorted) changed peers of a prefix */
+static int journal_peers_add(bwv_journal_peers_t *peers,
+                             bgpstream_peer_id_t peer_id)
 {
-  bwv_pfx_peerinfo_t *peerinfo = NULL;
-  int khret;
-  khiter_t k;
+  bgpstream_peer_id_t *ids;
+  uint32_t lo = 0, hi = peers->cnt, mid;
 
-  if (!v->peers_generic) {
-    if (iter->view->disable_extended) {
-      v->peers_min = kh_init(bwv_peerid_pfx_peerinfo);
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (peers->ids[mid] < peer_id) {
+      lo = mid + 1;
     } else {
-      v->peers_ext = kh_init(bwv_peerid_pfx_peerinfo_ext);
+      hi = mid;
     }
   }
+  if (lo < peers->cnt && peers->ids[lo] == peer_id) {
+    return 0;
+  }
 
-  if (iter->view->disable_extended) {
-    k = kh_put(bwv_peerid_pfx_peerinfo, v->peers_min, peerid, &khret);
-    if (khret > 0) {
-      // peer didn't exist; initialize it
-      kh_val(v->peers_min, k).state = BGPVIEW_FIELD_INVALID;
-    }
-    peerinfo = &kh_val(v->peers_min, k);
-  } else {
-    k = kh_put(bwv_peerid_pfx_peerinfo_ext, v->peers_ext, peerid, &khret);
-    if (khret > 0) {
-      // peer didn't exist; initialize it
-      kh_val(v->peers_ext, k).state = BGPVIEW_FIELD_INVALID;
-      kh_val(v->peers_ext, k).user = NULL;
+  if (peers->cnt == peers->alloc) {
+    if ((ids = realloc(peers->ids, sizeof(bgpstream_peer_id_t) *
+                                     (peers->alloc ? peers->alloc * 2 : 4))) ==
+        NULL) {
+      return -1;
     }
-    peerinfo = (bwv_pfx_peerinfo_t*)&kh_val(v->peers_ext, k);
+    peers->ids = ids;
+    peers->alloc = peers->alloc ? peers->alloc * 2 : 4;
   }
+  memmove(&peers->ids[lo + 1], &peers->ids[lo],
+          sizeof(bgpstream_peer_id_t) * (peers->cnt - lo));
+  peers->ids[lo] = peer_id;
+  peers->cnt++;
+  return 0;
+}
 
-  peerinfo->as_path_id = path_id;
+#define JOURNAL_PFX_PEER(journal, table, name, key, peer_id, ret)              \
+  do {                                                                         \
+    khiter_t k;                                                                \
+    int khret;                                                                 \
+    k = kh_put(name, (journal)->table, (key), &khret);                         \
+    if (khret < 0) {                                                           \
+      (ret) = -1;                                                              \
+      break;                                                                   \
+    }                                                                          \
+    if (khret > 0) {                                                           \
+      memset(&kh_val((journal)->table, k), 0, sizeof(bwv_journal_peers_t));    \
+    }                                                                          \
+    (ret) = journal_peers_add(&kh_val((journal)->table, k), (peer_id));        \
+  } while (0)
 
-  if (peerinfo->state == BGPVIEW_FIELD_INVALID) {
-    // did not already exist or was invalid
-    peerinfo->state = BGPVIEW_FIELD_INACTIVE;
+/* record that the pfx-peer the iterator points to (at the given peer) has
+   changed */
+static void journal_pfx_peer(bgpview_iter_t *iter, bgpstream_peer_id_t peer_id)
+{
+  bwv_journal_t *journal = iter->view->journal;
+  int ret = 0;
 
-    /** peerinfo->user remains untouched */
+  if (journal == NULL || journal->complete == 0) {
+    return;
+  }
 
-    /* and count this as a new inactive peer for this prefix */
-    v->peers_cnt[BGPVIEW_FIELD_INACTIVE]++;
+  switch (iter->version_ptr) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    JOURNAL_PFX_PEER(journal, v4pfxs, bwv_v4pfx_journal,
+                     BWV_V4PFX(iter->view, iter->pfx_it), peer_id, ret);
+    break;
 
-    /* also count this as an inactive pfx for the peer */
-    switch (iter->version_ptr) {
-    case BGPSTREAM_ADDR_VERSION_IPV4:
-      kh_value(iter->view->peerinfo, iter->peer_it)
-	.v4_pfx_cnt[BGPVIEW_FIELD_INACTIVE]++;
-      break;
-    case BGPSTREAM_ADDR_VERSION_IPV6:
-      kh_value(iter->view->peerinfo, iter->peer_it)
-	.v6_pfx_cnt[BGPVIEW_FIELD_INACTIVE]++;
-      break;
-    default:
-      return -1;
-    }
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    JOURNAL_PFX_PEER(journal, v6pfxs, bwv_v6pfx_journal,
+                     kh_key(iter->view->v6pfxs, iter->pfx_it), peer_id, ret);
+    break;
+
+  default:
+    ret = -1;
   }
 
-  /* now seek the iterator to this pfx/peer */
-  iter->pfx_peer_it = k;
-  iter->pfx_peer_it_valid = 1;
-  iter->pfx_peer_state_mask = BGPVIEW_FIELD_ALL_VALID;
+  if (ret != 0) {
+    fprintf(stderr, "WARN: Could not update change journal\n");
+    journal_reset(journal);
+    journal->complete = 0;
+  }
+}
 
-  return 0;
-}
-
-static inline void pfx_peer_info_destroy(bgpview_t *view, bwv_pfx_peerinfo_t *v)
-{
-  return;
-}
-
-static inline void pfx_peer_info_ext_destroy(bgpview_t *view,
-                                             bwv_pfx_peerinfo_ext_t *v)
+/* record that the given peer has changed */
+static void journal_peer(bgpview_t *view, bgpstream_peer_id_t peer_id)
 {
-  ASSERT_BWV_PFX_PEERINFO_EXT(view);
-  if (v->user != NULL && view->pfx_peer_user_destructor != NULL) {
-    view->pfx_peer_user_destructor(v->user);
-  }
-  v->user = NULL;
-}
+  int khret;
 
-static void peerid_pfxinfo_destroy(bgpview_t *view, bwv_peerid_pfxinfo_t *v)
-{
-  if (v == NULL) {
+  if (view->journal == NULL || view->journal->complete == 0) {
     return;
   }
-  khiter_t k;
-  if (v->peers_generic != NULL) {
-    if (view->disable_extended == 0) {
-      for (k = kh_begin(v->peers_ext); k != kh_end(v->peers_ext); ++k) {
-        if (!kh_exist(v->peers_ext, k)) continue;
-        pfx_peer_info_ext_destroy(view, &kh_val(v->peers_ext, k));
-      }
-      kh_destroy(bwv_peerid_pfx_peerinfo_ext, v->peers_ext);
-    } else {
-      // loop calling empty inline function can be optimized away
-      for (k = kh_begin(v->peers_min); k != kh_end(v->peers_min); ++k) {
-        if (!kh_exist(v->peers_min, k)) continue;
-        pfx_peer_info_destroy(view, &kh_val(v->peers_min, k));
-      }
-      kh_destroy(bwv_peerid_pfx_peerinfo, v->peers_min);
-    }
-  }
-  v->peers_generic = NULL;
-  v->state = BGPVIEW_FIELD_INVALID;
-  if (view->pfx_user_destructor != NULL && v->user != NULL) {
-    view->pfx_user_destructor(v->user);
+
+  kh_put(bwv_peerid_journal, view->journal->peers, peer_id, &khret);
+  if (khret < 0) {
+    fprintf(stderr, "WARN: Could not update change journal\n");
+    journal_reset(view->journal);
+    view->journal->complete = 0;
   }
-  v->user = NULL;
-  free(v);
 }
 
-#define __pfx_peerinfos(iter)                                                  \
-  (((iter)->version_ptr == BGPSTREAM_ADDR_VERSION_IPV4)                        \
-     ? (kh_val((iter)->view->v4pfxs, (iter)->pfx_it))                          \
-     : ((iter)->version_ptr == BGPSTREAM_ADDR_VERSION_IPV6)                    \
-         ? (kh_val((iter)->view->v6pfxs, (iter)->pfx_it))                      \
-         : NULL)
+/* ==================== ORIGIN INDEX ==================== */
 
-static int add_v4pfx(bgpview_iter_t *iter, bgpstream_ipv4_pfx_t *pfx)
+static void origin_index_reset(bwv_origin_index_t *index)
 {
-  bwv_peerid_pfxinfo_t *new_pfxpeerinfo;
   khiter_t k;
-  int khret;
 
-  k = kh_put(bwv_v4pfx_peerid_pfxinfo, iter->view->v4pfxs, *pfx, &khret);
-  if (khret > 0) {
-    /* pfx didn't exist */
-    if ((new_pfxpeerinfo = peerid_pfxinfo_create()) == NULL) {
-      return -1;
+  for (k = kh_begin(index->v4pfxs); k != kh_end(index->v4pfxs); ++k) {
+    if (kh_exist(index->v4pfxs, k)) {
+      free(kh_val(index->v4pfxs, k).origins);
+    }
+  }
+  for (k = kh_begin(index->v6pfxs); k != kh_end(index->v6pfxs); ++k) {
+    if (kh_exist(index->v6pfxs, k)) {
+      free(kh_val(index->v6pfxs, k).origins);
+    }
+  }
+  for (k = kh_begin(index->origins); k != kh_end(index->origins); ++k) {
+    if (!kh_exist(index->origins, k)) {
+      continue;
+    }
+    if (kh_val(index->origins, k).v4pfxs != NULL) {
+      kh_destroy(bwv_v4pfx_set, kh_val(index->origins, k).v4pfxs);
+    }
+    if (kh_val(index->origins, k).v6pfxs != NULL) {
+      kh_destroy(bwv_v6pfx_set, kh_val(index->origins, k).v6pfxs);
     }
-    kh_value(iter->view->v4pfxs, k) = new_pfxpeerinfo;
-
-    /* pfx is invalid at this point */
   }
+  kh_clear(bwv_v4pfx_origins, index->v4pfxs);
+  kh_clear(bwv_v6pfx_origins, index->v6pfxs);
+  kh_clear(bwv_origin_pfxs, index->origins);
+  kh_clear(bwv_v4pfx_set, index->v4moas);
+  kh_clear(bwv_v6pfx_set, index->v6moas);
 
-  /* seek the iterator to this prefix */
-  iter->pfx_it = k;
-  iter->version_ptr = BGPSTREAM_ADDR_VERSION_IPV4;
-  iter->pfx_peer_it_valid = 0; // moving pfx_it invalidates pfx_peer_it
+  index->valid = 1;
+}
 
-  if (kh_value(iter->view->v4pfxs, k)->state != BGPVIEW_FIELD_INVALID) {
-    /* it was already there and active/inactive */
-    return 0;
+static void origin_index_destroy(bwv_origin_index_t *index)
+{
+  if (index == NULL) {
+    return;
+  }
+  if (index->v4pfxs != NULL && index->v6pfxs != NULL &&
+      index->origins != NULL && index->v4moas != NULL &&
+      index->v6moas != NULL) {
+    origin_index_reset(index);
+  }
+  if (index->v4pfxs != NULL) {
+    kh_destroy(bwv_v4pfx_origins, index->v4pfxs);
+  }
+  if (index->v6pfxs != NULL) {
+    kh_destroy(bwv_v6pfx_origins, index->v6pfxs);
+  }
+  if (index->origins != NULL) {
+    kh_destroy(bwv_origin_pfxs, index->origins);
+  }
+  if (index->v4moas != NULL) {
+    kh_destroy(bwv_v4pfx_set, index->v4moas);
   }
+  if (index->v6moas != NULL) {
+    kh_destroy(bwv_v6pfx_set, index->v6moas);
+  }
+  free(index);
+}
 
-  kh_value(iter->view->v4pfxs, k)->state = BGPVIEW_FIELD_INACTIVE;
-  iter->view->v4pfxs_cnt[BGPVIEW_FIELD_INACTIVE]++;
+/* get the origin ASN of a path, or 0 if the path has no origin or if its
+   origin segment is not a single ASN (e.g. an AS set) */
+static uint32_t path_origin_asn(bgpview_t *view,
+                                bgpstream_as_path_store_path_id_t path_id)
+{
+  bgpstream_as_path_seg_t *seg = bgpstream_as_path_store_path_get_origin_seg(
+    bgpstream_as_path_store_get_store_path(view->pathstore, path_id));
 
-  return 0;
+  if (seg == NULL || seg->type != BGPSTREAM_AS_PATH_SEG_ASN) {
+    return 0;
+  }
+  return ((bgpstream_as_path_seg_asn_t *)seg)->asn;
 }
 
-static int add_v6pfx(bgpview_iter_t *iter, bgpstream_ipv6_pfx_t *pfx)
+/* count one more active pfx-peer with the given origin. returns 1 if the
+   origin is new for the prefix, 0 if it is not, and -1 if an allocation
+   fails */
+static int pfx_origins_add(bwv_pfx_origins_t *po, uint32_t asn)
 {
-  bwv_peerid_pfxinfo_t *new_pfxpeerinfo;
-  khiter_t k;
-  int khret;
+  bwv_origin_cnt_t *origins;
+  uint32_t alloc;
+  int i;
 
-  k = kh_put(bwv_v6pfx_peerid_pfxinfo, iter->view->v6pfxs, *pfx, &khret);
-  if (khret > 0) {
-    /* pfx didn't exist */
-    if ((new_pfxpeerinfo = peerid_pfxinfo_create()) == NULL) {
-      return -1;
+  for (i = 0; i < po->cnt; i++) {
+    if (po->origins[i].asn == asn) {
+      po->origins[i].cnt++;
+      return 0;
     }
-    kh_value(iter->view->v6pfxs, k) = new_pfxpeerinfo;
-
-    /* pfx is invalid at this point */
   }
 
-  /* seek the iterator to this prefix */
-  iter->pfx_it = k;
-  iter->version_ptr = BGPSTREAM_ADDR_VERSION_IPV6;
-  iter->pfx_peer_it_valid = 0; // moving pfx_it invalidates pfx_peer_it
-
-  if (kh_value(iter->view->v6pfxs, k)->state != BGPVIEW_FIELD_INVALID) {
-    /* it was already there and active/inactive */
-    return 0;
+  if (po->cnt == po->alloc) {
+    /* a prefix can't have more distinct origins than peers */
+    alloc = (po->alloc == 0) ? 1 : po->alloc * 2;
+    if (alloc > UINT16_MAX) {
+      alloc = UINT16_MAX;
+    }
+    if ((origins = realloc(po->origins, sizeof(bwv_origin_cnt_t) * alloc)) ==
+        NULL) {
+      return -1;
+    }
+    po->origins = origins;
+    po->alloc = alloc;
   }
 
-  kh_value(iter->view->v6pfxs, k)->state = BGPVIEW_FIELD_INACTIVE;
-  iter->view->v6pfxs_cnt[BGPVIEW_FIELD_INACTIVE]++;
-
-  return 0;
+  po->origins[po->cnt].asn = asn;
+  po->origins[po->cnt].cnt = 1;
+  po->cnt++;
+  return 1;
 }
 
-static int add_pfx(bgpview_iter_t *iter, bgpstream_pfx_t *pfx)
+/* count one less active pfx-peer with the given origin. returns 1 if it was
+   the last one (and the origin was removed from the prefix), 0 otherwise */
+static int pfx_origins_remove(bwv_pfx_origins_t *po, uint32_t asn)
 {
-  if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
-    return add_v4pfx(iter, &pfx->bs_ipv4);
-  } else if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV6) {
-    return add_v6pfx(iter, &pfx->bs_ipv6);
+  int i;
+
+  for (i = 0; i < po->cnt; i++) {
+    if (po->origins[i].asn == asn) {
+      break;
+    }
+  }
+  assert(i < po->cnt);
+  if (i == po->cnt || --po->origins[i].cnt > 0) {
+    return 0;
   }
 
-  return -1;
+  po->origins[i] = po->origins[--po->cnt];
+  return 1;
 }
 
-/* ==================== ITERATOR FUNCTIONS ==================== */
+/* add (delta > 0) or remove an active pfx-peer of the given prefix with the
+   given origin to/from the origin index. ret is set to -1 if an allocation
+   fails */
+#define ORIGIN_INDEX_UPDATE(index, ipv, key, asn, delta, ret)                  \
+  do {                                                                         \
+    khiter_t __k, __o;                                                         \
+    int __khret;                                                               \
+    bwv_pfx_origins_t *__po;                                                   \
+    bwv_origin_pfxs_t *__op;                                                   \
+    (ret) = 0;                                                                 \
+    if ((delta) > 0) {                                                         \
+      __k = kh_put(bwv_##ipv##pfx_origins, (index)->ipv##pfxs, (key),          \
+                   &__khret);                                                  \
+      if (__khret < 0) {                                                       \
+        (ret) = -1;                                                            \
+        break;                                                                 \
+      }                                                                        \
+      __po = &kh_val((index)->ipv##pfxs, __k);                                 \
+      if (__khret > 0) {                                                       \
+        memset(__po, 0, sizeof(bwv_pfx_origins_t));                            \
+      }                                                                        \
+      if (((ret) = pfx_origins_add(__po, (asn))) <= 0) {                       \
+        break;                                                                 \
+      }                                                                        \
+      (ret) = 0;                                                               \
+      /* the origin is new for the prefix */                                   \
+      if (__po->cnt == 2) {                                                    \
+        kh_put(bwv_##ipv##pfx_set, (index)->ipv##moas, (key), &__khret);       \
+        if (__khret < 0) {                                                     \
+          (ret) = -1;                                                          \
+          break;                                                               \
+        }                                                                      \
+      }                                                                        \
+      __o = kh_put(bwv_origin_pfxs, (index)->origins, (asn), &__khret);        \
+      if (__khret < 0) {                                                       \
+        (ret) = -1;                                                            \
+        break;                                                                 \
+      }                                                                        \
+      __op = &kh_val((index)->origins, __o);                                   \
+      if (__khret > 0) {                                                       \
+        memset(__op, 0, sizeof(bwv_origin_pfxs_t));                            \
+      }                                                                        \
+      if (__op->ipv##pfxs == NULL &&                                           \
+          (__op->ipv##pfxs = kh_init(bwv_##ipv##pfx_set)) == NULL) {           \
+        (ret) = -1;                                                            \
+        break;                                                                 \
+      }                                                                        \
+      kh_put(bwv_##ipv##pfx_set, __op->ipv##pfxs, (key), &__khret);            \
+      if (__khret < 0) {                                                       \
+        (ret) = -1;                                                            \
+      }                                                                        \
+    } else {                                                                   \
+      __k = kh_get(bwv_##ipv##pfx_origins, (index)->ipv##pfxs, (key));         \
+      assert(__k != kh_end((index)->ipv##pfxs));                               \
+      __po = &kh_val((index)->ipv##pfxs, __k);                                 \
+      if (pfx_origins_remove(__po, (asn)) == 0) {                              \
+        break;                                                                 \
+      }                                                                        \
+      /* that was the last pfx-peer with this origin */                        \
+      if (__po->cnt == 1) {                                                    \
+        kh_del(bwv_##ipv##pfx_set, (index)->ipv##moas,                         \
+               kh_get(bwv_##ipv##pfx_set, (index)->ipv##moas, (key)));         \
+      } else if (__po->cnt == 0) {                                             \
+        free(__po->origins);                                                   \
+        kh_del(bwv_##ipv##pfx_origins, (index)->ipv##pfxs, __k);               \
+      }                                                                        \
+      __o = kh_get(bwv_origin_pfxs, (index)->origins, (asn));                  \
+      assert(__o != kh_end((index)->origins));                                 \
+      __op = &kh_val((index)->origins, __o);                                   \
+      kh_del(bwv_##ipv##pfx_set, __op->ipv##pfxs,                              \
+             kh_get(bwv_##ipv##pfx_set, __op->ipv##pfxs, (key)));              \
+      if (kh_size(__op->ipv##pfxs) == 0) {                                     \
+        kh_destroy(bwv_##ipv##pfx_set, __op->ipv##pfxs);                       \
+        __op->ipv##pfxs = NULL;                                                \
+        if (__op->v4pfxs == NULL && __op->v6pfxs == NULL) {                    \
+          kh_del(bwv_origin_pfxs, (index)->origins, __o);                      \
+        }                                                                      \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
 
-bgpview_iter_t *bgpview_iter_create(bgpview_t *view)
+/* add (delta > 0) or remove an active pfx-peer of the current prefix with
+   the given origin to/from the origin index */
+static void origin_index_update(bgpview_iter_t *iter, uint32_t asn, int delta)
 {
-  bgpview_iter_t *iter;
-
-  /* DEBUG REMOVE ME */
-  fprintf(stderr, "AS Path Store size: %d\n",
-          bgpstream_as_path_store_get_size(view->pathstore));
+  bwv_origin_index_t *index = iter->view->origin_index;
+  int ret;
 
-  if ((iter = malloc_zero(sizeof(bgpview_iter_t))) == NULL) {
-    return NULL;
+  if (asn == 0) {
+    return;
   }
 
-  iter->view = view;
-
-  iter->version_ptr = BGPSTREAM_ADDR_VERSION_IPV4;
-  iter->version_filter = 0; // default: all prefix versions
-
-  iter->pfx_it = 0;
-
-  iter->peer_it = kh_end(iter->view->peerinfo);
+  switch (iter->version_ptr) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    ORIGIN_INDEX_UPDATE(index, v4, BWV_V4PFX(iter->view, iter->pfx_it), asn,
+                        delta, ret);
+    break;
 
-  iter->pfx_peer_it_valid = 0;
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    ORIGIN_INDEX_UPDATE(index, v6, kh_key(iter->view->v6pfxs, iter->pfx_it),
+                        asn, delta, ret);
+    break;
 
-  // default: all valid fields are iterated
-  iter->pfx_state_mask = BGPVIEW_FIELD_ALL_VALID;
-  iter->peer_state_mask = BGPVIEW_FIELD_ALL_VALID;
-  iter->pfx_peer_state_mask = BGPVIEW_FIELD_ALL_VALID;
+  default:
+    ret = -1;
+  }
 
-  return iter;
+  if (ret != 0) {
+    fprintf(stderr, "WARN: Could not update origin index\n");
+    origin_index_reset(index);
+    index->valid = 0;
+  }
 }
 
-void bgpview_iter_destroy(bgpview_iter_t *iter)
+/* record that an active pfx-peer of the current prefix with the given path
+   was added (delta > 0) or removed */
+static void origin_index_pfx_peer(bgpview_iter_t *iter,
+                                  bgpstream_as_path_store_path_id_t path_id,
+                                  int delta)
 {
-  free(iter);
+  if (iter->view->origin_index == NULL ||
+      iter->view->origin_index->valid == 0) {
+    return;
+  }
+  origin_index_update(iter, path_origin_asn(iter->view, path_id), delta);
 }
 
-/* ==================== ITER GETTER/SETTERS ==================== */
+/* record that the path of an active pfx-peer of the current prefix changed */
+static void
+origin_index_pfx_peer_path(bgpview_iter_t *iter,
+                           bgpstream_as_path_store_path_id_t old_path_id,
+                           bgpstream_as_path_store_path_id_t new_path_id)
+{
+  uint32_t old_asn, new_asn;
 
-#define __cnt_by_mask(counter, mask)                                           \
-  (((mask) == BGPVIEW_FIELD_ACTIVE || (mask) == BGPVIEW_FIELD_INACTIVE)        \
-     ? ((counter)[(mask)])                                                     \
-     : ((counter)[BGPVIEW_FIELD_ACTIVE] + (counter)[BGPVIEW_FIELD_INACTIVE]))
+  if (iter->view->origin_index == NULL ||
+      iter->view->origin_index->valid == 0 ||
+      memcmp(&old_path_id, &new_path_id, sizeof(old_path_id)) == 0) {
+    return;
+  }
 
-#define __pfx_field(iter, field) (__pfx_peerinfos((iter))->field)
+  old_asn = path_origin_asn(iter->view, old_path_id);
+  new_asn = path_origin_asn(iter->view, new_path_id);
+  if (old_asn != new_asn) {
+    origin_index_update(iter, old_asn, -1);
+    if (iter->view->origin_index->valid != 0) {
+      origin_index_update(iter, new_asn, 1);
+    }
+  }
+}
 
-#define __iter_get_view(iter) ((iter)->view)
+/* ==================== LPM INDEX ==================== */
 
-bgpview_t *bgpview_iter_get_view(bgpview_iter_t *iter)
+/* host byte order netmask of a v4 prefix of the given length */
+#define BWV_V4_MASK(len) ((len) == 0 ? 0 : (UINT32_MAX << (32 - (len))))
+
+static void lpm_index_reset(bwv_lpm_index_t *lpm)
 {
-  if (iter != NULL) {
-    return __iter_get_view(iter);
+  khiter_t k;
+
+  for (k = kh_begin(lpm->v4groups); k != kh_end(lpm->v4groups); ++k) {
+    if (kh_exist(lpm->v4groups, k)) {
+      free(kh_val(lpm->v4groups, k));
+    }
   }
-  return NULL;
-}
+  kh_clear(bwv_lpm_v4groups, lpm->v4groups);
+  memset(lpm->v4tbl, 0, (1 << 24) * sizeof(uint8_t));
+  memset(lpm->v4len_cnt, 0, sizeof(lpm->v4len_cnt));
+  memset(lpm->v6len_cnt, 0, sizeof(lpm->v6len_cnt));
 
-#define __iter_pfx_get_pfx(iter)                                               \
-  (((iter)->version_ptr == BGPSTREAM_ADDR_VERSION_IPV4)                        \
-     ? ((bgpstream_pfx_t *)&kh_key(iter->view->v4pfxs, iter->pfx_it))          \
-     : ((iter)->version_ptr == BGPSTREAM_ADDR_VERSION_IPV6)                    \
-         ? ((bgpstream_pfx_t *)&kh_key(iter->view->v6pfxs, iter->pfx_it))      \
-         : NULL)
+  lpm->valid = 1;
+}
 
-bgpstream_pfx_t *bgpview_iter_pfx_get_pfx(bgpview_iter_t *iter)
+static void lpm_index_destroy(bwv_lpm_index_t *lpm)
 {
-  return __iter_pfx_get_pfx(iter);
+  if (lpm == NULL) {
+    return;
+  }
+  if (lpm->v4groups != NULL) {
+    if (lpm->v4tbl != NULL) {
+      lpm_index_reset(lpm);
+    }
+    kh_destroy(bwv_lpm_v4groups, lpm->v4groups);
+  }
+  free(lpm->v4tbl);
+  free(lpm);
 }
 
-#define __iter_pfx_get_peer_cnt(iter, state_mask)                              \
-  (__cnt_by_mask(__pfx_field(iter, peers_cnt), state_mask))
-
-int bgpview_iter_pfx_get_peer_cnt(bgpview_iter_t *iter, uint8_t state_mask)
+/* build the v4 prefix of the given length that covers the (host byte order)
+   address */
+static void lpm_v4_pfx(bgpstream_ipv4_pfx_t *pfx, uint32_t addr, int len)
 {
-  return __iter_pfx_get_peer_cnt(iter, state_mask);
+  memset(pfx, 0, sizeof(bgpstream_ipv4_pfx_t));
+  pfx->mask_len = len;
+  pfx->address.version = BGPSTREAM_ADDR_VERSION_IPV4;
+  pfx->address.addr.s_addr = htonl(addr & BWV_V4_MASK(len));
 }
 
-#define __iter_pfx_get_state(iter) (__pfx_field(iter, state))
-
-bgpview_field_state_t bgpview_iter_pfx_get_state(bgpview_iter_t *iter)
+/* build the v6 prefix of the given length that covers the address */
+static void lpm_v6_pfx(bgpstream_ipv6_pfx_t *pfx, const struct in6_addr *addr,
+                       int len)
 {
-  return __iter_pfx_get_state(iter);
+  int i;
+
+  memset(pfx, 0, sizeof(bgpstream_ipv6_pfx_t));
+  pfx->mask_len = len;
+  pfx->address.version = BGPSTREAM_ADDR_VERSION_IPV6;
+  for (i = 0; i < 16 && len > 0; i++, len -= 8) {
+    pfx->address.addr.s6_addr[i] =
+      (len >= 8) ? addr->s6_addr[i] : (addr->s6_addr[i] & (0xff << (8 - len)));
+  }
 }
 
-#define __iter_pfx_get_user(iter) (__pfx_field(iter, user))
-
-void *bgpview_iter_pfx_get_user(bgpview_iter_t *iter)
+/* get the length of the longest active prefix that covers the address and is
+   not longer than max_len, or -1 if there is none. this probes the prefix
+   table once for each length in use */
+static int lpm_probe(bgpview_t *view, bgpstream_ip_addr_t *addr, int max_len)
 {
-  return __iter_pfx_get_user(iter);
+  bwv_lpm_index_t *lpm = view->lpm_index;
+  bgpstream_ipv4_pfx_t v4pfx;
+  bgpstream_ipv6_pfx_t v6pfx;
+  khiter_t k;
+  int len;
+
+  switch (addr->version) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    for (len = max_len; len >= 0; len--) {
+      if (lpm->v4len_cnt[len] == 0) {
+        continue;
+      }
+      lpm_v4_pfx(&v4pfx, ntohl(addr->bs_ipv4.addr.s_addr), len);
+      if ((k = kh_get(bwv_v4pfx_peerid_pfxinfo, view->v4pfxs,
+                      BWV_V4PFX_KEY(&v4pfx))) !=
+            kh_end(view->v4pfxs) &&
+          BWV_PFX_STATE(view, kh_val(view->v4pfxs, k)) ==
+            BGPVIEW_FIELD_ACTIVE) {
+        return len;
+      }
+    }
+    return -1;
+
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    for (len = max_len; len >= 0; len--) {
+      if (lpm->v6len_cnt[len] == 0) {
+        continue;
+      }
+      lpm_v6_pfx(&v6pfx, &addr->bs_ipv6.addr, len);
+      if ((k = kh_get(bwv_v6pfx_peerid_pfxinfo, view->v6pfxs, v6pfx)) !=
+            kh_end(view->v6pfxs) &&
+          BWV_PFX_STATE(view, kh_val(view->v6pfxs, k)) ==
+            BGPVIEW_FIELD_ACTIVE) {
+        return len;
+      }
+    }
+    return -1;
+
+  default:
+    return -1;
+  }
 }
 
-int bgpview_iter_pfx_set_user(bgpview_iter_t *iter, void *user)
+/* get the length of the longest active v4 prefix that covers the (host byte
+   order) address, or -1 if there is none */
+static inline int lpm_v4_lookup(bwv_lpm_index_t *lpm, uint32_t addr)
 {
-  bwv_peerid_pfxinfo_t *pfxinfo = __pfx_peerinfos(iter);
+  uint8_t v = lpm->v4tbl[addr >> 8];
+  khiter_t k;
 
-  if (pfxinfo->user == user) {
-    return 0;
+  if (v == BWV_LPM_V4_GROUP) {
+    k = kh_get(bwv_lpm_v4groups, lpm->v4groups, addr >> 8);
+    assert(k != kh_end(lpm->v4groups));
+    v = kh_val(lpm->v4groups, k)->lens[addr & 0xff];
   }
 
-  if (pfxinfo->user != NULL && iter->view->pfx_user_destructor != NULL) {
-    iter->view->pfx_user_destructor(pfxinfo->user);
-  }
-  pfxinfo->user = user;
-  return 1;
+  return (int)v - 1;
 }
 
-#define __iter_peer_get_peer_id(iter)                                          \
-  (kh_key(iter->view->peerinfo, iter->peer_it))
-
-bgpstream_peer_id_t bgpview_iter_peer_get_peer_id(bgpview_iter_t *iter)
-{
-  return __iter_peer_get_peer_id(iter);
-}
-
-#define __iter_peer_get_sig(iter)                                              \
-  (bgpstream_peer_sig_map_get_sig((iter)->view->peersigns,                     \
-                                  __iter_peer_get_peer_id(iter)))
-
-bgpstream_peer_sig_t *bgpview_iter_peer_get_sig(bgpview_iter_t *iter)
+/* get the sub-table of a /24 slot, creating it if needed */
+static bwv_lpm_v4group_t *lpm_v4_group(bwv_lpm_index_t *lpm, uint32_t slot)
 {
-  return __iter_peer_get_sig(iter);
-}
+  bwv_lpm_v4group_t *g;
+  khiter_t k;
+  int khret;
 
-#define __peer_get_pfx_cnt(iter, state_mask, field)                            \
-  (__cnt_by_mask(kh_value(iter->view->peerinfo, iter->peer_it).field,          \
-                 state_mask))
+  if (lpm->v4tbl[slot] == BWV_LPM_V4_GROUP) {
+    k = kh_get(bwv_lpm_v4groups, lpm->v4groups, slot);
+    assert(k != kh_end(lpm->v4groups));
+    return kh_val(lpm->v4groups, k);
+  }
 
-#define __iter_peer_get_pfx_cnt(iter, version, state_mask)                     \
-  (((version) == BGPSTREAM_ADDR_VERSION_IPV4)                                  \
-     ? (__peer_get_pfx_cnt(iter, state_mask, v4_pfx_cnt))                      \
-     : ((version) == BGPSTREAM_ADDR_VERSION_IPV6)                              \
-         ? (__peer_get_pfx_cnt(iter, state_mask, v6_pfx_cnt))                  \
-         : (__peer_get_pfx_cnt(iter, state_mask, v4_pfx_cnt) +                 \
-            __peer_get_pfx_cnt(iter, state_mask, v6_pfx_cnt)))
+  if ((g = malloc(sizeof(bwv_lpm_v4group_t))) == NULL) {
+    return NULL;
+  }
+  k = kh_put(bwv_lpm_v4groups, lpm->v4groups, slot, &khret);
+  if (khret < 0) {
+    free(g);
+    return NULL;
+  }
+  memset(g->lens, lpm->v4tbl[slot], sizeof(g->lens));
+  g->base = lpm->v4tbl[slot];
+  g->long_cnt = 0;
+  kh_val(lpm->v4groups, k) = g;
+  lpm->v4tbl[slot] = BWV_LPM_V4_GROUP;
 
-int bgpview_iter_peer_get_pfx_cnt(bgpview_iter_t *iter, int version,
-                                  uint8_t state_mask)
-{
-  return __iter_peer_get_pfx_cnt(iter, version, state_mask);
+  return g;
 }
 
-#define __peer_field(iter, field)                                              \
-  (kh_val((iter)->view->peerinfo, (iter)->peer_it).field)
-
-#define __iter_peer_get_state(iter) (__peer_field(iter, state))
+/* replace the length + 1 values in the given range of a /24 sub-table */
+#define LPM_V4_GROUP_SET(g, first, cnt, match, val)                            \
+  do {                                                                         \
+    uint32_t __j;                                                              \
+    for (__j = (first); __j < (first) + (cnt); __j++) {                        \
+      if (match) {                                                             \
+        (g)->lens[__j] = (val);                                                \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
 
-bgpview_field_state_t bgpview_iter_peer_get_state(bgpview_iter_t *iter)
+/* add an active v4 prefix (with host byte order address) to the table */
+static int lpm_v4_add(bwv_lpm_index_t *lpm, uint32_t addr, int len)
 {
-  return __iter_peer_get_state(iter);
-}
+  uint8_t v = len + 1;
+  bwv_lpm_v4group_t *g;
+  khiter_t k;
+  uint32_t i, first, cnt;
 
-#define __iter_peer_get_user(iter) (__peer_field(iter, user))
+  if (len > 24) {
+    if ((g = lpm_v4_group(lpm, addr >> 8)) == NULL) {
+      return -1;
+    }
+    g->long_cnt++;
+    LPM_V4_GROUP_SET(g, addr & 0xff, 1U << (32 - len), g->lens[__j] < v, v);
+    return 0;
+  }
 
-void *bgpview_iter_peer_get_user(bgpview_iter_t *iter)
-{
-  return __iter_peer_get_user(iter);
+  /* longer prefixes inside the range keep their slots */
+  first = addr >> 8;
+  cnt = 1U << (24 - len);
+  for (i = first; i < first + cnt; i++) {
+    if (lpm->v4tbl[i] == BWV_LPM_V4_GROUP) {
+      k = kh_get(bwv_lpm_v4groups, lpm->v4groups, i);
+      g = kh_val(lpm->v4groups, k);
+      if (g->base < v) {
+        g->base = v;
+      }
+      LPM_V4_GROUP_SET(g, 0, 256, g->lens[__j] < v, v);
+    } else if (lpm->v4tbl[i] < v) {
+      lpm->v4tbl[i] = v;
+    }
+  }
+  return 0;
 }
 
-int bgpview_iter_peer_set_user(bgpview_iter_t *iter, void *user)
+/* remove an active v4 prefix (with host byte order address) from the table.
+   the slots it was the longest match for fall back to the longest shorter
+   prefix that covers it, which is the same for all of them */
+static void lpm_v4_remove(bgpview_t *view, uint32_t addr, int len)
 {
-  void *cur_user = __peer_field(iter, user);
-
-  if (cur_user == user) {
-    return 0;
+  bwv_lpm_index_t *lpm = view->lpm_index;
+  bgpstream_ip_addr_t a;
+  uint8_t v = len + 1;
+  uint8_t f;
+  bwv_lpm_v4group_t *g;
+  khiter_t k;
+  uint32_t i, first, cnt;
+
+  memset(&a, 0, sizeof(a));
+  a.version = BGPSTREAM_ADDR_VERSION_IPV4;
+  a.bs_ipv4.addr.s_addr = htonl(addr);
+  f = lpm_probe(view, &a, len - 1) + 1;
+
+  if (len > 24) {
+    k = kh_get(bwv_lpm_v4groups, lpm->v4groups, addr >> 8);
+    assert(k != kh_end(lpm->v4groups));
+    g = kh_val(lpm->v4groups, k);
+    LPM_V4_GROUP_SET(g, addr & 0xff, 1U << (32 - len), g->lens[__j] == v, f);
+    if (--g->long_cnt == 0) {
+      lpm->v4tbl[addr >> 8] = g->base;
+      free(g);
+      kh_del(bwv_lpm_v4groups, lpm->v4groups, k);
+    }
+    return;
   }
 
-  if (cur_user != NULL && iter->view->peer_user_destructor != NULL) {
-    iter->view->peer_user_destructor(cur_user);
+  first = addr >> 8;
+  cnt = 1U << (24 - len);
+  for (i = first; i < first + cnt; i++) {
+    if (lpm->v4tbl[i] == BWV_LPM_V4_GROUP) {
+      k = kh_get(bwv_lpm_v4groups, lpm->v4groups, i);
+      g = kh_val(lpm->v4groups, k);
+      if (g->base == v) {
+        g->base = f;
+      }
+      LPM_V4_GROUP_SET(g, 0, 256, g->lens[__j] == v, f);
+    } else if (lpm->v4tbl[i] == v) {
+      lpm->v4tbl[i] = f;
+    }
   }
-
-  kh_val(iter->view->peerinfo, iter->peer_it).user = user;
-  return 1;
 }
 
-#define __pfx_peer_field(iter, field)                                          \
-  (BWV_PFX_GET_PEER_PTR((iter)->view, __pfx_peerinfos(iter),                   \
-                        (iter)->pfx_peer_it)                                   \
-     ->field)
+/* record that the current prefix of the iterator was activated (delta > 0)
+   or deactivated */
+static void lpm_index_pfx(bgpview_iter_t *iter, int delta)
+{
+  bwv_lpm_index_t *lpm = iter->view->lpm_index;
+  bgpstream_ipv4_pfx_t v4pfx;
+  bgpstream_ipv6_pfx_t *v6pfx;
+  uint32_t addr;
+  int ret = 0;
 
-#define __iter_pfx_peer_get_as_path_store_path(iter)                           \
-  (bgpstream_as_path_store_get_store_path((iter)->view->pathstore,             \
-                                          __pfx_peer_field(iter, as_path_id)))
+  if (lpm == NULL || lpm->valid == 0) {
+    return;
+  }
 
-bgpstream_as_path_store_path_t *
-bgpview_iter_pfx_peer_get_as_path_store_path(bgpview_iter_t *iter)
-{
-  return __iter_pfx_peer_get_as_path_store_path(iter);
-}
+  switch (iter->version_ptr) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    v4pfx = BWV_V4PFX(iter->view, iter->pfx_it);
+    addr = ntohl(v4pfx.address.addr.s_addr) & BWV_V4_MASK(v4pfx.mask_len);
+    if (delta > 0) {
+      lpm->v4len_cnt[v4pfx.mask_len]++;
+      ret = lpm_v4_add(lpm, addr, v4pfx.mask_len);
+    } else {
+      lpm->v4len_cnt[v4pfx.mask_len]--;
+      lpm_v4_remove(iter->view, addr, v4pfx.mask_len);
+    }
+    break;
 
-#define __iter_pfx_peer_get_as_path_store_path_id(iter)                        \
-  (__pfx_peer_field(iter, as_path_id))
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    v6pfx = &kh_key(iter->view->v6pfxs, iter->pfx_it);
+    if (delta > 0) {
+      lpm->v6len_cnt[v6pfx->mask_len]++;
+    } else {
+      lpm->v6len_cnt[v6pfx->mask_len]--;
+    }
+    break;
 
-bgpstream_as_path_store_path_id_t
-bgpview_iter_pfx_peer_get_as_path_store_path_id(bgpview_iter_t *iter)
-{
-  return __iter_pfx_peer_get_as_path_store_path_id(iter);
-}
+  default:
+    ret = -1;
+  }
 
-#define __iter_pfx_peer_get_as_path(iter)                                      \
-  (bgpstream_as_path_store_path_get_path(                                      \
-    __iter_pfx_peer_get_as_path_store_path(iter),                              \
-    (__iter_peer_get_sig(iter))->peer_asnumber))
+  if (ret != 0) {
+    fprintf(stderr, "WARN: Could not update LPM index\n");
+    lpm_index_reset(lpm);
+    lpm->valid = 0;
+  }
+}
 
-bgpstream_as_path_t *bgpview_iter_pfx_peer_get_as_path(bgpview_iter_t *iter)
+/* find the index of the given peer in a pfx-peer vector, returns vec->size if
+   the peer is not present */
+static inline uint16_t peervec_get(bwv_pfx_peervec_t *vec,
+                                   bgpstream_peer_id_t peerid)
 {
-  return __iter_pfx_peer_get_as_path(iter);
+  int lo = 0;
+  int hi = vec->size - 1;
+  int mid;
+
+  while (lo <= hi) {
+    mid = (lo + hi) / 2;
+    if (vec->ids[mid] == peerid) {
+      return mid;
+    }
+    if (vec->ids[mid] < peerid) {
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return vec->size;
 }
 
-#define __iter_pfx_peer_get_origin_seg(iter)                                   \
-  (bgpstream_as_path_store_path_get_origin_seg(                                \
-    __iter_pfx_peer_get_as_path_store_path(iter)))
+/* ==================== PEER INDEX ==================== */
 
-bgpstream_as_path_seg_t *
-bgpview_iter_pfx_peer_get_origin_seg(bgpview_iter_t *iter)
+#define BWV_BITS_WORDS(nbits) (((nbits) + 63) / 64)
+
+static void peer_index_free_bits(bwv_peer_index_t *index)
 {
-  return __iter_pfx_peer_get_origin_seg(iter);
-}
+  uint32_t i;
 
-#define __iter_pfx_peer_as_path_seg_iter_reset(iter)                           \
-  (bgpstream_as_path_store_path_iter_reset(                                    \
-    __iter_pfx_peer_get_as_path_store_path(iter), &(iter)->pfx_peer_path_it,   \
-    __iter_peer_get_sig(iter)->peer_asnumber))
+  for (i = 0; i < index->peers_alloc; i++) {
+    free(index->peers[i].v4.list);
+    free(index->peers[i].v4.bits);
+    free(index->peers[i].v6.list);
+    free(index->peers[i].v6.bits);
+  }
+  if (index->peers != NULL) {
+    memset(index->peers, 0, sizeof(bwv_peer_pfxs_t) * index->peers_alloc);
+  }
+}
 
-void bgpview_iter_pfx_peer_as_path_seg_iter_reset(bgpview_iter_t *iter)
+static void peer_index_reset(bgpview_t *view, bwv_peer_index_t *index)
 {
-  __iter_pfx_peer_as_path_seg_iter_reset(iter);
-}
+  peer_index_free_bits(index);
+  index->v4_nbits = kh_n_buckets(view->v4pfxs);
+  index->v6_nbits = kh_n_buckets(view->v6pfxs);
 
-#define __iter_pfx_peer_as_path_seg_next(iter)                                 \
-  (bgpstream_as_path_store_path_get_next_seg(&iter->pfx_peer_path_it))
+  index->valid = 1;
+}
 
-bgpstream_as_path_seg_t *
-bgpview_iter_pfx_peer_as_path_seg_next(bgpview_iter_t *iter)
+static void peer_index_destroy(bwv_peer_index_t *index)
 {
-  return __iter_pfx_peer_as_path_seg_next(iter);
+  if (index == NULL) {
+    return;
+  }
+  peer_index_free_bits(index);
+  free(index->peers);
+  free(index);
 }
 
-int bgpview_iter_pfx_peer_set_as_path(bgpview_iter_t *iter,
-                                      bgpstream_as_path_t *as_path)
+/* get the buckets of the given peer for the table of the given version,
+   growing the index for the peer if requested. returns NULL if the index has
+   no buckets for the peer (or could not be grown) */
+static bwv_peer_bkts_t *peer_index_bkts(bwv_peer_index_t *index,
+                                        bgpstream_peer_id_t peerid,
+                                        int version, int create)
 {
-  bgpstream_as_path_store_path_id_t *id = &(__pfx_peer_field(iter, as_path_id));
-
-  bgpstream_peer_sig_t *ps = __iter_peer_get_sig(iter);
+  bwv_peer_pfxs_t *peers;
+  uint32_t alloc;
 
-  if (bgpstream_as_path_store_get_path_id(iter->view->pathstore, as_path,
-                                          ps->peer_asnumber, id) != 0) {
-    fprintf(stderr, "ERROR: Failed to get AS Path ID from store\n");
-    return -1;
+  if (peerid >= index->peers_alloc) {
+    if (create == 0) {
+      return NULL;
+    }
+    alloc = (uint32_t)peerid + 1;
+    if ((peers = realloc(index->peers, sizeof(bwv_peer_pfxs_t) * alloc)) ==
+        NULL) {
+      return NULL;
+    }
+    memset(&peers[index->peers_alloc], 0,
+           sizeof(bwv_peer_pfxs_t) * (alloc - index->peers_alloc));
+    index->peers = peers;
+    index->peers_alloc = alloc;
   }
 
-  return 0;
+  if (version == BGPSTREAM_ADDR_VERSION_IPV4) {
+    return &index->peers[peerid].v4;
+  }
+  return &index->peers[peerid].v6;
 }
 
-int bgpview_iter_pfx_peer_set_as_path_by_id(
-  bgpview_iter_t *iter, bgpstream_as_path_store_path_id_t path_id)
+/* does the prefix in the given bucket of the table of the given version have
+   a valid pfx-peer for the given peer? */
+static int peer_index_bkt_is_valid(bgpview_t *view, int version,
+                                   khiter_t bkt, bgpstream_peer_id_t peerid)
 {
-  (__pfx_peer_field(iter, as_path_id)) = path_id;
-  return 0;
-}
+  bwv_peerid_pfxinfo_t *pfxinfo;
+  uint16_t i;
+  khiter_t k;
 
-#define __iter_pfx_peer_get_state(iter)                                        \
-  (BWV_PFX_GET_PEER_STATE(iter->view, __pfx_peerinfos(iter), iter->pfx_peer_it))
+  if (version == BGPSTREAM_ADDR_VERSION_IPV4) {
+    if (bkt >= kh_end(view->v4pfxs) || !kh_exist(view->v4pfxs, bkt)) {
+      return 0;
+    }
+    pfxinfo = kh_val(view->v4pfxs, bkt);
+  } else {
+    if (bkt >= kh_end(view->v6pfxs) || !kh_exist(view->v6pfxs, bkt)) {
+      return 0;
+    }
+    pfxinfo = kh_val(view->v6pfxs, bkt);
+  }
+  if (BWV_PFX_STATE(view, pfxinfo) == BGPVIEW_FIELD_INVALID ||
+      pfxinfo->peers_generic == NULL) {
+    return 0;
+  }
 
-bgpview_field_state_t bgpview_iter_pfx_peer_get_state(bgpview_iter_t *iter)
-{
-  return __iter_pfx_peer_get_state(iter);
+  if (BWV_PFX_PEERS_ARE_VEC(view)) {
+    return (i = peervec_get(pfxinfo->peers_vec, peerid)) !=
+             pfxinfo->peers_vec->size &&
+           BWV_PEERVEC_GET_PEER(view, pfxinfo->peers_vec, i)->state !=
+             BGPVIEW_FIELD_INVALID;
+  } else if (view->disable_extended) {
+    return (k = kh_get(bwv_peerid_pfx_peerinfo, pfxinfo->peers_min,
+                       peerid)) != kh_end(pfxinfo->peers_min) &&
+           kh_val(pfxinfo->peers_min, k).state != BGPVIEW_FIELD_INVALID;
+  }
+  return (k = kh_get(bwv_peerid_pfx_peerinfo_ext, pfxinfo->peers_ext,
+                     peerid)) != kh_end(pfxinfo->peers_ext) &&
+         kh_val(pfxinfo->peers_ext, k).state != BGPVIEW_FIELD_INVALID;
 }
 
-#define __iter_pfx_peer_get_user(iter)                                         \
-  (BWV_PFX_GET_PEER_EXT(__pfx_peerinfos(iter), iter->pfx_peer_it).user)
-
-void *bgpview_iter_pfx_peer_get_user(bgpview_iter_t *iter)
+static int peer_index_bkt_cmp(const void *a, const void *b)
 {
-  ASSERT_BWV_PFX_PEERINFO_EXT(iter->view);
-  return __iter_pfx_peer_get_user(iter);
+  khiter_t x = *(const khiter_t *)a;
+  khiter_t y = *(const khiter_t *)b;
+  return (x > y) - (x < y);
 }
 
-int bgpview_iter_pfx_peer_set_user(bgpview_iter_t *iter, void *user)
+/* sort the bucket list of a peer, and drop duplicate buckets and buckets that
+   no longer hold a pfx-peer of the peer */
+static void peer_index_compact(bgpview_t *view, bwv_peer_bkts_t *bkts,
+                               int version, bgpstream_peer_id_t peerid)
 {
-  ASSERT_BWV_PFX_PEERINFO_EXT(iter->view);
+  uint32_t i, j;
 
-  void *cur_user = __iter_pfx_peer_get_user(iter);
+  qsort(bkts->list, bkts->cnt, sizeof(khiter_t), peer_index_bkt_cmp);
+  for (i = 0, j = 0; i < bkts->cnt; i++) {
+    if ((j > 0 && bkts->list[i] == bkts->list[j - 1]) ||
+        peer_index_bkt_is_valid(view, version, bkts->list[i], peerid) == 0) {
+      continue;
+    }
+    bkts->list[j++] = bkts->list[i];
+  }
+  bkts->cnt = j;
+  bkts->removed = 0;
+}
 
-  if (cur_user == user) {
-    return 0;
+/* add a bucket to the buckets of a peer, switching to a bitmap once the list
+   would be larger than one */
+static int peer_index_bkts_add(bgpview_t *view, bwv_peer_bkts_t *bkts,
+                               int version, bgpstream_peer_id_t peerid,
+                               khiter_t bkt)
+{
+  khint_t nbits = (version == BGPSTREAM_ADDR_VERSION_IPV4)
+                    ? view->peer_index->v4_nbits
+                    : view->peer_index->v6_nbits;
+  khiter_t *list;
+  uint32_t alloc;
+  uint32_t i;
+
+  if (bkts->bits == NULL && bkts->cnt == bkts->alloc && bkts->removed > 0 &&
+      bkts->removed >= bkts->cnt / 2) {
+    peer_index_compact(view, bkts, version, peerid);
   }
 
-  if (cur_user != NULL && iter->view->pfx_peer_user_destructor != NULL) {
-    iter->view->pfx_peer_user_destructor(cur_user);
+  if (bkts->bits == NULL && bkts->cnt == bkts->alloc) {
+    alloc = (bkts->alloc == 0) ? 8 : bkts->alloc * 2;
+    if ((uint64_t)alloc * sizeof(khiter_t) <
+        BWV_BITS_WORDS(nbits) * sizeof(uint64_t)) {
+      if ((list = realloc(bkts->list, sizeof(khiter_t) * alloc)) == NULL) {
+        return -1;
+      }
+      bkts->list = list;
+      bkts->alloc = alloc;
+    } else {
+      if ((bkts->bits = calloc(BWV_BITS_WORDS(nbits), sizeof(uint64_t))) ==
+          NULL) {
+        return -1;
+      }
+      for (i = 0; i < bkts->cnt; i++) {
+        if (peer_index_bkt_is_valid(view, version, bkts->list[i], peerid)) {
+          bkts->bits[bkts->list[i] / 64] |=
+            (UINT64_C(1) << (bkts->list[i] % 64));
+        }
+      }
+      free(bkts->list);
+      bkts->list = NULL;
+      bkts->cnt = bkts->alloc = bkts->removed = 0;
+    }
   }
 
-  BWV_PFX_GET_PEER_EXT(__pfx_peerinfos(iter), iter->pfx_peer_it).user = user;
-  return 1;
+  if (bkts->bits != NULL) {
+    bkts->bits[bkt / 64] |= (UINT64_C(1) << (bkt % 64));
+  } else {
+    bkts->list[bkts->cnt++] = bkt;
+  }
+  return 0;
 }
 
-/* ==================== PEER ITERATORS ==================== */
-
-/* internal macros, optimized for performance */
-
-#define WHILE_NOT_MATCHED_PEER(iter)                                           \
-  while (iter->peer_it != kh_end(iter->view->peerinfo) &&                      \
-         (!kh_exist(iter->view->peerinfo, iter->peer_it) ||                    \
-          !(iter->peer_state_mask &                                            \
-            kh_val(iter->view->peerinfo, iter->peer_it).state)))
-
-#define __iter_first_peer(iter, state_mask)                                    \
+/* invalidate the peer index and the sorted index of the given prefix table if
+   adding a key to the table could rehash it (which khash does when the table
+   reaches its upper bound of occupied buckets, whether or not it grows, and
+   whether or not the key is already there) */
+#define PFX_TABLE_CHECK_PUT(view, table, index)                                \
   do {                                                                         \
-    iter->peer_it = kh_begin(iter->view->peerinfo);                            \
-    iter->peer_state_mask = state_mask;                                        \
-    iter->pfx_peer_it_valid = 0;                                               \
-    /* keep searching if this does not exist */                                \
-    WHILE_NOT_MATCHED_PEER(iter)                                               \
-    {                                                                          \
-      iter->peer_it++;                                                         \
+    if ((table)->n_occupied >= (table)->upper_bound) {                         \
+      (view)->rehash_gen++;                                                    \
+      if ((view)->peer_index != NULL) {                                        \
+        (view)->peer_index->valid = 0;                                         \
+      }                                                                        \
+      (index).valid = 0;                                                       \
     }                                                                          \
   } while (0)
 
-#define __iter_next_peer(iter)                                                 \
-  do {                                                                         \
-    do {                                                                       \
-      iter->peer_it++;                                                         \
-    }                                                                          \
-    WHILE_NOT_MATCHED_PEER(iter);                                              \
-  } while (0)
+/* record that the given peer got a valid pfx-peer on the current prefix of the
+   iterator (set > 0), or lost it */
+static void peer_index_pfx_peer(bgpview_iter_t *iter,
+                                bgpstream_peer_id_t peerid, int set)
+{
+  bwv_peer_index_t *index = iter->view->peer_index;
+  bwv_peer_bkts_t *bkts;
 
-#define __iter_has_more_peer(iter)                                             \
-  (iter->peer_it != kh_end(iter->view->peerinfo))
+  if (index == NULL || index->valid == 0) {
+    return;
+  }
 
-#define __iter_seek_peer(iter, peerid, state_mask)                             \
-  do {                                                                         \
-    iter->peer_state_mask = state_mask;                                        \
-    iter->peer_it = kh_get(bwv_peerid_peerinfo, iter->view->peerinfo, peerid); \
-  } while (0)
+  if ((bkts = peer_index_bkts(index, peerid, iter->version_ptr, set)) ==
+      NULL) {
+    if (set != 0) {
+      fprintf(stderr, "WARN: Could not update peer index\n");
+      index->valid = 0;
+    }
+    return;
+  }
 
-/* external functions */
+  if (set == 0) {
+    if (bkts->bits != NULL) {
+      bkts->bits[iter->pfx_it / 64] &= ~(UINT64_C(1) << (iter->pfx_it % 64));
+    } else if (bkts->cnt > 0) {
+      /* the bucket is dropped from the list when it is next compacted */
+      bkts->removed++;
+    }
+    return;
+  }
 
-int bgpview_iter_first_peer(bgpview_iter_t *iter, uint8_t state_mask)
-{
-  __iter_first_peer(iter, state_mask);
-  return __iter_has_more_peer(iter);
+  if (peer_index_bkts_add(iter->view, bkts, iter->version_ptr, peerid,
+                          iter->pfx_it) != 0) {
+    fprintf(stderr, "WARN: Could not update peer index\n");
+    index->valid = 0;
+  }
 }
 
-int bgpview_iter_next_peer(bgpview_iter_t *iter)
+/* get the number of bytes used by the peer index of a view */
+static uint64_t peer_index_bytes(bwv_peer_index_t *index)
 {
-  __iter_next_peer(iter);
-  return __iter_has_more_peer(iter);
-}
+  uint64_t bytes;
+  uint32_t i;
 
-int bgpview_iter_has_more_peer(bgpview_iter_t *iter)
+  if (index == NULL) {
+    return 0;
+  }
+  bytes = sizeof(bwv_peer_index_t) +
+          (uint64_t)index->peers_alloc * sizeof(bwv_peer_pfxs_t);
+  for (i = 0; i < index->peers_alloc; i++) {
+    bytes += (uint64_t)(index->peers[i].v4.alloc + index->peers[i].v6.alloc) *
+             sizeof(khiter_t);
+    if (index->peers[i].v4.bits != NULL) {
+      bytes += BWV_BITS_WORDS(index->v4_nbits) * sizeof(uint64_t);
+    }
+    if (index->peers[i].v6.bits != NULL) {
+      bytes += BWV_BITS_WORDS(index->v6_nbits) * sizeof(uint64_t);
+    }
+  }
+  return bytes;
+}
+
+static void peerinfo_reset(bwv_peerinfo_t *v)
 {
-  return __iter_has_more_peer(iter);
+  v->state = BGPVIEW_FIELD_INVALID;
+  v->v4_pfx_cnt[BGPVIEW_FIELD_INACTIVE] = 0;
+  v->v4_pfx_cnt[BGPVIEW_FIELD_ACTIVE] = 0;
+  v->v6_pfx_cnt[BGPVIEW_FIELD_INACTIVE] = 0;
+  v->v6_pfx_cnt[BGPVIEW_FIELD_ACTIVE] = 0;
 }
 
-int bgpview_iter_seek_peer(bgpview_iter_t *iter, bgpstream_peer_id_t peerid,
-                           uint8_t state_mask)
+static void peerinfo_destroy_user(bgpview_t *view)
 {
-  iter->pfx_peer_it_valid = 0; // moving peer_it invalidates pfx_peer_it
-  __iter_seek_peer(iter, peerid, state_mask);
-  if (iter->peer_it == kh_end(iter->view->peerinfo)) {
-    return 0;
+  khiter_t k;
+  if (view->peer_user_destructor == NULL) {
+    return;
   }
-  if (iter->peer_state_mask &
-      kh_val(iter->view->peerinfo, iter->peer_it).state) {
-    return 1;
+  for (k = kh_begin(view->peerinfo); k != kh_end(view->peerinfo); ++k) {
+    if (!kh_exist(view->peerinfo, k) ||
+        (kh_value(view->peerinfo, k).user == NULL)) {
+      continue;
+    }
+    view->peer_user_destructor(kh_value(view->peerinfo, k).user);
+    kh_value(view->peerinfo, k).user = NULL;
   }
-  iter->peer_it = kh_end(iter->view->peerinfo);
-  return 0;
 }
 
-/* ==================== PFX ITERATORS ==================== */
-
-#define WHILE_NOT_MATCHED_PFX(iter, table)                                     \
-  while ((iter)->pfx_it != kh_end((table)) &&   /* each hash item */           \
-         (!kh_exist((table), (iter)->pfx_it) || /* in hash? */                 \
-          !((iter)->pfx_state_mask &            /* correct state? */           \
-            kh_val((table), (iter)->pfx_it)->state)))
-
-#define __pfx_valid(iter, table) ((iter)->pfx_it != kh_end((table)))
+/* find the size class of a pfx-peer vector with space for alloc pfx-peers */
+static inline int peervec_class(uint32_t alloc)
+{
+  int c = 0;
+  while (((uint32_t)1 << c) < alloc) {
+    c++;
+  }
+  return c;
+}
 
-#define RETURN_IF_PFX_VALID(iter, table)                                       \
-  do {                                                                         \
-    if (__pfx_valid(iter, table)) {                                            \
-      return 1;                                                                \
-    }                                                                          \
-  } while (0)
+static void peervec_slabs_destroy(bgpview_t *view)
+{
+  int c;
+  for (c = 0; c < BWV_PEERVEC_SLAB_CLASSES; c++) {
+    bgpview_slab_destroy(view->alloc->peervec_slabs[c]);
+    view->alloc->peervec_slabs[c] = NULL;
+  }
+}
 
-int bgpview_iter_first_pfx(bgpview_iter_t *iter, int version,
-                           uint8_t state_mask)
+/* drop the reference of the view to its allocator, destroying the allocator
+   (and all the memory allocated from it) if this was the last user */
+static void allocator_release(bgpview_t *view)
 {
-  // set the version we iterate through
-  iter->version_filter = version;
+  if (view->alloc == NULL) {
+    return;
+  }
+  if (--view->alloc->refcnt == 0) {
+    bgpview_slab_destroy(view->alloc->pfxinfo_slab);
+    peervec_slabs_destroy(view);
+    free(view->alloc);
+  }
+  view->alloc = NULL;
+}
 
-  // set the version we start iterating through
-  if (iter->version_filter == BGPSTREAM_ADDR_VERSION_IPV4 ||
-      iter->version_filter == 0) {
-    iter->version_ptr = BGPSTREAM_ADDR_VERSION_IPV4;
+/* allocate an empty pfx-peer vector with space for at least alloc pfx-peers
+   (rounded up to the capacity of the size class) */
+static bwv_pfx_peervec_t *peervec_alloc(bgpview_t *view, uint16_t alloc)
+{
+  bwv_pfx_peervec_t *vec;
+  int c = peervec_class(alloc);
+  uint32_t cap = (uint32_t)1 << c;
+  size_t bytes;
+  uint32_t chunk_objs;
+
+  if (cap > UINT16_MAX) {
+    cap = UINT16_MAX;
+  }
+  bytes = sizeof(bwv_pfx_peervec_t) +
+          (cap * (sizeof(bgpstream_peer_id_t) + BWV_PFX_PEERINFO_SIZE(view)));
+
+  if (c < BWV_PEERVEC_SLAB_CLASSES) {
+    if (view->alloc->peervec_slabs[c] == NULL) {
+      chunk_objs = BWV_PEERVEC_SLAB_CHUNK_BYTES / bytes;
+      if ((view->alloc->peervec_slabs[c] = bgpview_slab_create(
+             bytes, (chunk_objs == 0) ? 1 : chunk_objs)) == NULL) {
+        return NULL;
+      }
+    }
+    vec = bgpview_slab_alloc(view->alloc->peervec_slabs[c]);
   } else {
-    iter->version_ptr = BGPSTREAM_ADDR_VERSION_IPV6;
+    vec = malloc(bytes);
+  }
+  if (vec == NULL) {
+    return NULL;
   }
 
-  // set the pfx mask
-  iter->pfx_state_mask = state_mask;
+  vec->ids = (bgpstream_peer_id_t *)(vec + 1);
+  vec->infos = (uint8_t *)(vec->ids + cap);
+  vec->size = 0;
+  vec->alloc = cap;
+  return vec;
+}
 
-  // moving pfx_it invalidates pfx_peer_it
-  iter->pfx_peer_it_valid = 0;
+static void peervec_free(bgpview_t *view, bwv_pfx_peervec_t *vec)
+{
+  int c;
 
-  if (iter->version_ptr == BGPSTREAM_ADDR_VERSION_IPV4) {
-    iter->pfx_it = kh_begin(iter->view->v4pfxs);
-    /* keep searching if this does not exist */
-    WHILE_NOT_MATCHED_PFX(iter, iter->view->v4pfxs)
-    {
-      iter->pfx_it++;
-    }
-    RETURN_IF_PFX_VALID(iter, iter->view->v4pfxs);
+  if (vec == NULL) {
+    return;
+  }
+  if ((c = peervec_class(vec->alloc)) < BWV_PEERVEC_SLAB_CLASSES) {
+    bgpview_slab_free(view->alloc->peervec_slabs[c], vec);
+  } else {
+    free(vec);
+  }
+}
 
-    // no ipv4 prefix was found, we don't look for other versions
-    // unless version_filter is zero
-    if (iter->version_filter) {
-      return 0;
-    }
+static bwv_pfx_peervec_t *peervec_resize(bgpview_t *view,
+                                         bwv_pfx_peervec_t *vec,
+                                         uint16_t alloc)
+{
+  bwv_pfx_peervec_t *new_vec;
+  uint16_t size = (vec == NULL) ? 0 : vec->size;
 
-    // continue to the next IP version
-    iter->version_ptr = BGPSTREAM_ADDR_VERSION_IPV6;
+  assert(alloc >= size);
+
+  if ((new_vec = peervec_alloc(view, alloc)) == NULL) {
+    return NULL;
   }
 
-  if (iter->version_ptr == BGPSTREAM_ADDR_VERSION_IPV6) {
-    iter->pfx_it = kh_begin(iter->view->v6pfxs);
-    /* keep searching if this does not exist */
-    WHILE_NOT_MATCHED_PFX(iter, iter->view->v6pfxs)
-    {
-      iter->pfx_it++;
-    }
-    RETURN_IF_PFX_VALID(iter, iter->view->v6pfxs);
+  if (vec != NULL) {
+    memcpy(new_vec->ids, vec->ids, size * sizeof(bgpstream_peer_id_t));
+    memcpy(new_vec->infos, vec->infos, size * BWV_PFX_PEERINFO_SIZE(view));
+    new_vec->size = size;
+    peervec_free(view, vec);
   }
 
-  return 0;
+  return new_vec;
 }
 
-#define __iter_next_pfx_v4(iter)                                               \
-  do {                                                                         \
-    /* skip to the next v4 pfx */                                              \
-    do {                                                                       \
-      (iter)->pfx_it++;                                                        \
-    }                                                                          \
-    WHILE_NOT_MATCHED_PFX(iter, (iter)->view->v4pfxs);                         \
-    /* if no v4 pfx, but considering all versions... */                        \
-    if (__pfx_valid(iter, (iter)->view->v4pfxs) == 0 &&                        \
-        (iter)->version_filter == 0) {                                         \
-      /* skip to the first v6 pfx */                                           \
-      bgpview_iter_first_pfx((iter), BGPSTREAM_ADDR_VERSION_IPV6,              \
-                             (iter)->pfx_state_mask);                          \
-    }                                                                          \
-    /* here: valid v4, valid v6, or invalid */                                 \
-  } while (0)
-
-#define __iter_next_pfx_v6(iter)                                               \
-  do {                                                                         \
-    do {                                                                       \
-      iter->pfx_it++;                                                          \
-    }                                                                          \
-    WHILE_NOT_MATCHED_PFX(iter, iter->view->v6pfxs);                           \
-  } while (0)
+/* insert the given peer into a pfx-peer vector (if not already present),
+   returns the index of the peer, or -1 on failure */
+static int peervec_put(bgpview_t *view, bwv_pfx_peervec_t **vecp,
+                       bgpstream_peer_id_t peerid, int *ret)
+{
+  bwv_pfx_peervec_t *vec = *vecp;
+  size_t isize = BWV_PFX_PEERINFO_SIZE(view);
+  uint32_t alloc;
+  int lo = 0;
+  int hi = vec->size - 1;
+  int mid;
+
+  /* binary search for the insertion point */
+  while (lo <= hi) {
+    mid = (lo + hi) / 2;
+    if (vec->ids[mid] == peerid) {
+      *ret = 0;
+      return mid;
+    }
+    if (vec->ids[mid] < peerid) {
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
 
-#define __iter_next_pfx(iter)                                                  \
-  do {                                                                         \
-    (iter)->pfx_peer_it_valid = 0;                                             \
-    if ((iter)->version_ptr == BGPSTREAM_ADDR_VERSION_IPV4) {                  \
-      __iter_next_pfx_v4(iter);                                                \
-    } else {                                                                   \
-      __iter_next_pfx_v6(iter);                                                \
-    }                                                                          \
-  } while (0)
+  if (vec->size == vec->alloc) {
+    alloc = (vec->alloc == 0) ? 2 : vec->alloc * 2;
+    if (alloc > UINT16_MAX) {
+      alloc = UINT16_MAX;
+    }
+    if ((vec = peervec_resize(view, vec, alloc)) == NULL) {
+      *ret = -1;
+      return -1;
+    }
+    *vecp = vec;
+  }
 
-#define __iter_has_more_pfx_v(iter, table) ((iter)->pfx_it != kh_end((table)))
+  /* shift everything after the insertion point */
+  memmove(&vec->ids[lo + 1], &vec->ids[lo],
+          (vec->size - lo) * sizeof(bgpstream_peer_id_t));
+  memmove(vec->infos + ((lo + 1) * isize), vec->infos + (lo * isize),
+          (vec->size - lo) * isize);
+  vec->ids[lo] = peerid;
+  vec->size++;
 
-#define __iter_has_more_pfx(iter)                                              \
-  (((iter)->version_ptr == BGPSTREAM_ADDR_VERSION_IPV4)                        \
-     ? (__iter_has_more_pfx_v((iter), iter->view->v4pfxs))                     \
-     : ((iter)->version_ptr == BGPSTREAM_ADDR_VERSION_IPV6)                    \
-         ? (__iter_has_more_pfx_v((iter), iter->view->v6pfxs))                 \
-         : 0)
+  *ret = 1;
+  return lo;
+}
 
-int bgpview_iter_next_pfx(bgpview_iter_t *iter)
+/* allocate an (uninitialized) prefix record from the slab of the view */
+static bwv_peerid_pfxinfo_t *pfxinfo_alloc(bgpview_t *view)
 {
-  __iter_next_pfx(iter);
-  return __iter_has_more_pfx(iter);
+  if (view->alloc->pfxinfo_slab == NULL &&
+      (view->alloc->pfxinfo_slab = bgpview_slab_create(
+         sizeof(bwv_peerid_pfxinfo_t), BWV_PFXINFO_SLAB_CHUNK_OBJS)) == NULL) {
+    return NULL;
+  }
+
+  return bgpview_slab_alloc(view->alloc->pfxinfo_slab);
 }
 
-int bgpview_iter_has_more_pfx(bgpview_iter_t *iter)
+static bwv_peerid_pfxinfo_t *peerid_pfxinfo_create(bgpview_t *view)
 {
-  return __iter_has_more_pfx(iter);
+  bwv_peerid_pfxinfo_t *v;
+
+  if ((v = pfxinfo_alloc(view)) == NULL) {
+    return NULL;
+  }
+  memset(v, 0, sizeof(bwv_peerid_pfxinfo_t));
+  v->state = BGPVIEW_FIELD_INVALID;
+  v->epoch = view->epoch;
+  v->refcnt = 1;
+
+  /* all other fields are memset to 0 */
+
+  return v;
 }
 
-int bgpview_iter_seek_pfx(bgpview_iter_t *iter, bgpstream_pfx_t *pfx,
-                          uint8_t state_mask)
+/* make sure that the pfx-peer table of a prefix has room for cnt more
+   pfx-peers, so that they can be inserted without growing it step by step */
+static int peerid_pfxinfo_reserve(bgpview_t *view, bwv_peerid_pfxinfo_t *v,
+                                  int cnt)
 {
-  iter->version_filter = pfx->address.version;
-  iter->version_ptr = pfx->address.version;
-  iter->pfx_state_mask = state_mask;
-  iter->pfx_peer_it_valid = 0;
-  iter->pfx_peer_it = 0;
+  uint32_t need;
 
-  switch (pfx->address.version) {
-  case BGPSTREAM_ADDR_VERSION_IPV4:
-    iter->pfx_it = kh_get(bwv_v4pfx_peerid_pfxinfo, iter->view->v4pfxs,
-                          pfx->bs_ipv4);
-    if (iter->pfx_it == kh_end(iter->view->v4pfxs)) {
-      return 0;
+  if (BWV_PFX_PEERS_ARE_VEC(view)) {
+    need = ((v->peers_vec == NULL) ? 0 : v->peers_vec->size) + cnt;
+    if (need > UINT16_MAX) {
+      need = UINT16_MAX;
     }
-    if (iter->pfx_state_mask &
-        kh_val(iter->view->v4pfxs, iter->pfx_it)->state) {
-      return 1;
+    if (v->peers_vec == NULL || need > v->peers_vec->alloc) {
+      if ((v->peers_vec = peervec_resize(view, v->peers_vec, need)) == NULL) {
+        return -1;
+      }
     }
-    // if the mask does not match, than set the iterator to the end
-    iter->pfx_it = kh_end(iter->view->v4pfxs);
     return 0;
+  }
 
-  case BGPSTREAM_ADDR_VERSION_IPV6:
-    iter->pfx_it = kh_get(bwv_v6pfx_peerid_pfxinfo, iter->view->v6pfxs,
-                          pfx->bs_ipv6);
-    if (iter->pfx_it == kh_end(iter->view->v6pfxs)) {
-      return 0;
+  if (v->peers_generic == NULL) {
+    if (view->disable_extended) {
+      v->peers_min = kh_init(bwv_peerid_pfx_peerinfo);
+    } else {
+      v->peers_ext = kh_init(bwv_peerid_pfx_peerinfo_ext);
     }
-    if (iter->pfx_state_mask &
-        kh_val(iter->view->v6pfxs, iter->pfx_it)->state) {
-      return 1;
+    if (v->peers_generic == NULL) {
+      return -1;
+    }
+  }
+
+  /* grow the table to the size that would hold all the pfx-peers below its
+     load factor */
+  if (view->disable_extended) {
+    need = kh_size(v->peers_min) + cnt;
+    if (need >= v->peers_min->upper_bound &&
+        kh_resize(bwv_peerid_pfx_peerinfo, v->peers_min,
+                  (khint_t)(need / __ac_HASH_UPPER) + 1) < 0) {
+      return -1;
+    }
+  } else {
+    need = kh_size(v->peers_ext) + cnt;
+    if (need >= v->peers_ext->upper_bound &&
+        kh_resize(bwv_peerid_pfx_peerinfo_ext, v->peers_ext,
+                  (khint_t)(need / __ac_HASH_UPPER) + 1) < 0) {
+      return -1;
     }
-    // if the mask does not match, than set the iterator to the end
-    iter->pfx_it = kh_end(iter->view->v6pfxs);
-    return 0;
-  default:
-    /* programming error */
-    assert(0);
   }
   return 0;
 }
 
-/* ==================== PFX-PEER ITERATORS ==================== */
+static int peerid_pfxinfo_insert(bgpview_iter_t *iter,
+                                 bwv_peerid_pfxinfo_t *v,
+                                 bgpstream_peer_id_t peerid,
+                                 bgpstream_as_path_store_path_id_t path_id)
+{
+  bwv_pfx_peerinfo_t *peerinfo = NULL;
+  int khret;
+  khiter_t k;
+  bwv_pfx_peervec_t *vec;
+  int idx;
 
-/* optimized macros. be careful when using these */
+  if (!v->peers_generic) {
+    if (BWV_PFX_PEERS_ARE_VEC(iter->view)) {
+      v->peers_vec = peervec_resize(iter->view, NULL, 1);
+    } else if (iter->view->disable_extended) {
+      v->peers_min = kh_init(bwv_peerid_pfx_peerinfo);
+    } else {
+      v->peers_ext = kh_init(bwv_peerid_pfx_peerinfo_ext);
+    }
+    if (!v->peers_generic) {
+      return -1;
+    }
+  }
 
-#define SCAN_FOR_MATCHING_PFX_PEER(iter, peertable)                            \
-  do {                                                                         \
-    for ( ; (iter)->pfx_peer_it != kh_end(peertable); ++(iter)->pfx_peer_it) { \
-      if (!kh_exist(peertable, (iter)->pfx_peer_it)) continue;                 \
-      if ((iter)->pfx_peer_state_mask &                                        \
-          kh_val(peertable, (iter)->pfx_peer_it).state) {                      \
-        __iter_seek_peer((iter), kh_key(peertable, (iter)->pfx_peer_it),       \
-            (iter)->pfx_peer_state_mask);                                      \
-        (iter)->pfx_peer_it_valid = 1;                                         \
-        break;                                                                 \
-      }                                                                        \
-    }                                                                          \
-  } while (0)
+  if (BWV_PFX_PEERS_ARE_VEC(iter->view)) {
+    vec = v->peers_vec;
+    idx = peervec_put(iter->view, &vec, peerid, &khret);
+    /* the vector may have been reallocated */
+    v->peers_vec = vec;
+    if (idx < 0) {
+      return -1;
+    }
+    k = idx;
+    peerinfo = BWV_PEERVEC_GET_PEER(iter->view, v->peers_vec, k);
+    if (khret > 0) {
+      // peer didn't exist; initialize it
+      peerinfo->state = BGPVIEW_FIELD_INVALID;
+      if (!iter->view->disable_extended) {
+        ((bwv_pfx_peerinfo_ext_t *)peerinfo)->user = NULL;
+      }
+    }
+  } else if (iter->view->disable_extended) {
+    k = kh_put(bwv_peerid_pfx_peerinfo, v->peers_min, peerid, &khret);
+    if (khret > 0) {
+      // peer didn't exist; initialize it
+      kh_val(v->peers_min, k).state = BGPVIEW_FIELD_INVALID;
+    }
+    peerinfo = &kh_val(v->peers_min, k);
+  } else {
+    k = kh_put(bwv_peerid_pfx_peerinfo_ext, v->peers_ext, peerid, &khret);
+    if (khret > 0) {
+      // peer didn't exist; initialize it
+      kh_val(v->peers_ext, k).state = BGPVIEW_FIELD_INVALID;
+      kh_val(v->peers_ext, k).user = NULL;
+    }
+    peerinfo = (bwv_pfx_peerinfo_t*)&kh_val(v->peers_ext, k);
+  }
 
-#define __iter_pfx_first_peer_tab(iter, peertable, state_mask)                 \
-  do {                                                                         \
-    (iter)->pfx_peer_state_mask = state_mask;                                  \
-    (iter)->pfx_peer_it = 0;                                                   \
-    (iter)->pfx_peer_it_valid = 0;                                             \
-    if (!peertable) break;                                                     \
-    SCAN_FOR_MATCHING_PFX_PEER(iter, peertable);                               \
-  } while (0)
+  if (peerinfo->state == BGPVIEW_FIELD_INVALID ||
+      memcmp(&peerinfo->as_path_id, &path_id, sizeof(path_id)) != 0) {
+    journal_pfx_peer(iter, peerid);
+  }
 
-#define __iter_pfx_first_peer(iter, state_mask)                                \
-  do {                                                                         \
-    bwv_peerid_pfxinfo_t *__infos = __pfx_peerinfos((iter));                   \
-    if ((iter)->view->disable_extended) {                                      \
+  if (peerinfo->state == BGPVIEW_FIELD_ACTIVE) {
+    origin_index_pfx_peer_path(iter, peerinfo->as_path_id, path_id);
+  }
+
+  peerinfo->as_path_id = path_id;
+
+  if (peerinfo->state == BGPVIEW_FIELD_INVALID) {
+    // did not already exist or was invalid
+    peerinfo->state = BGPVIEW_FIELD_INACTIVE;
+    peer_index_pfx_peer(iter, peerid, 1);
+
+    /** peerinfo->user remains untouched */
+
+    /* and count this as a new inactive peer for this prefix */
+    v->peers_cnt[BGPVIEW_FIELD_INACTIVE]++;
+
+    /* also count this as an inactive pfx for the peer */
+    switch (iter->version_ptr) {
+    case BGPSTREAM_ADDR_VERSION_IPV4:
+      kh_value(iter->view->peerinfo, iter->peer_it)
+	.v4_pfx_cnt[BGPVIEW_FIELD_INACTIVE]++;
+      break;
+    case BGPSTREAM_ADDR_VERSION_IPV6:
+      kh_value(iter->view->peerinfo, iter->peer_it)
+	.v6_pfx_cnt[BGPVIEW_FIELD_INACTIVE]++;
+      break;
+    default:
+      return -1;
+    }
+  }
+
+  /* now seek the iterator to this pfx/peer */
+  iter->pfx_peer_it = k;
+  iter->pfx_peer_it_valid = 1;
+  iter->pfx_peer_state_mask = BGPVIEW_FIELD_ALL_VALID;
+
+  return 0;
+}
+
+static inline void pfx_peer_info_destroy(bgpview_t *view, bwv_pfx_peerinfo_t *v)
+{
+  return;
+}
+
+static inline void pfx_peer_info_ext_destroy(bgpview_t *view,
+                                             bwv_pfx_peerinfo_ext_t *v)
+{
+  ASSERT_BWV_PFX_PEERINFO_EXT(view);
+  if (v->user != NULL && view->pfx_peer_user_destructor != NULL) {
+    view->pfx_peer_user_destructor(v->user);
+  }
+  v->user = NULL;
+}
+
+/* give up the user data of a prefix (and its pfx-peers) that is owned by the
+   given view, either destroying it, or just forgetting it (when another copy
+   of the prefix has taken ownership). user data is owned by the view that has
+   user destructors */
+static void peerid_pfxinfo_release_user(bgpview_t *view,
+                                        bwv_peerid_pfxinfo_t *v, int destroy)
+{
+  khiter_t k;
+  bwv_pfx_peerinfo_ext_t *pfx_peer;
+
+  if (view->pfx_user_destructor != NULL && v->user != NULL) {
+    if (destroy != 0) {
+      view->pfx_user_destructor(v->user);
+    }
+    v->user = NULL;
+  }
+
+  if (view->disable_extended != 0 || view->pfx_peer_user_destructor == NULL ||
+      v->peers_generic == NULL) {
+    return;
+  }
+
+  if (BWV_PFX_PEERS_ARE_VEC(view)) {
+    for (k = 0; k < v->peers_vec->size; k++) {
+      pfx_peer = BWV_PFX_GET_PEER_EXT_PTR(view, v, k);
+      if (destroy != 0) {
+        pfx_peer_info_ext_destroy(view, pfx_peer);
+      }
+      pfx_peer->user = NULL;
+    }
+  } else {
+    for (k = kh_begin(v->peers_ext); k != kh_end(v->peers_ext); ++k) {
+      if (!kh_exist(v->peers_ext, k)) continue;
+      if (destroy != 0) {
+        pfx_peer_info_ext_destroy(view, &kh_val(v->peers_ext, k));
+      }
+      kh_val(v->peers_ext, k).user = NULL;
+    }
+  }
+}
+
+/* forget the user data of a prefix (and its pfx-peers) copied into a view that
+   has no user destructors, since that user data belongs to another view */
+static void peerid_pfxinfo_forget_user(bgpview_t *view,
+                                       bwv_peerid_pfxinfo_t *v)
+{
+  khiter_t k;
+
+  if (view->pfx_user_destructor == NULL) {
+    v->user = NULL;
+  }
+
+  if (view->disable_extended != 0 || view->pfx_peer_user_destructor != NULL ||
+      v->peers_generic == NULL) {
+    return;
+  }
+
+  if (BWV_PFX_PEERS_ARE_VEC(view)) {
+    for (k = 0; k < v->peers_vec->size; k++) {
+      BWV_PFX_GET_PEER_EXT_PTR(view, v, k)->user = NULL;
+    }
+  } else {
+    for (k = kh_begin(v->peers_ext); k != kh_end(v->peers_ext); ++k) {
+      if (kh_exist(v->peers_ext, k)) {
+        kh_val(v->peers_ext, k).user = NULL;
+      }
+    }
+  }
+}
+
+/* copy a prefix (and its pfx-peers) into a new, unshared, prefix */
+static bwv_peerid_pfxinfo_t *peerid_pfxinfo_dup(bgpview_t *view,
+                                                bwv_peerid_pfxinfo_t *src)
+{
+  bwv_peerid_pfxinfo_t *v;
+  bwv_pfx_peervec_t *vec;
+  int ret = 0;
+
+  if ((v = pfxinfo_alloc(view)) == NULL) {
+    return NULL;
+  }
+  memcpy(v, src, sizeof(bwv_peerid_pfxinfo_t));
+  v->refcnt = 1;
+  v->peers_generic = NULL;
+
+  if (src->peers_generic == NULL) {
+    return v;
+  }
+
+  if (BWV_PFX_PEERS_ARE_VEC(view)) {
+    if ((vec = peervec_alloc(view, src->peers_vec->alloc)) == NULL) {
+      goto err;
+    }
+    memcpy(vec->ids, src->peers_vec->ids,
+           src->peers_vec->size * sizeof(bgpstream_peer_id_t));
+    memcpy(vec->infos, src->peers_vec->infos,
+           src->peers_vec->size * BWV_PFX_PEERINFO_SIZE(view));
+    vec->size = src->peers_vec->size;
+    v->peers_vec = vec;
+  } else if (view->disable_extended) {
+    if ((v->peers_min = kh_init(bwv_peerid_pfx_peerinfo)) == NULL) {
+      goto err;
+    }
+    BWV_KH_COPY(bwv_peerid_pfx_peerinfo, v->peers_min, src->peers_min, ret);
+  } else {
+    if ((v->peers_ext = kh_init(bwv_peerid_pfx_peerinfo_ext)) == NULL) {
+      goto err;
+    }
+    BWV_KH_COPY(bwv_peerid_pfx_peerinfo_ext, v->peers_ext, src->peers_ext,
+                ret);
+  }
+  if (ret != 0) {
+    goto err;
+  }
+
+  return v;
+
+err:
+  if (v->peers_generic != NULL) {
+    if (view->disable_extended) {
+      kh_destroy(bwv_peerid_pfx_peerinfo, v->peers_min);
+    } else {
+      kh_destroy(bwv_peerid_pfx_peerinfo_ext, v->peers_ext);
+    }
+  }
+  bgpview_slab_free(view->alloc->pfxinfo_slab, v);
+  return NULL;
+}
+
+static void peerid_pfxinfo_destroy(bgpview_t *view, bwv_peerid_pfxinfo_t *v)
+{
+  if (v == NULL) {
+    return;
+  }
+  khiter_t k;
+
+  if (v->refcnt > 1) {
+    /* other views still use this prefix, so just drop our reference (and any
+       user data that we own) */
+    peerid_pfxinfo_release_user(view, v, 1);
+    v->refcnt--;
+    return;
+  }
+
+  if (v->peers_generic != NULL) {
+    if (BWV_PFX_PEERS_ARE_VEC(view)) {
+      if (view->disable_extended == 0) {
+        for (k = 0; k < v->peers_vec->size; k++) {
+          pfx_peer_info_ext_destroy(
+            view, BWV_PFX_GET_PEER_EXT_PTR(view, v, k));
+        }
+      }
+      peervec_free(view, v->peers_vec);
+    } else if (view->disable_extended == 0) {
+      for (k = kh_begin(v->peers_ext); k != kh_end(v->peers_ext); ++k) {
+        if (!kh_exist(v->peers_ext, k)) continue;
+        pfx_peer_info_ext_destroy(view, &kh_val(v->peers_ext, k));
+      }
+      kh_destroy(bwv_peerid_pfx_peerinfo_ext, v->peers_ext);
+    } else {
+      // loop calling empty inline function can be optimized away
+      for (k = kh_begin(v->peers_min); k != kh_end(v->peers_min); ++k) {
+        if (!kh_exist(v->peers_min, k)) continue;
+        pfx_peer_info_destroy(view, &kh_val(v->peers_min, k));
+      }
+      kh_destroy(bwv_peerid_pfx_peerinfo, v->peers_min);
+    }
+  }
+  v->peers_generic = NULL;
+  v->state = BGPVIEW_FIELD_INVALID;
+  if (view->pfx_user_destructor != NULL && v->user != NULL) {
+    view->pfx_user_destructor(v->user);
+  }
+  v->user = NULL;
+  bgpview_slab_free(view->alloc->pfxinfo_slab, v);
+}
+
+/* invalidate a prefix and all of its pfx-peers, and stamp it with the current
+   epoch (the peer table is kept so that it can be reused) */
+static void peerid_pfxinfo_reset(bgpview_t *view, bwv_peerid_pfxinfo_t *v)
+{
+  v->peers_cnt[BGPVIEW_FIELD_INACTIVE] = 0;
+  v->peers_cnt[BGPVIEW_FIELD_ACTIVE] = 0;
+  v->state = BGPVIEW_FIELD_INVALID;
+  if (v->peers_generic != NULL) {
+    if (BWV_PFX_PEERS_ARE_VEC(view)) {
+      v->peers_vec->size = 0;
+    } else if (view->disable_extended) {
+      kh_clear(bwv_peerid_pfx_peerinfo, v->peers_min);
+    } else {
+      kh_clear(bwv_peerid_pfx_peerinfo_ext, v->peers_ext);
+    }
+  }
+  v->epoch = view->epoch;
+}
+
+#define __pfx_peerinfos(iter)                                                  \
+  (((iter)->version_ptr == BGPSTREAM_ADDR_VERSION_IPV4)                        \
+     ? (kh_val((iter)->view->v4pfxs, (iter)->pfx_it))                          \
+     : ((iter)->version_ptr == BGPSTREAM_ADDR_VERSION_IPV6)                    \
+         ? (kh_val((iter)->view->v6pfxs, (iter)->pfx_it))                      \
+         : NULL)
+
+/* get a pointer to the table slot that holds the current prefix */
+#define __pfx_peerinfos_slot(iter)                                             \
+  (((iter)->version_ptr == BGPSTREAM_ADDR_VERSION_IPV4)                        \
+     ? &(kh_val((iter)->view->v4pfxs, (iter)->pfx_it))                         \
+     : &(kh_val((iter)->view->v6pfxs, (iter)->pfx_it)))
+
+/* get the current prefix so that it can be modified, first making a private
+   copy of it if it is shared with other views. returns NULL if the copy
+   fails */
+static bwv_peerid_pfxinfo_t *pfxinfo_unshare(bgpview_iter_t *iter)
+{
+  bwv_peerid_pfxinfo_t **slot = __pfx_peerinfos_slot(iter);
+  bwv_peerid_pfxinfo_t *v;
+
+  RETURN_IF_FROZEN(iter->view, NULL);
+
+  if ((*slot)->refcnt == 1) {
+    return *slot;
+  }
+
+  if ((v = peerid_pfxinfo_dup(iter->view, *slot)) == NULL) {
+    fprintf(stderr, "ERROR: Could not copy shared prefix\n");
+    return NULL;
+  }
+  /* the copy now owns the user data (if this view owns any; otherwise the
+     user data stays with the views that share the original) */
+  peerid_pfxinfo_release_user(iter->view, *slot, 0);
+  peerid_pfxinfo_forget_user(iter->view, v);
+  (*slot)->refcnt--;
+  *slot = v;
+  return v;
+}
+
+/* invalidate the prefix in the given table slot, replacing it with a new
+   prefix if it is shared with other views */
+static int pfxinfo_slot_reset(bgpview_t *view, bwv_peerid_pfxinfo_t **slot)
+{
+  bwv_peerid_pfxinfo_t *v;
+
+  if ((*slot)->refcnt == 1) {
+    peerid_pfxinfo_reset(view, *slot);
+    return 0;
+  }
+
+  if ((v = peerid_pfxinfo_create(view)) == NULL) {
+    return -1;
+  }
+  peerid_pfxinfo_destroy(view, *slot);
+  *slot = v;
+  return 0;
+}
+
+static int add_v4pfx(bgpview_iter_t *iter, bgpstream_ipv4_pfx_t *pfx)
+{
+  bwv_peerid_pfxinfo_t *new_pfxpeerinfo;
+  khiter_t k;
+  int khret;
+
+  RETURN_IF_FROZEN(iter->view, -1);
+
+  PFX_TABLE_CHECK_PUT(iter->view, iter->view->v4pfxs,
+                      iter->view->v4pfxs_index);
+  k = kh_put(bwv_v4pfx_peerid_pfxinfo, iter->view->v4pfxs, BWV_V4PFX_KEY(pfx),
+             &khret);
+  if (khret > 0) {
+    /* pfx didn't exist */
+    iter->view->v4pfxs_index.valid = 0;
+    if ((new_pfxpeerinfo = peerid_pfxinfo_create(iter->view)) == NULL) {
+      return -1;
+    }
+    kh_value(iter->view->v4pfxs, k) = new_pfxpeerinfo;
+
+    /* pfx is invalid at this point */
+  }
+
+  /* seek the iterator to this prefix */
+  iter->pfx_it = k;
+  iter->version_ptr = BGPSTREAM_ADDR_VERSION_IPV4;
+  iter->pfx_peer_it_valid = 0; // moving pfx_it invalidates pfx_peer_it
+
+  if (kh_value(iter->view->v4pfxs, k)->epoch != iter->view->epoch &&
+      pfxinfo_slot_reset(iter->view, &kh_value(iter->view->v4pfxs, k)) != 0) {
+    /* stale prefix from before the last clear, start from scratch */
+    return -1;
+  }
+
+  if (kh_value(iter->view->v4pfxs, k)->state != BGPVIEW_FIELD_INVALID) {
+    /* it was already there and active/inactive */
+    return 0;
+  }
+
+  if (pfxinfo_unshare(iter) == NULL) {
+    return -1;
+  }
+  kh_value(iter->view->v4pfxs, k)->state = BGPVIEW_FIELD_INACTIVE;
+  iter->view->v4pfxs_cnt[BGPVIEW_FIELD_INACTIVE]++;
+
+  return 0;
+}
+
+static int add_v6pfx(bgpview_iter_t *iter, bgpstream_ipv6_pfx_t *pfx)
+{
+  bwv_peerid_pfxinfo_t *new_pfxpeerinfo;
+  khiter_t k;
+  int khret;
+
+  RETURN_IF_FROZEN(iter->view, -1);
+
+  PFX_TABLE_CHECK_PUT(iter->view, iter->view->v6pfxs,
+                      iter->view->v6pfxs_index);
+  k = kh_put(bwv_v6pfx_peerid_pfxinfo, iter->view->v6pfxs, *pfx, &khret);
+  if (khret > 0) {
+    /* pfx didn't exist */
+    iter->view->v6pfxs_index.valid = 0;
+    if ((new_pfxpeerinfo = peerid_pfxinfo_create(iter->view)) == NULL) {
+      return -1;
+    }
+    kh_value(iter->view->v6pfxs, k) = new_pfxpeerinfo;
+
+    /* pfx is invalid at this point */
+  }
+
+  /* seek the iterator to this prefix */
+  iter->pfx_it = k;
+  iter->version_ptr = BGPSTREAM_ADDR_VERSION_IPV6;
+  iter->pfx_peer_it_valid = 0; // moving pfx_it invalidates pfx_peer_it
+
+  if (kh_value(iter->view->v6pfxs, k)->epoch != iter->view->epoch &&
+      pfxinfo_slot_reset(iter->view, &kh_value(iter->view->v6pfxs, k)) != 0) {
+    /* stale prefix from before the last clear, start from scratch */
+    return -1;
+  }
+
+  if (kh_value(iter->view->v6pfxs, k)->state != BGPVIEW_FIELD_INVALID) {
+    /* it was already there and active/inactive */
+    return 0;
+  }
+
+  if (pfxinfo_unshare(iter) == NULL) {
+    return -1;
+  }
+  kh_value(iter->view->v6pfxs, k)->state = BGPVIEW_FIELD_INACTIVE;
+  iter->view->v6pfxs_cnt[BGPVIEW_FIELD_INACTIVE]++;
+
+  return 0;
+}
+
+static int add_pfx(bgpview_iter_t *iter, bgpstream_pfx_t *pfx)
+{
+  if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
+    return add_v4pfx(iter, &pfx->bs_ipv4);
+  } else if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV6) {
+    return add_v6pfx(iter, &pfx->bs_ipv6);
+  }
+
+  return -1;
+}
+
+/* ==================== SORTED PREFIX INDEX ==================== */
+
+/* qsort comparator for pointers to v4pfxs table keys, in (address, mask)
+   order */
+static int v4pfx_ptr_cmp(const void *a, const void *b)
+{
+#ifdef WITH_PACKED_V4PFX_KEYS
+  bwv_v4pfx_key_t ka = **(const bwv_v4pfx_key_t *const *)a;
+  bwv_v4pfx_key_t kb = **(const bwv_v4pfx_key_t *const *)b;
+
+  return (ka > kb) - (ka < kb);
+#else
+  const bgpstream_ipv4_pfx_t *pa = *(const bgpstream_ipv4_pfx_t *const *)a;
+  const bgpstream_ipv4_pfx_t *pb = *(const bgpstream_ipv4_pfx_t *const *)b;
+  uint32_t aa = ntohl(pa->address.addr.s_addr);
+  uint32_t ab = ntohl(pb->address.addr.s_addr);
+
+  if (aa != ab) {
+    return (aa < ab) ? -1 : 1;
+  }
+  return (int)pa->mask_len - (int)pb->mask_len;
+#endif
+}
+
+/* qsort comparator for pointers to v6 prefixes, in (address, mask) order */
+static int v6pfx_ptr_cmp(const void *a, const void *b)
+{
+  const bgpstream_ipv6_pfx_t *pa = *(const bgpstream_ipv6_pfx_t *const *)a;
+  const bgpstream_ipv6_pfx_t *pb = *(const bgpstream_ipv6_pfx_t *const *)b;
+  int ret;
+
+  if ((ret = memcmp(pa->address.addr.s6_addr, pb->address.addr.s6_addr,
+                    sizeof(pa->address.addr.s6_addr))) != 0) {
+    return ret;
+  }
+  return (int)pa->mask_len - (int)pb->mask_len;
+}
+
+/* (re-)build the index of the given prefix table. the keys are sorted through
+   an array of pointers, which are then converted to bucket numbers (and copied
+   into the index) */
+#define BUILD_PFX_INDEX(table, index, cmp, ret)                                \
+  do {                                                                         \
+    const void **ptrs = NULL;                                                  \
+    khiter_t *buckets;                                                         \
+    void *keys;                                                                \
+    khiter_t k;                                                                \
+    uint32_t i, n = 0;                                                         \
+    (ret) = 0;                                                                 \
+    if (kh_size((table)) > (index).alloc_cnt) {                                \
+      if ((buckets = realloc((index).buckets,                                  \
+                             sizeof(khiter_t) * kh_size((table)))) == NULL) {  \
+        (ret) = -1;                                                            \
+        break;                                                                 \
+      }                                                                        \
+      (index).buckets = buckets;                                               \
+      if ((keys = realloc((index).keys, sizeof(kh_key((table), 0)) *          \
+                                          kh_size((table)))) == NULL) {        \
+        (ret) = -1;                                                            \
+        break;                                                                 \
+      }                                                                        \
+      (index).keys = keys;                                                     \
+      (index).alloc_cnt = kh_size((table));                                    \
+    }                                                                          \
+    if (kh_size((table)) > 0 &&                                                \
+        (ptrs = malloc(sizeof(void *) * kh_size((table)))) == NULL) {          \
+      (ret) = -1;                                                              \
+      break;                                                                   \
+    }                                                                          \
+    for (k = kh_begin((table)); k != kh_end((table)); ++k) {                   \
+      if (kh_exist((table), k)) {                                              \
+        ptrs[n++] = &kh_key((table), k);                                       \
+      }                                                                        \
+    }                                                                          \
+    qsort(ptrs, n, sizeof(void *), cmp);                                       \
+    for (i = 0; i < n; i++) {                                                  \
+      (index).buckets[i] = ((const char *)ptrs[i] -                            \
+                            (const char *)&kh_key((table), 0)) /               \
+                           sizeof(kh_key((table), 0));                         \
+      memcpy((char *)(index).keys + i * sizeof(kh_key((table), 0)), ptrs[i],   \
+             sizeof(kh_key((table), 0)));                                      \
+    }                                                                          \
+    free(ptrs);                                                                \
+    (index).cnt = n;                                                           \
+    (index).valid = 1;                                                         \
+  } while (0)
+
+/* make sure the index of the table of the given version is valid */
+static int pfx_index_build(bgpview_t *view, int version)
+{
+  int ret = 0;
+
+  if (version == BGPSTREAM_ADDR_VERSION_IPV4 &&
+      view->v4pfxs_index.valid == 0) {
+    BUILD_PFX_INDEX(view->v4pfxs, view->v4pfxs_index, v4pfx_ptr_cmp, ret);
+  } else if (version == BGPSTREAM_ADDR_VERSION_IPV6 &&
+             view->v6pfxs_index.valid == 0) {
+    BUILD_PFX_INDEX(view->v6pfxs, view->v6pfxs_index, v6pfx_ptr_cmp, ret);
+  }
+
+  if (ret != 0) {
+    fprintf(stderr, "ERROR: Could not build sorted prefix index\n");
+  }
+  return ret;
+}
+
+/* ==================== ITERATOR FUNCTIONS ==================== */
+
+bgpview_iter_t *bgpview_iter_create(bgpview_t *view)
+{
+  bgpview_iter_t *iter;
+
+  if ((iter = malloc_zero(sizeof(bgpview_iter_t))) == NULL) {
+    return NULL;
+  }
+
+  iter->view = view;
+
+  iter->version_ptr = BGPSTREAM_ADDR_VERSION_IPV4;
+  iter->version_filter = 0; // default: all prefix versions
+
+  iter->pfx_it = 0;
+
+  iter->peer_it = kh_end(iter->view->peerinfo);
+
+  iter->pfx_peer_it_valid = 0;
+
+  // default: all valid fields are iterated
+  iter->pfx_state_mask = BGPVIEW_FIELD_ALL_VALID;
+  iter->peer_state_mask = BGPVIEW_FIELD_ALL_VALID;
+  iter->pfx_peer_state_mask = BGPVIEW_FIELD_ALL_VALID;
+
+  return iter;
+}
+
+bgpview_iter_t *bgpview_iter_create_partition(bgpview_t *view, int part,
+                                              int parts_cnt)
+{
+  bgpview_iter_t *iter;
+  uint64_t n;
+
+  if (parts_cnt < 1 || part < 0 || part >= parts_cnt) {
+    fprintf(stderr, "ERROR: Invalid partition %d of %d\n", part, parts_cnt);
+    return NULL;
+  }
+
+  if ((iter = bgpview_iter_create(view)) == NULL) {
+    return NULL;
+  }
+
+  iter->pfx_part = 1;
+
+  n = kh_n_buckets(view->v4pfxs);
+  iter->pfx_part_begin[BWV_PART_V4] = (n * part) / parts_cnt;
+  iter->pfx_part_end[BWV_PART_V4] = (n * (part + 1)) / parts_cnt;
+
+  n = kh_n_buckets(view->v6pfxs);
+  iter->pfx_part_begin[BWV_PART_V6] = (n * part) / parts_cnt;
+  iter->pfx_part_end[BWV_PART_V6] = (n * (part + 1)) / parts_cnt;
+
+  iter->pfx_it = iter->pfx_part_begin[BWV_PART_V4];
+
+  return iter;
+}
+
+int bgpview_iter_set_pfx_order(bgpview_iter_t *iter, bgpview_pfx_order_t order)
+{
+  if (order == BGPVIEW_PFX_ORDER_SORTED && iter->pfx_part != 0) {
+    fprintf(stderr,
+            "ERROR: Sorted order is not supported by partitioned iterators\n");
+    return -1;
+  }
+  iter->pfx_sorted = (order == BGPVIEW_PFX_ORDER_SORTED);
+  return 0;
+}
+
+void bgpview_iter_destroy(bgpview_iter_t *iter)
+{
+  free(iter);
+}
+
+/* ==================== ITER GETTER/SETTERS ==================== */
+
+#define __cnt_by_mask(counter, mask)                                           \
+  (((mask) == BGPVIEW_FIELD_ACTIVE || (mask) == BGPVIEW_FIELD_INACTIVE)        \
+     ? ((counter)[(mask)])                                                     \
+     : ((counter)[BGPVIEW_FIELD_ACTIVE] + (counter)[BGPVIEW_FIELD_INACTIVE]))
+
+#define __pfx_field(iter, field) (__pfx_peerinfos((iter))->field)
+
+#define __iter_get_view(iter) ((iter)->view)
+
+bgpview_t *bgpview_iter_get_view(bgpview_iter_t *iter)
+{
+  if (iter != NULL) {
+    return __iter_get_view(iter);
+  }
+  return NULL;
+}
+
+#ifdef WITH_PACKED_V4PFX_KEYS
+static inline bgpstream_pfx_t *iter_v4pfx_unpack(bgpview_iter_t *iter)
+{
+  iter->v4pfx = BWV_V4PFX(iter->view, iter->pfx_it);
+  return (bgpstream_pfx_t *)&iter->v4pfx;
+}
+#define __iter_v4pfx_ptr(iter) iter_v4pfx_unpack(iter)
+#else
+#define __iter_v4pfx_ptr(iter)                                                 \
+  ((bgpstream_pfx_t *)&kh_key((iter)->view->v4pfxs, (iter)->pfx_it))
+#endif
+
+#define __iter_pfx_get_pfx(iter)                                               \
+  (((iter)->version_ptr == BGPSTREAM_ADDR_VERSION_IPV4)                        \
+     ? __iter_v4pfx_ptr(iter)                                                  \
+     : ((iter)->version_ptr == BGPSTREAM_ADDR_VERSION_IPV6)                    \
+         ? ((bgpstream_pfx_t *)&kh_key(iter->view->v6pfxs, iter->pfx_it))      \
+         : NULL)
+
+bgpstream_pfx_t *bgpview_iter_pfx_get_pfx(bgpview_iter_t *iter)
+{
+  return __iter_pfx_get_pfx(iter);
+}
+
+#define __iter_pfx_get_peer_cnt(iter, state_mask)                              \
+  (__cnt_by_mask(__pfx_field(iter, peers_cnt), state_mask))
+
+int bgpview_iter_pfx_get_peer_cnt(bgpview_iter_t *iter, uint8_t state_mask)
+{
+  return __iter_pfx_get_peer_cnt(iter, state_mask);
+}
+
+/* count the pfx-peers of a hash table that match the state mask and whose peer
+   id is set in the bitset */
+#define PEERTABLE_BITSET_CNT(peertable, state_mask, peer_bits, cnt)            \
+  do {                                                                         \
+    khiter_t __k;                                                              \
+    for (__k = kh_begin(peertable); __k != kh_end(peertable); ++__k) {         \
+      if (kh_exist(peertable, __k) &&                                          \
+          ((state_mask) & kh_val(peertable, __k).state)) {                     \
+        (cnt) +=                                                               \
+          BGPVIEW_PEER_BITSET_TEST(peer_bits, kh_key(peertable, __k));         \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+int bgpview_iter_pfx_get_peer_bitset_cnt(bgpview_iter_t *iter,
+                                         uint8_t state_mask,
+                                         const uint64_t *peer_bits)
+{
+  bwv_peerid_pfxinfo_t *infos = __pfx_peerinfos(iter);
+  bwv_pfx_peervec_t *vec;
+  int cnt = 0;
+  uint16_t k;
+
+  if (__iter_pfx_get_peer_cnt(iter, state_mask) == 0) {
+    return 0;
+  }
+
+  if (BWV_PFX_PEERS_ARE_VEC(iter->view)) {
+    /* ids are contiguous, so this loop is branch-free */
+    vec = infos->peers_vec;
+    for (k = 0; k < vec->size; k++) {
+      cnt += BGPVIEW_PEER_BITSET_TEST(peer_bits, vec->ids[k]) &
+             ((state_mask & BWV_PEERVEC_GET_PEER(iter->view, vec, k)->state) !=
+              0);
+    }
+  } else if (iter->view->disable_extended) {
+    PEERTABLE_BITSET_CNT(infos->peers_min, state_mask, peer_bits, cnt);
+  } else {
+    PEERTABLE_BITSET_CNT(infos->peers_ext, state_mask, peer_bits, cnt);
+  }
+
+  return cnt;
+}
+
+#define __iter_pfx_get_state(iter)                                             \
+  (BWV_PFX_STATE((iter)->view, __pfx_peerinfos(iter)))
+
+bgpview_field_state_t bgpview_iter_pfx_get_state(bgpview_iter_t *iter)
+{
+  return __iter_pfx_get_state(iter);
+}
+
+#define __iter_pfx_get_user(iter) (__pfx_field(iter, user))
+
+void *bgpview_iter_pfx_get_user(bgpview_iter_t *iter)
+{
+  return __iter_pfx_get_user(iter);
+}
+
+int bgpview_iter_pfx_set_user(bgpview_iter_t *iter, void *user)
+{
+  bwv_peerid_pfxinfo_t *pfxinfo = __pfx_peerinfos(iter);
+
+  if (pfxinfo->user == user) {
+    return 0;
+  }
+
+  if ((pfxinfo = pfxinfo_unshare(iter)) == NULL) {
+    return -1;
+  }
+
+  if (pfxinfo->user != NULL && iter->view->pfx_user_destructor != NULL) {
+    iter->view->pfx_user_destructor(pfxinfo->user);
+  }
+  pfxinfo->user = user;
+  return 1;
+}
+
+#define __iter_peer_get_peer_id(iter)                                          \
+  (kh_key(iter->view->peerinfo, iter->peer_it))
+
+bgpstream_peer_id_t bgpview_iter_peer_get_peer_id(bgpview_iter_t *iter)
+{
+  return __iter_peer_get_peer_id(iter);
+}
+
+#define __iter_peer_get_sig(iter)                                              \
+  (bgpstream_peer_sig_map_get_sig((iter)->view->peersigns,                     \
+                                  __iter_peer_get_peer_id(iter)))
+
+bgpstream_peer_sig_t *bgpview_iter_peer_get_sig(bgpview_iter_t *iter)
+{
+  return __iter_peer_get_sig(iter);
+}
+
+#define __peer_get_pfx_cnt(iter, state_mask, field)                            \
+  (__cnt_by_mask(kh_value(iter->view->peerinfo, iter->peer_it).field,          \
+                 state_mask))
+
+#define __iter_peer_get_pfx_cnt(iter, version, state_mask)                     \
+  (((version) == BGPSTREAM_ADDR_VERSION_IPV4)                                  \
+     ? (__peer_get_pfx_cnt(iter, state_mask, v4_pfx_cnt))                      \
+     : ((version) == BGPSTREAM_ADDR_VERSION_IPV6)                              \
+         ? (__peer_get_pfx_cnt(iter, state_mask, v6_pfx_cnt))                  \
+         : (__peer_get_pfx_cnt(iter, state_mask, v4_pfx_cnt) +                 \
+            __peer_get_pfx_cnt(iter, state_mask, v6_pfx_cnt)))
+
+int bgpview_iter_peer_get_pfx_cnt(bgpview_iter_t *iter, int version,
+                                  uint8_t state_mask)
+{
+  return __iter_peer_get_pfx_cnt(iter, version, state_mask);
+}
+
+#define __peer_field(iter, field)                                              \
+  (kh_val((iter)->view->peerinfo, (iter)->peer_it).field)
+
+#define __iter_peer_get_state(iter)                                            \
+  (BWV_PEER_STATE((iter)->view,                                                \
+                  kh_val((iter)->view->peerinfo, (iter)->peer_it)))
+
+bgpview_field_state_t bgpview_iter_peer_get_state(bgpview_iter_t *iter)
+{
+  return __iter_peer_get_state(iter);
+}
+
+#define __iter_peer_get_user(iter) (__peer_field(iter, user))
+
+void *bgpview_iter_peer_get_user(bgpview_iter_t *iter)
+{
+  return __iter_peer_get_user(iter);
+}
+
+int bgpview_iter_peer_set_user(bgpview_iter_t *iter, void *user)
+{
+  void *cur_user = __peer_field(iter, user);
+
+  if (cur_user == user) {
+    return 0;
+  }
+
+  RETURN_IF_FROZEN(iter->view, -1);
+
+  if (cur_user != NULL && iter->view->peer_user_destructor != NULL) {
+    iter->view->peer_user_destructor(cur_user);
+  }
+
+  kh_val(iter->view->peerinfo, iter->peer_it).user = user;
+  return 1;
+}
+
+#define __pfx_peer_field(iter, field)                                          \
+  (BWV_PFX_GET_PEER_PTR((iter)->view, __pfx_peerinfos(iter),                   \
+                        (iter)->pfx_peer_it)                                   \
+     ->field)
+
+#define __iter_pfx_peer_get_as_path_store_path(iter)                           \
+  (bgpstream_as_path_store_get_store_path((iter)->view->pathstore,             \
+                                          __pfx_peer_field(iter, as_path_id)))
+
+bgpstream_as_path_store_path_t *
+bgpview_iter_pfx_peer_get_as_path_store_path(bgpview_iter_t *iter)
+{
+  return __iter_pfx_peer_get_as_path_store_path(iter);
+}
+
+#define __iter_pfx_peer_get_as_path_store_path_id(iter)                        \
+  (__pfx_peer_field(iter, as_path_id))
+
+bgpstream_as_path_store_path_id_t
+bgpview_iter_pfx_peer_get_as_path_store_path_id(bgpview_iter_t *iter)
+{
+  return __iter_pfx_peer_get_as_path_store_path_id(iter);
+}
+
+#define __iter_pfx_peer_get_as_path(iter)                                      \
+  (bgpstream_as_path_store_path_get_path(                                      \
+    __iter_pfx_peer_get_as_path_store_path(iter),                              \
+    (__iter_peer_get_sig(iter))->peer_asnumber))
+
+bgpstream_as_path_t *bgpview_iter_pfx_peer_get_as_path(bgpview_iter_t *iter)
+{
+  return __iter_pfx_peer_get_as_path(iter);
+}
+
+#define __iter_pfx_peer_get_origin_seg(iter)                                   \
+  (bgpstream_as_path_store_path_get_origin_seg(                                \
+    __iter_pfx_peer_get_as_path_store_path(iter)))
+
+bgpstream_as_path_seg_t *
+bgpview_iter_pfx_peer_get_origin_seg(bgpview_iter_t *iter)
+{
+  return __iter_pfx_peer_get_origin_seg(iter);
+}
+
+#define __iter_pfx_peer_as_path_seg_iter_reset(iter)                           \
+  (bgpstream_as_path_store_path_iter_reset(                                    \
+    __iter_pfx_peer_get_as_path_store_path(iter), &(iter)->pfx_peer_path_it,   \
+    __iter_peer_get_sig(iter)->peer_asnumber))
+
+void bgpview_iter_pfx_peer_as_path_seg_iter_reset(bgpview_iter_t *iter)
+{
+  __iter_pfx_peer_as_path_seg_iter_reset(iter);
+}
+
+#define __iter_pfx_peer_as_path_seg_next(iter)                                 \
+  (bgpstream_as_path_store_path_get_next_seg(&iter->pfx_peer_path_it))
+
+bgpstream_as_path_seg_t *
+bgpview_iter_pfx_peer_as_path_seg_next(bgpview_iter_t *iter)
+{
+  return __iter_pfx_peer_as_path_seg_next(iter);
+}
+
+int bgpview_iter_pfx_peer_set_as_path(bgpview_iter_t *iter,
+                                      bgpstream_as_path_t *as_path)
+{
+  if (pfxinfo_unshare(iter) == NULL) {
+    return -1;
+  }
+
+  bgpstream_as_path_store_path_id_t *id = &(__pfx_peer_field(iter, as_path_id));
+  bgpstream_as_path_store_path_id_t old_id = *id;
+
+  bgpstream_peer_sig_t *ps = __iter_peer_get_sig(iter);
+
+  if (bgpstream_as_path_store_get_path_id(iter->view->pathstore, as_path,
+                                          ps->peer_asnumber, id) != 0) {
+    fprintf(stderr, "ERROR: Failed to get AS Path ID from store\n");
+    return -1;
+  }
+
+  if (memcmp(&old_id, id, sizeof(old_id)) != 0) {
+    journal_pfx_peer(iter, kh_key(iter->view->peerinfo, iter->peer_it));
+  }
+
+  if (__pfx_peer_field(iter, state) == BGPVIEW_FIELD_ACTIVE) {
+    origin_index_pfx_peer_path(iter, old_id, *id);
+  }
+
+  return 0;
+}
+
+int bgpview_iter_pfx_peer_set_as_path_by_id(
+  bgpview_iter_t *iter, bgpstream_as_path_store_path_id_t path_id)
+{
+  if (pfxinfo_unshare(iter) == NULL) {
+    return -1;
+  }
+  if (memcmp(&(__pfx_peer_field(iter, as_path_id)), &path_id,
+             sizeof(path_id)) != 0) {
+    journal_pfx_peer(iter, kh_key(iter->view->peerinfo, iter->peer_it));
+  }
+  if (__pfx_peer_field(iter, state) == BGPVIEW_FIELD_ACTIVE) {
+    origin_index_pfx_peer_path(iter, __pfx_peer_field(iter, as_path_id),
+                               path_id);
+  }
+  (__pfx_peer_field(iter, as_path_id)) = path_id;
+  return 0;
+}
+
+#define __iter_pfx_peer_get_state(iter)                                        \
+  (BWV_PFX_GET_PEER_STATE(iter->view, __pfx_peerinfos(iter), iter->pfx_peer_it))
+
+bgpview_field_state_t bgpview_iter_pfx_peer_get_state(bgpview_iter_t *iter)
+{
+  return __iter_pfx_peer_get_state(iter);
+}
+
+#define __iter_pfx_peer_get_user(iter)                                         \
+  (BWV_PFX_GET_PEER_EXT_PTR((iter)->view, __pfx_peerinfos(iter),               \
+                            (iter)->pfx_peer_it)                               \
+     ->user)
+
+void *bgpview_iter_pfx_peer_get_user(bgpview_iter_t *iter)
+{
+  ASSERT_BWV_PFX_PEERINFO_EXT(iter->view);
+  return __iter_pfx_peer_get_user(iter);
+}
+
+int bgpview_iter_pfx_peer_set_user(bgpview_iter_t *iter, void *user)
+{
+  ASSERT_BWV_PFX_PEERINFO_EXT(iter->view);
+
+  void *cur_user = __iter_pfx_peer_get_user(iter);
+
+  if (cur_user == user) {
+    return 0;
+  }
+
+  if (pfxinfo_unshare(iter) == NULL) {
+    return -1;
+  }
+
+  if (cur_user != NULL && iter->view->pfx_peer_user_destructor != NULL) {
+    iter->view->pfx_peer_user_destructor(cur_user);
+  }
+
+  __iter_pfx_peer_get_user(iter) = user;
+  return 1;
+}
+
+/* ==================== PEER ITERATORS ==================== */
+
+/* internal macros, optimized for performance */
+
+#define WHILE_NOT_MATCHED_PEER(iter)                                           \
+  while (iter->peer_it != kh_end(iter->view->peerinfo) &&                      \
+         (!kh_exist(iter->view->peerinfo, iter->peer_it) ||                    \
+          !(iter->peer_state_mask &                                            \
+            BWV_PEER_STATE(iter->view,                                         \
+                           kh_val(iter->view->peerinfo, iter->peer_it)))))
+
+#define __iter_first_peer(iter, state_mask)                                    \
+  do {                                                                         \
+    iter->peer_it = kh_begin(iter->view->peerinfo);                            \
+    iter->peer_state_mask = state_mask;                                        \
+    iter->pfx_peer_it_valid = 0;                                               \
+    /* keep searching if this does not exist */                                \
+    WHILE_NOT_MATCHED_PEER(iter)                                               \
+    {                                                                          \
+      iter->peer_it++;                                                         \
+    }                                                                          \
+  } while (0)
+
+#define __iter_next_peer(iter)                                                 \
+  do {                                                                         \
+    do {                                                                       \
+      iter->peer_it++;                                                         \
+    }                                                                          \
+    WHILE_NOT_MATCHED_PEER(iter);                                              \
+  } while (0)
+
+#define __iter_has_more_peer(iter)                                             \
+  (iter->peer_it != kh_end(iter->view->peerinfo))
+
+#define __iter_seek_peer(iter, peerid, state_mask)                             \
+  do {                                                                         \
+    iter->peer_state_mask = state_mask;                                        \
+    iter->peer_it = kh_get(bwv_peerid_peerinfo, iter->view->peerinfo, peerid); \
+  } while (0)
+
+/* external functions */
+
+int bgpview_iter_first_peer(bgpview_iter_t *iter, uint8_t state_mask)
+{
+  __iter_first_peer(iter, state_mask);
+  return __iter_has_more_peer(iter);
+}
+
+int bgpview_iter_next_peer(bgpview_iter_t *iter)
+{
+  __iter_next_peer(iter);
+  return __iter_has_more_peer(iter);
+}
+
+int bgpview_iter_has_more_peer(bgpview_iter_t *iter)
+{
+  return __iter_has_more_peer(iter);
+}
+
+int bgpview_iter_seek_peer(bgpview_iter_t *iter, bgpstream_peer_id_t peerid,
+                           uint8_t state_mask)
+{
+  iter->pfx_peer_it_valid = 0; // moving peer_it invalidates pfx_peer_it
+  __iter_seek_peer(iter, peerid, state_mask);
+  if (iter->peer_it == kh_end(iter->view->peerinfo)) {
+    return 0;
+  }
+  if (iter->peer_state_mask &
+      BWV_PEER_STATE(iter->view, kh_val(iter->view->peerinfo, iter->peer_it))) {
+    return 1;
+  }
+  iter->peer_it = kh_end(iter->view->peerinfo);
+  return 0;
+}
+
+/* ==================== PFX ITERATORS ==================== */
+
+/* first and end buckets of the given table (v is BWV_PART_V4 or BWV_PART_V6)
+   that this iterator covers */
+#define __pfx_begin(iter, table, v)                                            \
+  ((iter)->pfx_part ? (iter)->pfx_part_begin[(v)] : kh_begin((table)))
+
+#define __pfx_end(iter, table, v)                                              \
+  ((iter)->pfx_part ? (iter)->pfx_part_end[(v)] : kh_end((table)))
+
+#define __pfx_in_part(iter, v)                                                 \
+  ((iter)->pfx_part == 0 || ((iter)->pfx_it >= (iter)->pfx_part_begin[(v)] &&  \
+                             (iter)->pfx_it < (iter)->pfx_part_end[(v)]))
+
+#define WHILE_NOT_MATCHED_PFX(iter, table, v)                                  \
+  while ((iter)->pfx_it != __pfx_end(iter, table, v) && /* each hash item */   \
+         (!kh_exist((table), (iter)->pfx_it) ||         /* in hash? */         \
+          !((iter)->pfx_state_mask &                    /* correct state? */   \
+            BWV_PFX_STATE((iter)->view, kh_val((table), (iter)->pfx_it)))))
+
+/* move a sorted iterator to the first prefix (at or after its current
+   position in the index) that matches the state mask. if the index has been
+   invalidated (i.e., prefixes were added or deleted, or the table was
+   rehashed), or a bucket no longer holds the prefix it was indexed for, the
+   iteration ends */
+#define SORTED_PFX_MATCH(iter, table, index, cmp)                              \
+  do {                                                                         \
+    const void *tkey, *ikey;                                                   \
+    khiter_t b;                                                                \
+    (iter)->pfx_it = kh_end((table));                                          \
+    for (; (index).valid && (iter)->pfx_sorted_idx < (index).cnt;              \
+         (iter)->pfx_sorted_idx++) {                                           \
+      b = (index).buckets[(iter)->pfx_sorted_idx];                             \
+      tkey = &kh_key((table), b);                                              \
+      ikey = (const char *)(index).keys +                                      \
+             (iter)->pfx_sorted_idx * sizeof(kh_key((table), 0));              \
+      if (!kh_exist((table), b) || cmp(&tkey, &ikey) != 0) {                   \
+        /* stale index */                                                      \
+        break;                                                                 \
+      }                                                                        \
+      if ((iter)->pfx_state_mask &                                             \
+          BWV_PFX_STATE((iter)->view, kh_val((table), b))) {                   \
+        (iter)->pfx_it = b;                                                    \
+        break;                                                                 \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+/* find the position of bucket k of the table in the (valid) index */
+#define SORTED_PFX_FIND(iter, table, index, cmp, k)                            \
+  do {                                                                         \
+    const void *key = &kh_key((table), (k));                                   \
+    const void *mid_key;                                                       \
+    uint32_t lo = 0, hi = (index).cnt, mid;                                    \
+    while (lo < hi) {                                                          \
+      mid = lo + (hi - lo) / 2;                                                \
+      mid_key = &kh_key((table), (index).buckets[mid]);                        \
+      if (cmp(&mid_key, &key) < 0) {                                           \
+        lo = mid + 1;                                                          \
+      } else {                                                                 \
+        hi = mid;                                                              \
+      }                                                                        \
+    }                                                                          \
+    (iter)->pfx_sorted_idx = lo;                                               \
+  } while (0)
+
+#define __pfx_valid(iter, table, v)                                            \
+  ((iter)->pfx_it != __pfx_end(iter, table, v))
+
+#define RETURN_IF_PFX_VALID(iter, table, v)                                    \
+  do {                                                                         \
+    if (__pfx_valid(iter, table, v)) {                                         \
+      return 1;                                                                \
+    }                                                                          \
+  } while (0)
+
+int bgpview_iter_first_pfx(bgpview_iter_t *iter, int version,
+                           uint8_t state_mask)
+{
+  // set the version we iterate through
+  iter->version_filter = version;
+
+  // set the version we start iterating through
+  if (iter->version_filter == BGPSTREAM_ADDR_VERSION_IPV4 ||
+      iter->version_filter == 0) {
+    iter->version_ptr = BGPSTREAM_ADDR_VERSION_IPV4;
+  } else {
+    iter->version_ptr = BGPSTREAM_ADDR_VERSION_IPV6;
+  }
+
+  // set the pfx mask
+  iter->pfx_state_mask = state_mask;
+
+  // moving pfx_it invalidates pfx_peer_it
+  iter->pfx_peer_it_valid = 0;
+
+  if (iter->version_ptr == BGPSTREAM_ADDR_VERSION_IPV4) {
+    if (iter->pfx_sorted) {
+      if (pfx_index_build(iter->view, BGPSTREAM_ADDR_VERSION_IPV4) != 0) {
+        iter->pfx_it = kh_end(iter->view->v4pfxs);
+        return 0;
+      }
+      iter->pfx_sorted_idx = 0;
+      SORTED_PFX_MATCH(iter, iter->view->v4pfxs, iter->view->v4pfxs_index,
+                       v4pfx_ptr_cmp);
+    } else {
+      iter->pfx_it = __pfx_begin(iter, iter->view->v4pfxs, BWV_PART_V4);
+      /* keep searching if this does not exist */
+      WHILE_NOT_MATCHED_PFX(iter, iter->view->v4pfxs, BWV_PART_V4)
+      {
+        iter->pfx_it++;
+      }
+    }
+    RETURN_IF_PFX_VALID(iter, iter->view->v4pfxs, BWV_PART_V4);
+
+    // no ipv4 prefix was found, we don't look for other versions
+    // unless version_filter is zero
+    if (iter->version_filter) {
+      return 0;
+    }
+
+    // continue to the next IP version
+    iter->version_ptr = BGPSTREAM_ADDR_VERSION_IPV6;
+  }
+
+  if (iter->version_ptr == BGPSTREAM_ADDR_VERSION_IPV6) {
+    if (iter->pfx_sorted) {
+      if (pfx_index_build(iter->view, BGPSTREAM_ADDR_VERSION_IPV6) != 0) {
+        iter->pfx_it = kh_end(iter->view->v6pfxs);
+        return 0;
+      }
+      iter->pfx_sorted_idx = 0;
+      SORTED_PFX_MATCH(iter, iter->view->v6pfxs, iter->view->v6pfxs_index,
+                       v6pfx_ptr_cmp);
+    } else {
+      iter->pfx_it = __pfx_begin(iter, iter->view->v6pfxs, BWV_PART_V6);
+      /* keep searching if this does not exist */
+      WHILE_NOT_MATCHED_PFX(iter, iter->view->v6pfxs, BWV_PART_V6)
+      {
+        iter->pfx_it++;
+      }
+    }
+    RETURN_IF_PFX_VALID(iter, iter->view->v6pfxs, BWV_PART_V6);
+  }
+
+  return 0;
+}
+
+#define __iter_next_pfx_v4(iter)                                               \
+  do {                                                                         \
+    /* skip to the next v4 pfx */                                              \
+    if ((iter)->pfx_sorted) {                                                  \
+      (iter)->pfx_sorted_idx++;                                                \
+      SORTED_PFX_MATCH(iter, (iter)->view->v4pfxs,                             \
+                       (iter)->view->v4pfxs_index, v4pfx_ptr_cmp);             \
+    } else {                                                                   \
+      do {                                                                     \
+        (iter)->pfx_it++;                                                      \
+      }                                                                        \
+      WHILE_NOT_MATCHED_PFX(iter, (iter)->view->v4pfxs, BWV_PART_V4);          \
+    }                                                                          \
+    /* if no v4 pfx, but considering all versions... */                        \
+    if (__pfx_valid(iter, (iter)->view->v4pfxs, BWV_PART_V4) == 0 &&           \
+        (iter)->version_filter == 0) {                                         \
+      /* skip to the first v6 pfx */                                           \
+      bgpview_iter_first_pfx((iter), BGPSTREAM_ADDR_VERSION_IPV6,              \
+                             (iter)->pfx_state_mask);                          \
+    }                                                                          \
+    /* here: valid v4, valid v6, or invalid */                                 \
+  } while (0)
+
+#define __iter_next_pfx_v6(iter)                                               \
+  do {                                                                         \
+    if ((iter)->pfx_sorted) {                                                  \
+      (iter)->pfx_sorted_idx++;                                                \
+      SORTED_PFX_MATCH(iter, (iter)->view->v6pfxs,                             \
+                       (iter)->view->v6pfxs_index, v6pfx_ptr_cmp);             \
+    } else {                                                                   \
+      do {                                                                     \
+        iter->pfx_it++;                                                        \
+      }                                                                        \
+      WHILE_NOT_MATCHED_PFX(iter, iter->view->v6pfxs, BWV_PART_V6);            \
+    }                                                                          \
+  } while (0)
+
+#define __iter_next_pfx(iter)                                                  \
+  do {                                                                         \
+    (iter)->pfx_peer_it_valid = 0;                                             \
+    if ((iter)->version_ptr == BGPSTREAM_ADDR_VERSION_IPV4) {                  \
+      __iter_next_pfx_v4(iter);                                                \
+    } else {                                                                   \
+      __iter_next_pfx_v6(iter);                                                \
+    }                                                                          \
+  } while (0)
+
+#define __iter_has_more_pfx_v(iter, table, v)                                  \
+  ((iter)->pfx_it != __pfx_end(iter, table, v))
+
+#define __iter_has_more_pfx(iter)                                              \
+  (((iter)->version_ptr == BGPSTREAM_ADDR_VERSION_IPV4)                        \
+     ? (__iter_has_more_pfx_v((iter), iter->view->v4pfxs, BWV_PART_V4))        \
+     : ((iter)->version_ptr == BGPSTREAM_ADDR_VERSION_IPV6)                    \
+         ? (__iter_has_more_pfx_v((iter), iter->view->v6pfxs, BWV_PART_V6))    \
+         : 0)
+
+int bgpview_iter_next_pfx(bgpview_iter_t *iter)
+{
+  __iter_next_pfx(iter);
+  return __iter_has_more_pfx(iter);
+}
+
+int bgpview_iter_has_more_pfx(bgpview_iter_t *iter)
+{
+  return __iter_has_more_pfx(iter);
+}
+
+int bgpview_iter_seek_pfx(bgpview_iter_t *iter, bgpstream_pfx_t *pfx,
+                          uint8_t state_mask)
+{
+  iter->version_filter = pfx->address.version;
+  iter->version_ptr = pfx->address.version;
+  iter->pfx_state_mask = state_mask;
+  iter->pfx_peer_it_valid = 0;
+  iter->pfx_peer_it = 0;
+
+  switch (pfx->address.version) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    if (iter->pfx_sorted &&
+        pfx_index_build(iter->view, BGPSTREAM_ADDR_VERSION_IPV4) != 0) {
+      iter->pfx_it = kh_end(iter->view->v4pfxs);
+      return 0;
+    }
+    iter->pfx_it = kh_get(bwv_v4pfx_peerid_pfxinfo, iter->view->v4pfxs,
+                          BWV_V4PFX_KEY(&pfx->bs_ipv4));
+    if (iter->pfx_it == kh_end(iter->view->v4pfxs)) {
+      iter->pfx_it = __pfx_end(iter, iter->view->v4pfxs, BWV_PART_V4);
+      return 0;
+    }
+    if (__pfx_in_part(iter, BWV_PART_V4) &&
+        (iter->pfx_state_mask &
+         BWV_PFX_STATE(iter->view, kh_val(iter->view->v4pfxs, iter->pfx_it)))) {
+      if (iter->pfx_sorted) {
+        SORTED_PFX_FIND(iter, iter->view->v4pfxs, iter->view->v4pfxs_index,
+                        v4pfx_ptr_cmp, iter->pfx_it);
+      }
+      return 1;
+    }
+    // if the mask (or partition) does not match, than set the iterator to the
+    // end
+    iter->pfx_it = __pfx_end(iter, iter->view->v4pfxs, BWV_PART_V4);
+    return 0;
+
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    if (iter->pfx_sorted &&
+        pfx_index_build(iter->view, BGPSTREAM_ADDR_VERSION_IPV6) != 0) {
+      iter->pfx_it = kh_end(iter->view->v6pfxs);
+      return 0;
+    }
+    iter->pfx_it = kh_get(bwv_v6pfx_peerid_pfxinfo, iter->view->v6pfxs,
+                          pfx->bs_ipv6);
+    if (iter->pfx_it == kh_end(iter->view->v6pfxs)) {
+      iter->pfx_it = __pfx_end(iter, iter->view->v6pfxs, BWV_PART_V6);
+      return 0;
+    }
+    if (__pfx_in_part(iter, BWV_PART_V6) &&
+        (iter->pfx_state_mask &
+         BWV_PFX_STATE(iter->view, kh_val(iter->view->v6pfxs, iter->pfx_it)))) {
+      if (iter->pfx_sorted) {
+        SORTED_PFX_FIND(iter, iter->view->v6pfxs, iter->view->v6pfxs_index,
+                        v6pfx_ptr_cmp, iter->pfx_it);
+      }
+      return 1;
+    }
+    // if the mask (or partition) does not match, than set the iterator to the
+    // end
+    iter->pfx_it = __pfx_end(iter, iter->view->v6pfxs, BWV_PART_V6);
+    return 0;
+  default:
+    /* programming error */
+    assert(0);
+  }
+  return 0;
+}
+
+/* ==================== PFX-PEER ITERATORS ==================== */
+
+/* optimized macros. be careful when using these */
+
+#define SCAN_FOR_MATCHING_PFX_PEER(iter, peertable)                            \
+  do {                                                                         \
+    for ( ; (iter)->pfx_peer_it != kh_end(peertable); ++(iter)->pfx_peer_it) { \
+      if (!kh_exist(peertable, (iter)->pfx_peer_it)) continue;                 \
+      if ((iter)->pfx_peer_state_mask &                                        \
+          kh_val(peertable, (iter)->pfx_peer_it).state) {                      \
+        __iter_seek_peer((iter), kh_key(peertable, (iter)->pfx_peer_it),       \
+            (iter)->pfx_peer_state_mask);                                      \
+        (iter)->pfx_peer_it_valid = 1;                                         \
+        break;                                                                 \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+#define __iter_pfx_first_peer_tab(iter, peertable, state_mask)                 \
+  do {                                                                         \
+    (iter)->pfx_peer_state_mask = state_mask;                                  \
+    (iter)->pfx_peer_it = 0;                                                   \
+    (iter)->pfx_peer_it_valid = 0;                                             \
+    if (!peertable) break;                                                     \
+    SCAN_FOR_MATCHING_PFX_PEER(iter, peertable);                               \
+  } while (0)
+
+#define SCAN_FOR_MATCHING_PFX_PEER_VEC(iter, vec)                              \
+  do {                                                                         \
+    for (; (iter)->pfx_peer_it < (vec)->size; ++(iter)->pfx_peer_it) {         \
+      if ((iter)->pfx_peer_state_mask &                                        \
+          BWV_PEERVEC_GET_PEER((iter)->view, vec, (iter)->pfx_peer_it)         \
+            ->state) {                                                         \
+        __iter_seek_peer((iter), (vec)->ids[(iter)->pfx_peer_it],              \
+                         (iter)->pfx_peer_state_mask);                         \
+        (iter)->pfx_peer_it_valid = 1;                                         \
+        break;                                                                 \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+#define __iter_pfx_first_peer_vec(iter, vec, state_mask)                       \
+  do {                                                                         \
+    (iter)->pfx_peer_state_mask = state_mask;                                  \
+    (iter)->pfx_peer_it = 0;                                                   \
+    (iter)->pfx_peer_it_valid = 0;                                             \
+    if (!vec)                                                                  \
+      break;                                                                   \
+    SCAN_FOR_MATCHING_PFX_PEER_VEC(iter, vec);                                 \
+  } while (0)
+
+#define __iter_pfx_first_peer(iter, state_mask)                                \
+  do {                                                                         \
+    bwv_peerid_pfxinfo_t *__infos = __pfx_peerinfos((iter));                   \
+    if (BWV_PFX_PEERS_ARE_VEC((iter)->view)) {                                 \
+      __iter_pfx_first_peer_vec(iter, __infos->peers_vec, state_mask);         \
+    } else if ((iter)->view->disable_extended) {                               \
       __iter_pfx_first_peer_tab(iter, __infos->peers_min, state_mask);         \
     } else {                                                                   \
       __iter_pfx_first_peer_tab(iter, __infos->peers_ext, state_mask);         \
     }                                                                          \
   } while (0)
 
-#define __iter_pfx_next_peer_tab(iter, peertable)                              \
-  do {                                                                         \
-    (iter)->pfx_peer_it_valid = 0;                                             \
-    (iter)->pfx_peer_it++;                                                     \
-    SCAN_FOR_MATCHING_PFX_PEER(iter, peertable);                               \
-  } while (0)
+#define __iter_pfx_next_peer_tab(iter, peertable)                              \
+  do {                                                                         \
+    (iter)->pfx_peer_it_valid = 0;                                             \
+    (iter)->pfx_peer_it++;                                                     \
+    SCAN_FOR_MATCHING_PFX_PEER(iter, peertable);                               \
+  } while (0)
+
+#define __iter_pfx_next_peer_vec(iter, vec)                                    \
+  do {                                                                         \
+    (iter)->pfx_peer_it_valid = 0;                                             \
+    (iter)->pfx_peer_it++;                                                     \
+    SCAN_FOR_MATCHING_PFX_PEER_VEC(iter, vec);                                 \
+  } while (0)
+
+#define __iter_pfx_next_peer(iter)                                             \
+  do {                                                                         \
+    bwv_peerid_pfxinfo_t *__infos = __pfx_peerinfos((iter));                   \
+    if (BWV_PFX_PEERS_ARE_VEC((iter)->view)) {                                 \
+      __iter_pfx_next_peer_vec(iter, __infos->peers_vec);                      \
+    } else if ((iter)->view->disable_extended) {                               \
+      __iter_pfx_next_peer_tab(iter, __infos->peers_min);                      \
+    } else {                                                                   \
+      __iter_pfx_next_peer_tab(iter, __infos->peers_ext);                      \
+    }                                                                          \
+  } while (0)
+
+#define __iter_pfx_has_more_peer(iter)                                         \
+  ((iter)->pfx_peer_it_valid)
+
+#define __iter_pfx_seek_peer_tab(iter, tabtype, peertable, peerid, state_mask) \
+  do {                                                                         \
+    (iter)->pfx_peer_state_mask = state_mask;                                  \
+    khiter_t k;                                                                \
+    if (peertable &&                                                           \
+        (k = kh_get(tabtype, peertable, peerid)) != kh_end(peertable) &&       \
+        ((iter)->pfx_peer_state_mask & kh_val(peertable, k).state)) {          \
+      (iter)->pfx_peer_it_valid = 1;                                           \
+      (iter)->pfx_peer_it = k;                                                 \
+      __iter_seek_peer((iter), peerid, state_mask);                            \
+    } else {                                                                   \
+      iter->pfx_peer_it_valid = 0;                                             \
+    }                                                                          \
+  } while (0)
+
+#define __iter_pfx_seek_peer_vec(iter, vec, peerid, state_mask)                \
+  do {                                                                         \
+    (iter)->pfx_peer_state_mask = state_mask;                                  \
+    uint16_t k;                                                                \
+    if (vec && (k = peervec_get(vec, peerid)) != (vec)->size &&               \
+        ((iter)->pfx_peer_state_mask &                                         \
+         BWV_PEERVEC_GET_PEER((iter)->view, vec, k)->state)) {                 \
+      (iter)->pfx_peer_it_valid = 1;                                           \
+      (iter)->pfx_peer_it = k;                                                 \
+      __iter_seek_peer((iter), peerid, state_mask);                            \
+    } else {                                                                   \
+      iter->pfx_peer_it_valid = 0;                                             \
+    }                                                                          \
+  } while (0)
+
+#define __iter_pfx_seek_peer(iter, peerid, state_mask)                         \
+  do {                                                                         \
+    bwv_peerid_pfxinfo_t *__infos = __pfx_peerinfos((iter));                   \
+    if (BWV_PFX_PEERS_ARE_VEC((iter)->view)) {                                 \
+      __iter_pfx_seek_peer_vec(iter, __infos->peers_vec, peerid, state_mask);  \
+    } else if ((iter)->view->disable_extended) {                               \
+      __iter_pfx_seek_peer_tab(iter, bwv_peerid_pfx_peerinfo,                  \
+          __infos->peers_min, peerid, state_mask);                             \
+    } else {                                                                   \
+      __iter_pfx_seek_peer_tab(iter, bwv_peerid_pfx_peerinfo_ext,              \
+          __infos->peers_ext, peerid, state_mask);                             \
+    }                                                                          \
+  } while (0)
+
+/* public accessor functions */
+
+int bgpview_iter_pfx_first_peer(bgpview_iter_t *iter, uint8_t state_mask)
+{
+  __iter_pfx_first_peer(iter, state_mask);
+  assert(iter->pfx_peer_it_valid == 0 || __iter_has_more_peer(iter));
+  return (iter->pfx_peer_it_valid);
+}
+
+int bgpview_iter_pfx_next_peer(bgpview_iter_t *iter)
+{
+  __iter_pfx_next_peer(iter);
+  assert(iter->pfx_peer_it_valid == 0 || __iter_has_more_peer(iter));
+  return (iter->pfx_peer_it_valid);
+}
+
+int bgpview_iter_pfx_has_more_peer(bgpview_iter_t *iter)
+{
+  return __iter_pfx_has_more_peer(iter);
+}
+
+int bgpview_iter_pfx_seek_peer(bgpview_iter_t *iter, bgpstream_peer_id_t peerid,
+                               uint8_t state_mask)
+{
+  __iter_pfx_seek_peer(iter, peerid, state_mask);
+  return (iter->pfx_peer_it_valid);
+}
+
+/* =================== ALL-PFX-PEER ITERATORS ==================== */
+
+int bgpview_iter_first_pfx_peer(bgpview_iter_t *iter, int version,
+                                uint8_t pfx_mask, uint8_t peer_mask)
+{
+  // set the version(s) we iterate through
+  iter->version_filter = version;
+
+  // set the version we start iterating through
+  iter->version_ptr = (iter->version_filter == BGPSTREAM_ADDR_VERSION_IPV6)
+                        ? BGPSTREAM_ADDR_VERSION_IPV6
+                        : BGPSTREAM_ADDR_VERSION_IPV4;
+
+  // masks are going to be set by each first function
+  iter->pfx_state_mask = 0;
+  iter->pfx_peer_state_mask = 0;
+
+  // start from the first matching prefix
+  bgpview_iter_first_pfx(iter, version, pfx_mask);
+  while (__iter_has_more_pfx(iter)) {
+    // look for the first matching peer within the prefix
+    if (bgpview_iter_pfx_first_peer(iter, peer_mask)) {
+      return 1;
+    }
+    __iter_next_pfx(iter);
+  }
+  return 0;
+}
+
+#define __iter_has_more_pfx_peer(iter)                                         \
+  (__iter_has_more_pfx(iter) && __iter_pfx_has_more_peer(iter))
+
+#define __iter_next_pfx_peer(iter)                                             \
+  do {                                                                         \
+    while (__iter_has_more_pfx(iter)) {                                        \
+      /* look for the next matching peer within the prefix */                  \
+      __iter_pfx_next_peer(iter);                                              \
+      if (__iter_pfx_has_more_peer(iter))                                      \
+        break;                                                                 \
+      /* no more peers, go to the next prefix */                               \
+      __iter_next_pfx(iter);                                                   \
+      if (__iter_has_more_pfx(iter)) {                                         \
+        /* go to the first peer */                                             \
+        __iter_pfx_first_peer(iter, iter->pfx_peer_state_mask);                \
+        break;                                                                 \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+int bgpview_iter_next_pfx_peer(bgpview_iter_t *iter)
+{
+  __iter_next_pfx_peer(iter);
+  return __iter_has_more_pfx_peer(iter);
+}
+
+int bgpview_iter_has_more_pfx_peer(bgpview_iter_t *iter)
+{
+  return bgpview_iter_has_more_pfx(iter) &&
+         bgpview_iter_pfx_has_more_peer(iter);
+}
+
+int bgpview_iter_seek_pfx_peer(bgpview_iter_t *iter, bgpstream_pfx_t *pfx,
+                               bgpstream_peer_id_t peerid, uint8_t pfx_mask,
+                               uint8_t peer_mask)
+{
+  if (bgpview_iter_seek_pfx(iter, pfx, pfx_mask) &&
+      bgpview_iter_pfx_seek_peer(iter, peerid, peer_mask)) {
+    return 1;
+  }
+
+  // if the peer is not found we reset the iterators
+  iter->version_ptr = BGPSTREAM_ADDR_VERSION_IPV4;
+  iter->pfx_it = __pfx_end(iter, iter->view->v4pfxs, BWV_PART_V4);
+  iter->pfx_peer_it_valid = 0;
+  iter->pfx_peer_it = 0;
+
+  return 0;
+}
+
+/* ==================== JOURNAL ITERATORS ==================== */
+
+#define WHILE_NOT_MATCHED_JOURNAL_PFX(iter, table)                             \
+  while ((iter)->journal_pfx_it != kh_end((table)) &&                          \
+         !kh_exist((table), (iter)->journal_pfx_it))
+
+int bgpview_iter_first_changed_pfx(bgpview_iter_t *iter, int version)
+{
+  bwv_journal_t *journal = iter->view->journal;
+
+  if (journal == NULL) {
+    iter->journal_version_ptr = 0;
+    return 0;
+  }
+
+  iter->journal_version_filter = version;
+
+  if (version == BGPSTREAM_ADDR_VERSION_IPV4 || version == 0) {
+    iter->journal_version_ptr = BGPSTREAM_ADDR_VERSION_IPV4;
+    iter->journal_pfx_it = kh_begin(journal->v4pfxs);
+    WHILE_NOT_MATCHED_JOURNAL_PFX(iter, journal->v4pfxs)
+    {
+      iter->journal_pfx_it++;
+    }
+    if (iter->journal_pfx_it != kh_end(journal->v4pfxs)) {
+      return 1;
+    }
+    if (version != 0) {
+      return 0;
+    }
+  }
+
+  iter->journal_version_ptr = BGPSTREAM_ADDR_VERSION_IPV6;
+  iter->journal_pfx_it = kh_begin(journal->v6pfxs);
+  WHILE_NOT_MATCHED_JOURNAL_PFX(iter, journal->v6pfxs)
+  {
+    iter->journal_pfx_it++;
+  }
+  return iter->journal_pfx_it != kh_end(journal->v6pfxs);
+}
+
+int bgpview_iter_next_changed_pfx(bgpview_iter_t *iter)
+{
+  bwv_journal_t *journal = iter->view->journal;
+
+  switch (iter->journal_version_ptr) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    do {
+      iter->journal_pfx_it++;
+    }
+    WHILE_NOT_MATCHED_JOURNAL_PFX(iter, journal->v4pfxs);
+    if (iter->journal_pfx_it != kh_end(journal->v4pfxs)) {
+      return 1;
+    }
+    if (iter->journal_version_filter != 0) {
+      return 0;
+    }
+    return bgpview_iter_first_changed_pfx(iter, BGPSTREAM_ADDR_VERSION_IPV6);
+
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    do {
+      iter->journal_pfx_it++;
+    }
+    WHILE_NOT_MATCHED_JOURNAL_PFX(iter, journal->v6pfxs);
+    return iter->journal_pfx_it != kh_end(journal->v6pfxs);
+
+  default:
+    return 0;
+  }
+}
+
+int bgpview_iter_has_more_changed_pfx(bgpview_iter_t *iter)
+{
+  bwv_journal_t *journal = iter->view->journal;
+
+  switch (iter->journal_version_ptr) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    return iter->journal_pfx_it != kh_end(journal->v4pfxs);
+
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    return iter->journal_pfx_it != kh_end(journal->v6pfxs);
+
+  default:
+    return 0;
+  }
+}
+
+bgpstream_pfx_t *bgpview_iter_changed_pfx_get_pfx(bgpview_iter_t *iter)
+{
+  bwv_journal_t *journal = iter->view->journal;
+
+  switch (iter->journal_version_ptr) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    return (bgpstream_pfx_t *)&kh_key(journal->v4pfxs, iter->journal_pfx_it);
+
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    return (bgpstream_pfx_t *)&kh_key(journal->v6pfxs, iter->journal_pfx_it);
+
+  default:
+    return NULL;
+  }
+}
+
+int bgpview_iter_changed_pfx_get_peers(bgpview_iter_t *iter,
+                                       bgpstream_peer_id_t **peer_ids)
+{
+  bwv_journal_t *journal = iter->view->journal;
+  bwv_journal_peers_t *peers;
+
+  switch (iter->journal_version_ptr) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    peers = &kh_val(journal->v4pfxs, iter->journal_pfx_it);
+    break;
+
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    peers = &kh_val(journal->v6pfxs, iter->journal_pfx_it);
+    break;
+
+  default:
+    return -1;
+  }
+
+  *peer_ids = peers->ids;
+  return peers->cnt;
+}
+
+int bgpview_iter_first_changed_peer(bgpview_iter_t *iter)
+{
+  bwv_journal_t *journal = iter->view->journal;
+
+  if (journal == NULL) {
+    return 0;
+  }
+
+  iter->journal_peer_it = kh_begin(journal->peers);
+  while (iter->journal_peer_it != kh_end(journal->peers) &&
+         !kh_exist(journal->peers, iter->journal_peer_it)) {
+    iter->journal_peer_it++;
+  }
+  return iter->journal_peer_it != kh_end(journal->peers);
+}
+
+int bgpview_iter_next_changed_peer(bgpview_iter_t *iter)
+{
+  bwv_journal_t *journal = iter->view->journal;
+
+  do {
+    iter->journal_peer_it++;
+  } while (iter->journal_peer_it != kh_end(journal->peers) &&
+           !kh_exist(journal->peers, iter->journal_peer_it));
+  return iter->journal_peer_it != kh_end(journal->peers);
+}
+
+int bgpview_iter_has_more_changed_peer(bgpview_iter_t *iter)
+{
+  return iter->view->journal != NULL &&
+         iter->journal_peer_it != kh_end(iter->view->journal->peers);
+}
+
+bgpstream_peer_id_t bgpview_iter_changed_peer_get_peer_id(bgpview_iter_t *iter)
+{
+  return kh_key(iter->view->journal->peers, iter->journal_peer_it);
+}
+
+/* ==================== ORIGIN INDEX ITERATORS ==================== */
+
+/* (re)build the origin index from the active pfx-peers of the view */
+static int origin_index_build(bgpview_t *view)
+{
+  bwv_origin_index_t *index = view->origin_index;
+  bgpview_iter_t *it;
+
+  origin_index_reset(index);
+
+  if ((it = bgpview_iter_create(view)) == NULL) {
+    index->valid = 0;
+    return -1;
+  }
+  for (bgpview_iter_first_pfx_peer(it, 0, BGPVIEW_FIELD_ACTIVE,
+                                   BGPVIEW_FIELD_ACTIVE);
+       bgpview_iter_has_more_pfx_peer(it) && index->valid != 0;
+       bgpview_iter_next_pfx_peer(it)) {
+    origin_index_pfx_peer(it, __iter_pfx_peer_get_as_path_store_path_id(it),
+                          1);
+  }
+  bgpview_iter_destroy(it);
+
+  return (index->valid != 0) ? 0 : -1;
+}
+
+/* get the origin index of a view, rebuilding it if needed. returns NULL if
+   the index is disabled or could not be built */
+static bwv_origin_index_t *origin_index_get(bgpview_t *view)
+{
+  if (view->origin_index == NULL ||
+      (view->origin_index->valid == 0 && origin_index_build(view) != 0)) {
+    return NULL;
+  }
+  return view->origin_index;
+}
+
+#define WHILE_NOT_MATCHED_INDEXED_PFX(iter, table)                             \
+  while ((table) != NULL && (iter)->index_pfx_it != kh_end((table)) &&         \
+         !kh_exist((table), (iter)->index_pfx_it))
+
+/* move the index iterator to the first indexed prefix at or after its
+   position, and seek the prefix iterator to it */
+static int index_pfx_seek(bgpview_iter_t *iter)
+{
+  int found;
+
+  switch (iter->index_version_ptr) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    WHILE_NOT_MATCHED_INDEXED_PFX(iter, iter->index_v4pfxs)
+    {
+      iter->index_pfx_it++;
+    }
+    if (iter->index_v4pfxs != NULL &&
+        iter->index_pfx_it != kh_end(iter->index_v4pfxs)) {
+      found = bgpview_iter_seek_pfx(
+        iter,
+        (bgpstream_pfx_t *)&kh_key(iter->index_v4pfxs, iter->index_pfx_it),
+        BGPVIEW_FIELD_ACTIVE);
+      assert(found);
+      return found;
+    }
+    /* continue with the v6 prefixes */
+    iter->index_version_ptr = BGPSTREAM_ADDR_VERSION_IPV6;
+    iter->index_pfx_it = 0;
+    /* fall through */
+
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    WHILE_NOT_MATCHED_INDEXED_PFX(iter, iter->index_v6pfxs)
+    {
+      iter->index_pfx_it++;
+    }
+    if (iter->index_v6pfxs != NULL &&
+        iter->index_pfx_it != kh_end(iter->index_v6pfxs)) {
+      found = bgpview_iter_seek_pfx(
+        iter,
+        (bgpstream_pfx_t *)&kh_key(iter->index_v6pfxs, iter->index_pfx_it),
+        BGPVIEW_FIELD_ACTIVE);
+      assert(found);
+      return found;
+    }
+    iter->index_version_ptr = 0;
+    return 0;
+
+  default:
+    return 0;
+  }
+}
+
+static int index_first_pfx(bgpview_iter_t *iter,
+                           khash_t(bwv_v4pfx_set) *v4pfxs,
+                           khash_t(bwv_v6pfx_set) *v6pfxs)
+{
+  iter->index_v4pfxs = v4pfxs;
+  iter->index_v6pfxs = v6pfxs;
+  iter->index_version_ptr = BGPSTREAM_ADDR_VERSION_IPV4;
+  iter->index_pfx_it = 0;
+  return index_pfx_seek(iter);
+}
+
+int bgpview_iter_first_origin_pfx(bgpview_iter_t *iter, uint32_t origin_asn)
+{
+  bwv_origin_index_t *index;
+  khiter_t k;
+
+  iter->index_version_ptr = 0;
+
+  if ((index = origin_index_get(iter->view)) == NULL ||
+      (k = kh_get(bwv_origin_pfxs, index->origins, origin_asn)) ==
+        kh_end(index->origins)) {
+    return 0;
+  }
+
+  return index_first_pfx(iter, kh_val(index->origins, k).v4pfxs,
+                         kh_val(index->origins, k).v6pfxs);
+}
+
+int bgpview_iter_first_moas_pfx(bgpview_iter_t *iter)
+{
+  bwv_origin_index_t *index;
+
+  iter->index_version_ptr = 0;
+
+  if ((index = origin_index_get(iter->view)) == NULL) {
+    return 0;
+  }
+
+  return index_first_pfx(iter, index->v4moas, index->v6moas);
+}
+
+int bgpview_iter_next_indexed_pfx(bgpview_iter_t *iter)
+{
+  if (iter->index_version_ptr == 0) {
+    return 0;
+  }
+  iter->index_pfx_it++;
+  return index_pfx_seek(iter);
+}
+
+int bgpview_iter_has_more_indexed_pfx(bgpview_iter_t *iter)
+{
+  return iter->index_version_ptr != 0;
+}
+
+int bgpview_iter_pfx_get_origins(bgpview_iter_t *iter, uint32_t *asns,
+                                 int len)
+{
+  bwv_origin_index_t *index;
+  bwv_pfx_origins_t *po = NULL;
+  khiter_t k;
+  int i;
+
+  if ((index = origin_index_get(iter->view)) == NULL) {
+    return -1;
+  }
+
+  switch (iter->version_ptr) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    k = kh_get(bwv_v4pfx_origins, index->v4pfxs,
+               BWV_V4PFX(iter->view, iter->pfx_it));
+    if (k != kh_end(index->v4pfxs)) {
+      po = &kh_val(index->v4pfxs, k);
+    }
+    break;
+
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    k = kh_get(bwv_v6pfx_origins, index->v6pfxs,
+               kh_key(iter->view->v6pfxs, iter->pfx_it));
+    if (k != kh_end(index->v6pfxs)) {
+      po = &kh_val(index->v6pfxs, k);
+    }
+    break;
+
+  default:
+    return -1;
+  }
+
+  if (po == NULL) {
+    return 0;
+  }
+  for (i = 0; i < po->cnt && i < len; i++) {
+    asns[i] = po->origins[i].asn;
+  }
+  return po->cnt;
+}
+
+/* ==================== LPM ITERATORS ==================== */
+
+/* (re)build the LPM index from the active prefixes of the view */
+static int lpm_index_build(bgpview_t *view)
+{
+  bwv_lpm_index_t *lpm = view->lpm_index;
+  bgpview_iter_t *it;
+
+  lpm_index_reset(lpm);
+
+  if ((it = bgpview_iter_create(view)) == NULL) {
+    lpm->valid = 0;
+    return -1;
+  }
+  for (bgpview_iter_first_pfx(it, 0, BGPVIEW_FIELD_ACTIVE);
+       bgpview_iter_has_more_pfx(it) && lpm->valid != 0;
+       bgpview_iter_next_pfx(it)) {
+    lpm_index_pfx(it, 1);
+  }
+  bgpview_iter_destroy(it);
+
+  return (lpm->valid != 0) ? 0 : -1;
+}
+
+/* get the LPM index of a view, rebuilding it if needed. returns NULL if the
+   index is disabled or could not be built */
+static bwv_lpm_index_t *lpm_index_get(bgpview_t *view)
+{
+  if (view->lpm_index == NULL ||
+      (view->lpm_index->valid == 0 && lpm_index_build(view) != 0)) {
+    return NULL;
+  }
+  return view->lpm_index;
+}
+
+/* get the length of the longest active prefix that covers the address, or -1
+   if there is none */
+static int lpm_lookup(bgpview_t *view, bwv_lpm_index_t *lpm,
+                      bgpstream_ip_addr_t *addr)
+{
+  switch (addr->version) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    return lpm_v4_lookup(lpm, ntohl(addr->bs_ipv4.addr.s_addr));
+
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    return lpm_probe(view, addr, 128);
+
+  default:
+    return -1;
+  }
+}
+
+/* build the prefix of the given length that covers the address */
+static void lpm_pfx(bgpstream_pfx_t *pfx, bgpstream_ip_addr_t *addr, int len)
+{
+  if (addr->version == BGPSTREAM_ADDR_VERSION_IPV4) {
+    lpm_v4_pfx(&pfx->bs_ipv4, ntohl(addr->bs_ipv4.addr.s_addr), len);
+  } else {
+    lpm_v6_pfx(&pfx->bs_ipv6, &addr->bs_ipv6.addr, len);
+  }
+}
+
+/* seek the prefix iterator to the covering prefix of the given length, or end
+   the covering iteration if len is -1 */
+static int lpm_seek(bgpview_iter_t *iter, int len)
+{
+  bgpstream_pfx_t pfx;
+  int found;
+
+  if (len < 0) {
+    iter->lpm_addr.version = 0;
+    return 0;
+  }
+  iter->lpm_len = len;
+  lpm_pfx(&pfx, &iter->lpm_addr, len);
+  found = bgpview_iter_seek_pfx(iter, &pfx, BGPVIEW_FIELD_ACTIVE);
+  assert(found);
+  return found;
+}
+
+int bgpview_iter_first_covering_pfx(bgpview_iter_t *iter,
+                                    bgpstream_ip_addr_t *addr)
+{
+  bwv_lpm_index_t *lpm;
+
+  iter->lpm_addr.version = 0;
+
+  if ((lpm = lpm_index_get(iter->view)) == NULL) {
+    return 0;
+  }
+
+  bgpstream_addr_copy(&iter->lpm_addr, addr);
+  return lpm_seek(iter, lpm_lookup(iter->view, lpm, addr));
+}
+
+int bgpview_iter_next_covering_pfx(bgpview_iter_t *iter)
+{
+  if (iter->lpm_addr.version == 0) {
+    return 0;
+  }
+  if (iter->lpm_len == 0 || lpm_index_get(iter->view) == NULL) {
+    return lpm_seek(iter, -1);
+  }
+  return lpm_seek(iter, lpm_probe(iter->view, &iter->lpm_addr,
+                                  iter->lpm_len - 1));
+}
+
+int bgpview_iter_has_more_covering_pfx(bgpview_iter_t *iter)
+{
+  return iter->lpm_addr.version != 0;
+}
+
+/* ==================== PEER-PFX ITERATORS ==================== */
+
+/* (re)build the peer index from the valid pfx-peers of the view */
+static int peer_index_build(bgpview_t *view)
+{
+  bwv_peer_index_t *index = view->peer_index;
+  bgpview_iter_t *it;
+
+  peer_index_reset(view, index);
+
+  if ((it = bgpview_iter_create(view)) == NULL) {
+    index->valid = 0;
+    return -1;
+  }
+  for (bgpview_iter_first_pfx_peer(it, 0, BGPVIEW_FIELD_ALL_VALID,
+                                   BGPVIEW_FIELD_ALL_VALID);
+       bgpview_iter_has_more_pfx_peer(it) && index->valid != 0;
+       bgpview_iter_next_pfx_peer(it)) {
+    peer_index_pfx_peer(it, bgpview_iter_peer_get_peer_id(it), 1);
+  }
+  bgpview_iter_destroy(it);
+
+  return (index->valid != 0) ? 0 : -1;
+}
+
+/* get the peer index of a view, rebuilding it if needed. returns NULL if the
+   index is disabled or could not be built */
+static bwv_peer_index_t *peer_index_get(bgpview_t *view)
+{
+  bwv_peer_index_t *index = view->peer_index;
+
+  if (index == NULL) {
+    return NULL;
+  }
+  if (index->valid != 0 && (index->v4_nbits != kh_n_buckets(view->v4pfxs) ||
+                            index->v6_nbits != kh_n_buckets(view->v6pfxs))) {
+    index->valid = 0;
+  }
+  if (index->valid == 0 && peer_index_build(view) != 0) {
+    return NULL;
+  }
+  return index;
+}
+
+/* compact the bucket list (if any) that the peer-pfx iterator is about to walk,
+   so that it has no duplicate buckets. the list is not changed during the
+   walk, since no pfx-peers may be added meanwhile */
+static void peer_pfx_prepare(bgpview_iter_t *iter)
+{
+  bwv_peer_bkts_t *bkts;
+
+  if (iter->peer_pfx_indexed == 0 ||
+      (bkts = peer_index_bkts(iter->view->peer_index, iter->peer_pfx_id,
+                              iter->peer_pfx_version, 0)) == NULL ||
+      bkts->bits != NULL || bkts->removed == 0) {
+    return;
+  }
+  peer_index_compact(iter->view, bkts, iter->peer_pfx_version,
+                     iter->peer_pfx_id);
+}
+
+/* move the peer-pfx iterator to the first pfx-peer of its peer (at or after
+   its position) that matches the pfx-peer state mask. the buckets of the
+   prefix tables are either scanned in full, or only those that the peer index
+   lists or flags for the peer */
+static int peer_pfx_seek(bgpview_iter_t *iter)
+{
+  bwv_peer_index_t *index = iter->view->peer_index;
+  uint8_t state_mask = iter->pfx_peer_state_mask;
+  bwv_peerid_pfxinfo_t *pfxinfo;
+  bwv_peer_bkts_t *bkts = NULL;
+  uint64_t *bits = NULL;
+  uint64_t w;
+  khiter_t end;
+  khiter_t bkt;
+
+  while (iter->peer_pfx_version != 0) {
+    if (iter->peer_pfx_version == BGPSTREAM_ADDR_VERSION_IPV4) {
+      end = kh_end(iter->view->v4pfxs);
+    } else {
+      end = kh_end(iter->view->v6pfxs);
+    }
+    if (iter->peer_pfx_indexed != 0) {
+      bkts = peer_index_bkts(index, iter->peer_pfx_id, iter->peer_pfx_version,
+                             0);
+      if (bkts == NULL) {
+        iter->peer_pfx_bucket = end;
+      } else if ((bits = bkts->bits) == NULL) {
+        /* walk the list of buckets instead */
+        end = bkts->cnt;
+      }
+    }
+
+    for (; iter->peer_pfx_bucket < end; iter->peer_pfx_bucket++) {
+      bkt = iter->peer_pfx_bucket;
+      if (bkts != NULL && bits == NULL) {
+        bkt = bkts->list[iter->peer_pfx_bucket];
+      } else if (bits != NULL) {
+        /* skip to the next flagged bucket */
+        w = bits[iter->peer_pfx_bucket / 64] >> (iter->peer_pfx_bucket % 64);
+        if (w == 0) {
+          iter->peer_pfx_bucket |= 63;
+          continue;
+        }
+        iter->peer_pfx_bucket += __builtin_ctzll(w);
+        if (iter->peer_pfx_bucket >= end) {
+          break;
+        }
+        bkt = iter->peer_pfx_bucket;
+      }
+      if (iter->peer_pfx_version == BGPSTREAM_ADDR_VERSION_IPV4) {
+        if (!kh_exist(iter->view->v4pfxs, bkt)) {
+          continue;
+        }
+        pfxinfo = kh_val(iter->view->v4pfxs, bkt);
+      } else {
+        if (!kh_exist(iter->view->v6pfxs, bkt)) {
+          continue;
+        }
+        pfxinfo = kh_val(iter->view->v6pfxs, bkt);
+      }
+      if (BWV_PFX_STATE(iter->view, pfxinfo) == BGPVIEW_FIELD_INVALID) {
+        continue;
+      }
+      iter->version_ptr = iter->peer_pfx_version;
+      iter->pfx_it = bkt;
+      __iter_pfx_seek_peer(iter, iter->peer_pfx_id, state_mask);
+      if (iter->pfx_peer_it_valid) {
+        return 1;
+      }
+    }
+
+    /* continue with the v6 prefixes */
+    if (iter->peer_pfx_version == BGPSTREAM_ADDR_VERSION_IPV4 &&
+        iter->peer_pfx_version_filter == 0) {
+      iter->peer_pfx_version = BGPSTREAM_ADDR_VERSION_IPV6;
+      iter->peer_pfx_bucket = 0;
+      bkts = NULL;
+      bits = NULL;
+      peer_pfx_prepare(iter);
+    } else {
+      iter->peer_pfx_version = 0;
+    }
+  }
+
+  iter->pfx_peer_it_valid = 0;
+  return 0;
+}
+
+int bgpview_iter_peer_first_pfx(bgpview_iter_t *iter, int version,
+                                uint8_t state_mask)
+{
+  assert(__iter_has_more_peer(iter));
+
+  iter->peer_pfx_id = __iter_peer_get_peer_id(iter);
+  iter->peer_pfx_version_filter = version;
+  iter->peer_pfx_version = (version == BGPSTREAM_ADDR_VERSION_IPV6)
+                             ? BGPSTREAM_ADDR_VERSION_IPV6
+                             : BGPSTREAM_ADDR_VERSION_IPV4;
+  iter->peer_pfx_bucket = 0;
+  iter->peer_pfx_indexed = (peer_index_get(iter->view) != NULL);
+  iter->pfx_peer_state_mask = state_mask;
+  peer_pfx_prepare(iter);
+
+  return peer_pfx_seek(iter);
+}
+
+int bgpview_iter_peer_next_pfx(bgpview_iter_t *iter)
+{
+  if (iter->peer_pfx_version == 0) {
+    return 0;
+  }
+  iter->peer_pfx_bucket++;
+  return peer_pfx_seek(iter);
+}
+
+int bgpview_iter_peer_has_more_pfx(bgpview_iter_t *iter)
+{
+  return iter->peer_pfx_version != 0;
+}
+
+/* ==================== CREATION FUNCS ==================== */
+
+bgpstream_peer_id_t bgpview_iter_add_peer(bgpview_iter_t *iter,
+                                          const char *collector_str,
+                                          bgpstream_ip_addr_t *peer_address,
+                                          uint32_t peer_asnumber)
+{
+  bgpstream_peer_id_t peer_id;
+  khiter_t k;
+  int khret;
+
+  RETURN_IF_FROZEN(iter->view, 0);
+
+  /* add peer to signatures' map */
+  if ((peer_id =
+         bgpstream_peer_sig_map_get_id(iter->view->peersigns, collector_str,
+                                       peer_address, peer_asnumber)) == 0) {
+    fprintf(stderr, "Could not add peer to peersigns\n");
+    fprintf(stderr, "Consider making bgpstream_peer_sig_map_set more robust\n");
+    return 0;
+  }
+
+  /* populate peer information in peerinfo */
+
+  if ((k = kh_get(bwv_peerid_peerinfo, iter->view->peerinfo, peer_id)) ==
+      kh_end(iter->view->peerinfo)) {
+    /* new peer!  */
+    if (iter->view->peerinfo->n_occupied >=
+        iter->view->peerinfo->upper_bound) {
+      /* the put may rehash the table */
+      iter->view->rehash_gen++;
+    }
+    k = kh_put(bwv_peerid_peerinfo, iter->view->peerinfo, peer_id, &khret);
+    memset(&kh_val(iter->view->peerinfo, k), 0, sizeof(bwv_peerinfo_t));
+    kh_val(iter->view->peerinfo, k).epoch = iter->view->epoch;
+    /* peer is invalid */
+  } else if (kh_val(iter->view->peerinfo, k).epoch != iter->view->epoch) {
+    /* stale peer from before the last clear, start from scratch */
+    peerinfo_reset(&kh_val(iter->view->peerinfo, k));
+    kh_val(iter->view->peerinfo, k).epoch = iter->view->epoch;
+  }
+
+  /* seek the iterator */
+  iter->peer_it = k;
+  iter->peer_state_mask = BGPVIEW_FIELD_ALL_VALID;
+  iter->pfx_peer_it_valid = 0; // moving peer_it invalidates pfx_peer_it
+
+  /* here iter->peer_it points to a peer, it could be invalid, inactive,
+     active */
+  if (kh_val(iter->view->peerinfo, k).state != BGPVIEW_FIELD_INVALID) {
+    /* it was already here, and it was inactive/active, just return */
+    return peer_id;
+  }
+
+  /* by here, it was invalid */
+  kh_val(iter->view->peerinfo, k).state = BGPVIEW_FIELD_INACTIVE;
+  journal_peer(iter->view, peer_id);
+
+  /* and count one more inactive peer */
+  iter->view->peerinfo_cnt[BGPVIEW_FIELD_INACTIVE]++;
+
+  return peer_id;
+}
+
+int bgpview_iter_remove_peer(bgpview_iter_t *iter)
+{
+  bgpview_iter_t *lit;
+  /* we have to have a valid peer */
+  assert(__iter_has_more_peer(iter));
+
+  RETURN_IF_FROZEN(iter->view, -1);
+
+  /* if the peer is active, then we deactivate it first */
+  if (bgpview_iter_peer_get_state(iter) == BGPVIEW_FIELD_ACTIVE) {
+    bgpview_iter_deactivate_peer(iter);
+  }
+  assert(bgpview_iter_peer_get_state(iter) == BGPVIEW_FIELD_INACTIVE);
+
+  /* if the peer had prefixes, then we need to remove all pfx-peers for this
+     peer */
+  if (bgpview_iter_peer_get_pfx_cnt(iter, 0, BGPVIEW_FIELD_ALL_VALID) > 0) {
+    lit = bgpview_iter_create(iter->view);
+    assert(lit != NULL);
+    lit->peer_it = iter->peer_it;
+    for (bgpview_iter_peer_first_pfx(lit, 0, BGPVIEW_FIELD_ALL_VALID);
+         bgpview_iter_peer_has_more_pfx(lit); bgpview_iter_peer_next_pfx(lit)) {
+      bgpview_iter_pfx_remove_peer(lit);
+    }
+    bgpview_iter_destroy(lit);
+  }
+
+  journal_peer(iter->view, kh_key(iter->view->peerinfo, iter->peer_it));
+
+  /* set the state to invalid and reset the counters */
+  peerinfo_reset(&kh_value(iter->view->peerinfo, iter->peer_it));
+  iter->view->need_gc_peerinfo = 1;
+  iter->view->peerinfo_cnt[BGPVIEW_FIELD_INACTIVE]--;
+
+  return 0;
+}
+
+int bgpview_iter_add_pfx_peer(bgpview_iter_t *iter,
+                                   bgpstream_pfx_t *pfx,
+                                   bgpstream_peer_id_t peer_id,
+                                   bgpstream_as_path_t *as_path)
+{
+  bgpstream_as_path_store_path_id_t path_id;
+  bgpstream_peer_sig_t *ps;
+
+  /* first seek to the prefix */
+  if (bgpview_iter_seek_pfx(iter, pfx, BGPVIEW_FIELD_ALL_VALID) == 0) {
+    /* we have to first create (or un-invalid) the prefix */
+    if (add_pfx(iter, pfx) != 0) {
+      return -1;
+    }
+  }
+
+  /* the peer must already exist */
+  __iter_seek_peer(iter, peer_id, BGPVIEW_FIELD_ALL_VALID);
+  iter->pfx_peer_it_valid = 0; // moving peer_it invalidates pfx_peer_it
+  if (iter->peer_it == kh_end(iter->view->peerinfo)) {
+    return -1;
+  }
+  /* get the peer ASN */
+  ps = bgpview_iter_peer_get_sig(iter);
+
+  if (bgpstream_as_path_store_get_path_id(iter->view->pathstore, as_path,
+                                          ps->peer_asnumber, &path_id) != 0) {
+    fprintf(stderr, "ERROR: Failed to get AS Path ID from store\n");
+    return -1;
+  }
+
+  /* now insert the prefix-peer info */
+  return bgpview_iter_pfx_add_peer_by_id(iter, peer_id, path_id);
+}
+
+int bgpview_iter_add_pfx_peer_by_id(bgpview_iter_t *iter, bgpstream_pfx_t *pfx,
+                                    bgpstream_peer_id_t peer_id,
+                                    bgpstream_as_path_store_path_id_t path_id)
+{
+  /* the peer must already exist */
+  if (bgpview_iter_seek_peer(iter, peer_id, BGPVIEW_FIELD_ALL_VALID) == 0) {
+    return -1;
+  }
+
+  /* now seek to the prefix */
+  if (bgpview_iter_seek_pfx(iter, pfx, BGPVIEW_FIELD_ALL_VALID) == 0) {
+    /* we have to first create (or un-invalid) the prefix */
+    if (add_pfx(iter, pfx) != 0) {
+      return -1;
+    }
+  }
+
+  /* now insert the prefix-peer info */
+  return bgpview_iter_pfx_add_peer_by_id(iter, peer_id, path_id);
+}
+
+int bgpview_iter_remove_pfx(bgpview_iter_t *iter)
+{
+  bwv_peerid_pfxinfo_t *pfxinfo;
+  bgpview_iter_t ti;
+
+  if ((pfxinfo = pfxinfo_unshare(iter)) == NULL) {
+    return -1;
+  }
+
+  /* if the pfx is active, then we deactivate it first */
+  if (bgpview_iter_pfx_get_state(iter) == BGPVIEW_FIELD_ACTIVE) {
+    bgpview_iter_deactivate_pfx(iter);
+  }
+
+  assert(pfxinfo->state == BGPVIEW_FIELD_INACTIVE);
+
+  pfxinfo->state = BGPVIEW_FIELD_INVALID;
+
+  /* if there are any active or inactive pfx-peers, we remove them now */
+  if (bgpview_iter_pfx_get_peer_cnt(iter, BGPVIEW_FIELD_ALL_VALID) > 0) {
+    ti = *iter;
+    /* iterate over all pfx-peers for this pfx */
+    __iter_pfx_first_peer(&ti, BGPVIEW_FIELD_ALL_VALID);
+    while (bgpview_iter_pfx_has_more_peer(&ti)) {
+      bgpview_iter_pfx_remove_peer(&ti);
+      __iter_pfx_next_peer(&ti);
+    }
+  }
+
+  assert(pfxinfo->peers_cnt[BGPVIEW_FIELD_INACTIVE] == 0 &&
+         pfxinfo->peers_cnt[BGPVIEW_FIELD_ACTIVE] == 0);
+
+  /* set the state to invalid and update counters */
+
+  switch (iter->version_ptr) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    iter->view->v4pfxs_cnt[BGPVIEW_FIELD_INACTIVE]--;
+    iter->view->need_gc_v4pfxs = 1;
+    break;
+
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    iter->view->v6pfxs_cnt[BGPVIEW_FIELD_INACTIVE]--;
+    iter->view->need_gc_v6pfxs = 1;
+    break;
+
+  default:
+    return -1;
+  }
+
+  return 0;
+}
+
+int bgpview_iter_pfx_add_peer(bgpview_iter_t *iter, bgpstream_peer_id_t peer_id,
+                              bgpstream_as_path_t *as_path)
+{
+  bgpstream_as_path_store_path_id_t path_id;
+
+  /* get the peer ASN */
+  if (bgpstream_as_path_store_get_path_id(
+        iter->view->pathstore, as_path,
+        __iter_peer_get_sig(iter)->peer_asnumber, &path_id) != 0) {
+    fprintf(stderr, "ERROR: Failed to get AS Path ID from store\n");
+    return -1;
+  }
+
+  __iter_seek_peer(iter, peer_id, BGPVIEW_FIELD_ALL_VALID);
+
+  if (pfxinfo_unshare(iter) == NULL) {
+    return -1;
+  }
+  return peerid_pfxinfo_insert(iter, __pfx_peerinfos(iter), peer_id, path_id);
+}
+
+int bgpview_iter_pfx_add_peer_by_id(bgpview_iter_t *iter,
+                                    bgpstream_peer_id_t peer_id,
+                                    bgpstream_as_path_store_path_id_t path_id)
+{
+  /* this code is mostly a duplicate of the above func, for efficiency */
+  __iter_seek_peer(iter, peer_id, BGPVIEW_FIELD_ALL_VALID);
+
+  if (pfxinfo_unshare(iter) == NULL) {
+    return -1;
+  }
+  return peerid_pfxinfo_insert(iter, __pfx_peerinfos(iter), peer_id, path_id);
+}
+
+int bgpview_iter_pfx_remove_peer(bgpview_iter_t *iter)
+{
+  bwv_peerid_pfxinfo_t *pfxinfo;
+
+  if ((pfxinfo = pfxinfo_unshare(iter)) == NULL) {
+    return -1;
+  }
+
+  /* if the pfx-peer is active, then we deactivate it first */
+  if (__iter_pfx_peer_get_state(iter) == BGPVIEW_FIELD_ACTIVE) {
+    bgpview_iter_pfx_deactivate_peer(iter);
+  }
+
+  assert(BWV_PFX_GET_PEER_STATE(iter->view, pfxinfo, iter->pfx_peer_it) ==
+         BGPVIEW_FIELD_INACTIVE);
+
+  journal_pfx_peer(iter, kh_key(iter->view->peerinfo, iter->peer_it));
+
+  /* now, simply set the state to invalid and reset the pfx counters. the
+     pfx-peer cell is reclaimed by the next gc sweep of the prefix table */
+  BWV_PFX_SET_PEER_STATE(iter->view, pfxinfo, iter->pfx_peer_it,
+      BGPVIEW_FIELD_INVALID);
+  pfxinfo->peers_cnt[BGPVIEW_FIELD_INACTIVE]--;
+  peer_index_pfx_peer(iter, kh_key(iter->view->peerinfo, iter->peer_it), 0);
+
+  assert(__iter_has_more_peer(iter));
+  switch (iter->version_ptr) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    kh_value(iter->view->peerinfo, iter->peer_it)
+      .v4_pfx_cnt[BGPVIEW_FIELD_INACTIVE]--;
+    iter->view->need_gc_v4pfxs = 1;
+    break;
+
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    kh_value(iter->view->peerinfo, iter->peer_it)
+      .v6_pfx_cnt[BGPVIEW_FIELD_INACTIVE]--;
+    iter->view->need_gc_v6pfxs = 1;
+    break;
+
+  default:
+    return -1;
+  }
+
+  /* if there are no peers left in this pfx, the pfx should be removed */
+  if (pfxinfo->state != BGPVIEW_FIELD_INVALID &&
+      pfxinfo->peers_cnt[BGPVIEW_FIELD_INACTIVE] == 0 &&
+      pfxinfo->peers_cnt[BGPVIEW_FIELD_ACTIVE] == 0) {
+    return bgpview_iter_remove_pfx(iter);
+  }
+
+  return 0;
+}
+
+/* ==================== ACTIVATE/DEACTIVATE ==================== */
+
+#define ACTIVATE_FIELD_CNT(field)                                              \
+  do {                                                                         \
+    field[BGPVIEW_FIELD_INACTIVE]--;                                           \
+    field[BGPVIEW_FIELD_ACTIVE]++;                                             \
+  } while (0);
+
+#define DEACTIVATE_FIELD_CNT(field)                                            \
+  do {                                                                         \
+    field[BGPVIEW_FIELD_INACTIVE]++;                                           \
+    field[BGPVIEW_FIELD_ACTIVE]--;                                             \
+  } while (0)
+
+int bgpview_iter_activate_peer(bgpview_iter_t *iter)
+{
+  assert(__iter_has_more_peer(iter));
+  assert(__iter_peer_get_state(iter) > 0);
+
+  if (__iter_peer_get_state(iter) != BGPVIEW_FIELD_INACTIVE) {
+    return 0;
+  }
+
+  RETURN_IF_FROZEN(iter->view, -1);
+
+  journal_peer(iter->view, kh_key(iter->view->peerinfo, iter->peer_it));
+
+  kh_val(iter->view->peerinfo, iter->peer_it).state = BGPVIEW_FIELD_ACTIVE;
+  ACTIVATE_FIELD_CNT(iter->view->peerinfo_cnt);
+  return 1;
+}
+
+int bgpview_iter_deactivate_peer(bgpview_iter_t *iter)
+{
+  assert(__iter_has_more_peer(iter));
+  assert(__iter_peer_get_state(iter) > 0);
+
+  bgpview_iter_t *lit;
+
+  if (__iter_peer_get_state(iter) != BGPVIEW_FIELD_ACTIVE) {
+    return 0;
+  }
+
+  RETURN_IF_FROZEN(iter->view, -1);
+
+  journal_peer(iter->view, kh_key(iter->view->peerinfo, iter->peer_it));
+
+  /* only do the massive work of deactivating all pfx-peers if this peer has any
+     active pfxs */
+  if (__iter_peer_get_pfx_cnt(iter, 0, BGPVIEW_FIELD_ACTIVE) > 0) {
+    lit = bgpview_iter_create(iter->view);
+    assert(lit != NULL);
+    lit->peer_it = iter->peer_it;
+
+    // deactivate all the peer-pfx associated with the peer
+    for (bgpview_iter_peer_first_pfx(lit, 0, BGPVIEW_FIELD_ACTIVE);
+         bgpview_iter_peer_has_more_pfx(lit); bgpview_iter_peer_next_pfx(lit)) {
+      bgpview_iter_pfx_deactivate_peer(lit);
+    }
+    bgpview_iter_destroy(lit);
+  }
+
+  /* mark as inactive */
+  kh_val(iter->view->peerinfo, iter->peer_it).state = BGPVIEW_FIELD_INACTIVE;
+
+  /* update the counters */
+  DEACTIVATE_FIELD_CNT(iter->view->peerinfo_cnt);
+
+  return 1;
+}
+
+static inline int activate_pfx(bgpview_iter_t *iter)
+{
+  bwv_peerid_pfxinfo_t *pfxinfo;
+
+  if ((pfxinfo = pfxinfo_unshare(iter)) == NULL) {
+    return -1;
+  }
+
+  assert(pfxinfo->state > 0);
+  if (pfxinfo->state != BGPVIEW_FIELD_INACTIVE) {
+    return 0;
+  }
+
+  pfxinfo->state = BGPVIEW_FIELD_ACTIVE;
+  lpm_index_pfx(iter, 1);
+
+  switch (iter->version_ptr) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    ACTIVATE_FIELD_CNT(iter->view->v4pfxs_cnt);
+    break;
+
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    ACTIVATE_FIELD_CNT(iter->view->v6pfxs_cnt);
+    break;
+
+  default:
+    return -1;
+  }
+
+  return 1;
+}
+
+int bgpview_iter_deactivate_pfx(bgpview_iter_t *iter)
+{
+  bwv_peerid_pfxinfo_t *pfxinfo;
+  bgpview_iter_t ti = *iter;
+
+  if ((pfxinfo = pfxinfo_unshare(iter)) == NULL) {
+    return -1;
+  }
+
+  assert(pfxinfo->state > 0);
+  if (pfxinfo->state != BGPVIEW_FIELD_ACTIVE) {
+    return 0;
+  }
+
+  /* now mark the pfx as inactive */
+  pfxinfo->state = BGPVIEW_FIELD_INACTIVE;
+  lpm_index_pfx(iter, -1);
+
+  /* deactivate all pfx-peers for this prefix */
+  __iter_pfx_first_peer(&ti, BGPVIEW_FIELD_ACTIVE);
+  while (__iter_pfx_has_more_peer(&ti)) {
+    bgpview_iter_pfx_deactivate_peer(&ti);
+    __iter_pfx_next_peer(&ti);
+  }
+
+  /* now update the counters */
+  switch (iter->version_ptr) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    DEACTIVATE_FIELD_CNT(iter->view->v4pfxs_cnt);
+    break;
+
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    DEACTIVATE_FIELD_CNT(iter->view->v6pfxs_cnt);
+    break;
+
+  default:
+    return -1;
+  }
+
+  return 1;
+}
+
+/* activate the current pfx-peer of the (unshared) prefix, without activating
+   the prefix itself */
+static int pfx_peer_activate(bgpview_iter_t *iter,
+                             bwv_peerid_pfxinfo_t *pfxinfo)
+{
+  assert(BWV_PFX_GET_PEER_STATE(iter->view, pfxinfo, iter->pfx_peer_it) > 0);
+  if (BWV_PFX_GET_PEER_STATE(iter->view, pfxinfo, iter->pfx_peer_it) !=
+      BGPVIEW_FIELD_INACTIVE) {
+    return 0;
+  }
+
+  journal_pfx_peer(iter, kh_key(iter->view->peerinfo, iter->peer_it));
+  origin_index_pfx_peer(iter, __pfx_peer_field(iter, as_path_id), 1);
+
+  /* update the number of peers that observe this pfx */
+  ACTIVATE_FIELD_CNT(pfxinfo->peers_cnt);
+
+  /* the peer MUST be active */
+  assert(__iter_peer_get_state(iter) == BGPVIEW_FIELD_ACTIVE);
+
+  // increment the number of prefixes observed by the peer
+  switch (iter->version_ptr) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    ACTIVATE_FIELD_CNT(
+      kh_value(iter->view->peerinfo, iter->peer_it).v4_pfx_cnt);
+    break;
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    ACTIVATE_FIELD_CNT(
+      kh_value(iter->view->peerinfo, iter->peer_it).v6_pfx_cnt);
+    break;
+  default:
+    return -1;
+  }
+
+  BWV_PFX_SET_PEER_STATE(iter->view, pfxinfo, iter->pfx_peer_it,
+      BGPVIEW_FIELD_ACTIVE);
+
+  return 1;
+}
+
+int bgpview_iter_pfx_activate_peer(bgpview_iter_t *iter)
+{
+  bwv_peerid_pfxinfo_t *pfxinfo;
+  int ret;
+
+  assert(__iter_pfx_has_more_peer(iter));
+
+  if ((pfxinfo = pfxinfo_unshare(iter)) == NULL) {
+    return -1;
+  }
+
+  /* if this is the first active peer, the pfx must be activated too */
+  if ((ret = pfx_peer_activate(iter, pfxinfo)) == 1 &&
+      pfxinfo->peers_cnt[BGPVIEW_FIELD_ACTIVE] == 1) {
+    activate_pfx(iter);
+  }
+
+  return ret;
+}
+
+int bgpview_iter_pfx_deactivate_peer(bgpview_iter_t *iter)
+{
+  bwv_peerid_pfxinfo_t *pfxinfo;
+
+  assert(__iter_pfx_has_more_peer(iter));
+
+  if ((pfxinfo = pfxinfo_unshare(iter)) == NULL) {
+    return -1;
+  }
+
+  assert(BWV_PFX_GET_PEER_STATE(iter->view, pfxinfo, iter->pfx_peer_it) > 0);
+  if (BWV_PFX_GET_PEER_STATE(iter->view, pfxinfo, iter->pfx_peer_it) !=
+      BGPVIEW_FIELD_ACTIVE) {
+    return 0;
+  }
+
+  journal_pfx_peer(iter, kh_key(iter->view->peerinfo, iter->peer_it));
+  origin_index_pfx_peer(iter, __pfx_peer_field(iter, as_path_id), -1);
+
+  /* set the state to inactive */
+  BWV_PFX_SET_PEER_STATE(iter->view, pfxinfo, iter->pfx_peer_it,
+      BGPVIEW_FIELD_INACTIVE);
+
+  /* update the number of peers that observe the pfx */
+  DEACTIVATE_FIELD_CNT(pfxinfo->peers_cnt);
+  if (pfxinfo->peers_cnt[BGPVIEW_FIELD_ACTIVE] == 0) {
+    bgpview_iter_deactivate_pfx(iter);
+  }
+
+  // decrement the number of pfxs observed by the peer
+  switch (iter->version_ptr) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    DEACTIVATE_FIELD_CNT(
+      kh_value(iter->view->peerinfo, iter->peer_it).v4_pfx_cnt);
+    break;
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    DEACTIVATE_FIELD_CNT(
+      kh_value(iter->view->peerinfo, iter->peer_it).v6_pfx_cnt);
+    break;
+  default:
+    return -1;
+  }
+
+  return 1;
+}
+
+int bgpview_iter_add_pfx_peers(bgpview_iter_t *iter, bgpstream_pfx_t *pfx,
+                               bgpstream_peer_id_t *peer_ids,
+                               bgpstream_as_path_store_path_id_t *path_ids,
+                               uint8_t *states, int cnt)
+{
+  bwv_peerid_pfxinfo_t *pfxinfo;
+  int i;
+
+  RETURN_IF_FROZEN(iter->view, -1);
+
+  if (cnt <= 0) {
+    return 0;
+  }
+
+  /* seek to the prefix, or create (or un-invalid) it */
+  if (bgpview_iter_seek_pfx(iter, pfx, BGPVIEW_FIELD_ALL_VALID) == 0 &&
+      add_pfx(iter, pfx) != 0) {
+    return -1;
+  }
+
+  /* the prefix is unshared and its pfx-peer table sized once for the whole
+     row */
+  if ((pfxinfo = pfxinfo_unshare(iter)) == NULL ||
+      peerid_pfxinfo_reserve(iter->view, pfxinfo, cnt) != 0) {
+    return -1;
+  }
+
+  for (i = 0; i < cnt; i++) {
+    /* the peer must already exist */
+    __iter_seek_peer(iter, peer_ids[i], BGPVIEW_FIELD_ALL_VALID);
+    if (iter->peer_it == kh_end(iter->view->peerinfo)) {
+      iter->pfx_peer_it_valid = 0;
+      return -1;
+    }
+    if (peerid_pfxinfo_insert(iter, pfxinfo, peer_ids[i], path_ids[i]) != 0) {
+      return -1;
+    }
+    if (states == NULL || states[i] == BGPVIEW_FIELD_ACTIVE) {
+      pfx_peer_activate(iter, pfxinfo);
+    } else if (__iter_pfx_peer_get_state(iter) == BGPVIEW_FIELD_ACTIVE &&
+               bgpview_iter_pfx_deactivate_peer(iter) < 0) {
+      return -1;
+    }
+  }
+
+  /* activate the prefix once, if it gained its first active pfx-peers */
+  if (pfxinfo->peers_cnt[BGPVIEW_FIELD_ACTIVE] > 0 &&
+      activate_pfx(iter) < 0) {
+    return -1;
+  }
 
-#define __iter_pfx_next_peer(iter)                                             \
-  do {                                                                         \
-    bwv_peerid_pfxinfo_t *__infos = __pfx_peerinfos((iter));                   \
-    if ((iter)->view->disable_extended) {                                      \
-      __iter_pfx_next_peer_tab(iter, __infos->peers_min);                      \
-    } else {                                                                   \
-      __iter_pfx_next_peer_tab(iter, __infos->peers_ext);                      \
-    }                                                                          \
-  } while (0)
+  return 0;
+}
 
-#define __iter_pfx_has_more_peer(iter)                                         \
-  ((iter)->pfx_peer_it_valid)
+/* ========== PUBLIC FUNCTIONS ========== */
+
+bgpview_t *
+bgpview_create_shared(bgpstream_peer_sig_map_t *peersigns,
+                      bgpstream_as_path_store_t *pathstore,
+                      bgpview_destroy_user_t *bwv_user_destructor,
+                      bgpview_destroy_user_t *bwv_peer_user_destructor,
+                      bgpview_destroy_user_t *bwv_pfx_user_destructor,
+                      bgpview_destroy_user_t *bwv_pfx_peer_user_destructor)
+{
+  bgpview_t *view;
+  struct timeval time_created;
+
+  if ((view = malloc_zero(sizeof(bgpview_t))) == NULL) {
+    return NULL;
+  }
+
+  if ((view->v4pfxs = kh_init(bwv_v4pfx_peerid_pfxinfo)) == NULL) {
+    goto err;
+  }
+
+  if ((view->v6pfxs = kh_init(bwv_v6pfx_peerid_pfxinfo)) == NULL) {
+    goto err;
+  }
+
+  if (peersigns != NULL) {
+    view->peersigns_shared = 1;
+    view->peersigns = peersigns;
+  } else {
+    if ((view->peersigns = bgpstream_peer_sig_map_create()) == NULL) {
+      fprintf(stderr, "Failed to create peersigns table\n");
+      goto err;
+    }
+    view->peersigns_shared = 0;
+  }
+
+  if (pathstore != NULL) {
+    view->pathstore_shared = 1;
+    view->pathstore = pathstore;
+  } else {
+    if ((view->pathstore = bgpstream_as_path_store_create()) == NULL) {
+      fprintf(stderr, "Failed to create AS Path Store\n");
+      goto err;
+    }
+    view->pathstore_shared = 0;
+  }
+
+  if ((view->peerinfo = kh_init(bwv_peerid_peerinfo)) == NULL) {
+    fprintf(stderr, "Failed to create peer info table\n");
+    goto err;
+  }
+
+  if ((view->alloc = malloc_zero(sizeof(bwv_allocator_t))) == NULL) {
+    fprintf(stderr, "Failed to create prefix allocator\n");
+    goto err;
+  }
+  view->alloc->refcnt = 1;
+
+  gettimeofday(&time_created, NULL);
+  view->time_created = time_created.tv_sec;
+
+  view->user_destructor = bwv_user_destructor;
+  view->peer_user_destructor = bwv_peer_user_destructor;
+  view->pfx_user_destructor = bwv_pfx_user_destructor;
+  view->pfx_peer_user_destructor = bwv_pfx_peer_user_destructor;
+
+  /* all other fields are memset to 0 */
+
+  return view;
+
+err:
+  fprintf(stderr, "Failed to create BGPView\n");
+  bgpview_destroy(view);
+  return NULL;
+}
+
+bgpview_t *bgpview_create(bgpview_destroy_user_t *bwv_user_destructor,
+                          bgpview_destroy_user_t *bwv_peer_user_destructor,
+                          bgpview_destroy_user_t *bwv_pfx_user_destructor,
+                          bgpview_destroy_user_t *bwv_pfx_peer_user_destructor)
+{
+  return bgpview_create_shared(
+    NULL, NULL, bwv_user_destructor, bwv_peer_user_destructor,
+    bwv_pfx_user_destructor, bwv_pfx_peer_user_destructor);
+}
+
+void bgpview_destroy(bgpview_t *view)
+{
+  if (view == NULL) {
+    return;
+  }
+
+  khiter_t k;
+
+  /* if there is no per-prefix state outside of the slabs, there is no need to
+     walk the prefixes, everything is released in bulk when the slabs are
+     destroyed (unless the records are shared with other views) */
+  int walk_pfxs = !BWV_PFX_PEERS_ARE_VEC(view) ||
+                  (view->alloc != NULL && view->alloc->refcnt > 1) ||
+                  view->pfx_user_destructor != NULL ||
+                  (view->disable_extended == 0 &&
+                   view->pfx_peer_user_destructor != NULL);
+
+  /* the prefixes of a frozen view are all in the arena */
+  if (view->frozen != 0) {
+    walk_pfxs = 0;
+  }
+
+  /* the bucket flags and keys of a mapped view are in the image */
+  if (view->image != NULL) {
+    if (view->v4pfxs != NULL) {
+      view->v4pfxs->flags = NULL;
+      view->v4pfxs->keys = NULL;
+    }
+    if (view->v6pfxs != NULL) {
+      view->v6pfxs->flags = NULL;
+      view->v6pfxs->keys = NULL;
+    }
+  }
+
+  if (view->v4pfxs != NULL) {
+    for (k = kh_begin(view->v4pfxs); walk_pfxs && k != kh_end(view->v4pfxs);
+         ++k) {
+      if (kh_exist(view->v4pfxs, k)) {
+        peerid_pfxinfo_destroy(view, kh_value(view->v4pfxs, k));
+      }
+    }
+    kh_destroy(bwv_v4pfx_peerid_pfxinfo, view->v4pfxs);
+    view->v4pfxs = NULL;
+  }
+
+  if (view->v6pfxs != NULL) {
+    for (k = kh_begin(view->v6pfxs); walk_pfxs && k != kh_end(view->v6pfxs);
+         ++k) {
+      if (kh_exist(view->v6pfxs, k)) {
+        peerid_pfxinfo_destroy(view, kh_value(view->v6pfxs, k));
+      }
+    }
+    kh_destroy(bwv_v6pfx_peerid_pfxinfo, view->v6pfxs);
+    view->v6pfxs = NULL;
+  }
+
+  free(view->v4pfxs_index.buckets);
+  free(view->v4pfxs_index.keys);
+  free(view->v6pfxs_index.buckets);
+  free(view->v6pfxs_index.keys);
+
+  free(view->frozen_arena);
+
+  if (view->image != NULL) {
+    munmap(view->image, view->image_len);
+  }
+
+  journal_destroy(view->journal);
+  view->journal = NULL;
+
+  origin_index_destroy(view->origin_index);
+  view->origin_index = NULL;
+
+  lpm_index_destroy(view->lpm_index);
+  view->lpm_index = NULL;
+
+  peer_index_destroy(view->peer_index);
+  view->peer_index = NULL;
+
+  allocator_release(view);
+
+  if (view->peersigns_shared == 0 && view->peersigns != NULL) {
+    bgpstream_peer_sig_map_destroy(view->peersigns);
+    view->peersigns = NULL;
+  }
+
+  if (view->pathstore_shared == 0 && view->pathstore != NULL) {
+    bgpstream_as_path_store_destroy(view->pathstore);
+    view->pathstore = NULL;
+  }
+
+  if (view->peerinfo != NULL) {
+    peerinfo_destroy_user(view);
+    kh_destroy(bwv_peerid_peerinfo, view->peerinfo);
+    view->peerinfo = NULL;
+  }
+
+  if (view->user != NULL) {
+    if (view->user_destructor != NULL) {
+      view->user_destructor(view->user);
+    }
+    view->user = NULL;
+  }
+
+  free(view);
+}
+
+/* explicitly invalidate every prefix and peer in the view. this is only
+   needed when the epoch counter wraps */
+static void clear_all_records(bgpview_t *view)
+{
+  khiter_t k;
+
+  for (k = kh_begin(view->v4pfxs); k != kh_end(view->v4pfxs); ++k) {
+    if (kh_exist(view->v4pfxs, k) &&
+        pfxinfo_slot_reset(view, &kh_value(view->v4pfxs, k)) != 0) {
+      assert(0 && "Could not reset shared prefix");
+    }
+  }
+
+  for (k = kh_begin(view->v6pfxs); k != kh_end(view->v6pfxs); ++k) {
+    if (kh_exist(view->v6pfxs, k) &&
+        pfxinfo_slot_reset(view, &kh_value(view->v6pfxs, k)) != 0) {
+      assert(0 && "Could not reset shared prefix");
+    }
+  }
+
+  for (k = kh_begin(view->peerinfo); k != kh_end(view->peerinfo); ++k) {
+    if (kh_exist(view->peerinfo, k)) {
+      peerinfo_reset(&kh_value(view->peerinfo, k));
+      kh_value(view->peerinfo, k).epoch = view->epoch;
+    }
+  }
+}
+
+void bgpview_clear(bgpview_t *view)
+{
+  struct timeval time_created;
+
+  RETURN_IF_FROZEN(view, );
+
+  /* the journal can't record every change made by a clear */
+  if (view->journal != NULL) {
+    journal_reset(view->journal);
+    view->journal->complete = 0;
+  }
+
+  /* a cleared view has no active pfx-peers */
+  if (view->origin_index != NULL) {
+    origin_index_reset(view->origin_index);
+  }
+  if (view->lpm_index != NULL) {
+    lpm_index_reset(view->lpm_index);
+  }
+  if (view->peer_index != NULL) {
+    peer_index_reset(view, view->peer_index);
+  }
+
+  view->time = 0;
+
+  gettimeofday(&time_created, NULL);
+  view->time_created = time_created.tv_sec;
+
+  /* moving to a new epoch invalidates all prefixes, pfx-peers and peers. they
+     are lazily reset when re-added, or freed by bgpview_gc */
+  if (view->epoch == UINT8_MAX) {
+    /* the epoch is about to wrap, so stamps from old epochs could become
+       current again. reset everything to the new epoch explicitly */
+    view->epoch = 0;
+    clear_all_records(view);
+  } else {
+    view->epoch++;
+  }
+
+  view->need_gc_v4pfxs = (kh_size(view->v4pfxs) > 0);
+  view->need_gc_v6pfxs = (kh_size(view->v6pfxs) > 0);
+  view->v4pfxs_cnt[BGPVIEW_FIELD_INACTIVE] = 0;
+  view->v4pfxs_cnt[BGPVIEW_FIELD_ACTIVE] = 0;
+  view->v6pfxs_cnt[BGPVIEW_FIELD_INACTIVE] = 0;
+  view->v6pfxs_cnt[BGPVIEW_FIELD_ACTIVE] = 0;
+
+  view->need_gc_peerinfo = (kh_size(view->peerinfo) > 0);
+  view->peerinfo_cnt[BGPVIEW_FIELD_INACTIVE] = 0;
+  view->peerinfo_cnt[BGPVIEW_FIELD_ACTIVE] = 0;
+}
+
+/* approximate number of bytes used by a khash peer table with the given
+   number of buckets (keys, values and flags) */
+#define BWV_PEERTABLE_BYTES(view, n_buckets)                                   \
+  ((n_buckets) * (sizeof(bgpstream_peer_id_t) + BWV_PFX_PEERINFO_SIZE(view)) + \
+   ((n_buckets) / 4))
+
+/* number of bytes used by a pfx-peer vector with the given capacity */
+#define BWV_PEERVEC_BYTES(view, alloc)                                         \
+  (sizeof(bwv_pfx_peervec_t) +                                                 \
+   ((alloc) * (sizeof(bgpstream_peer_id_t) + BWV_PFX_PEERINFO_SIZE(view))))
+
+static uint64_t peerid_pfxinfo_bytes(bgpview_t *view, bwv_peerid_pfxinfo_t *v)
+{
+  uint64_t bytes = sizeof(bwv_peerid_pfxinfo_t);
+
+  if (v->peers_generic == NULL) {
+    return bytes;
+  }
+  if (BWV_PFX_PEERS_ARE_VEC(view)) {
+    bytes += BWV_PEERVEC_BYTES(view, v->peers_vec->alloc);
+  } else if (view->disable_extended) {
+    bytes += BWV_PEERTABLE_BYTES(view, kh_n_buckets(v->peers_min));
+  } else {
+    bytes += BWV_PEERTABLE_BYTES(view, kh_n_buckets(v->peers_ext));
+  }
+  return bytes;
+}
+
+/* reclaim the invalid pfx-peers of a valid prefix, and shrink its peer table
+   if it has become mostly empty. returns the amount of work done */
+static uint64_t peerid_pfxinfo_gc(bgpview_t *view, bwv_peerid_pfxinfo_t *v)
+{
+  bwv_pfx_peervec_t *vec;
+  uint32_t valid_cnt = v->peers_cnt[BGPVIEW_FIELD_INACTIVE] +
+                       v->peers_cnt[BGPVIEW_FIELD_ACTIVE];
+  uint32_t cells;
+  uint32_t i, j;
+  khiter_t k;
+  khint_t n_buckets;
+
+  if (v->peers_generic == NULL || v->refcnt > 1) {
+    /* shared prefixes are left alone, they will be compacted when they are
+       un-shared, or freed */
+    return 0;
+  }
+
+  if (BWV_PFX_PEERS_ARE_VEC(view)) {
+    vec = v->peers_vec;
+    cells = vec->alloc;
+    if (vec->size != valid_cnt) {
+      /* compact the vector, keeping it sorted */
+      for (i = 0, j = 0; i < vec->size; i++) {
+        if (BWV_PEERVEC_GET_PEER(view, vec, i)->state ==
+            BGPVIEW_FIELD_INVALID) {
+          if (view->disable_extended == 0) {
+            pfx_peer_info_ext_destroy(
+              view, (bwv_pfx_peerinfo_ext_t *)BWV_PEERVEC_GET_PEER(view, vec,
+                                                                   i));
+          }
+          view->gc_stats.pfx_peers_reclaimed++;
+          continue;
+        }
+        if (i != j) {
+          vec->ids[j] = vec->ids[i];
+          memcpy(BWV_PEERVEC_GET_PEER(view, vec, j),
+                 BWV_PEERVEC_GET_PEER(view, vec, i),
+                 BWV_PFX_PEERINFO_SIZE(view));
+        }
+        j++;
+      }
+      vec->size = j;
+    }
+    if (vec->alloc > 1 && ((uint32_t)vec->size * 4) <= vec->alloc) {
+      n_buckets = vec->alloc;
+      if ((vec = peervec_resize(view, vec, vec->size)) != NULL) {
+        view->gc_stats.bytes_reclaimed += BWV_PEERVEC_BYTES(view, n_buckets) -
+                                          BWV_PEERVEC_BYTES(view, vec->alloc);
+        view->gc_stats.tables_shrunk++;
+        v->peers_vec = vec;
+      }
+      /* else: keep using the old vector */
+    }
+    return cells;
+  }
+
+  if (view->disable_extended) {
+    cells = kh_n_buckets(v->peers_min);
+    if (kh_size(v->peers_min) != valid_cnt) {
+      for (k = kh_begin(v->peers_min); k != kh_end(v->peers_min); ++k) {
+        if (kh_exist(v->peers_min, k) &&
+            kh_val(v->peers_min, k).state == BGPVIEW_FIELD_INVALID) {
+          kh_del(bwv_peerid_pfx_peerinfo, v->peers_min, k);
+          view->gc_stats.pfx_peers_reclaimed++;
+        }
+      }
+    }
+    n_buckets = kh_n_buckets(v->peers_min);
+    if (n_buckets > 4 && (kh_size(v->peers_min) * 4) <= n_buckets &&
+        kh_resize(bwv_peerid_pfx_peerinfo, v->peers_min,
+                  kh_size(v->peers_min) * 2) == 0) {
+      view->gc_stats.bytes_reclaimed +=
+        BWV_PEERTABLE_BYTES(view, n_buckets) -
+        BWV_PEERTABLE_BYTES(view, kh_n_buckets(v->peers_min));
+      view->gc_stats.tables_shrunk++;
+    }
+  } else {
+    cells = kh_n_buckets(v->peers_ext);
+    if (kh_size(v->peers_ext) != valid_cnt) {
+      for (k = kh_begin(v->peers_ext); k != kh_end(v->peers_ext); ++k) {
+        if (kh_exist(v->peers_ext, k) &&
+            kh_val(v->peers_ext, k).state == BGPVIEW_FIELD_INVALID) {
+          pfx_peer_info_ext_destroy(view, &kh_val(v->peers_ext, k));
+          kh_del(bwv_peerid_pfx_peerinfo_ext, v->peers_ext, k);
+          view->gc_stats.pfx_peers_reclaimed++;
+        }
+      }
+    }
+    n_buckets = kh_n_buckets(v->peers_ext);
+    if (n_buckets > 4 && (kh_size(v->peers_ext) * 4) <= n_buckets &&
+        kh_resize(bwv_peerid_pfx_peerinfo_ext, v->peers_ext,
+                  kh_size(v->peers_ext) * 2) == 0) {
+      view->gc_stats.bytes_reclaimed +=
+        BWV_PEERTABLE_BYTES(view, n_buckets) -
+        BWV_PEERTABLE_BYTES(view, kh_n_buckets(v->peers_ext));
+      view->gc_stats.tables_shrunk++;
+    }
+  }
 
-#define __iter_pfx_seek_peer_tab(iter, tabtype, peertable, peerid, state_mask) \
+  return cells;
+}
+
+/* garbage collect a single bucket of a prefix table */
+#define GC_PFX_BUCKET(view, table, tabname, index, k, work)                    \
   do {                                                                         \
-    (iter)->pfx_peer_state_mask = state_mask;                                  \
-    khiter_t k;                                                                \
-    if (peertable &&                                                           \
-        (k = kh_get(tabtype, peertable, peerid)) != kh_end(peertable) &&       \
-        ((iter)->pfx_peer_state_mask & kh_val(peertable, k).state)) {          \
-      (iter)->pfx_peer_it_valid = 1;                                           \
-      (iter)->pfx_peer_it = k;                                                 \
-      __iter_seek_peer((iter), peerid, state_mask);                            \
+    bwv_peerid_pfxinfo_t *pfxinfo;                                             \
+    if (!kh_exist(table, k)) {                                                 \
+      break;                                                                   \
+    }                                                                          \
+    pfxinfo = kh_value(table, k);                                              \
+    if (BWV_PFX_STATE(view, pfxinfo) == BGPVIEW_FIELD_INVALID) {               \
+      if (pfxinfo->refcnt == 1) {                                              \
+        (view)->gc_stats.bytes_reclaimed +=                                    \
+          peerid_pfxinfo_bytes(view, pfxinfo);                                 \
+      }                                                                        \
+      (view)->gc_stats.pfxs_reclaimed++;                                       \
+      peerid_pfxinfo_destroy(view, pfxinfo);                                   \
+      kh_del(tabname, table, k);                                               \
+      (index).valid = 0;                                                       \
     } else {                                                                   \
-      iter->pfx_peer_it_valid = 0;                                             \
+      (work) += peerid_pfxinfo_gc(view, pfxinfo);                              \
     }                                                                          \
   } while (0)
 
-#define __iter_pfx_seek_peer(iter, peerid, state_mask)                         \
+/* move the garbage collector to the given table, or to the next one if the
+   given table does not need to be swept */
+static void gc_start_phase(bgpview_t *view, bwv_gc_phase_t phase)
+{
+  view->gc_phase = phase;
+
+  /* flags are reset when a sweep starts, anything invalidated after this will
+     flag the table again */
+  switch (phase) {
+  case BWV_GC_PHASE_V4PFXS:
+    if (view->need_gc_v4pfxs == 0) {
+      gc_start_phase(view, BWV_GC_PHASE_V6PFXS);
+      return;
+    }
+    view->need_gc_v4pfxs = 0;
+    break;
+
+  case BWV_GC_PHASE_V6PFXS:
+    if (view->need_gc_v6pfxs == 0) {
+      gc_start_phase(view, BWV_GC_PHASE_PEERINFO);
+      return;
+    }
+    view->need_gc_v6pfxs = 0;
+    break;
+
+  case BWV_GC_PHASE_PEERINFO:
+    if (view->need_gc_peerinfo == 0) {
+      gc_start_phase(view, BWV_GC_PHASE_DONE);
+      return;
+    }
+    view->need_gc_peerinfo = 0;
+    break;
+
+  case BWV_GC_PHASE_DONE:
+    view->gc_stats.passes++;
+    break;
+  }
+  view->gc_it = 0;
+  view->gc_rehash_gen = view->rehash_gen;
+}
+
+/* if a table may have been rehashed since the sweep of the current table
+   started (moving prefixes from buckets that were not swept yet to ones that
+   were), flag the table again and restart its sweep */
+static void gc_check_rehash(bgpview_t *view)
+{
+  if (view->gc_phase == BWV_GC_PHASE_DONE ||
+      view->gc_rehash_gen == view->rehash_gen) {
+    return;
+  }
+
+  switch (view->gc_phase) {
+  case BWV_GC_PHASE_V4PFXS:
+    view->need_gc_v4pfxs = 1;
+    break;
+
+  case BWV_GC_PHASE_V6PFXS:
+    view->need_gc_v6pfxs = 1;
+    break;
+
+  case BWV_GC_PHASE_PEERINFO:
+    view->need_gc_peerinfo = 1;
+    break;
+
+  default:
+    break;
+  }
+  gc_start_phase(view, view->gc_phase);
+}
+
+int bgpview_gc_step(bgpview_t *view, uint64_t max_work)
+{
+  uint64_t work = 0;
+  khiter_t k;
+
+  /* frozen views have nothing to collect */
+  if (view->frozen != 0) {
+    return 1;
+  }
+
+  view->gc_stats.steps++;
+
+  /* tables are rehashed by puts between steps, never by the sweep itself */
+  gc_check_rehash(view);
+
+  while (max_work == 0 || work < max_work) {
+    switch (view->gc_phase) {
+    case BWV_GC_PHASE_DONE:
+      if (view->need_gc_v4pfxs == 0 && view->need_gc_v6pfxs == 0 &&
+          view->need_gc_peerinfo == 0) {
+        /* nothing left to collect */
+        return 1;
+      }
+      gc_start_phase(view, BWV_GC_PHASE_V4PFXS);
+      break;
+
+    case BWV_GC_PHASE_V4PFXS:
+      for (k = view->gc_it; k != kh_end(view->v4pfxs) &&
+                            (max_work == 0 || work < max_work);
+           ++k, ++work) {
+        GC_PFX_BUCKET(view, view->v4pfxs, bwv_v4pfx_peerid_pfxinfo,
+                      view->v4pfxs_index, k, work);
+      }
+      view->gc_it = k;
+      if (k == kh_end(view->v4pfxs)) {
+        gc_start_phase(view, BWV_GC_PHASE_V6PFXS);
+      }
+      break;
+
+    case BWV_GC_PHASE_V6PFXS:
+      for (k = view->gc_it; k != kh_end(view->v6pfxs) &&
+                            (max_work == 0 || work < max_work);
+           ++k, ++work) {
+        GC_PFX_BUCKET(view, view->v6pfxs, bwv_v6pfx_peerid_pfxinfo,
+                      view->v6pfxs_index, k, work);
+      }
+      view->gc_it = k;
+      if (k == kh_end(view->v6pfxs)) {
+        gc_start_phase(view, BWV_GC_PHASE_PEERINFO);
+      }
+      break;
+
+    case BWV_GC_PHASE_PEERINFO:
+      for (k = view->gc_it; k != kh_end(view->peerinfo) &&
+                            (max_work == 0 || work < max_work);
+           ++k, ++work) {
+        if (kh_exist(view->peerinfo, k) &&
+            BWV_PEER_STATE(view, kh_value(view->peerinfo, k)) ==
+              BGPVIEW_FIELD_INVALID) {
+          if (view->peer_user_destructor != NULL &&
+              kh_value(view->peerinfo, k).user != NULL) {
+            view->peer_user_destructor(kh_value(view->peerinfo, k).user);
+          }
+          kh_del(bwv_peerid_peerinfo, view->peerinfo, k);
+          view->gc_stats.peers_reclaimed++;
+        }
+      }
+      view->gc_it = k;
+      if (k == kh_end(view->peerinfo)) {
+        gc_start_phase(view, BWV_GC_PHASE_DONE);
+      }
+      break;
+    }
+  }
+
+  return 0;
+}
+
+void bgpview_gc(bgpview_t *view)
+{
+  /* finish any partial sweep, and then sweep everything that is flagged */
+  bgpview_gc_step(view, 0);
+}
+
+void bgpview_get_gc_stats(bgpview_t *view, bgpview_gc_stats_t *stats)
+{
+  *stats = view->gc_stats;
+}
+
+int bgpview_build_pfx_index(bgpview_t *view)
+{
+  if (pfx_index_build(view, BGPSTREAM_ADDR_VERSION_IPV4) != 0 ||
+      pfx_index_build(view, BGPSTREAM_ADDR_VERSION_IPV6) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+/* make a copy (owned by dst) of the active part of a prefix from src. the
+   views must use the same peer ids and pfx-peer layout */
+static bwv_peerid_pfxinfo_t *peerid_pfxinfo_clone_active(
+  bgpview_t *dst, bgpview_t *src, bwv_peerid_pfxinfo_t *src_pfxinfo)
+{
+  bwv_peerid_pfxinfo_t *v;
+  bwv_pfx_peervec_t *vec;
+  bwv_pfx_peerinfo_t *peerinfo;
+  uint32_t i, j;
+  khiter_t k;
+  int all_active;
+
+  if ((v = peerid_pfxinfo_dup(dst, src_pfxinfo)) == NULL) {
+    return NULL;
+  }
+  v->epoch = dst->epoch;
+  v->state = BGPVIEW_FIELD_ACTIVE;
+  v->peers_cnt[BGPVIEW_FIELD_INACTIVE] = 0;
+  v->user = NULL;
+
+  if (v->peers_generic == NULL) {
+    return v;
+  }
+
+  /* drop any inactive/invalid pfx-peers, and the user data of the rest */
+  if (BWV_PFX_PEERS_ARE_VEC(dst)) {
+    vec = v->peers_vec;
+    all_active = (vec->size == v->peers_cnt[BGPVIEW_FIELD_ACTIVE]);
+    for (i = 0, j = 0; i < vec->size; i++) {
+      peerinfo = BWV_PEERVEC_GET_PEER(dst, vec, i);
+      if (all_active == 0 && peerinfo->state != BGPVIEW_FIELD_ACTIVE) {
+        continue;
+      }
+      if (i != j) {
+        vec->ids[j] = vec->ids[i];
+        memcpy(BWV_PEERVEC_GET_PEER(dst, vec, j), peerinfo,
+               BWV_PFX_PEERINFO_SIZE(dst));
+      }
+      if (dst->disable_extended == 0) {
+        ((bwv_pfx_peerinfo_ext_t *)BWV_PEERVEC_GET_PEER(dst, vec, j))->user =
+          NULL;
+      }
+      j++;
+    }
+    vec->size = j;
+  } else if (dst->disable_extended) {
+    if (kh_size(v->peers_min) != v->peers_cnt[BGPVIEW_FIELD_ACTIVE]) {
+      for (k = kh_begin(v->peers_min); k != kh_end(v->peers_min); ++k) {
+        if (kh_exist(v->peers_min, k) &&
+            kh_val(v->peers_min, k).state != BGPVIEW_FIELD_ACTIVE) {
+          kh_del(bwv_peerid_pfx_peerinfo, v->peers_min, k);
+        }
+      }
+    }
+  } else {
+    all_active = (kh_size(v->peers_ext) == v->peers_cnt[BGPVIEW_FIELD_ACTIVE]);
+    for (k = kh_begin(v->peers_ext); k != kh_end(v->peers_ext); ++k) {
+      if (!kh_exist(v->peers_ext, k)) {
+        continue;
+      }
+      if (all_active == 0 &&
+          kh_val(v->peers_ext, k).state != BGPVIEW_FIELD_ACTIVE) {
+        kh_del(bwv_peerid_pfx_peerinfo_ext, v->peers_ext, k);
+        continue;
+      }
+      kh_val(v->peers_ext, k).user = NULL;
+    }
+  }
+
+  return v;
+}
+
+/* clone the active prefixes of the src prefix table into the (empty) dst
+   table, by copying the bucket arrays and then replacing the values */
+#define CLONE_PFX_TABLE(dst_view, src_view, table, name, ret)                  \
   do {                                                                         \
-    bwv_peerid_pfxinfo_t *__infos = __pfx_peerinfos((iter));                   \
-    if ((iter)->view->disable_extended) {                                      \
-      __iter_pfx_seek_peer_tab(iter, bwv_peerid_pfx_peerinfo,                  \
-          __infos->peers_min, peerid, state_mask);                             \
-    } else {                                                                   \
-      __iter_pfx_seek_peer_tab(iter, bwv_peerid_pfx_peerinfo_ext,              \
-          __infos->peers_ext, peerid, state_mask);                             \
+    khiter_t k, e;                                                             \
+    bwv_peerid_pfxinfo_t *pfxinfo;                                             \
+    BWV_KH_COPY(name, (dst_view)->table, (src_view)->table, ret);              \
+    if ((ret) != 0) {                                                          \
+      kh_clear(name, (dst_view)->table);                                       \
+      break;                                                                   \
+    }                                                                          \
+    for (k = kh_begin((dst_view)->table); k != kh_end((dst_view)->table);      \
+         ++k) {                                                                \
+      if (!kh_exist((dst_view)->table, k)) {                                   \
+        continue;                                                              \
+      }                                                                        \
+      pfxinfo = kh_val((src_view)->table, k);                                  \
+      if (BWV_PFX_STATE(src_view, pfxinfo) != BGPVIEW_FIELD_ACTIVE) {          \
+        kh_del(name, (dst_view)->table, k);                                    \
+        continue;                                                              \
+      }                                                                        \
+      if ((kh_val((dst_view)->table, k) = peerid_pfxinfo_clone_active(         \
+             dst_view, src_view, pfxinfo)) == NULL) {                          \
+        /* the rest of the table still points to src prefixes */               \
+        for (e = k; e != kh_end((dst_view)->table); ++e) {                     \
+          if (kh_exist((dst_view)->table, e)) {                                \
+            kh_del(name, (dst_view)->table, e);                                \
+          }                                                                    \
+        }                                                                      \
+        (ret) = -1;                                                            \
+        break;                                                                 \
+      }                                                                        \
     }                                                                          \
   } while (0)
 
-/* public accessor functions */
+/* copy the active peers of src (with only their active pfx counts) into the
+   empty peer table of dst */
+static int clone_active_peers(bgpview_t *dst, bgpview_t *src)
+{
+  khiter_t k;
+  int ret;
 
-int bgpview_iter_pfx_first_peer(bgpview_iter_t *iter, uint8_t state_mask)
+  BWV_KH_COPY(bwv_peerid_peerinfo, dst->peerinfo, src->peerinfo, ret);
+  if (ret != 0) {
+    kh_clear(bwv_peerid_peerinfo, dst->peerinfo);
+    return -1;
+  }
+  for (k = kh_begin(dst->peerinfo); k != kh_end(dst->peerinfo); ++k) {
+    if (!kh_exist(dst->peerinfo, k)) {
+      continue;
+    }
+    if (BWV_PEER_STATE(src, kh_val(src->peerinfo, k)) !=
+        BGPVIEW_FIELD_ACTIVE) {
+      kh_del(bwv_peerid_peerinfo, dst->peerinfo, k);
+      continue;
+    }
+    kh_val(dst->peerinfo, k).v4_pfx_cnt[BGPVIEW_FIELD_INACTIVE] = 0;
+    kh_val(dst->peerinfo, k).v6_pfx_cnt[BGPVIEW_FIELD_INACTIVE] = 0;
+    kh_val(dst->peerinfo, k).user = NULL;
+    kh_val(dst->peerinfo, k).epoch = dst->epoch;
+  }
+  dst->peerinfo_cnt[BGPVIEW_FIELD_ACTIVE] =
+    src->peerinfo_cnt[BGPVIEW_FIELD_ACTIVE];
+
+  return 0;
+}
+
+/* fast path for bgpview_copy when the views share peer ids and AS path ids,
+   and dst is empty */
+static int copy_clone(bgpview_t *dst, bgpview_t *src)
 {
-  __iter_pfx_first_peer(iter, state_mask);
-  assert(iter->pfx_peer_it_valid == 0 || __iter_has_more_peer(iter));
-  return (iter->pfx_peer_it_valid);
+  int ret;
+
+  /* dst has no valid records, so get rid of any invalid ones */
+  bgpview_gc(dst);
+  assert(kh_size(dst->v4pfxs) == 0 && kh_size(dst->v6pfxs) == 0 &&
+         kh_size(dst->peerinfo) == 0);
+
+  dst->time = src->time;
+
+  /* the journal can't record the changes of a bulk clone */
+  if (dst->journal != NULL) {
+    journal_reset(dst->journal);
+    dst->journal->complete = 0;
+  }
+
+  /* nor can the other indexes, so rebuild them when next used */
+  if (dst->origin_index != NULL) {
+    origin_index_reset(dst->origin_index);
+    dst->origin_index->valid = 0;
+  }
+  if (dst->lpm_index != NULL) {
+    lpm_index_reset(dst->lpm_index);
+    dst->lpm_index->valid = 0;
+  }
+  if (dst->peer_index != NULL) {
+    dst->peer_index->valid = 0;
+  }
+
+  if (clone_active_peers(dst, src) != 0) {
+    return -1;
+  }
+
+  /* active prefixes (with only their active pfx-peers) */
+  dst->v4pfxs_index.valid = 0;
+  dst->v6pfxs_index.valid = 0;
+  CLONE_PFX_TABLE(dst, src, v4pfxs, bwv_v4pfx_peerid_pfxinfo, ret);
+  if (ret != 0) {
+    return -1;
+  }
+  dst->v4pfxs_cnt[BGPVIEW_FIELD_ACTIVE] = src->v4pfxs_cnt[BGPVIEW_FIELD_ACTIVE];
+
+  CLONE_PFX_TABLE(dst, src, v6pfxs, bwv_v6pfx_peerid_pfxinfo, ret);
+  if (ret != 0) {
+    return -1;
+  }
+  dst->v6pfxs_cnt[BGPVIEW_FIELD_ACTIVE] = src->v6pfxs_cnt[BGPVIEW_FIELD_ACTIVE];
+
+  return 0;
 }
 
-int bgpview_iter_pfx_next_peer(bgpview_iter_t *iter)
+int bgpview_copy(bgpview_t *dst, bgpview_t *src)
 {
-  __iter_pfx_next_peer(iter);
-  assert(iter->pfx_peer_it_valid == 0 || __iter_has_more_peer(iter));
-  return (iter->pfx_peer_it_valid);
+  bgpview_iter_t *src_iter = NULL;
+  bgpview_iter_t *dst_iter = NULL;
+
+  bgpstream_peer_sig_t *ps;
+  bgpstream_peer_id_t src_id, dst_id;
+  bgpstream_peer_id_t *dstids = NULL;
+
+  bgpstream_pfx_t *pfx;
+  bgpstream_as_path_t *path;
+  bgpstream_peer_id_t *row_ids = NULL;
+  bgpstream_as_path_store_path_id_t *row_paths = NULL;
+  int row_cnt;
+
+  RETURN_IF_FROZEN(dst, -1);
+
+  /* if the views share tables, and dst is empty, clone the tables directly
+     (this needs no peer id remapping) */
+  if (dst->peersigns == src->peersigns && dst->pathstore == src->pathstore &&
+      dst->disable_extended == src->disable_extended &&
+      dst->pfx_peer_layout == src->pfx_peer_layout &&
+      bgpview_pfx_cnt(dst, BGPVIEW_FIELD_ALL_VALID) == 0 &&
+      bgpview_peer_cnt(dst, BGPVIEW_FIELD_ALL_VALID) == 0) {
+    return copy_clone(dst, src);
+  }
+
+  dst->time = src->time;
+
+  if (((src_iter = bgpview_iter_create(src)) == NULL) ||
+      ((dst_iter = bgpview_iter_create(dst)) == NULL)) {
+    goto err;
+  }
+
+  /* map from src peer ids to dst peer ids (on the heap, since this may run on
+     a thread with a small stack) */
+  if ((dstids = malloc(sizeof(bgpstream_peer_id_t) * (UINT16_MAX + 1))) ==
+      NULL) {
+    goto err;
+  }
+
+  for (bgpview_iter_first_peer(src_iter, BGPVIEW_FIELD_ACTIVE);
+       bgpview_iter_has_more_peer(src_iter); bgpview_iter_next_peer(src_iter)) {
+    ps = bgpview_iter_peer_get_sig(src_iter);
+    src_id = bgpview_iter_peer_get_peer_id(src_iter);
+    if ((dst_id = bgpview_iter_add_peer(
+           dst_iter, ps->collector_str,
+           &ps->peer_ip_addr, ps->peer_asnumber)) == 0) {
+      goto err;
+    }
+    dstids[src_id] = dst_id;
+    bgpview_iter_activate_peer(dst_iter);
+  }
+
+  /* each prefix is added as a single row */
+  if ((row_ids = malloc(sizeof(bgpstream_peer_id_t) * UINT16_MAX)) == NULL ||
+      (row_paths = malloc(sizeof(bgpstream_as_path_store_path_id_t) *
+                          UINT16_MAX)) == NULL) {
+    goto err;
+  }
+
+  for (bgpview_iter_first_pfx(src_iter, 0, BGPVIEW_FIELD_ACTIVE);
+       bgpview_iter_has_more_pfx(src_iter); bgpview_iter_next_pfx(src_iter)) {
+    row_cnt = 0;
+    pfx = bgpview_iter_pfx_get_pfx(src_iter);
+    for (bgpview_iter_pfx_first_peer(src_iter, BGPVIEW_FIELD_ACTIVE);
+         bgpview_iter_pfx_has_more_peer(src_iter);
+         bgpview_iter_pfx_next_peer(src_iter)) {
+      src_id = bgpview_iter_peer_get_peer_id(src_iter);
+      row_ids[row_cnt] = dstids[src_id];
+
+      /* if they share tables, be more efficient */
+      if (dst->pathstore == src->pathstore) {
+        row_paths[row_cnt] =
+          bgpview_iter_pfx_peer_get_as_path_store_path_id(src_iter);
+      } else {
+        /* inefficiently copy */
+        path = bgpview_iter_pfx_peer_get_as_path(src_iter);
+        ps = bgpview_iter_peer_get_sig(src_iter);
+        if (bgpstream_as_path_store_get_path_id(dst->pathstore, path,
+                                                ps->peer_asnumber,
+                                                &row_paths[row_cnt]) != 0) {
+          fprintf(stderr, "ERROR: Failed to get AS Path ID from store\n");
+          bgpstream_as_path_destroy(path);
+          goto err;
+        }
+        bgpstream_as_path_destroy(path);
+      }
+      row_cnt++;
+    }
+    if (bgpview_iter_add_pfx_peers(dst_iter, pfx, row_ids, row_paths, NULL,
+                                   row_cnt) != 0) {
+      goto err;
+    }
+  }
+
+  free(dstids);
+  free(row_ids);
+  free(row_paths);
+  bgpview_iter_destroy(src_iter);
+  bgpview_iter_destroy(dst_iter);
+
+  return 0;
+
+err:
+  free(dstids);
+  free(row_ids);
+  free(row_paths);
+  bgpview_iter_destroy(src_iter);
+  bgpview_iter_destroy(dst_iter);
+  return -1;
 }
 
-int bgpview_iter_pfx_has_more_peer(bgpview_iter_t *iter)
-{
-  return __iter_pfx_has_more_peer(iter);
+bgpview_t *bgpview_dup(bgpview_t *src)
+{
+  bgpview_t *dst = NULL;
+
+  if ((dst = bgpview_create_shared(
+         src->peersigns, src->pathstore, src->user_destructor,
+         src->peer_user_destructor, src->pfx_user_destructor,
+         src->pfx_peer_user_destructor)) == NULL) {
+    return NULL;
+  }
+
+  dst->disable_extended = src->disable_extended;
+  dst->pfx_peer_layout = src->pfx_peer_layout;
+
+  if (bgpview_copy(dst, src) != 0) {
+    goto err;
+  }
+
+  return dst;
+
+err:
+  bgpview_destroy(dst);
+  return NULL;
 }
 
-int bgpview_iter_pfx_seek_peer(bgpview_iter_t *iter, bgpstream_peer_id_t peerid,
-                               uint8_t state_mask)
+/* share the prefixes of the src table with the (empty) dst table of the given
+   snapshot view */
+#define SNAPSHOT_PFX_TABLE(view, dst, src, name, ret)                          \
+  do {                                                                         \
+    khiter_t k, e;                                                             \
+    bwv_peerid_pfxinfo_t *v;                                                   \
+    BWV_KH_COPY(name, dst, src, ret);                                          \
+    if ((ret) != 0) {                                                          \
+      break;                                                                   \
+    }                                                                          \
+    for (k = kh_begin(dst); k != kh_end(dst); ++k) {                           \
+      if (!kh_exist(dst, k)) {                                                 \
+        continue;                                                              \
+      }                                                                        \
+      if (kh_val(dst, k)->refcnt < UINT16_MAX) {                               \
+        kh_val(dst, k)->refcnt++;                                              \
+        continue;                                                              \
+      }                                                                        \
+      /* the prefix can't be shared by any more views, so the snapshot gets   \
+         its own copy */                                                       \
+      if ((v = peerid_pfxinfo_dup(view, kh_val(dst, k))) == NULL) {            \
+        /* the rest of the table points to prefixes it holds no reference     \
+           to */                                                               \
+        for (e = k; e != kh_end(dst); ++e) {                                   \
+          if (kh_exist(dst, e)) {                                              \
+            kh_del(name, dst, e);                                              \
+          }                                                                    \
+        }                                                                      \
+        (ret) = -1;                                                            \
+        break;                                                                 \
+      }                                                                        \
+      peerid_pfxinfo_forget_user(view, v);                                     \
+      kh_val(dst, k) = v;                                                      \
+    }                                                                          \
+  } while (0)
+
+bgpview_t *bgpview_snapshot(bgpview_t *src)
 {
-  __iter_pfx_seek_peer(iter, peerid, state_mask);
-  return (iter->pfx_peer_it_valid);
-}
+  bgpview_t *dst = NULL;
+  khiter_t k;
+  int ret;
 
-/* =================== ALL-PFX-PEER ITERATORS ==================== */
+  /* frozen views are immutable, but their prefixes can't be shared */
+  if (src->frozen != 0) {
+    return bgpview_dup(src);
+  }
 
-int bgpview_iter_first_pfx_peer(bgpview_iter_t *iter, int version,
-                                uint8_t pfx_mask, uint8_t peer_mask)
-{
-  // set the version(s) we iterate through
-  iter->version_filter = version;
+  if ((dst = bgpview_create_shared(src->peersigns, src->pathstore, NULL, NULL,
+                                   NULL, NULL)) == NULL) {
+    return NULL;
+  }
 
-  // set the version we start iterating through
-  iter->version_ptr = (iter->version_filter == BGPSTREAM_ADDR_VERSION_IPV6)
-                        ? BGPSTREAM_ADDR_VERSION_IPV6
-                        : BGPSTREAM_ADDR_VERSION_IPV4;
+  dst->disable_extended = src->disable_extended;
+  dst->pfx_peer_layout = src->pfx_peer_layout;
+  dst->time = src->time;
+  dst->epoch = src->epoch;
 
-  // masks are going to be set by each first function
-  iter->pfx_state_mask = 0;
-  iter->pfx_peer_state_mask = 0;
+  /* share the allocator that the prefixes were allocated from */
+  allocator_release(dst);
+  dst->alloc = src->alloc;
+  dst->alloc->refcnt++;
 
-  // start from the first matching prefix
-  bgpview_iter_first_pfx(iter, version, pfx_mask);
-  while (__iter_has_more_pfx(iter)) {
-    // look for the first matching peer within the prefix
-    if (bgpview_iter_pfx_first_peer(iter, peer_mask)) {
-      return 1;
+  /* copy the prefix tables, sharing all the prefixes */
+  SNAPSHOT_PFX_TABLE(dst, dst->v4pfxs, src->v4pfxs, bwv_v4pfx_peerid_pfxinfo,
+                     ret);
+  if (ret != 0) {
+    goto err;
+  }
+  memcpy(dst->v4pfxs_cnt, src->v4pfxs_cnt, sizeof(src->v4pfxs_cnt));
+  SNAPSHOT_PFX_TABLE(dst, dst->v6pfxs, src->v6pfxs, bwv_v6pfx_peerid_pfxinfo,
+                     ret);
+  if (ret != 0) {
+    goto err;
+  }
+  memcpy(dst->v6pfxs_cnt, src->v6pfxs_cnt, sizeof(src->v6pfxs_cnt));
+
+  /* the peer table is small, so just copy it (without the user data) */
+  BWV_KH_COPY(bwv_peerid_peerinfo, dst->peerinfo, src->peerinfo, ret);
+  if (ret != 0) {
+    goto err;
+  }
+  for (k = kh_begin(dst->peerinfo); k != kh_end(dst->peerinfo); ++k) {
+    if (kh_exist(dst->peerinfo, k)) {
+      kh_val(dst->peerinfo, k).user = NULL;
     }
-    __iter_next_pfx(iter);
   }
-  return 0;
+  memcpy(dst->peerinfo_cnt, src->peerinfo_cnt, sizeof(src->peerinfo_cnt));
+
+  dst->need_gc_v4pfxs = src->need_gc_v4pfxs;
+  dst->need_gc_v6pfxs = src->need_gc_v6pfxs;
+  dst->need_gc_peerinfo = src->need_gc_peerinfo;
+
+  return dst;
+
+err:
+  fprintf(stderr, "ERROR: Could not create view snapshot\n");
+  bgpview_destroy(dst);
+  return NULL;
 }
 
-#define __iter_has_more_pfx_peer(iter)                                         \
-  (__iter_has_more_pfx(iter) && __iter_pfx_has_more_peer(iter))
+/** A pfx-peer cell of a frozen view (used while sorting by peer ID) */
+typedef struct bwv_frozen_cell {
 
-#define __iter_next_pfx_peer(iter)                                             \
-  do {                                                                         \
-    while (__iter_has_more_pfx(iter)) {                                        \
-      /* look for the next matching peer within the prefix */                  \
-      __iter_pfx_next_peer(iter);                                              \
-      if (__iter_pfx_has_more_peer(iter))                                      \
-        break;                                                                 \
-      /* no more peers, go to the next prefix */                               \
-      __iter_next_pfx(iter);                                                   \
-      if (__iter_has_more_pfx(iter)) {                                         \
-        /* go to the first peer */                                             \
-        __iter_pfx_first_peer(iter, iter->pfx_peer_state_mask);                \
-        break;                                                                 \
-      }                                                                        \
-    }                                                                          \
-  } while (0)
+  /** ID of the peer */
+  bgpstream_peer_id_t id;
 
-int bgpview_iter_next_pfx_peer(bgpview_iter_t *iter)
+  /** pfx-peer info */
+  bwv_pfx_peerinfo_t info;
+
+} bwv_frozen_cell_t;
+
+static int frozen_cell_cmp(const void *a, const void *b)
 {
-  __iter_next_pfx_peer(iter);
-  return __iter_has_more_pfx_peer(iter);
+  const bwv_frozen_cell_t *ca = a;
+  const bwv_frozen_cell_t *cb = b;
+  return (ca->id > cb->id) - (ca->id < cb->id);
 }
 
-int bgpview_iter_has_more_pfx_peer(bgpview_iter_t *iter)
+#define BWV_ALIGN8(x) (((x) + 7) & ~((size_t)7))
+
+/* set up an active prefix record of a frozen view whose cnt (active)
+   pfx-peers are in the given flat arrays */
+static void frozen_pfxinfo_init(bgpview_t *view, bwv_peerid_pfxinfo_t *pfxinfo,
+                                bwv_pfx_peervec_t *vec,
+                                bgpstream_peer_id_t *ids,
+                                bwv_pfx_peerinfo_t *infos, uint16_t cnt)
 {
-  return bgpview_iter_has_more_pfx(iter) &&
-         bgpview_iter_pfx_has_more_peer(iter);
+  memset(pfxinfo, 0, sizeof(bwv_peerid_pfxinfo_t));
+  pfxinfo->peers_vec = vec;
+  vec->ids = ids;
+  vec->infos = (uint8_t *)infos;
+  vec->size = vec->alloc = cnt;
+  pfxinfo->peers_cnt[BGPVIEW_FIELD_ACTIVE] = cnt;
+  pfxinfo->state = BGPVIEW_FIELD_ACTIVE;
+  pfxinfo->epoch = view->epoch;
+  pfxinfo->refcnt = 1;
 }
 
-int bgpview_iter_seek_pfx_peer(bgpview_iter_t *iter, bgpstream_pfx_t *pfx,
-                               bgpstream_peer_id_t peerid, uint8_t pfx_mask,
-                               uint8_t peer_mask)
+/* copy the active pfx-peers of a src prefix into the given (flat) arrays,
+   sorted by peer ID. cells is a scratch buffer of UINT16_MAX+1 cells. returns
+   the number of pfx-peers copied */
+static uint32_t freeze_pfx_peers(bgpview_t *src,
+                                 bwv_peerid_pfxinfo_t *src_pfxinfo,
+                                 bwv_frozen_cell_t *cells,
+                                 bgpstream_peer_id_t *ids,
+                                 bwv_pfx_peerinfo_t *infos)
 {
-  if (bgpview_iter_seek_pfx(iter, pfx, pfx_mask) &&
-      bgpview_iter_pfx_seek_peer(iter, peerid, peer_mask)) {
-    return 1;
+  bwv_pfx_peerinfo_t *peerinfo;
+  uint32_t i, n = 0;
+  khiter_t k;
+
+  if (src_pfxinfo->peers_generic == NULL) {
+    return 0;
   }
 
-  // if the peer is not found we reset the iterators
-  iter->version_ptr = BGPSTREAM_ADDR_VERSION_IPV4;
-  iter->pfx_it = kh_end(iter->view->v4pfxs);
-  iter->pfx_peer_it_valid = 0;
-  iter->pfx_peer_it = 0;
+  /* both pfx-peer info types start with the fields of bwv_pfx_peerinfo_t */
+  if (BWV_PFX_PEERS_ARE_VEC(src)) {
+    /* already sorted */
+    for (i = 0; i < src_pfxinfo->peers_vec->size; i++) {
+      peerinfo = BWV_PEERVEC_GET_PEER(src, src_pfxinfo->peers_vec, i);
+      if (peerinfo->state == BGPVIEW_FIELD_ACTIVE) {
+        ids[n] = src_pfxinfo->peers_vec->ids[i];
+        memcpy(&infos[n], peerinfo, sizeof(bwv_pfx_peerinfo_t));
+        n++;
+      }
+    }
+    return n;
+  }
 
-  return 0;
+  if (src->disable_extended) {
+    for (k = kh_begin(src_pfxinfo->peers_min);
+         k != kh_end(src_pfxinfo->peers_min); ++k) {
+      if (kh_exist(src_pfxinfo->peers_min, k) &&
+          kh_val(src_pfxinfo->peers_min, k).state == BGPVIEW_FIELD_ACTIVE) {
+        cells[n].id = kh_key(src_pfxinfo->peers_min, k);
+        memcpy(&cells[n].info, &kh_val(src_pfxinfo->peers_min, k),
+               sizeof(bwv_pfx_peerinfo_t));
+        n++;
+      }
+    }
+  } else {
+    for (k = kh_begin(src_pfxinfo->peers_ext);
+         k != kh_end(src_pfxinfo->peers_ext); ++k) {
+      if (kh_exist(src_pfxinfo->peers_ext, k) &&
+          kh_val(src_pfxinfo->peers_ext, k).state == BGPVIEW_FIELD_ACTIVE) {
+        cells[n].id = kh_key(src_pfxinfo->peers_ext, k);
+        memcpy(&cells[n].info, &kh_val(src_pfxinfo->peers_ext, k),
+               sizeof(bwv_pfx_peerinfo_t));
+        n++;
+      }
+    }
+  }
+
+  qsort(cells, n, sizeof(bwv_frozen_cell_t), frozen_cell_cmp);
+  for (i = 0; i < n; i++) {
+    ids[i] = cells[i].id;
+    infos[i] = cells[i].info;
+  }
+  return n;
 }
 
-/* ==================== CREATION FUNCS ==================== */
+/* copy the active prefixes of a src prefix table into the (empty) dst table,
+   placing the records (and their pfx-peers) consecutively in the arena, in
+   bucket order */
+#define FREEZE_PFX_TABLE(dst, src, table, name, ret)                           \
+  do {                                                                         \
+    khiter_t k;                                                                \
+    bwv_peerid_pfxinfo_t *src_pfxinfo;                                         \
+    bwv_peerid_pfxinfo_t *pfxinfo;                                             \
+    BWV_KH_COPY(name, (dst)->table, (src)->table, ret);                        \
+    if ((ret) != 0) {                                                          \
+      break;                                                                   \
+    }                                                                          \
+    for (k = kh_begin((dst)->table); k != kh_end((dst)->table); ++k) {         \
+      if (!kh_exist((dst)->table, k)) {                                        \
+        continue;                                                              \
+      }                                                                        \
+      src_pfxinfo = kh_val((src)->table, k);                                   \
+      if (BWV_PFX_STATE((src), src_pfxinfo) != BGPVIEW_FIELD_ACTIVE) {         \
+        kh_del(name, (dst)->table, k);                                         \
+        continue;                                                              \
+      }                                                                        \
+      pfxinfo = &pfxinfos[pfx_idx];                                            \
+      frozen_pfxinfo_init((dst), pfxinfo, &vecs[pfx_idx], &ids[cell_idx],      \
+                          &infos[cell_idx],                                    \
+                          freeze_pfx_peers((src), src_pfxinfo, cells,          \
+                                           &ids[cell_idx], &infos[cell_idx])); \
+      cell_idx += pfxinfo->peers_vec->size;                                    \
+      kh_val((dst)->table, k) = pfxinfo;                                       \
+      pfx_idx++;                                                               \
+    }                                                                          \
+  } while (0)
 
-bgpstream_peer_id_t bgpview_iter_add_peer(bgpview_iter_t *iter,
-                                          const char *collector_str,
-                                          bgpstream_ip_addr_t *peer_address,
-                                          uint32_t peer_asnumber)
+bgpview_t *bgpview_freeze(bgpview_t *src)
 {
-  bgpstream_peer_id_t peer_id;
+  bgpview_t *dst = NULL;
+  bwv_frozen_cell_t *cells = NULL;
+  bwv_pfx_peervec_t *vecs;
+  bwv_peerid_pfxinfo_t *pfxinfos;
+  bwv_pfx_peerinfo_t *infos;
+  bgpstream_peer_id_t *ids;
+  uint64_t pfx_cnt, pfx_idx = 0;
+  uint64_t cell_cnt = 0, cell_idx = 0;
+  size_t pfxinfos_off, infos_off, ids_off, arena_size;
   khiter_t k;
-  int khret;
+  int ret;
 
-  /* add peer to signatures' map */
-  if ((peer_id =
-         bgpstream_peer_sig_map_get_id(iter->view->peersigns, collector_str,
-                                       peer_address, peer_asnumber)) == 0) {
-    fprintf(stderr, "Could not add peer to peersigns\n");
-    fprintf(stderr, "Consider making bgpstream_peer_sig_map_set more robust\n");
-    return 0;
+  if ((dst = bgpview_create_shared(src->peersigns, src->pathstore, NULL, NULL,
+                                   NULL, NULL)) == NULL) {
+    return NULL;
   }
 
-  /* populate peer information in peerinfo */
+  dst->disable_extended = 1;
+  dst->pfx_peer_layout = BGPVIEW_PFX_PEER_LAYOUT_VECTOR;
+  dst->time = src->time;
 
-  if ((k = kh_get(bwv_peerid_peerinfo, iter->view->peerinfo, peer_id)) ==
-      kh_end(iter->view->peerinfo)) {
-    /* new peer!  */
-    k = kh_put(bwv_peerid_peerinfo, iter->view->peerinfo, peer_id, &khret);
-    memset(&kh_val(iter->view->peerinfo, k), 0, sizeof(bwv_peerinfo_t));
-    /* peer is invalid */
+  /* count the active prefixes and pfx-peers */
+  pfx_cnt = src->v4pfxs_cnt[BGPVIEW_FIELD_ACTIVE] +
+            src->v6pfxs_cnt[BGPVIEW_FIELD_ACTIVE];
+  for (k = kh_begin(src->v4pfxs); k != kh_end(src->v4pfxs); ++k) {
+    if (kh_exist(src->v4pfxs, k) &&
+        BWV_PFX_STATE(src, kh_val(src->v4pfxs, k)) == BGPVIEW_FIELD_ACTIVE) {
+      cell_cnt += kh_val(src->v4pfxs, k)->peers_cnt[BGPVIEW_FIELD_ACTIVE];
+    }
+  }
+  for (k = kh_begin(src->v6pfxs); k != kh_end(src->v6pfxs); ++k) {
+    if (kh_exist(src->v6pfxs, k) &&
+        BWV_PFX_STATE(src, kh_val(src->v6pfxs, k)) == BGPVIEW_FIELD_ACTIVE) {
+      cell_cnt += kh_val(src->v6pfxs, k)->peers_cnt[BGPVIEW_FIELD_ACTIVE];
+    }
   }
 
-  /* seek the iterator */
-  iter->peer_it = k;
-  iter->peer_state_mask = BGPVIEW_FIELD_ALL_VALID;
-  iter->pfx_peer_it_valid = 0; // moving peer_it invalidates pfx_peer_it
+  /* a single block holds (in order) the vector headers, the prefix records,
+     the pfx-peer infos and the peer ids */
+  pfxinfos_off = BWV_ALIGN8(pfx_cnt * sizeof(bwv_pfx_peervec_t));
+  infos_off =
+    pfxinfos_off + BWV_ALIGN8(pfx_cnt * sizeof(bwv_peerid_pfxinfo_t));
+  ids_off = infos_off + BWV_ALIGN8(cell_cnt * sizeof(bwv_pfx_peerinfo_t));
+  arena_size = ids_off + cell_cnt * sizeof(bgpstream_peer_id_t);
+
+  if ((dst->frozen_arena = malloc(arena_size > 0 ? arena_size : 1)) == NULL ||
+      (cells = malloc(sizeof(bwv_frozen_cell_t) * (UINT16_MAX + 1))) ==
+        NULL) {
+    goto err;
+  }
+  dst->frozen = 1;
 
-  /* here iter->peer_it points to a peer, it could be invalid, inactive,
-     active */
-  if (kh_val(iter->view->peerinfo, k).state != BGPVIEW_FIELD_INVALID) {
-    /* it was already here, and it was inactive/active, just return */
-    return peer_id;
+  vecs = dst->frozen_arena;
+  pfxinfos = (bwv_peerid_pfxinfo_t *)((uint8_t *)dst->frozen_arena +
+                                      pfxinfos_off);
+  infos = (bwv_pfx_peerinfo_t *)((uint8_t *)dst->frozen_arena + infos_off);
+  ids = (bgpstream_peer_id_t *)((uint8_t *)dst->frozen_arena + ids_off);
+
+  if (clone_active_peers(dst, src) != 0) {
+    goto err;
   }
 
-  /* by here, it was invalid */
-  kh_val(iter->view->peerinfo, k).state = BGPVIEW_FIELD_INACTIVE;
+  FREEZE_PFX_TABLE(dst, src, v4pfxs, bwv_v4pfx_peerid_pfxinfo, ret);
+  if (ret != 0) {
+    goto err;
+  }
+  dst->v4pfxs_cnt[BGPVIEW_FIELD_ACTIVE] = src->v4pfxs_cnt[BGPVIEW_FIELD_ACTIVE];
 
-  /* and count one more inactive peer */
-  iter->view->peerinfo_cnt[BGPVIEW_FIELD_INACTIVE]++;
+  FREEZE_PFX_TABLE(dst, src, v6pfxs, bwv_v6pfx_peerid_pfxinfo, ret);
+  if (ret != 0) {
+    goto err;
+  }
+  dst->v6pfxs_cnt[BGPVIEW_FIELD_ACTIVE] = src->v6pfxs_cnt[BGPVIEW_FIELD_ACTIVE];
 
-  return peer_id;
+  assert(pfx_idx == pfx_cnt && cell_idx == cell_cnt);
+
+  free(cells);
+  return dst;
+
+err:
+  fprintf(stderr, "ERROR: Could not freeze view\n");
+  free(cells);
+  /* prefix tables that could not be copied may still point to the records of
+     src, but the prefixes of a frozen view are never destroyed one by one */
+  bgpview_destroy(dst);
+  return NULL;
 }
 
-int bgpview_iter_remove_peer(bgpview_iter_t *iter)
+bgpview_t *bgpview_freeze_detached(bgpview_t *src)
 {
-  bgpview_iter_t *lit;
-  /* we have to have a valid peer */
-  assert(__iter_has_more_peer(iter));
+  bgpview_t *tmp = NULL;
+  bgpview_t *dst = NULL;
 
-  /* if the peer is active, then we deactivate it first */
-  if (bgpview_iter_peer_get_state(iter) == BGPVIEW_FIELD_ACTIVE) {
-    bgpview_iter_deactivate_peer(iter);
+  /* copy the active part of src into a view with its own tables (which
+     re-interns the peers and AS paths that are in use), and freeze that */
+  if ((tmp = bgpview_create(NULL, NULL, NULL, NULL)) == NULL) {
+    goto err;
   }
-  assert(bgpview_iter_peer_get_state(iter) == BGPVIEW_FIELD_INACTIVE);
+  bgpview_disable_user_data(tmp);
+  bgpview_set_pfx_peer_layout(tmp, BGPVIEW_PFX_PEER_LAYOUT_VECTOR);
 
-  /* if the peer had prefixes, then we need to remove all pfx-peers for this
-     peer */
-  if (bgpview_iter_peer_get_pfx_cnt(iter, 0, BGPVIEW_FIELD_ALL_VALID) > 0) {
-    lit = bgpview_iter_create(iter->view);
-    assert(lit != NULL);
-    for (bgpview_iter_first_pfx_peer(lit, 0, BGPVIEW_FIELD_ALL_VALID,
-                                     BGPVIEW_FIELD_ALL_VALID);
-         bgpview_iter_has_more_pfx_peer(lit); bgpview_iter_next_pfx_peer(lit)) {
-      // remove all the peer-pfx associated with the peer
-      if (bgpview_iter_peer_get_peer_id(iter) ==
-          bgpview_iter_peer_get_peer_id(lit)) {
-        bgpview_iter_pfx_remove_peer(lit);
-      }
-    }
-    bgpview_iter_destroy(lit);
+  if (bgpview_copy(tmp, src) != 0 || (dst = bgpview_freeze(tmp)) == NULL) {
+    goto err;
   }
 
-  /* set the state to invalid and reset the counters */
-  peerinfo_reset(&kh_value(iter->view->peerinfo, iter->peer_it));
-  iter->view->need_gc_peerinfo = 1;
-  iter->view->peerinfo_cnt[BGPVIEW_FIELD_INACTIVE]--;
+  /* and hand the tables over to the frozen view */
+  dst->peersigns_shared = 0;
+  dst->pathstore_shared = 0;
+  tmp->peersigns_shared = 1;
+  tmp->pathstore_shared = 1;
+  bgpview_destroy(tmp);
 
-  return 0;
+  return dst;
+
+err:
+  fprintf(stderr, "ERROR: Could not create detached frozen view\n");
+  bgpview_destroy(tmp);
+  return NULL;
 }
 
-int bgpview_iter_add_pfx_peer(bgpview_iter_t *iter,
-                                   bgpstream_pfx_t *pfx,
-                                   bgpstream_peer_id_t peer_id,
-                                   bgpstream_as_path_t *as_path)
+int bgpview_is_frozen(bgpview_t *view)
 {
-  bgpstream_as_path_store_path_id_t path_id;
-  bgpstream_peer_sig_t *ps;
+  return view->frozen;
+}
 
-  /* first seek to the prefix */
-  if (bgpview_iter_seek_pfx(iter, pfx, BGPVIEW_FIELD_ALL_VALID) == 0) {
-    /* we have to first create (or un-invalid) the prefix */
-    if (add_pfx(iter, pfx) != 0) {
-      return -1;
-    }
-  }
+/* ==================== SNAPSHOT IMAGES ==================== */
 
-  /* the peer must already exist */
-  __iter_seek_peer(iter, peer_id, BGPVIEW_FIELD_ALL_VALID);
-  iter->pfx_peer_it_valid = 0; // moving peer_it invalidates pfx_peer_it
-  if (iter->peer_it == kh_end(iter->view->peerinfo)) {
-    return -1;
-  }
-  /* get the peer ASN */
-  ps = bgpview_iter_peer_get_sig(iter);
+/** Magic string at the start of a snapshot image */
+#define BWV_IMAGE_MAGIC "BGPVIMG"
 
-  if (bgpstream_as_path_store_get_path_id(iter->view->pathstore, as_path,
-                                          ps->peer_asnumber, &path_id) != 0) {
-    fprintf(stderr, "ERROR: Failed to get AS Path ID from store\n");
-    return -1;
-  }
+/** Version of the snapshot image layout */
+#define BWV_IMAGE_VERSION 1
+
+/** Written in native byte order, to detect images from a different host */
+#define BWV_IMAGE_BYTE_ORDER 0x01020304
+
+/** Maximum number of keys of each prefix table of an image that are looked up
+    to check that the image was hashed the same way as the reader hashes */
+#define BWV_IMAGE_HASH_CHECKS 64
+
+/** Prefix table of a snapshot image. The bucket flags and keys are stored as
+    they are laid out in memory, followed by the number of pfx-peers of each
+    prefix, in bucket order */
+typedef struct bwv_image_table {
+
+  /** khash state of the table */
+  uint32_t n_buckets;
+  uint32_t size;
+  uint32_t n_occupied;
+  uint32_t upper_bound;
+
+  /** Offset of the bucket flags */
+  uint64_t flags_off;
+
+  /** Offset of the bucket keys */
+  uint64_t keys_off;
+
+  /** Offset of the pfx-peer counts (uint16_t) of the prefixes */
+  uint64_t cnts_off;
+
+} bwv_image_table_t;
+
+/** Header of a snapshot image. Sections are referenced by their offset from
+    the start of the image, so the image can be mapped at any address */
+typedef struct bwv_image_hdr {
+
+  /** BWV_IMAGE_MAGIC */
+  char magic[8];
+
+  /** BWV_IMAGE_VERSION */
+  uint32_t version;
+
+  /** BWV_IMAGE_BYTE_ORDER */
+  uint32_t byte_order;
+
+  /** Sizes of the records in the image, which must match those of the
+      reader */
+  uint32_t hdr_size;
+  uint32_t v4key_size;
+  uint32_t v6key_size;
+  uint32_t peer_size;
+  uint32_t cell_size;
+
+  /** Time of the view */
+  uint32_t time;
+
+  /** Number of peers */
+  uint32_t peer_cnt;
+
+  /** Number of AS paths */
+  uint32_t path_cnt;
+
+  /** Number of pfx-peers */
+  uint64_t cell_cnt;
+
+  /** Prefix tables */
+  bwv_image_table_t v4pfxs;
+  bwv_image_table_t v6pfxs;
+
+  /** Offset of the peers (bwv_image_peer_t) */
+  uint64_t peers_off;
+
+  /** Offset of the AS paths (bwv_image_path_t, each followed by the path
+      data) */
+  uint64_t paths_off;
+
+  /** Offset of the peer IDs of the pfx-peers */
+  uint64_t ids_off;
+
+  /** Offset of the pfx-peer infos (bwv_pfx_peerinfo_t) */
+  uint64_t infos_off;
 
-  /* now insert the prefix-peer info */
-  return bgpview_iter_pfx_add_peer_by_id(iter, peer_id, path_id);
-}
+  /** Size of the image */
+  uint64_t size;
 
-int bgpview_iter_add_pfx_peer_by_id(bgpview_iter_t *iter, bgpstream_pfx_t *pfx,
-                                    bgpstream_peer_id_t peer_id,
-                                    bgpstream_as_path_store_path_id_t path_id)
-{
-  /* the peer must already exist */
-  if (bgpview_iter_seek_peer(iter, peer_id, BGPVIEW_FIELD_ALL_VALID) == 0) {
-    return -1;
-  }
+} bwv_image_hdr_t;
 
-  /* now seek to the prefix */
-  if (bgpview_iter_seek_pfx(iter, pfx, BGPVIEW_FIELD_ALL_VALID) == 0) {
-    /* we have to first create (or un-invalid) the prefix */
-    if (add_pfx(iter, pfx) != 0) {
-      return -1;
-    }
-  }
+/** Peer of a snapshot image */
+typedef struct bwv_image_peer {
 
-  /* now insert the prefix-peer info */
-  return bgpview_iter_pfx_add_peer_by_id(iter, peer_id, path_id);
-}
+  /** Signature of the peer */
+  bgpstream_peer_sig_t sig;
 
-int bgpview_iter_remove_pfx(bgpview_iter_t *iter)
-{
-  bwv_peerid_pfxinfo_t *pfxinfo = __pfx_peerinfos(iter);
-  bgpview_iter_t ti;
+  /** ID of the peer */
+  bgpstream_peer_id_t id;
 
-  /* if the pfx is active, then we deactivate it first */
-  if (bgpview_iter_pfx_get_state(iter) == BGPVIEW_FIELD_ACTIVE) {
-    bgpview_iter_deactivate_pfx(iter);
-  }
+  /** Number of v4 and v6 prefixes of the peer */
+  uint32_t v4_pfx_cnt[BGPVIEW_FIELD_ALL_VALID];
+  uint32_t v6_pfx_cnt[BGPVIEW_FIELD_ALL_VALID];
 
-  assert(pfxinfo->state == BGPVIEW_FIELD_INACTIVE);
+} bwv_image_peer_t;
 
-  pfxinfo->state = BGPVIEW_FIELD_INVALID;
+/** AS path of a snapshot image */
+typedef struct bwv_image_path {
 
-  /* if there are any active or inactive pfx-peers, we remove them now */
-  if (bgpview_iter_pfx_get_peer_cnt(iter, BGPVIEW_FIELD_ALL_VALID) > 0) {
-    ti = *iter;
-    /* iterate over all pfx-peers for this pfx */
-    __iter_pfx_first_peer(&ti, BGPVIEW_FIELD_ALL_VALID);
-    while (bgpview_iter_pfx_has_more_peer(&ti)) {
-      bgpview_iter_pfx_remove_peer(&ti);
-      __iter_pfx_next_peer(&ti);
-    }
-  }
+  /** ID of the path in the store of the view that was saved */
+  bgpstream_as_path_store_path_id_t id;
 
-  assert(pfxinfo->peers_cnt[BGPVIEW_FIELD_INACTIVE] == 0 &&
-         pfxinfo->peers_cnt[BGPVIEW_FIELD_ACTIVE] == 0);
+  /** Is this a core path? */
+  uint8_t is_core;
 
-  /* set the state to invalid and update counters */
+  /** Length of the path data that follows */
+  uint16_t len;
 
-  switch (iter->version_ptr) {
-  case BGPSTREAM_ADDR_VERSION_IPV4:
-    iter->view->v4pfxs_cnt[BGPVIEW_FIELD_INACTIVE]--;
-    iter->view->need_gc_v4pfxs = 1;
-    break;
+} __attribute__((packed)) bwv_image_path_t;
 
-  case BGPSTREAM_ADDR_VERSION_IPV6:
-    iter->view->v6pfxs_cnt[BGPVIEW_FIELD_INACTIVE]--;
-    iter->view->need_gc_v6pfxs = 1;
-    break;
+#define BWV_PATHID_KEY(id) (((uint64_t)(id).path_hash << 16) | (id).path_id)
 
-  default:
+KHASH_INIT(bwv_pathid_set, uint64_t, char, 0, kh_int64_hash_func,
+           kh_int64_hash_equal)
+
+KHASH_INIT(bwv_pathid_map, uint64_t, bgpstream_as_path_store_path_id_t, 1,
+           kh_int64_hash_func, kh_int64_hash_equal)
+
+/* write len bytes to an image, keeping track of the offset */
+static int image_write(FILE *fh, const void *buf, size_t len, uint64_t *off)
+{
+  if (len > 0 && fwrite(buf, 1, len, fh) != len) {
     return -1;
   }
-
+  *off += len;
   return 0;
 }
 
-int bgpview_iter_pfx_add_peer(bgpview_iter_t *iter, bgpstream_peer_id_t peer_id,
-                              bgpstream_as_path_t *as_path)
+/* pad an image to the next multiple of 8 bytes */
+static int image_align(FILE *fh, uint64_t *off)
 {
-  bgpstream_as_path_store_path_id_t path_id;
+  static const uint8_t zeros[8] = {0};
+  return image_write(fh, zeros, BWV_ALIGN8(*off) - *off, off);
+}
 
-  /* get the peer ASN */
-  if (bgpstream_as_path_store_get_path_id(
-        iter->view->pathstore, as_path,
-        __iter_peer_get_sig(iter)->peer_asnumber, &path_id) != 0) {
-    fprintf(stderr, "ERROR: Failed to get AS Path ID from store\n");
-    return -1;
-  }
+/* add the AS paths used by the prefixes of a frozen prefix table to the set */
+#define IMAGE_TABLE_PATHS(view, table, paths, ret)                             \
+  do {                                                                         \
+    khiter_t k;                                                                \
+    bwv_pfx_peervec_t *vec;                                                    \
+    int i;                                                                     \
+    for (k = kh_begin((view)->table);                                          \
+         (ret) >= 0 && k != kh_end((view)->table); ++k) {                      \
+      if (!kh_exist((view)->table, k)) {                                       \
+        continue;                                                              \
+      }                                                                        \
+      vec = kh_val((view)->table, k)->peers_vec;                               \
+      for (i = 0; (ret) >= 0 && i < vec->size; i++) {                          \
+        kh_put(bwv_pathid_set, (paths),                                        \
+               BWV_PATHID_KEY(BWV_PEERVEC_GET_PEER(view, vec, i)->as_path_id), \
+               &(ret));                                                        \
+      }                                                                        \
+    }                                                                          \
+    (ret) = ((ret) < 0) ? -1 : 0;                                              \
+  } while (0)
 
-  __iter_seek_peer(iter, peer_id, BGPVIEW_FIELD_ALL_VALID);
+/* write the bucket flags and keys, and the pfx-peer counts of a frozen prefix
+   table to an image */
+#define IMAGE_WRITE_TABLE(fh, view, table, itab, off, ret)                     \
+  do {                                                                         \
+    khiter_t k;                                                                \
+    uint16_t cnt;                                                              \
+    __typeof__((view)->table->keys[0]) zero_key;                               \
+    (ret) = 0;                                                                 \
+    memset(&zero_key, 0, sizeof(zero_key));                                    \
+    (itab).n_buckets = (view)->table->n_buckets;                               \
+    (itab).size = (view)->table->size;                                         \
+    (itab).n_occupied = (view)->table->n_occupied;                             \
+    (itab).upper_bound = (view)->table->upper_bound;                           \
+    if ((itab).n_buckets == 0) {                                               \
+      break;                                                                   \
+    }                                                                          \
+    if (image_align(fh, &(off)) != 0) {                                        \
+      (ret) = -1;                                                              \
+      break;                                                                   \
+    }                                                                          \
+    (itab).flags_off = (off);                                                  \
+    if (image_write(fh, (view)->table->flags,                                  \
+                    __ac_fsize((itab).n_buckets) * sizeof(khint32_t),          \
+                    &(off)) != 0 ||                                            \
+        image_align(fh, &(off)) != 0) {                                        \
+      (ret) = -1;                                                              \
+      break;                                                                   \
+    }                                                                          \
+    /* the keys of unused buckets are zeroed rather than copied */             \
+    (itab).keys_off = (off);                                                   \
+    for (k = kh_begin((view)->table); k != kh_end((view)->table); ++k) {       \
+      if (image_write(fh,                                                      \
+                      kh_exist((view)->table, k) ? &kh_key((view)->table, k)   \
+                                                 : &zero_key,                  \
+                      sizeof(zero_key), &(off)) != 0) {                        \
+        (ret) = -1;                                                            \
+        break;                                                                 \
+      }                                                                        \
+    }                                                                          \
+    if ((ret) != 0 || image_align(fh, &(off)) != 0) {                          \
+      (ret) = -1;                                                              \
+      break;                                                                   \
+    }                                                                          \
+    (itab).cnts_off = (off);                                                   \
+    for (k = kh_begin((view)->table); k != kh_end((view)->table); ++k) {       \
+      if (!kh_exist((view)->table, k)) {                                       \
+        continue;                                                              \
+      }                                                                        \
+      cnt = kh_val((view)->table, k)->peers_vec->size;                         \
+      if (image_write(fh, &cnt, sizeof(cnt), &(off)) != 0) {                   \
+        (ret) = -1;                                                            \
+        break;                                                                 \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
 
-  return peerid_pfxinfo_insert(iter, __pfx_peerinfos(iter), peer_id, path_id);
-}
+/* write either the peer IDs or the infos of the pfx-peers of a frozen prefix
+   table to an image */
+#define IMAGE_WRITE_CELLS(fh, view, table, write_ids, off, ret)                \
+  do {                                                                         \
+    khiter_t k;                                                                \
+    bwv_pfx_peervec_t *vec;                                                    \
+    (ret) = 0;                                                                 \
+    for (k = kh_begin((view)->table); k != kh_end((view)->table); ++k) {       \
+      if (!kh_exist((view)->table, k)) {                                       \
+        continue;                                                              \
+      }                                                                        \
+      vec = kh_val((view)->table, k)->peers_vec;                               \
+      if ((write_ids) != 0) {                                                  \
+        (ret) = image_write(fh, vec->ids,                                      \
+                            sizeof(bgpstream_peer_id_t) * vec->size, &(off));  \
+      } else {                                                                 \
+        (ret) = image_write(fh, vec->infos,                                    \
+                            sizeof(bwv_pfx_peerinfo_t) * vec->size, &(off));   \
+      }                                                                        \
+      if ((ret) != 0) {                                                        \
+        break;                                                                 \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
 
-int bgpview_iter_pfx_add_peer_by_id(bgpview_iter_t *iter,
-                                    bgpstream_peer_id_t peer_id,
-                                    bgpstream_as_path_store_path_id_t path_id)
+/* write the image of a frozen view */
+static int image_write_view(FILE *fh, bgpview_t *view)
 {
-  /* this code is mostly a duplicate of the above func, for efficiency */
-  __iter_seek_peer(iter, peer_id, BGPVIEW_FIELD_ALL_VALID);
+  bwv_image_hdr_t hdr;
+  bwv_image_peer_t peer;
+  bwv_image_path_t ipath;
+  bgpstream_peer_sig_t *sig;
+  bgpstream_as_path_store_path_t *spath;
+  bgpstream_as_path_t *path;
+  uint8_t *path_data;
+  khash_t(bwv_pathid_set) *paths = NULL;
+  uint64_t off = 0;
+  khiter_t k;
+  int ret = 0;
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, BWV_IMAGE_MAGIC, sizeof(BWV_IMAGE_MAGIC));
+  hdr.version = BWV_IMAGE_VERSION;
+  hdr.byte_order = BWV_IMAGE_BYTE_ORDER;
+  hdr.hdr_size = sizeof(bwv_image_hdr_t);
+  hdr.v4key_size = sizeof(view->v4pfxs->keys[0]);
+  hdr.v6key_size = sizeof(view->v6pfxs->keys[0]);
+  hdr.peer_size = sizeof(bwv_image_peer_t);
+  hdr.cell_size = sizeof(bwv_pfx_peerinfo_t);
+  hdr.time = view->time;
+
+  /* the header is rewritten once the sections are in place */
+  if (image_write(fh, &hdr, sizeof(hdr), &off) != 0) {
+    goto err;
+  }
 
-  return peerid_pfxinfo_insert(iter, __pfx_peerinfos(iter), peer_id, path_id);
+  /* peers */
+  if (image_align(fh, &off) != 0) {
+    goto err;
+  }
+  hdr.peers_off = off;
+  for (k = kh_begin(view->peerinfo); k != kh_end(view->peerinfo); ++k) {
+    if (!kh_exist(view->peerinfo, k) ||
+        BWV_PEER_STATE(view, kh_val(view->peerinfo, k)) !=
+          BGPVIEW_FIELD_ACTIVE) {
+      continue;
+    }
+    memset(&peer, 0, sizeof(peer));
+    peer.id = kh_key(view->peerinfo, k);
+    if ((sig = bgpstream_peer_sig_map_get_sig(view->peersigns, peer.id)) ==
+        NULL) {
+      goto err;
+    }
+    peer.sig = *sig;
+    memcpy(peer.v4_pfx_cnt, kh_val(view->peerinfo, k).v4_pfx_cnt,
+           sizeof(peer.v4_pfx_cnt));
+    memcpy(peer.v6_pfx_cnt, kh_val(view->peerinfo, k).v6_pfx_cnt,
+           sizeof(peer.v6_pfx_cnt));
+    if (image_write(fh, &peer, sizeof(peer), &off) != 0) {
+      goto err;
+    }
+    hdr.peer_cnt++;
+  }
+
+  /* the AS paths that are in use */
+  if ((paths = kh_init(bwv_pathid_set)) == NULL) {
+    goto err;
+  }
+  IMAGE_TABLE_PATHS(view, v4pfxs, paths, ret);
+  if (ret == 0) {
+    IMAGE_TABLE_PATHS(view, v6pfxs, paths, ret);
+  }
+  if (ret != 0 || image_align(fh, &off) != 0) {
+    goto err;
+  }
+  hdr.paths_off = off;
+  for (k = kh_begin(paths); k != kh_end(paths); ++k) {
+    if (!kh_exist(paths, k)) {
+      continue;
+    }
+    ipath.id.path_hash = kh_key(paths, k) >> 16;
+    ipath.id.path_id = kh_key(paths, k) & 0xffff;
+    if ((spath = bgpstream_as_path_store_get_store_path(view->pathstore,
+                                                        ipath.id)) == NULL) {
+      goto err;
+    }
+    ipath.is_core = bgpstream_as_path_store_path_is_core(spath);
+    path = bgpstream_as_path_store_path_get_int_path(spath);
+    ipath.len = bgpstream_as_path_get_data(path, &path_data);
+    if (image_write(fh, &ipath, sizeof(ipath), &off) != 0 ||
+        image_write(fh, path_data, ipath.len, &off) != 0) {
+      goto err;
+    }
+    hdr.path_cnt++;
+  }
+
+  /* prefix tables */
+  IMAGE_WRITE_TABLE(fh, view, v4pfxs, hdr.v4pfxs, off, ret);
+  if (ret != 0) {
+    goto err;
+  }
+  IMAGE_WRITE_TABLE(fh, view, v6pfxs, hdr.v6pfxs, off, ret);
+  if (ret != 0) {
+    goto err;
+  }
+
+  /* pfx-peers, in bucket order */
+  if (image_align(fh, &off) != 0) {
+    goto err;
+  }
+  hdr.ids_off = off;
+  IMAGE_WRITE_CELLS(fh, view, v4pfxs, 1, off, ret);
+  if (ret == 0) {
+    IMAGE_WRITE_CELLS(fh, view, v6pfxs, 1, off, ret);
+  }
+  if (ret != 0) {
+    goto err;
+  }
+  hdr.cell_cnt = (off - hdr.ids_off) / sizeof(bgpstream_peer_id_t);
+  if (image_align(fh, &off) != 0) {
+    goto err;
+  }
+  hdr.infos_off = off;
+  IMAGE_WRITE_CELLS(fh, view, v4pfxs, 0, off, ret);
+  if (ret == 0) {
+    IMAGE_WRITE_CELLS(fh, view, v6pfxs, 0, off, ret);
+  }
+  if (ret != 0) {
+    goto err;
+  }
+  hdr.size = off;
+
+  if (fseek(fh, 0, SEEK_SET) != 0 ||
+      fwrite(&hdr, sizeof(hdr), 1, fh) != 1) {
+    goto err;
+  }
+
+  kh_destroy(bwv_pathid_set, paths);
+  return 0;
+
+err:
+  kh_destroy(bwv_pathid_set, paths);
+  return -1;
 }
 
-int bgpview_iter_pfx_remove_peer(bgpview_iter_t *iter)
+int bgpview_snapshot_save(bgpview_t *view, const char *filename)
 {
-  bwv_peerid_pfxinfo_t *pfxinfo = __pfx_peerinfos(iter);
+  bgpview_t *frozen = view;
+  char *tmpname = NULL;
+  FILE *fh = NULL;
 
-  /* if the pfx-peer is active, then we deactivate it first */
-  if (__iter_pfx_peer_get_state(iter) == BGPVIEW_FIELD_ACTIVE) {
-    bgpview_iter_pfx_deactivate_peer(iter);
+  /* the image is written from the flat layout of a frozen view */
+  if (view->frozen == 0 && (frozen = bgpview_freeze(view)) == NULL) {
+    goto err;
   }
 
-  assert(BWV_PFX_GET_PEER_STATE(iter->view, pfxinfo, iter->pfx_peer_it) ==
-         BGPVIEW_FIELD_INACTIVE);
+  /* write to a temporary file, and only replace an existing image once the
+     new one is complete */
+  if ((tmpname = malloc(strlen(filename) + sizeof(".tmp"))) == NULL) {
+    goto err;
+  }
+  sprintf(tmpname, "%s.tmp", filename);
+  if ((fh = fopen(tmpname, "w")) == NULL) {
+    fprintf(stderr, "ERROR: Could not open %s for writing\n", tmpname);
+    goto err;
+  }
 
-  /* now, simply set the state to invalid and reset the pfx counters */
-  // XXX view->need_gc_pfx_peers = 1;
-  BWV_PFX_SET_PEER_STATE(iter->view, pfxinfo, iter->pfx_peer_it,
-      BGPVIEW_FIELD_INVALID);
-  pfxinfo->peers_cnt[BGPVIEW_FIELD_INACTIVE]--;
+  if (image_write_view(fh, frozen) != 0) {
+    fprintf(stderr, "ERROR: Could not write snapshot image to %s\n", tmpname);
+    goto err;
+  }
+  if (fclose(fh) != 0) {
+    fh = NULL;
+    goto err;
+  }
+  fh = NULL;
+  if (rename(tmpname, filename) != 0) {
+    fprintf(stderr, "ERROR: Could not rename %s to %s\n", tmpname, filename);
+    goto err;
+  }
 
-  assert(__iter_has_more_peer(iter));
-  switch (iter->version_ptr) {
-  case BGPSTREAM_ADDR_VERSION_IPV4:
-    kh_value(iter->view->peerinfo, iter->peer_it)
-      .v4_pfx_cnt[BGPVIEW_FIELD_INACTIVE]--;
-    break;
+  free(tmpname);
+  if (frozen != view) {
+    bgpview_destroy(frozen);
+  }
+  return 0;
 
-  case BGPSTREAM_ADDR_VERSION_IPV6:
-    kh_value(iter->view->peerinfo, iter->peer_it)
-      .v6_pfx_cnt[BGPVIEW_FIELD_INACTIVE]--;
-    break;
+err:
+  fprintf(stderr, "ERROR: Could not save snapshot of view\n");
+  if (fh != NULL) {
+    fclose(fh);
+  }
+  if (tmpname != NULL) {
+    unlink(tmpname);
+    free(tmpname);
+  }
+  if (frozen != NULL && frozen != view) {
+    bgpview_destroy(frozen);
+  }
+  return -1;
+}
 
-  default:
+/* check that the len bytes at the given offset are within the image */
+#define IMAGE_IN_RANGE(hdr, off, len)                                          \
+  ((off) <= (hdr)->size && (len) <= (hdr)->size - (off))
+
+/* check that the sections of a prefix table are within the image */
+static int image_table_check(bwv_image_hdr_t *hdr, bwv_image_table_t *itab,
+                             uint32_t key_size)
+{
+  if (itab->n_buckets == 0) {
+    return itab->size == 0 ? 0 : -1;
+  }
+  if ((itab->n_buckets & (itab->n_buckets - 1)) != 0 ||
+      itab->size > itab->n_buckets || itab->n_occupied > itab->n_buckets ||
+      !IMAGE_IN_RANGE(hdr, itab->flags_off,
+                      (uint64_t)__ac_fsize(itab->n_buckets) *
+                        sizeof(khint32_t)) ||
+      !IMAGE_IN_RANGE(hdr, itab->keys_off,
+                      (uint64_t)itab->n_buckets * key_size) ||
+      !IMAGE_IN_RANGE(hdr, itab->cnts_off,
+                      (uint64_t)itab->size * sizeof(uint16_t))) {
     return -1;
   }
+  return 0;
+}
 
-  /* if there are no peers left in this pfx, the pfx should be removed */
-  if (pfxinfo->state != BGPVIEW_FIELD_INVALID &&
-      pfxinfo->peers_cnt[BGPVIEW_FIELD_INACTIVE] == 0 &&
-      pfxinfo->peers_cnt[BGPVIEW_FIELD_ACTIVE] == 0) {
-    return bgpview_iter_remove_pfx(iter);
+/* check the header of an image of the given size */
+static int image_hdr_check(bwv_image_hdr_t *hdr, uint64_t size)
+{
+  if (memcmp(hdr->magic, BWV_IMAGE_MAGIC, sizeof(BWV_IMAGE_MAGIC)) != 0) {
+    fprintf(stderr, "ERROR: Not a bgpview snapshot image\n");
+    return -1;
+  }
+  if (hdr->version != BWV_IMAGE_VERSION ||
+      hdr->byte_order != BWV_IMAGE_BYTE_ORDER ||
+      hdr->hdr_size != sizeof(bwv_image_hdr_t) ||
+      hdr->v4key_size != sizeof(((bgpview_t *)NULL)->v4pfxs->keys[0]) ||
+      hdr->v6key_size != sizeof(((bgpview_t *)NULL)->v6pfxs->keys[0]) ||
+      hdr->peer_size != sizeof(bwv_image_peer_t) ||
+      hdr->cell_size != sizeof(bwv_pfx_peerinfo_t)) {
+    fprintf(stderr, "ERROR: Snapshot image was written by an incompatible "
+                    "version or build of bgpview\n");
+    return -1;
+  }
+  if (hdr->size != size ||
+      hdr->cell_cnt > hdr->size / sizeof(bwv_pfx_peerinfo_t) ||
+      !IMAGE_IN_RANGE(hdr, hdr->peers_off,
+                      (uint64_t)hdr->peer_cnt * sizeof(bwv_image_peer_t)) ||
+      hdr->paths_off > hdr->size ||
+      !IMAGE_IN_RANGE(hdr, hdr->ids_off,
+                      hdr->cell_cnt * sizeof(bgpstream_peer_id_t)) ||
+      !IMAGE_IN_RANGE(hdr, hdr->infos_off,
+                      hdr->cell_cnt * sizeof(bwv_pfx_peerinfo_t)) ||
+      image_table_check(hdr, &hdr->v4pfxs, hdr->v4key_size) != 0 ||
+      image_table_check(hdr, &hdr->v6pfxs, hdr->v6key_size) != 0) {
+    fprintf(stderr, "ERROR: Snapshot image is truncated or corrupt\n");
+    return -1;
   }
-
   return 0;
 }
 
-/* ==================== ACTIVATE/DEACTIVATE ==================== */
-
-#define ACTIVATE_FIELD_CNT(field)                                              \
+/* point a prefix table of a mapped view at the flags and keys in the image,
+   and set up the prefix records of the table in the arena */
+#define IMAGE_MAP_TABLE(view, table, itab, ret)                                \
   do {                                                                         \
-    field[BGPVIEW_FIELD_INACTIVE]--;                                           \
-    field[BGPVIEW_FIELD_ACTIVE]++;                                             \
-  } while (0);
+    khiter_t k;                                                                \
+    uint16_t *cnts;                                                            \
+    uint32_t i = 0;                                                            \
+    (ret) = 0;                                                                 \
+    if ((itab).n_buckets == 0) {                                               \
+      break;                                                                   \
+    }                                                                          \
+    if (((view)->table->vals = malloc(sizeof(bwv_peerid_pfxinfo_t *) *         \
+                                      (itab).n_buckets)) == NULL) {            \
+      (ret) = -1;                                                              \
+      break;                                                                   \
+    }                                                                          \
+    (view)->table->flags = (khint32_t *)((view)->image + (itab).flags_off);    \
+    (view)->table->keys = (void *)((view)->image + (itab).keys_off);           \
+    (view)->table->n_buckets = (itab).n_buckets;                               \
+    (view)->table->size = (itab).size;                                         \
+    (view)->table->n_occupied = (itab).n_occupied;                             \
+    (view)->table->upper_bound = (itab).upper_bound;                           \
+    cnts = (uint16_t *)((view)->image + (itab).cnts_off);                      \
+    for (k = kh_begin((view)->table); k != kh_end((view)->table); ++k) {       \
+      if (!kh_exist((view)->table, k)) {                                       \
+        continue;                                                              \
+      }                                                                        \
+      if (i == (itab).size || cnts[i] > cell_cnt - cell_idx) {                 \
+        (ret) = -1;                                                            \
+        break;                                                                 \
+      }                                                                        \
+      frozen_pfxinfo_init((view), &pfxinfos[pfx_idx], &vecs[pfx_idx],          \
+                          &ids[cell_idx], &infos[cell_idx], cnts[i]);          \
+      kh_val((view)->table, k) = &pfxinfos[pfx_idx];                           \
+      cell_idx += cnts[i];                                                     \
+      pfx_idx++;                                                               \
+      i++;                                                                     \
+    }                                                                          \
+    if (i != (itab).size) {                                                    \
+      (ret) = -1;                                                              \
+    }                                                                          \
+  } while (0)
 
-#define DEACTIVATE_FIELD_CNT(field)                                            \
+/* check that a sample of the keys of a mapped prefix table are found where
+   they are (i.e. that the image was hashed like this build hashes) */
+#define IMAGE_CHECK_TABLE_HASH(view, table, name, ret)                         \
   do {                                                                         \
-    field[BGPVIEW_FIELD_INACTIVE]++;                                           \
-    field[BGPVIEW_FIELD_ACTIVE]--;                                             \
+    khiter_t k;                                                                \
+    khint_t step = kh_n_buckets((view)->table) / BWV_IMAGE_HASH_CHECKS;        \
+    (ret) = 0;                                                                 \
+    for (k = kh_begin((view)->table); k < kh_end((view)->table);               \
+         k += (step > 0) ? step : 1) {                                         \
+      if (kh_exist((view)->table, k) &&                                        \
+          kh_get(name, (view)->table, kh_key((view)->table, k)) != k) {        \
+        (ret) = -1;                                                            \
+        break;                                                                 \
+      }                                                                        \
+    }                                                                          \
   } while (0)
 
-int bgpview_iter_activate_peer(bgpview_iter_t *iter)
+bgpview_t *bgpview_snapshot_map(const char *filename)
 {
-  assert(__iter_has_more_peer(iter));
-  assert(__iter_peer_get_state(iter) > 0);
+  bgpview_t *view = NULL;
+  bwv_image_hdr_t hdr;
+  bwv_image_peer_t peer;
+  bwv_image_path_t ipath;
+  bgpstream_as_path_store_path_id_t pathid;
+  khash_t(bwv_pathid_map) *remap = NULL;
+  struct stat st;
+  void *image = MAP_FAILED;
+  bwv_pfx_peervec_t *vecs;
+  bwv_peerid_pfxinfo_t *pfxinfos;
+  bwv_pfx_peerinfo_t *infos;
+  bgpstream_peer_id_t *ids;
+  uint64_t pfx_cnt, pfx_idx = 0;
+  uint64_t cell_cnt, cell_idx = 0;
+  uint64_t off;
+  size_t pfxinfos_off;
+  khiter_t k;
+  uint32_t i;
+  int fd;
+  int ret;
 
-  if (__iter_peer_get_state(iter) != BGPVIEW_FIELD_INACTIVE) {
-    return 0;
+  if ((fd = open(filename, O_RDONLY)) < 0) {
+    fprintf(stderr, "ERROR: Could not open %s\n", filename);
+    goto err;
+  }
+  if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(hdr)) {
+    fprintf(stderr, "ERROR: %s is not a bgpview snapshot image\n", filename);
+    close(fd);
+    goto err;
+  }
+  /* the image is mapped copy-on-write so that AS path IDs can be fixed up in
+     place if needed */
+  image = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED) {
+    fprintf(stderr, "ERROR: Could not map %s\n", filename);
+    goto err;
+  }
+  memcpy(&hdr, image, sizeof(hdr));
+  if (image_hdr_check(&hdr, st.st_size) != 0) {
+    goto err;
+  }
+
+  if ((view = bgpview_create(NULL, NULL, NULL, NULL)) == NULL) {
+    goto err;
   }
+  view->image = image;
+  view->image_len = st.st_size;
+  image = MAP_FAILED;
 
-  kh_val(iter->view->peerinfo, iter->peer_it).state = BGPVIEW_FIELD_ACTIVE;
-  ACTIVATE_FIELD_CNT(iter->view->peerinfo_cnt);
-  return 1;
-}
-
-int bgpview_iter_deactivate_peer(bgpview_iter_t *iter)
-{
-  assert(__iter_has_more_peer(iter));
-  assert(__iter_peer_get_state(iter) > 0);
+  view->disable_extended = 1;
+  view->pfx_peer_layout = BGPVIEW_PFX_PEER_LAYOUT_VECTOR;
+  view->frozen = 1;
+  view->time = hdr.time;
+
+  /* peers keep their IDs */
+  for (i = 0; i < hdr.peer_cnt; i++) {
+    memcpy(&peer, view->image + hdr.peers_off + i * sizeof(peer),
+           sizeof(peer));
+    peer.sig.collector_str[BGPSTREAM_UTILS_STR_NAME_LEN - 1] = '\0';
+    if (bgpstream_peer_sig_map_set(view->peersigns, peer.id,
+                                   peer.sig.collector_str,
+                                   &peer.sig.peer_ip_addr,
+                                   peer.sig.peer_asnumber) != 0) {
+      goto err;
+    }
+    k = kh_put(bwv_peerid_peerinfo, view->peerinfo, peer.id, &ret);
+    if (ret < 0) {
+      goto err;
+    }
+    memset(&kh_val(view->peerinfo, k), 0, sizeof(bwv_peerinfo_t));
+    memcpy(kh_val(view->peerinfo, k).v4_pfx_cnt, peer.v4_pfx_cnt,
+           sizeof(peer.v4_pfx_cnt));
+    memcpy(kh_val(view->peerinfo, k).v6_pfx_cnt, peer.v6_pfx_cnt,
+           sizeof(peer.v6_pfx_cnt));
+    kh_val(view->peerinfo, k).state = BGPVIEW_FIELD_ACTIVE;
+    kh_val(view->peerinfo, k).epoch = view->epoch;
+    view->peerinfo_cnt[BGPVIEW_FIELD_ACTIVE]++;
+  }
 
-  bgpview_iter_t *lit;
-  bgpstream_peer_id_t current_id;
+  /* AS paths are re-interned, which normally gives them back their IDs */
+  off = hdr.paths_off;
+  for (i = 0; i < hdr.path_cnt; i++) {
+    if (!IMAGE_IN_RANGE(&hdr, off, sizeof(ipath))) {
+      goto corrupt;
+    }
+    memcpy(&ipath, view->image + off, sizeof(ipath));
+    off += sizeof(ipath);
+    if (!IMAGE_IN_RANGE(&hdr, off, ipath.len)) {
+      goto corrupt;
+    }
+    if (bgpstream_as_path_store_insert_path(view->pathstore,
+                                            view->image + off, ipath.len,
+                                            ipath.is_core, &pathid) != 0) {
+      goto err;
+    }
+    off += ipath.len;
+    if (BWV_PATHID_KEY(pathid) == BWV_PATHID_KEY(ipath.id)) {
+      continue;
+    }
+    if (remap == NULL && (remap = kh_init(bwv_pathid_map)) == NULL) {
+      goto err;
+    }
+    k = kh_put(bwv_pathid_map, remap, BWV_PATHID_KEY(ipath.id), &ret);
+    if (ret < 0) {
+      goto err;
+    }
+    kh_val(remap, k) = pathid;
+  }
 
-  if (__iter_peer_get_state(iter) != BGPVIEW_FIELD_ACTIVE) {
-    return 0;
+  /* prefix records and pfx-peer vectors are the only per-prefix state that
+     is allocated, the pfx-peers themselves stay in the image */
+  pfx_cnt = (uint64_t)hdr.v4pfxs.size + hdr.v6pfxs.size;
+  cell_cnt = hdr.cell_cnt;
+  pfxinfos_off = BWV_ALIGN8(pfx_cnt * sizeof(bwv_pfx_peervec_t));
+  if ((view->frozen_arena = malloc(
+         pfxinfos_off + pfx_cnt * sizeof(bwv_peerid_pfxinfo_t) + 1)) ==
+      NULL) {
+    goto err;
+  }
+  vecs = view->frozen_arena;
+  pfxinfos = (bwv_peerid_pfxinfo_t *)((uint8_t *)view->frozen_arena +
+                                      pfxinfos_off);
+  ids = (bgpstream_peer_id_t *)(view->image + hdr.ids_off);
+  infos = (bwv_pfx_peerinfo_t *)(view->image + hdr.infos_off);
+
+  IMAGE_MAP_TABLE(view, v4pfxs, hdr.v4pfxs, ret);
+  if (ret != 0) {
+    goto corrupt;
+  }
+  IMAGE_MAP_TABLE(view, v6pfxs, hdr.v6pfxs, ret);
+  if (ret != 0 || cell_idx != cell_cnt) {
+    goto corrupt;
   }
+  view->v4pfxs_cnt[BGPVIEW_FIELD_ACTIVE] = hdr.v4pfxs.size;
+  view->v6pfxs_cnt[BGPVIEW_FIELD_ACTIVE] = hdr.v6pfxs.size;
 
-  /* only do the massive work of deactivating all pfx-peers if this peer has any
-     active pfxs */
-  if (__iter_peer_get_pfx_cnt(iter, 0, BGPVIEW_FIELD_ACTIVE) > 0) {
-    lit = bgpview_iter_create(iter->view);
-    assert(lit != NULL);
-    current_id = __iter_peer_get_peer_id(iter);
+  IMAGE_CHECK_TABLE_HASH(view, v4pfxs, bwv_v4pfx_peerid_pfxinfo, ret);
+  if (ret == 0) {
+    IMAGE_CHECK_TABLE_HASH(view, v6pfxs, bwv_v6pfx_peerid_pfxinfo, ret);
+  }
+  if (ret != 0) {
+    fprintf(stderr, "ERROR: Snapshot image was written by an incompatible "
+                    "version or build of bgpview\n");
+    goto err;
+  }
 
-    bgpview_iter_first_pfx_peer(lit, 0, BGPVIEW_FIELD_ACTIVE,
-                                BGPVIEW_FIELD_ACTIVE);
-    while (__iter_has_more_pfx_peer(lit)) {
-      // deactivate all the peer-pfx associated with the peer
-      if (__iter_peer_get_peer_id(lit) == current_id) {
-        bgpview_iter_pfx_deactivate_peer(lit);
+  /* only if the store gave some paths different IDs do the pfx-peers need to
+     be touched (which copies the pages they are in) */
+  if (remap != NULL) {
+    for (cell_idx = 0; cell_idx < cell_cnt; cell_idx++) {
+      if ((k = kh_get(bwv_pathid_map, remap,
+                      BWV_PATHID_KEY(infos[cell_idx].as_path_id))) !=
+          kh_end(remap)) {
+        infos[cell_idx].as_path_id = kh_val(remap, k);
       }
-      __iter_next_pfx_peer(lit);
     }
-    bgpview_iter_destroy(lit);
+    kh_destroy(bwv_pathid_map, remap);
   }
 
-  /* mark as inactive */
-  kh_val(iter->view->peerinfo, iter->peer_it).state = BGPVIEW_FIELD_INACTIVE;
+  return view;
 
-  /* update the counters */
-  DEACTIVATE_FIELD_CNT(iter->view->peerinfo_cnt);
+corrupt:
+  fprintf(stderr, "ERROR: Snapshot image is truncated or corrupt\n");
+err:
+  fprintf(stderr, "ERROR: Could not map snapshot image %s\n", filename);
+  if (image != MAP_FAILED) {
+    munmap(image, st.st_size);
+  }
+  if (remap != NULL) {
+    kh_destroy(bwv_pathid_map, remap);
+  }
+  bgpview_destroy(view);
+  return NULL;
+}
 
-  return 1;
+void bgpview_disable_user_data(bgpview_t *view)
+{
+  /* the user can't be wanting to destroy pfx-peer user data... */
+  assert(view->pfx_peer_user_destructor == NULL);
+  /* nor can they have any prefixes... */
+  assert(bgpview_pfx_cnt(view, BGPVIEW_FIELD_ALL_VALID) == 0);
+
+  /* the size of pfx-peer vectors depends on the pfx-peer info size, so any
+     (necessarily empty) vector slabs must be re-created */
+  assert(view->alloc->refcnt == 1);
+  peervec_slabs_destroy(view);
+
+  view->disable_extended = 1;
 }
 
-static inline int activate_pfx(bgpview_iter_t *iter)
+void bgpview_set_pfx_peer_layout(bgpview_t *view,
+                                 bgpview_pfx_peer_layout_t layout)
 {
-  bwv_peerid_pfxinfo_t *pfxinfo = __pfx_peerinfos(iter);
+  /* the layout can only be changed while the view has no prefixes */
+  assert(bgpview_pfx_cnt(view, BGPVIEW_FIELD_ALL_VALID) == 0);
+  assert(kh_size(view->v4pfxs) == 0 && kh_size(view->v6pfxs) == 0);
 
-  assert(pfxinfo->state > 0);
-  if (pfxinfo->state != BGPVIEW_FIELD_INACTIVE) {
+  view->pfx_peer_layout = layout;
+}
+
+bgpview_pfx_peer_layout_t bgpview_get_pfx_peer_layout(bgpview_t *view)
+{
+  return view->pfx_peer_layout;
+}
+
+int bgpview_enable_journal(bgpview_t *view)
+{
+  if (view->journal != NULL) {
     return 0;
   }
 
-  pfxinfo->state = BGPVIEW_FIELD_ACTIVE;
+  if ((view->journal = malloc_zero(sizeof(bwv_journal_t))) == NULL ||
+      (view->journal->v4pfxs = kh_init(bwv_v4pfx_journal)) == NULL ||
+      (view->journal->v6pfxs = kh_init(bwv_v6pfx_journal)) == NULL ||
+      (view->journal->peers = kh_init(bwv_peerid_journal)) == NULL) {
+    fprintf(stderr, "ERROR: Could not create change journal\n");
+    journal_destroy(view->journal);
+    view->journal = NULL;
+    return -1;
+  }
+  view->journal->complete = 1;
 
-  switch (iter->version_ptr) {
-  case BGPSTREAM_ADDR_VERSION_IPV4:
-    ACTIVATE_FIELD_CNT(iter->view->v4pfxs_cnt);
-    break;
+  return 0;
+}
 
-  case BGPSTREAM_ADDR_VERSION_IPV6:
-    ACTIVATE_FIELD_CNT(iter->view->v6pfxs_cnt);
-    break;
+void bgpview_disable_journal(bgpview_t *view)
+{
+  journal_destroy(view->journal);
+  view->journal = NULL;
+}
 
-  default:
-    return -1;
+void bgpview_journal_mark(bgpview_t *view)
+{
+  if (view->journal != NULL) {
+    journal_reset(view->journal);
   }
+}
 
-  return 1;
+int bgpview_journal_is_complete(bgpview_t *view)
+{
+  return view->journal != NULL && view->journal->complete;
 }
 
-int bgpview_iter_deactivate_pfx(bgpview_iter_t *iter)
+int bgpview_enable_origin_index(bgpview_t *view)
 {
-  bwv_peerid_pfxinfo_t *pfxinfo = __pfx_peerinfos(iter);
-  bgpview_iter_t ti = *iter;
+  bwv_origin_index_t *index;
 
-  assert(pfxinfo->state > 0);
-  if (pfxinfo->state != BGPVIEW_FIELD_ACTIVE) {
+  if (view->origin_index != NULL) {
     return 0;
   }
 
-  /* now mark the pfx as inactive */
-  pfxinfo->state = BGPVIEW_FIELD_INACTIVE;
-
-  /* deactivate all pfx-peers for this prefix */
-  __iter_pfx_first_peer(&ti, BGPVIEW_FIELD_ACTIVE);
-  while (__iter_pfx_has_more_peer(&ti)) {
-    bgpview_iter_pfx_deactivate_peer(&ti);
-    __iter_pfx_next_peer(&ti);
+  if ((index = malloc_zero(sizeof(bwv_origin_index_t))) == NULL ||
+      (index->v4pfxs = kh_init(bwv_v4pfx_origins)) == NULL ||
+      (index->v6pfxs = kh_init(bwv_v6pfx_origins)) == NULL ||
+      (index->origins = kh_init(bwv_origin_pfxs)) == NULL ||
+      (index->v4moas = kh_init(bwv_v4pfx_set)) == NULL ||
+      (index->v6moas = kh_init(bwv_v6pfx_set)) == NULL) {
+    fprintf(stderr, "ERROR: Could not create origin index\n");
+    origin_index_destroy(index);
+    return -1;
   }
+  view->origin_index = index;
 
-  /* now update the counters */
-  switch (iter->version_ptr) {
-  case BGPSTREAM_ADDR_VERSION_IPV4:
-    DEACTIVATE_FIELD_CNT(iter->view->v4pfxs_cnt);
-    break;
-
-  case BGPSTREAM_ADDR_VERSION_IPV6:
-    DEACTIVATE_FIELD_CNT(iter->view->v6pfxs_cnt);
-    break;
-
-  default:
+  if (origin_index_build(view) != 0) {
+    fprintf(stderr, "ERROR: Could not build origin index\n");
+    bgpview_disable_origin_index(view);
     return -1;
   }
 
-  return 1;
+  return 0;
 }
 
-int bgpview_iter_pfx_activate_peer(bgpview_iter_t *iter)
+void bgpview_disable_origin_index(bgpview_t *view)
 {
-  bwv_peerid_pfxinfo_t *pfxinfo = __pfx_peerinfos(iter);
+  origin_index_destroy(view->origin_index);
+  view->origin_index = NULL;
+}
 
-  assert(__iter_pfx_has_more_peer(iter));
+int bgpview_enable_lpm_index(bgpview_t *view)
+{
+  bwv_lpm_index_t *lpm;
 
-  assert(BWV_PFX_GET_PEER_STATE(iter->view, pfxinfo, iter->pfx_peer_it) > 0);
-  if (BWV_PFX_GET_PEER_STATE(iter->view, pfxinfo, iter->pfx_peer_it) !=
-      BGPVIEW_FIELD_INACTIVE) {
+  if (view->lpm_index != NULL) {
     return 0;
   }
 
-  /* update the number of peers that observe this pfx */
-  ACTIVATE_FIELD_CNT(pfxinfo->peers_cnt);
-
-  /* this is the first active peer, so pfx must be activated */
-  if (pfxinfo->peers_cnt[BGPVIEW_FIELD_ACTIVE] == 1) {
-    activate_pfx(iter);
+  if ((lpm = malloc_zero(sizeof(bwv_lpm_index_t))) == NULL ||
+      (lpm->v4tbl = malloc((1 << 24) * sizeof(uint8_t))) == NULL ||
+      (lpm->v4groups = kh_init(bwv_lpm_v4groups)) == NULL) {
+    fprintf(stderr, "ERROR: Could not create LPM index\n");
+    lpm_index_destroy(lpm);
+    return -1;
   }
+  view->lpm_index = lpm;
 
-  /* the peer MUST be active */
-  assert(__iter_peer_get_state(iter) == BGPVIEW_FIELD_ACTIVE);
-
-  // increment the number of prefixes observed by the peer
-  switch (iter->version_ptr) {
-  case BGPSTREAM_ADDR_VERSION_IPV4:
-    ACTIVATE_FIELD_CNT(
-      kh_value(iter->view->peerinfo, iter->peer_it).v4_pfx_cnt);
-    break;
-  case BGPSTREAM_ADDR_VERSION_IPV6:
-    ACTIVATE_FIELD_CNT(
-      kh_value(iter->view->peerinfo, iter->peer_it).v6_pfx_cnt);
-    break;
-  default:
+  if (lpm_index_build(view) != 0) {
+    fprintf(stderr, "ERROR: Could not build LPM index\n");
+    bgpview_disable_lpm_index(view);
     return -1;
   }
 
-  BWV_PFX_SET_PEER_STATE(iter->view, pfxinfo, iter->pfx_peer_it,
-      BGPVIEW_FIELD_ACTIVE);
-
-  return 1;
+  return 0;
 }
 
-int bgpview_iter_pfx_deactivate_peer(bgpview_iter_t *iter)
+void bgpview_disable_lpm_index(bgpview_t *view)
 {
-  bwv_peerid_pfxinfo_t *pfxinfo = __pfx_peerinfos(iter);
+  lpm_index_destroy(view->lpm_index);
+  view->lpm_index = NULL;
+}
 
-  assert(__iter_pfx_has_more_peer(iter));
+int bgpview_enable_peer_index(bgpview_t *view)
+{
+  bwv_peer_index_t *index;
 
-  assert(BWV_PFX_GET_PEER_STATE(iter->view, pfxinfo, iter->pfx_peer_it) > 0);
-  if (BWV_PFX_GET_PEER_STATE(iter->view, pfxinfo, iter->pfx_peer_it) !=
-      BGPVIEW_FIELD_ACTIVE) {
+  if (view->peer_index != NULL) {
     return 0;
   }
 
-  /* set the state to inactive */
-  BWV_PFX_SET_PEER_STATE(iter->view, pfxinfo, iter->pfx_peer_it,
-      BGPVIEW_FIELD_INACTIVE);
-
-  /* update the number of peers that observe the pfx */
-  DEACTIVATE_FIELD_CNT(pfxinfo->peers_cnt);
-  if (pfxinfo->peers_cnt[BGPVIEW_FIELD_ACTIVE] == 0) {
-    bgpview_iter_deactivate_pfx(iter);
+  if ((index = malloc_zero(sizeof(bwv_peer_index_t))) == NULL) {
+    fprintf(stderr, "ERROR: Could not create peer index\n");
+    return -1;
   }
+  view->peer_index = index;
 
-  // decrement the number of pfxs observed by the peer
-  switch (iter->version_ptr) {
-  case BGPSTREAM_ADDR_VERSION_IPV4:
-    DEACTIVATE_FIELD_CNT(
-      kh_value(iter->view->peerinfo, iter->peer_it).v4_pfx_cnt);
-    break;
-  case BGPSTREAM_ADDR_VERSION_IPV6:
-    DEACTIVATE_FIELD_CNT(
-      kh_value(iter->view->peerinfo, iter->peer_it).v6_pfx_cnt);
-    break;
-  default:
+  if (peer_index_build(view) != 0) {
+    fprintf(stderr, "ERROR: Could not build peer index\n");
+    bgpview_disable_peer_index(view);
     return -1;
   }
 
-  return 1;
+  return 0;
 }
 
-/* ========== PUBLIC FUNCTIONS ========== */
-
-bgpview_t *
-bgpview_create_shared(bgpstream_peer_sig_map_t *peersigns,
-                      bgpstream_as_path_store_t *pathstore,
-                      bgpview_destroy_user_t *bwv_user_destructor,
-                      bgpview_destroy_user_t *bwv_peer_user_destructor,
-                      bgpview_destroy_user_t *bwv_pfx_user_destructor,
-                      bgpview_destroy_user_t *bwv_pfx_peer_user_destructor)
+void bgpview_disable_peer_index(bgpview_t *view)
 {
-  bgpview_t *view;
-  struct timeval time_created;
+  peer_index_destroy(view->peer_index);
+  view->peer_index = NULL;
+}
 
-  if ((view = malloc_zero(sizeof(bgpview_t))) == NULL) {
-    return NULL;
-  }
+static void alloc_stats_add_slab(bgpview_alloc_stats_t *stats,
+                                 bgpview_slab_t *slab, uint64_t *used_cnt,
+                                 uint64_t *high_water_cnt)
+{
+  bgpview_slab_stats_t ss;
 
-  if ((view->v4pfxs = kh_init(bwv_v4pfx_peerid_pfxinfo)) == NULL) {
-    goto err;
+  if (slab == NULL) {
+    return;
   }
+  bgpview_slab_get_stats(slab, &ss);
+
+  *used_cnt += ss.used_cnt;
+  *high_water_cnt += ss.high_water_cnt;
+  stats->chunk_bytes += ss.chunk_bytes;
+  stats->used_bytes += ss.used_cnt * ss.obj_size;
+  stats->free_bytes += ss.free_cnt * ss.obj_size;
+  stats->high_water_bytes += ss.high_water_cnt * ss.obj_size;
+}
 
-  if ((view->v6pfxs = kh_init(bwv_v6pfx_peerid_pfxinfo)) == NULL) {
-    goto err;
-  }
+void bgpview_get_alloc_stats(bgpview_t *view, bgpview_alloc_stats_t *stats)
+{
+  int c;
 
-  if (peersigns != NULL) {
-    view->peersigns_shared = 1;
-    view->peersigns = peersigns;
-  } else {
-    if ((view->peersigns = bgpstream_peer_sig_map_create()) == NULL) {
-      fprintf(stderr, "Failed to create peersigns table\n");
-      goto err;
-    }
-    view->peersigns_shared = 0;
-  }
+  memset(stats, 0, sizeof(bgpview_alloc_stats_t));
 
-  if (pathstore != NULL) {
-    view->pathstore_shared = 1;
-    view->pathstore = pathstore;
-  } else {
-    if ((view->pathstore = bgpstream_as_path_store_create()) == NULL) {
-      fprintf(stderr, "Failed to create AS Path Store\n");
-      goto err;
-    }
-    view->pathstore_shared = 0;
+  alloc_stats_add_slab(stats, view->alloc->pfxinfo_slab,
+                       &stats->pfxinfo_used_cnt,
+                       &stats->pfxinfo_high_water_cnt);
+  for (c = 0; c < BWV_PEERVEC_SLAB_CLASSES; c++) {
+    alloc_stats_add_slab(stats, view->alloc->peervec_slabs[c],
+                         &stats->peervec_used_cnt,
+                         &stats->peervec_high_water_cnt);
   }
 
-  if ((view->peerinfo = kh_init(bwv_peerid_peerinfo)) == NULL) {
-    fprintf(stderr, "Failed to create peer info table\n");
-    goto err;
+  if (stats->chunk_bytes > 0) {
+    stats->fragmentation =
+      1.0 - ((double)stats->used_bytes / (double)stats->chunk_bytes);
   }
+}
 
-  gettimeofday(&time_created, NULL);
-  view->time_created = time_created.tv_sec;
-
-  view->user_destructor = bwv_user_destructor;
-  view->peer_user_destructor = bwv_peer_user_destructor;
-  view->pfx_user_destructor = bwv_pfx_user_destructor;
-  view->pfx_peer_user_destructor = bwv_pfx_peer_user_destructor;
-
-  /* all other fields are memset to 0 */
-
-  return view;
+/* approximate number of bytes used by a khash table (keys, values and
+   flags) */
+#define BWV_KH_BYTES(h, key_size, val_size)                                    \
+  ((uint64_t)kh_n_buckets(h) * ((key_size) + (val_size)) +                     \
+   (kh_n_buckets(h) / 4))
 
-err:
-  fprintf(stderr, "Failed to create BGPView\n");
-  bgpview_destroy(view);
-  return NULL;
-}
+#define MEM_TABLE_SET(ts, h, key_size, val_size)                               \
+  do {                                                                         \
+    (ts).bytes = BWV_KH_BYTES(h, key_size, val_size);                          \
+    (ts).entries = kh_size(h);                                                 \
+    (ts).slots = kh_n_buckets(h);                                              \
+  } while (0)
 
-bgpview_t *bgpview_create(bgpview_destroy_user_t *bwv_user_destructor,
-                          bgpview_destroy_user_t *bwv_peer_user_destructor,
-                          bgpview_destroy_user_t *bwv_pfx_user_destructor,
-                          bgpview_destroy_user_t *bwv_pfx_peer_user_destructor)
-{
-  return bgpview_create_shared(
-    NULL, NULL, bwv_user_destructor, bwv_peer_user_destructor,
-    bwv_pfx_user_destructor, bwv_pfx_peer_user_destructor);
-}
+#define MEM_TABLE_LOAD(ts)                                                     \
+  do {                                                                         \
+    (ts).load_factor =                                                         \
+      ((ts).slots > 0) ? ((double)(ts).entries / (double)(ts).slots) : 0;      \
+  } while (0)
 
-void bgpview_destroy(bgpview_t *view)
+/* add the record of a prefix and its pfx-peers to the stats */
+static void mem_stats_add_pfx(bgpview_t *view, bwv_peerid_pfxinfo_t *v,
+                              bgpview_mem_stats_t *stats)
 {
-  if (view == NULL) {
+  khiter_t k;
+
+  stats->pfx_peers.bytes += peerid_pfxinfo_bytes(view, v);
+  stats->pfxs_shared_cnt += (v->refcnt > 1);
+  stats->pfx_user_cnt += (v->user != NULL);
+
+  if (v->peers_generic == NULL) {
     return;
   }
 
-  khiter_t k;
-
-  if (view->v4pfxs != NULL) {
-    for (k = kh_begin(view->v4pfxs); k != kh_end(view->v4pfxs); ++k) {
-      if (kh_exist(view->v4pfxs, k)) {
-        peerid_pfxinfo_destroy(view, kh_value(view->v4pfxs, k));
+  if (BWV_PFX_PEERS_ARE_VEC(view)) {
+    stats->pfx_peers.entries += v->peers_vec->size;
+    stats->pfx_peers.slots += v->peers_vec->alloc;
+    if (view->disable_extended == 0) {
+      for (k = 0; k < v->peers_vec->size; k++) {
+        stats->pfx_peer_user_cnt +=
+          (BWV_PFX_GET_PEER_EXT_PTR(view, v, k)->user != NULL);
       }
     }
-    kh_destroy(bwv_v4pfx_peerid_pfxinfo, view->v4pfxs);
-    view->v4pfxs = NULL;
-  }
-
-  if (view->v6pfxs != NULL) {
-    for (k = kh_begin(view->v6pfxs); k != kh_end(view->v6pfxs); ++k) {
-      if (kh_exist(view->v6pfxs, k)) {
-        peerid_pfxinfo_destroy(view, kh_value(view->v6pfxs, k));
+  } else if (view->disable_extended) {
+    stats->pfx_peers.entries += kh_size(v->peers_min);
+    stats->pfx_peers.slots += kh_n_buckets(v->peers_min);
+  } else {
+    stats->pfx_peers.entries += kh_size(v->peers_ext);
+    stats->pfx_peers.slots += kh_n_buckets(v->peers_ext);
+    for (k = kh_begin(v->peers_ext); k < kh_end(v->peers_ext); k++) {
+      if (kh_exist(v->peers_ext, k)) {
+        stats->pfx_peer_user_cnt += (kh_val(v->peers_ext, k).user != NULL);
       }
     }
-    kh_destroy(bwv_v6pfx_peerid_pfxinfo, view->v6pfxs);
-    view->v6pfxs = NULL;
   }
+}
 
-  if (view->peersigns_shared == 0 && view->peersigns != NULL) {
-    bgpstream_peer_sig_map_destroy(view->peersigns);
-    view->peersigns = NULL;
-  }
+void bgpview_get_mem_stats(bgpview_t *view, bgpview_mem_stats_t *stats)
+{
+  bgpstream_as_path_store_t *ps = view->pathstore;
+  bgpstream_as_path_t *path;
+  uint8_t *path_data;
+  khiter_t k;
 
-  if (view->pathstore_shared == 0 && view->pathstore != NULL) {
-    bgpstream_as_path_store_destroy(view->pathstore);
-    view->pathstore = NULL;
+  memset(stats, 0, sizeof(bgpview_mem_stats_t));
+
+  /* prefix tables */
+  MEM_TABLE_SET(stats->v4pfxs, view->v4pfxs, sizeof(bwv_v4pfx_key_t),
+                sizeof(bwv_peerid_pfxinfo_t *));
+  stats->v4pfxs.bytes += view->v4pfxs_index.alloc_cnt *
+                         (sizeof(khiter_t) + sizeof(bwv_v4pfx_key_t));
+  MEM_TABLE_SET(stats->v6pfxs, view->v6pfxs, sizeof(bgpstream_ipv6_pfx_t),
+                sizeof(bwv_peerid_pfxinfo_t *));
+  stats->v6pfxs.bytes += view->v6pfxs_index.alloc_cnt *
+                         (sizeof(khiter_t) + sizeof(bgpstream_ipv6_pfx_t));
+
+  /* prefix records and pfx-peers */
+  for (k = kh_begin(view->v4pfxs); k < kh_end(view->v4pfxs); k++) {
+    if (kh_exist(view->v4pfxs, k)) {
+      mem_stats_add_pfx(view, kh_val(view->v4pfxs, k), stats);
+    }
   }
-
-  if (view->peerinfo != NULL) {
-    peerinfo_destroy_user(view);
-    kh_destroy(bwv_peerid_peerinfo, view->peerinfo);
-    view->peerinfo = NULL;
+  for (k = kh_begin(view->v6pfxs); k < kh_end(view->v6pfxs); k++) {
+    if (kh_exist(view->v6pfxs, k)) {
+      mem_stats_add_pfx(view, kh_val(view->v6pfxs, k), stats);
+    }
   }
 
-  if (view->user != NULL) {
-    if (view->user_destructor != NULL) {
-      view->user_destructor(view->user);
+  /* peers */
+  MEM_TABLE_SET(stats->peers, view->peerinfo, sizeof(bgpstream_peer_id_t),
+                sizeof(bwv_peerinfo_t));
+  for (k = kh_begin(view->peerinfo); k < kh_end(view->peerinfo); k++) {
+    if (kh_exist(view->peerinfo, k)) {
+      stats->peer_user_cnt += (kh_val(view->peerinfo, k).user != NULL);
     }
-    view->user = NULL;
   }
 
-  free(view);
+  stats->peer_index_bytes = peer_index_bytes(view->peer_index);
+
+  stats->view_bytes = stats->v4pfxs.bytes + stats->v6pfxs.bytes +
+                      stats->pfx_peers.bytes + stats->peers.bytes +
+                      stats->peer_index_bytes;
+
+  /* AS path store */
+  for (bgpstream_as_path_store_iter_first_path(ps);
+       bgpstream_as_path_store_iter_has_more_path(ps);
+       bgpstream_as_path_store_iter_next_path(ps)) {
+    path = bgpstream_as_path_store_path_get_int_path(
+      bgpstream_as_path_store_iter_get_path(ps));
+    stats->pathstore.bytes += bgpstream_as_path_get_data(path, &path_data);
+    stats->pathstore.entries++;
+  }
+
+  /* peer signatures (each is indexed both by ID and by signature) */
+  stats->peersigns.entries = bgpstream_peer_sig_map_get_size(view->peersigns);
+  stats->peersigns.bytes =
+    stats->peersigns.entries *
+    (sizeof(bgpstream_peer_sig_t) +
+     2 * (sizeof(bgpstream_peer_id_t) + sizeof(bgpstream_peer_sig_t *)));
+
+  MEM_TABLE_LOAD(stats->v4pfxs);
+  MEM_TABLE_LOAD(stats->v6pfxs);
+  MEM_TABLE_LOAD(stats->pfx_peers);
+  MEM_TABLE_LOAD(stats->peers);
 }
 
-void bgpview_clear(bgpview_t *view)
-{
-  struct timeval time_created;
-  bwv_peerid_pfxinfo_t *pfxinfo;
-  bgpview_iter_t *lit = bgpview_iter_create(view);
-  assert(lit != NULL);
+/* ==================== VIEW DIFF ==================== */
 
-  view->time = 0;
+/** State of a diff between two views */
+typedef struct bwv_diff {
 
-  gettimeofday(&time_created, NULL);
-  view->time_created = time_created.tv_sec;
+  /** Iterator into the old view */
+  bgpview_iter_t *old_it;
 
-  /* mark all prefixes as invalid */
-  bgpview_iter_first_pfx(lit, 0, BGPVIEW_FIELD_ALL_VALID);
-  while (__iter_has_more_pfx(lit)) {
-    pfxinfo = __pfx_peerinfos(lit);
-    pfxinfo->peers_cnt[BGPVIEW_FIELD_INACTIVE] = 0;
-    pfxinfo->peers_cnt[BGPVIEW_FIELD_ACTIVE] = 0;
-    pfxinfo->state = BGPVIEW_FIELD_INVALID;
-    if (view->disable_extended) {
-      kh_clear(bwv_peerid_pfx_peerinfo, pfxinfo->peers_min);
-    } else {
-      kh_clear(bwv_peerid_pfx_peerinfo_ext, pfxinfo->peers_ext);
-    }
-    __iter_next_pfx(lit);
+  /** Iterator into the new view */
+  bgpview_iter_t *new_it;
+
+  /** Callbacks to invoke for each difference */
+  bgpview_diff_cbs_t *cbs;
+
+  /** Filter callback (may be NULL) */
+  bgpview_io_filter_cb_t *filter;
+
+  /** User pointer passed to the callbacks and the filter */
+  void *user;
+
+  /** Do the views share an AS path store? (i.e., can paths be compared by
+      ID) */
+  int same_pathstore;
+
+} bwv_diff_t;
+
+/* get the peer ID of the current pfx-peer, without looking up the peer */
+#define __iter_pfx_peer_get_peer_id(iter)                                      \
+  (BWV_PFX_PEERS_ARE_VEC((iter)->view)                                         \
+     ? __pfx_peerinfos(iter)->peers_vec->ids[(iter)->pfx_peer_it]              \
+     : (iter)->view->disable_extended                                          \
+         ? kh_key(__pfx_peerinfos(iter)->peers_min, (iter)->pfx_peer_it)       \
+         : kh_key(__pfx_peerinfos(iter)->peers_ext, (iter)->pfx_peer_it))
+
+/* invoke a diff callback (if set), jumping to err if it fails */
+#define DIFF_CB(diff, name)                                                    \
+  do {                                                                         \
+    if ((diff)->cbs->name != NULL &&                                           \
+        (diff)->cbs->name((diff)->old_it, (diff)->new_it, (diff)->user) !=     \
+          0) {                                                                 \
+      goto err;                                                                \
+    }                                                                          \
+  } while (0)
+
+static int diff_filter(bwv_diff_t *diff, bgpview_iter_t *it,
+                       bgpview_io_filter_type_t type)
+{
+  if (diff->filter == NULL) {
+    return 1;
   }
-  view->need_gc_v4pfxs = (kh_size(view->v4pfxs) > 0);
-  view->need_gc_v6pfxs = (kh_size(view->v6pfxs) > 0);
-  view->v4pfxs_cnt[BGPVIEW_FIELD_INACTIVE] = 0;
-  view->v4pfxs_cnt[BGPVIEW_FIELD_ACTIVE] = 0;
-  view->v6pfxs_cnt[BGPVIEW_FIELD_INACTIVE] = 0;
-  view->v6pfxs_cnt[BGPVIEW_FIELD_ACTIVE] = 0;
+  return diff->filter(it, type, diff->user);
+}
 
-  /* clear out the peerinfo table */
-  __iter_first_peer(lit, BGPVIEW_FIELD_ALL_VALID);
-  while (__iter_has_more_peer(lit)) {
-    peerinfo_reset(&kh_value(view->peerinfo, lit->peer_it));
-    __iter_next_peer(lit);
+/* returns 1 if the paths of the current pfx-peers differ, 0 if they are the
+   same, and -1 if an error occurred */
+static int diff_pfx_peer_paths(bwv_diff_t *diff)
+{
+  bgpstream_as_path_store_path_id_t old_id =
+    __iter_pfx_peer_get_as_path_store_path_id(diff->old_it);
+  bgpstream_as_path_store_path_id_t new_id =
+    __iter_pfx_peer_get_as_path_store_path_id(diff->new_it);
+  bgpstream_as_path_t *old_path = NULL;
+  bgpstream_as_path_t *new_path = NULL;
+  int ret = -1;
+
+  if (diff->same_pathstore) {
+    return memcmp(&old_id, &new_id, sizeof(old_id)) != 0;
   }
-  view->need_gc_peerinfo = (kh_size(view->peerinfo) > 0);
-  view->peerinfo_cnt[BGPVIEW_FIELD_INACTIVE] = 0;
-  view->peerinfo_cnt[BGPVIEW_FIELD_ACTIVE] = 0;
 
-  bgpview_iter_destroy(lit);
+  if ((old_path = __iter_pfx_peer_get_as_path(diff->old_it)) == NULL ||
+      (new_path = __iter_pfx_peer_get_as_path(diff->new_it)) == NULL) {
+    goto done;
+  }
+  ret = bgpstream_as_path_equal(old_path, new_path) == 0;
+
+done:
+  bgpstream_as_path_destroy(old_path);
+  bgpstream_as_path_destroy(new_path);
+  return ret;
 }
 
-void bgpview_gc(bgpview_t *view)
+/* diff a pfx-peer that is in both views. both iterators must refer to the
+   pfx-peer. if shared is set, the pfx-peers are known to be identical */
+static int diff_common_pfx_peer(bwv_diff_t *diff, int shared, int *changes)
 {
-  khiter_t k;
+  int old_ok, new_ok, changed;
 
-  /* note: in the current implementation we don't free pfx-peers for pfxs that
-     are not invalid since it would be an expensive walk and/or we just haven't
-     implemented it yet. */
+  if ((old_ok = diff_filter(diff, diff->old_it, BGPVIEW_IO_FILTER_PFX_PEER)) <
+        0 ||
+      (new_ok = diff_filter(diff, diff->new_it, BGPVIEW_IO_FILTER_PFX_PEER)) <
+        0) {
+    goto err;
+  }
 
-  if (view->need_gc_v4pfxs) {
-    for (k = kh_begin(view->v4pfxs); k != kh_end(view->v4pfxs); ++k) {
-      if (kh_exist(view->v4pfxs, k) &&
-          kh_value(view->v4pfxs, k)->state == BGPVIEW_FIELD_INVALID) {
-        peerid_pfxinfo_destroy(view, kh_value(view->v4pfxs, k));
-        kh_del(bwv_v4pfx_peerid_pfxinfo, view->v4pfxs, k);
-      }
+  if (old_ok && new_ok) {
+    if (shared) {
+      return 0;
     }
-    view->need_gc_v4pfxs = 0;
+    if ((changed = diff_pfx_peer_paths(diff)) < 0) {
+      goto err;
+    }
+    if (changed == 0) {
+      return 0;
+    }
+    DIFF_CB(diff, pfx_peer_changed);
+  } else if (old_ok) {
+    DIFF_CB(diff, pfx_peer_removed);
+  } else if (new_ok) {
+    DIFF_CB(diff, pfx_peer_added);
+  } else {
+    return 0;
   }
 
-  if (view->need_gc_v6pfxs) {
-    for (k = kh_begin(view->v6pfxs); k != kh_end(view->v6pfxs); ++k) {
-      if (kh_exist(view->v6pfxs, k) &&
-          kh_value(view->v6pfxs, k)->state == BGPVIEW_FIELD_INVALID) {
-        peerid_pfxinfo_destroy(view, kh_value(view->v6pfxs, k));
-        kh_del(bwv_v6pfx_peerid_pfxinfo, view->v6pfxs, k);
-      }
+  (*changes)++;
+  return 0;
+
+err:
+  return -1;
+}
+
+/* diff the pfx-peers of a prefix by walking both peer lists in peer ID order.
+   only valid if both views use the vector layout, or if the prefix record is
+   shared between the views (in which case both walks visit the same
+   pfx-peers in the same order) */
+static int diff_pfx_peers_merge(bwv_diff_t *diff, int shared, int *changes)
+{
+  bgpview_iter_t *old_it = diff->old_it;
+  bgpview_iter_t *new_it = diff->new_it;
+  bgpstream_peer_id_t old_id = 0, new_id = 0;
+  int old_more, new_more, ok;
+
+  __iter_pfx_first_peer(old_it, BGPVIEW_FIELD_ACTIVE);
+  __iter_pfx_first_peer(new_it, BGPVIEW_FIELD_ACTIVE);
+
+  while ((old_more = __iter_pfx_has_more_peer(old_it)) |
+         (new_more = __iter_pfx_has_more_peer(new_it))) {
+    if (old_more) {
+      old_id = __iter_pfx_peer_get_peer_id(old_it);
+    }
+    if (new_more) {
+      new_id = __iter_pfx_peer_get_peer_id(new_it);
     }
-    view->need_gc_v6pfxs = 0;
-  }
 
-  if (view->need_gc_peerinfo) {
-    for (k = kh_begin(view->peerinfo); k != kh_end(view->peerinfo); ++k) {
-      if (kh_exist(view->peerinfo, k) &&
-          kh_value(view->peerinfo, k).state == BGPVIEW_FIELD_INVALID) {
-        if (view->peer_user_destructor != NULL &&
-            kh_value(view->peerinfo, k).user != NULL) {
-          view->peer_user_destructor(kh_value(view->peerinfo, k).user);
-        }
-        kh_del(bwv_peerid_peerinfo, view->peerinfo, k);
+    if (new_more && (!old_more || new_id < old_id)) {
+      /* only in the new view */
+      if ((ok = diff_filter(diff, new_it, BGPVIEW_IO_FILTER_PFX_PEER)) < 0) {
+        goto err;
+      }
+      if (ok) {
+        DIFF_CB(diff, pfx_peer_added);
+        (*changes)++;
+      }
+      __iter_pfx_next_peer(new_it);
+    } else if (old_more && (!new_more || old_id < new_id)) {
+      /* only in the old view */
+      if ((ok = diff_filter(diff, old_it, BGPVIEW_IO_FILTER_PFX_PEER)) < 0) {
+        goto err;
       }
+      if (ok) {
+        DIFF_CB(diff, pfx_peer_removed);
+        (*changes)++;
+      }
+      __iter_pfx_next_peer(old_it);
+    } else {
+      if (diff_common_pfx_peer(diff, shared, changes) != 0) {
+        goto err;
+      }
+      __iter_pfx_next_peer(old_it);
+      __iter_pfx_next_peer(new_it);
     }
-    view->need_gc_peerinfo = 0;
   }
-}
-
-int bgpview_copy(bgpview_t *dst, bgpview_t *src)
-{
-  bgpview_iter_t *src_iter = NULL;
-  bgpview_iter_t *dst_iter = NULL;
 
-  bgpstream_peer_sig_t *ps;
-  bgpstream_peer_id_t src_id, dst_id;
-  bgpstream_peer_id_t dstids[UINT16_MAX];
+  return 0;
 
-  int first;
-  bgpstream_pfx_t *pfx;
-  bgpstream_as_path_store_path_id_t pathid;
-  bgpstream_as_path_t *path;
+err:
+  return -1;
+}
 
-  dst->time = src->time;
+/* diff the pfx-peers of a prefix by seeking each pfx-peer of the new view in
+   the old view. the pfx-peers of the old view are only walked if some of them
+   were not found */
+static int diff_pfx_peers_seek(bwv_diff_t *diff, int *changes)
+{
+  bgpview_iter_t *old_it = diff->old_it;
+  bgpview_iter_t *new_it = diff->new_it;
+  bgpstream_peer_id_t peer_id;
+  int matched = 0;
+  int ok;
+
+  for (bgpview_iter_pfx_first_peer(new_it, BGPVIEW_FIELD_ACTIVE);
+       bgpview_iter_pfx_has_more_peer(new_it);
+       bgpview_iter_pfx_next_peer(new_it)) {
+    peer_id = __iter_pfx_peer_get_peer_id(new_it);
+    __iter_pfx_seek_peer(old_it, peer_id, BGPVIEW_FIELD_ACTIVE);
+    if (__iter_pfx_has_more_peer(old_it)) {
+      matched++;
+      if (diff_common_pfx_peer(diff, 0, changes) != 0) {
+        goto err;
+      }
+      continue;
+    }
+    if ((ok = diff_filter(diff, new_it, BGPVIEW_IO_FILTER_PFX_PEER)) < 0) {
+      goto err;
+    }
+    if (ok) {
+      DIFF_CB(diff, pfx_peer_added);
+      (*changes)++;
+    }
+  }
 
-  if (((src_iter = bgpview_iter_create(src)) == NULL) ||
-      ((dst_iter = bgpview_iter_create(dst)) == NULL)) {
-    goto err;
+  if (matched == __iter_pfx_get_peer_cnt(old_it, BGPVIEW_FIELD_ACTIVE)) {
+    /* every pfx-peer of the old view is also in the new view */
+    return 0;
   }
 
-  for (bgpview_iter_first_peer(src_iter, BGPVIEW_FIELD_ACTIVE);
-       bgpview_iter_has_more_peer(src_iter); bgpview_iter_next_peer(src_iter)) {
-    ps = bgpview_iter_peer_get_sig(src_iter);
-    src_id = bgpview_iter_peer_get_peer_id(src_iter);
-    if ((dst_id = bgpview_iter_add_peer(
-           dst_iter, ps->collector_str,
-           &ps->peer_ip_addr, ps->peer_asnumber)) == 0) {
+  for (bgpview_iter_pfx_first_peer(old_it, BGPVIEW_FIELD_ACTIVE);
+       bgpview_iter_pfx_has_more_peer(old_it);
+       bgpview_iter_pfx_next_peer(old_it)) {
+    peer_id = __iter_pfx_peer_get_peer_id(old_it);
+    __iter_pfx_seek_peer(new_it, peer_id, BGPVIEW_FIELD_ACTIVE);
+    if (__iter_pfx_has_more_peer(new_it)) {
+      continue;
+    }
+    if ((ok = diff_filter(diff, old_it, BGPVIEW_IO_FILTER_PFX_PEER)) < 0) {
       goto err;
     }
-    dstids[src_id] = dst_id;
-    bgpview_iter_activate_peer(dst_iter);
+    if (ok) {
+      DIFF_CB(diff, pfx_peer_removed);
+      (*changes)++;
+    }
   }
 
-  for (bgpview_iter_first_pfx(src_iter, 0, BGPVIEW_FIELD_ACTIVE);
-       bgpview_iter_has_more_pfx(src_iter); bgpview_iter_next_pfx(src_iter)) {
-    first = 1;
-    pfx = bgpview_iter_pfx_get_pfx(src_iter);
-    for (bgpview_iter_pfx_first_peer(src_iter, BGPVIEW_FIELD_ACTIVE);
-         bgpview_iter_pfx_has_more_peer(src_iter);
-         bgpview_iter_pfx_next_peer(src_iter)) {
-      src_id = bgpview_iter_peer_get_peer_id(src_iter);
-      dst_id = dstids[src_id];
-      pathid = bgpview_iter_pfx_peer_get_as_path_store_path_id(src_iter);
+  return 0;
 
-      /* if they share tables, be more efficient */
-      if (dst->pathstore == src->pathstore) {
-        if (first != 0) {
-          /* this is the first pfx-peer for this prefix */
-          if (bgpview_iter_add_pfx_peer_by_id(dst_iter, pfx, dst_id, pathid) !=
-              0) {
-            goto err;
-          }
-          first = 0;
-        } else {
-          if (bgpview_iter_pfx_add_peer_by_id(dst_iter, dst_id, pathid) != 0) {
-            goto err;
-          }
-        }
-      } else {
-        /* inefficiently copy */
-        path = bgpview_iter_pfx_peer_get_as_path(src_iter);
+err:
+  return -1;
+}
 
-        if (first != 0) {
-          if (bgpview_iter_add_pfx_peer(dst_iter, pfx, dst_id, path) != 0) {
-            goto err;
-          }
-          first = 0;
-        } else {
-          if (bgpview_iter_pfx_add_peer(dst_iter, dst_id, path) != 0) {
-            goto err;
-          }
-        }
+/* diff a prefix that is in both views. both iterators must refer to the
+   prefix */
+static int diff_common_pfx(bwv_diff_t *diff)
+{
+  int shared = diff->same_pathstore && __pfx_peerinfos(diff->old_it) ==
+                                         __pfx_peerinfos(diff->new_it);
+  int changes = 0;
 
-        bgpstream_as_path_destroy(path);
-      }
-      bgpview_iter_pfx_activate_peer(dst_iter);
+  if (shared && diff->filter == NULL) {
+    /* the views share the prefix record, so nothing has changed */
+    return 0;
+  }
+
+  if (shared || (BWV_PFX_PEERS_ARE_VEC(diff->old_it->view) &&
+                 BWV_PFX_PEERS_ARE_VEC(diff->new_it->view))) {
+    if (diff_pfx_peers_merge(diff, shared, &changes) != 0) {
+      goto err;
     }
+  } else if (diff_pfx_peers_seek(diff, &changes) != 0) {
+    goto err;
   }
 
-  bgpview_iter_destroy(src_iter);
-  bgpview_iter_destroy(dst_iter);
+  if (changes > 0) {
+    DIFF_CB(diff, pfx_changed);
+  }
 
   return 0;
 
 err:
-  bgpview_iter_destroy(src_iter);
-  bgpview_iter_destroy(dst_iter);
   return -1;
 }
 
-bgpview_t *bgpview_dup(bgpview_t *src)
+int bgpview_diff(bgpview_t *old_view, bgpview_t *new_view,
+                 bgpview_diff_cbs_t *cbs, bgpview_io_filter_cb_t *filter,
+                 void *user)
 {
-  bgpview_t *dst = NULL;
+  bwv_diff_t diff = {NULL, NULL, cbs, filter, user,
+                     old_view->pathstore == new_view->pathstore};
+  bgpstream_pfx_t *pfx;
+  uint32_t matched = 0;
+  int found, old_ok, new_ok;
 
-  if ((dst = bgpview_create_shared(
-         src->peersigns, src->pathstore, src->user_destructor,
-         src->peer_user_destructor, src->pfx_user_destructor,
-         src->pfx_peer_user_destructor)) == NULL) {
-    return NULL;
+  if (old_view->peersigns != new_view->peersigns) {
+    fprintf(stderr, "ERROR: Cannot diff views that do not share peer "
+                    "signatures\n");
+    goto err;
   }
 
-  dst->disable_extended = src->disable_extended;
-
-  if (bgpview_copy(dst, src) != 0) {
+  if ((diff.old_it = bgpview_iter_create(old_view)) == NULL ||
+      (diff.new_it = bgpview_iter_create(new_view)) == NULL) {
     goto err;
   }
 
-  return dst;
+  /* for each prefix in the new view */
+  for (bgpview_iter_first_pfx(diff.new_it, 0, BGPVIEW_FIELD_ACTIVE);
+       bgpview_iter_has_more_pfx(diff.new_it);
+       bgpview_iter_next_pfx(diff.new_it)) {
+    pfx = __iter_pfx_get_pfx(diff.new_it);
+    found = bgpview_iter_seek_pfx(diff.old_it, pfx, BGPVIEW_FIELD_ACTIVE);
+    matched += found;
+
+    if ((old_ok = found ? diff_filter(&diff, diff.old_it,
+                                      BGPVIEW_IO_FILTER_PFX)
+                        : 0) < 0 ||
+        (new_ok = diff_filter(&diff, diff.new_it, BGPVIEW_IO_FILTER_PFX)) <
+          0) {
+      goto err;
+    }
 
-err:
-  bgpview_destroy(dst);
-  return NULL;
-}
+    if (old_ok && new_ok) {
+      if (diff_common_pfx(&diff) != 0) {
+        goto err;
+      }
+    } else if (old_ok) {
+      DIFF_CB(&diff, pfx_removed);
+    } else if (new_ok) {
+      DIFF_CB(&diff, pfx_added);
+    }
+  }
 
-void bgpview_disable_user_data(bgpview_t *view)
-{
-  /* the user can't be wanting to destroy pfx-peer user data... */
-  assert(view->pfx_peer_user_destructor == NULL);
-  /* nor can they have any prefixes... */
-  assert(bgpview_pfx_cnt(view, BGPVIEW_FIELD_ALL_VALID) == 0);
+  /* if some prefixes of the old view were not found, walk the old view to
+     find them */
+  if (matched < bgpview_pfx_cnt(old_view, BGPVIEW_FIELD_ACTIVE)) {
+    for (bgpview_iter_first_pfx(diff.old_it, 0, BGPVIEW_FIELD_ACTIVE);
+         bgpview_iter_has_more_pfx(diff.old_it);
+         bgpview_iter_next_pfx(diff.old_it)) {
+      pfx = __iter_pfx_get_pfx(diff.old_it);
+      if (bgpview_iter_seek_pfx(diff.new_it, pfx, BGPVIEW_FIELD_ACTIVE) != 0) {
+        continue;
+      }
+      if ((old_ok = diff_filter(&diff, diff.old_it, BGPVIEW_IO_FILTER_PFX)) <
+          0) {
+        goto err;
+      }
+      if (old_ok) {
+        DIFF_CB(&diff, pfx_removed);
+      }
+    }
+  }
 
-  view->disable_extended = 1;
+  bgpview_iter_destroy(diff.old_it);
+  bgpview_iter_destroy(diff.new_it);
+  return 0;
+
+err:
+  bgpview_iter_destroy(diff.old_it);
+  bgpview_iter_destroy(diff.new_it);
+  return -1;
 }
 
 /* ==================== SIMPLE ACCESSOR FUNCTIONS ==================== */
@@ -2095,6 +7692,49 @@ uint32_t bgpview_peer_cnt(bgpview_t *view, uint8_t state_mask)
   return __cnt_by_mask(view->peerinfo_cnt, state_mask);
 }
 
+uint32_t bgpview_origin_pfx_cnt(bgpview_t *view, uint32_t origin_asn)
+{
+  bwv_origin_index_t *index;
+  bwv_origin_pfxs_t *op;
+  khiter_t k;
+
+  if ((index = origin_index_get(view)) == NULL ||
+      (k = kh_get(bwv_origin_pfxs, index->origins, origin_asn)) ==
+        kh_end(index->origins)) {
+    return 0;
+  }
+  op = &kh_val(index->origins, k);
+
+  return ((op->v4pfxs != NULL) ? kh_size(op->v4pfxs) : 0) +
+         ((op->v6pfxs != NULL) ? kh_size(op->v6pfxs) : 0);
+}
+
+uint32_t bgpview_moas_pfx_cnt(bgpview_t *view)
+{
+  bwv_origin_index_t *index;
+
+  if ((index = origin_index_get(view)) == NULL) {
+    return 0;
+  }
+  return kh_size(index->v4moas) + kh_size(index->v6moas);
+}
+
+int bgpview_lookup_addr(bgpview_t *view, bgpstream_ip_addr_t *addr,
+                        bgpstream_pfx_t *pfx)
+{
+  bwv_lpm_index_t *lpm;
+  int len;
+
+  if ((lpm = lpm_index_get(view)) == NULL ||
+      (len = lpm_lookup(view, lpm, addr)) < 0) {
+    return 0;
+  }
+  if (pfx != NULL) {
+    lpm_pfx(pfx, addr, len);
+  }
+  return 1;
+}
+
 uint32_t bgpview_get_time(bgpview_t *view)
 {
   return view->time;
@@ -80,6 +80,49 @@ typedef enum {
 
 } bgpview_field_state_t;
 
+/** Storage layouts for the table of pfx-peers of each prefix */
+typedef enum {
+
+  /** Each prefix stores its pfx-peers in a hash table keyed by peer ID. This
+   *  is the default layout. */
+  BGPVIEW_PFX_PEER_LAYOUT_HASH = 0,
+
+  /** Each prefix stores its pfx-peers in a compact vector sorted by peer
+   *  ID. This uses significantly less memory than the hash layout for views
+   *  with many prefixes, at the cost of a binary search when seeking to a
+   *  specific pfx-peer. */
+  BGPVIEW_PFX_PEER_LAYOUT_VECTOR = 1,
+
+} bgpview_pfx_peer_layout_t;
+
+/** Orders in which an iterator can visit the prefixes of a view */
+typedef enum {
+
+  /** Prefixes are visited in hash table order. This is the default. */
+  BGPVIEW_PFX_ORDER_HASH = 0,
+
+  /** Prefixes are visited in (version, address, mask length) order, using a
+   *  sorted index of the prefix tables that is built on demand (and rebuilt
+   *  after prefixes have been added to, or garbage collected from, the
+   *  view) */
+  BGPVIEW_PFX_ORDER_SORTED = 1,
+
+} bgpview_pfx_order_t;
+
+/** Possible entry types that can be passed to the filter callback */
+typedef enum {
+
+  /** The iterator refers to a peer */
+  BGPVIEW_IO_FILTER_PEER = 0,
+
+  /** The iterator refers to a prefix */
+  BGPVIEW_IO_FILTER_PFX = 1,
+
+  /** The iterator refers to a prefix-peer */
+  BGPVIEW_IO_FILTER_PFX_PEER = 2,
+
+} bgpview_io_filter_type_t;
+
 /** @} */
 
 /**
@@ -102,6 +145,19 @@ typedef enum {
 
 #endif
 
+/** Number of 64-bit words in a dense peer bitset, i.e. a bitset with one bit
+ *  for every possible bgpstream_peer_id_t */
+#define BGPVIEW_PEER_BITSET_WORDS ((UINT16_MAX + 1) / 64)
+
+/** Set the bit for the given peer id in a dense peer bitset */
+#define BGPVIEW_PEER_BITSET_SET(bits, peerid)                                  \
+  ((bits)[(peerid) >> 6] |= (UINT64_C(1) << ((peerid)&63)))
+
+/** Check whether the bit for the given peer id is set in a dense peer bitset
+ *  (evaluates to 0 or 1) */
+#define BGPVIEW_PEER_BITSET_TEST(bits, peerid)                                 \
+  (((bits)[(peerid) >> 6] >> ((peerid)&63)) & 1)
+
 /** @} */
 
 /**
@@ -115,6 +171,206 @@ typedef enum {
  */
 typedef void(bgpview_destroy_user_t)(void *user);
 
+/** Callback for filtering entries in a view when sending from
+ * bgpview_io_client.
+ *
+ * @param iter          iterator to check
+ * @param type          enum indicating the type of entry to filter
+ * @param user          user-provided pointer
+ * @return 1 to include the entry, 0 to exclude the entry, and -1 if an error
+ * occured.
+ *
+ * @note This callback will be called for every prefix/peer combination, so it
+ * should be efficient at determining if an entry is to be included.
+ */
+typedef int(bgpview_io_filter_cb_t)(bgpview_iter_t *iter,
+                                    bgpview_io_filter_type_t type, void *user);
+
+/** Callback invoked by bgpview_diff for each difference between two views
+ *
+ * @param old_it        iterator into the old view
+ * @param new_it        iterator into the new view
+ * @param user          user pointer passed to bgpview_diff
+ * @return 0 to continue the diff, -1 to abort it
+ *
+ * The callback must not modify either view, or move either iterator.
+ */
+typedef int(bgpview_diff_cb_t)(bgpview_iter_t *old_it, bgpview_iter_t *new_it,
+                               void *user);
+
+/** Set of callbacks invoked by bgpview_diff (any of them may be NULL) */
+typedef struct bgpview_diff_cbs {
+
+  /** A prefix is in the new view, but not in the old view. new_it refers to
+   *  the prefix */
+  bgpview_diff_cb_t *pfx_added;
+
+  /** A prefix is in the old view, but not in the new view. old_it refers to
+   *  the prefix */
+  bgpview_diff_cb_t *pfx_removed;
+
+  /** A prefix is in both views, and at least one of its pfx-peers was added,
+   *  removed or changed. Both iterators refer to the prefix. This is called
+   *  after the pfx-peer callbacks of the prefix */
+  bgpview_diff_cb_t *pfx_changed;
+
+  /** A pfx-peer of a prefix that is in both views is in the new view, but not
+   *  in the old view. Both iterators refer to the prefix, and new_it refers
+   *  to the pfx-peer */
+  bgpview_diff_cb_t *pfx_peer_added;
+
+  /** A pfx-peer of a prefix that is in both views is in the old view, but not
+   *  in the new view. Both iterators refer to the prefix, and old_it refers
+   *  to the pfx-peer */
+  bgpview_diff_cb_t *pfx_peer_removed;
+
+  /** A pfx-peer is in both views, but its AS path changed. Both iterators
+   *  refer to the pfx-peer */
+  bgpview_diff_cb_t *pfx_peer_changed;
+
+} bgpview_diff_cbs_t;
+
+/** Statistics about the memory used by the prefix records of a view
+ *
+ * Prefix info records and (when using the vector layout) pfx-peer tables are
+ * allocated from per-view slabs. Pfx-peer vectors larger than the largest
+ * slab size class are allocated directly from the system and are not included
+ * in these statistics.
+ */
+typedef struct bgpview_alloc_stats {
+
+  /** Number of prefix info records currently in use */
+  uint64_t pfxinfo_used_cnt;
+
+  /** Maximum number of prefix info records in use at once */
+  uint64_t pfxinfo_high_water_cnt;
+
+  /** Number of pfx-peer vectors currently in use */
+  uint64_t peervec_used_cnt;
+
+  /** Sum of the high-water marks of each pfx-peer vector size class */
+  uint64_t peervec_high_water_cnt;
+
+  /** Number of bytes allocated from the system by the slabs */
+  uint64_t chunk_bytes;
+
+  /** Number of bytes used by records that are currently in use */
+  uint64_t used_bytes;
+
+  /** Number of bytes used by freed records waiting to be reused */
+  uint64_t free_bytes;
+
+  /** Number of bytes used by records at their high-water marks */
+  uint64_t high_water_bytes;
+
+  /** Fraction of the slab memory not used by live records (0 if no memory
+      has been allocated) */
+  double fragmentation;
+
+} bgpview_alloc_stats_t;
+
+/** Memory statistics of one of the tables of a view */
+typedef struct bgpview_mem_table_stats {
+
+  /** Approximate number of bytes used by the table */
+  uint64_t bytes;
+
+  /** Number of entries in the table (including invalid entries that have not
+      been garbage collected yet) */
+  uint64_t entries;
+
+  /** Number of slots allocated for entries (hash table buckets, or vector
+      capacity) */
+  uint64_t slots;
+
+  /** Ratio of entries to slots (0 if no slots are allocated) */
+  double load_factor;
+
+} bgpview_mem_table_stats_t;
+
+/** Memory statistics of a view, and of the stores that it (may) share with
+ *  other views
+ *
+ * Byte counts are estimates computed from the number and size of the
+ * allocated entries, and do not include allocator overhead, or the memory
+ * used by user structures (only the number of user pointers is reported).
+ */
+typedef struct bgpview_mem_stats {
+
+  /** Table of v4 prefixes (including its sorted index, if any) */
+  bgpview_mem_table_stats_t v4pfxs;
+
+  /** Table of v6 prefixes (including its sorted index, if any) */
+  bgpview_mem_table_stats_t v6pfxs;
+
+  /** Prefix records and their per-prefix peer tables (entries are
+      pfx-peers) */
+  bgpview_mem_table_stats_t pfx_peers;
+
+  /** Number of prefix records that are shared with other views (see
+      bgpview_snapshot). These are counted in the stats of every view that
+      shares them */
+  uint64_t pfxs_shared_cnt;
+
+  /** Table of peers */
+  bgpview_mem_table_stats_t peers;
+
+  /** Number of prefixes that have a user pointer */
+  uint64_t pfx_user_cnt;
+
+  /** Number of peers that have a user pointer */
+  uint64_t peer_user_cnt;
+
+  /** Number of pfx-peers that have a user pointer */
+  uint64_t pfx_peer_user_cnt;
+
+  /** Bytes used by the per-peer prefix index (0 if it is disabled, see
+      bgpview_enable_peer_index) */
+  uint64_t peer_index_bytes;
+
+  /** Total bytes used by the view (v4pfxs, v6pfxs, pfx_peers, peers and the
+      peer index) */
+  uint64_t view_bytes;
+
+  /** AS path store (bytes only account for the AS path data, and slots are
+      not known). This store may be shared with other views */
+  bgpview_mem_table_stats_t pathstore;
+
+  /** Peer signature map (slots are not known). This map may be shared with
+      other views */
+  bgpview_mem_table_stats_t peersigns;
+
+} bgpview_mem_stats_t;
+
+/** Cumulative statistics about the memory reclaimed by the garbage collector
+ *  of a view */
+typedef struct bgpview_gc_stats {
+
+  /** Number of prefixes freed */
+  uint64_t pfxs_reclaimed;
+
+  /** Number of invalid pfx-peers removed from prefixes that are still valid */
+  uint64_t pfx_peers_reclaimed;
+
+  /** Number of peers freed */
+  uint64_t peers_reclaimed;
+
+  /** Number of per-prefix peer tables that were shrunk */
+  uint64_t tables_shrunk;
+
+  /** Approximate number of bytes reclaimed by freeing prefixes and shrinking
+      per-prefix peer tables */
+  uint64_t bytes_reclaimed;
+
+  /** Number of calls to bgpview_gc_step (including those made by
+      bgpview_gc) */
+  uint64_t steps;
+
+  /** Number of completed sweeps over the view */
+  uint64_t passes;
+
+} bgpview_gc_stats_t;
+
 /** @} */
 
 /** Create a new BGP View
@@ -208,6 +464,44 @@ void bgpview_clear(bgpview_t *view);
  */
 void bgpview_gc(bgpview_t *view);
 
+/** Incrementally garbage collect a view
+ *
+ * @param view          view to garbage collect on
+ * @param max_work      maximum number of hash buckets and pfx-peer cells to
+ *                      visit, or 0 to run until there is nothing left to
+ *                      collect
+ * @return 1 if there is nothing left to collect, 0 if more work remains
+ *
+ * Each call resumes the sweep where the previous call stopped, so that the
+ * cost of garbage collection can be spread across many short slices (e.g.
+ * between intervals). In addition to the memory freed by bgpview_gc, this
+ * removes invalid pfx-peers from prefixes that are still valid, and shrinks
+ * per-prefix peer tables that have become mostly empty.
+ *
+ * @note as with bgpview_gc, this may move or free records, so it must not be
+ * called while an iterator is positioned on a pfx-peer that is still in use.
+ */
+int bgpview_gc_step(bgpview_t *view, uint64_t max_work);
+
+/** Get the cumulative garbage collector statistics for a view
+ *
+ * @param view          view to get the statistics for
+ * @param stats         pointer to a stats structure to fill
+ */
+void bgpview_get_gc_stats(bgpview_t *view, bgpview_gc_stats_t *stats);
+
+/** Build the sorted prefix index used by sorted iterators
+ *
+ * @param view          view to build the index for
+ * @return 0 if the index was built successfully, -1 otherwise
+ *
+ * The index is otherwise built lazily by the first sorted iterator that needs
+ * it (see bgpview_iter_set_pfx_order). Since building the index modifies the
+ * view, this must be called before sorted iterators are used concurrently
+ * from multiple threads.
+ */
+int bgpview_build_pfx_index(bgpview_t *view);
+
 /** Copy one BGPView into another
  *
  * @param dst           pointer to the destination view
@@ -215,6 +509,11 @@ void bgpview_gc(bgpview_t *view);
  * @return 0 if the view was copied successfully, -1 otherwise
  *
  * The destination view will **not** be cleared prior to copying.
+ *
+ * If the two views share the same peer sig and path store (e.g., dst was
+ * created using bgpview_dup or bgpview_create_shared) and dst has no valid
+ * prefixes or peers (e.g., it has just been cleared), the hash tables of src
+ * are cloned in bulk rather than re-inserting each pfx-peer.
  */
 int bgpview_copy(bgpview_t *dst, bgpview_t *src);
 
@@ -228,6 +527,108 @@ int bgpview_copy(bgpview_t *dst, bgpview_t *src);
  */
 bgpview_t *bgpview_dup(bgpview_t *src);
 
+/** Create a copy-on-write snapshot of a view
+ *
+ * @param src           pointer to the view to snapshot
+ * @return pointer to the snapshot created, NULL if an error occurred
+ *
+ * The snapshot is a complete copy of the source view (including inactive
+ * prefixes and peers), but rather than copying every pfx-peer, it shares the
+ * per-prefix records with the source view. A shared prefix is only copied
+ * when it is modified by one of the views, so keeping a snapshot costs memory
+ * (and time) proportional to the number of prefixes that change, rather than
+ * the size of the view.
+ *
+ * Like bgpview_dup, the snapshot shares the peer signature map and AS path
+ * store of the source view, so it must be destroyed before them.
+ *
+ * User data is owned by the source view: the snapshot has no user
+ * destructors, and no view or peer user data. Prefix and pfx-peer user
+ * pointers are visible in the snapshot until the source view modifies or
+ * frees the prefix.
+ *
+ * @note a view and its snapshots share an allocator, so they must not be used
+ * concurrently from different threads.
+ */
+bgpview_t *bgpview_snapshot(bgpview_t *src);
+
+/** Create a compact, read-only copy of the active part of a view
+ *
+ * @param src           pointer to the view to freeze
+ * @return pointer to the frozen view if successful, NULL otherwise
+ *
+ * The frozen view holds the active prefixes, pfx-peers and peers of src (like
+ * bgpview_dup), stored in a compressed sparse row layout: the prefix records,
+ * and the (peer ID, pfx-peer info) cells of all prefixes, are each stored
+ * contiguously in a single block, in the order in which the prefix iterator
+ * visits them, and the cells of each prefix are sorted by peer ID. This makes
+ * traversing the frozen view with the regular iterator API cheaper than
+ * traversing src.
+ *
+ * The frozen view shares the peer signature map and AS path store of src (so
+ * it must be destroyed before them), and has pfx-peer user data disabled.
+ * Any attempt to modify it (adding, removing, (de)activating or setting user
+ * data of prefixes, peers or pfx-peers, or clearing it) fails. Since a frozen
+ * view is never modified, any number of threads may iterate over it
+ * concurrently (see bgpview_iter_create_partition).
+ */
+bgpview_t *bgpview_freeze(bgpview_t *src);
+
+/** Create a frozen view that does not share any tables with its source
+ *
+ * @param src           pointer to the view to freeze
+ * @return pointer to the frozen view if successful, NULL otherwise
+ *
+ * Like bgpview_freeze, but the frozen view gets its own peer signature map
+ * and AS path store, holding only the peers and AS paths that it uses. This
+ * is more expensive, but the frozen view stays valid (and may be read by
+ * other threads) while src, and any tables that src shares with other views,
+ * are modified or destroyed.
+ */
+bgpview_t *bgpview_freeze_detached(bgpview_t *src);
+
+/** Check whether a view is frozen
+ *
+ * @param view          pointer to the view to check
+ * @return 1 if the view was created using bgpview_freeze, 0 otherwise
+ */
+int bgpview_is_frozen(bgpview_t *view);
+
+/** Save an image of the active part of a view to a file
+ *
+ * @param view          pointer to the view to save
+ * @param filename      name of the file to write the image to
+ * @return 0 if the image was written successfully, -1 otherwise
+ *
+ * The image holds the active prefixes, pfx-peers and peers of the view,
+ * along with the peer signatures and AS paths that they use, laid out so that
+ * bgpview_snapshot_map can use it in place. The image is written to a
+ * temporary file that replaces filename once it is complete. If the view is
+ * not frozen, a frozen copy of it is made first (see bgpview_freeze).
+ *
+ * Images are specific to the host and build that wrote them (byte order,
+ * record layout and prefix hash functions), they are meant for restarting a
+ * process, not for exchanging views (see bgpview_io_file for that).
+ */
+int bgpview_snapshot_save(bgpview_t *view, const char *filename);
+
+/** Create a frozen view from an image written by bgpview_snapshot_save
+ *
+ * @param filename      name of the image file
+ * @return pointer to the frozen view if successful, NULL otherwise
+ *
+ * The file is memory-mapped (copy-on-write) and the prefix tables and
+ * pfx-peers of the view are used where they are in the mapping, so the cost
+ * of loading an image is that of re-interning its peers and AS paths, plus a
+ * pass over the prefix table buckets; pages of the image are read as they
+ * are used. The view has its own peer signature map and AS path store, in
+ * which peers keep the IDs they had in the saved view (AS path IDs may
+ * differ). The view is frozen (see bgpview_freeze): it can be traversed,
+ * duplicated or copied into a regular view, and the file may be removed or
+ * replaced while it is mapped, but not truncated or rewritten in place.
+ */
+bgpview_t *bgpview_snapshot_map(const char *filename);
+
 /** Disable user data for a view
  *
  * @param view          view to disable user data for
@@ -238,6 +639,184 @@ bgpview_t *bgpview_dup(bgpview_t *src);
  */
 void bgpview_disable_user_data(bgpview_t *view);
 
+/** Set the storage layout used for the pfx-peers of each prefix
+ *
+ * @param view          view to set the layout for
+ * @param layout        layout to use
+ *
+ * Like bgpview_disable_user_data, this must be called before any prefixes are
+ * added to the view (i.e., right after the view is created). The layout is
+ * transparent to users of the iterator API. Views created using bgpview_dup
+ * inherit the layout of the source view.
+ */
+void bgpview_set_pfx_peer_layout(bgpview_t *view,
+                                 bgpview_pfx_peer_layout_t layout);
+
+/** Get the storage layout used for the pfx-peers of each prefix
+ *
+ * @param view          view to get the layout for
+ * @return the layout used by the view
+ */
+bgpview_pfx_peer_layout_t bgpview_get_pfx_peer_layout(bgpview_t *view);
+
+/** Enable the change journal of a view
+ *
+ * @param view          view to enable the journal for
+ * @return 0 if the journal was enabled successfully, -1 otherwise
+ *
+ * While the journal is enabled, the view records which pfx-peers (and thus
+ * prefixes) and which peers changed since the last call to
+ * bgpview_journal_mark (or since the journal was enabled). A pfx-peer changes
+ * when it is added, removed, activated or deactivated, or when its AS path
+ * changes; a peer changes when it is added, removed, activated or
+ * deactivated. Changes to user data are not recorded. The changes can be
+ * listed using bgpview_iter_first_changed_pfx and
+ * bgpview_iter_first_changed_peer.
+ */
+int bgpview_enable_journal(bgpview_t *view);
+
+/** Disable (and discard) the change journal of a view
+ *
+ * @param view          view to disable the journal for
+ */
+void bgpview_disable_journal(bgpview_t *view);
+
+/** Discard the changes recorded in the journal of a view
+ *
+ * @param view          view to mark
+ *
+ * After this call, the journal only records changes made from now on, and is
+ * complete again (see bgpview_journal_is_complete).
+ */
+void bgpview_journal_mark(bgpview_t *view);
+
+/** Check whether the journal of a view holds every change since the mark
+ *
+ * @param view          view to check
+ * @return 1 if the journal is complete, 0 otherwise
+ *
+ * The journal becomes incomplete if the view is cleared (or bulk copied into
+ * using bgpview_copy), or if the journal could not be updated. Users of an
+ * incomplete journal must fall back to scanning the whole view.
+ */
+int bgpview_journal_is_complete(bgpview_t *view);
+
+/** Enable the origin index of a view
+ *
+ * @param view          view to enable the origin index for
+ * @return 0 if the index was enabled (and built) successfully, -1 otherwise
+ *
+ * The origin index maps each origin AS to the prefixes it originates, and each
+ * prefix to its distinct origin ASes, considering only active pfx-peers. It is
+ * kept up to date as pfx-peers are activated, deactivated or given a new AS
+ * path, so that the prefixes of an origin (bgpview_iter_first_origin_pfx), the
+ * prefixes with more than one origin (bgpview_iter_first_moas_pfx) and the
+ * origins of a prefix (bgpview_iter_pfx_get_origins) can be looked up without
+ * scanning the view. Only origins that are a single AS are indexed (i.e. AS
+ * set origins are ignored). The index is not copied by bgpview_dup,
+ * bgpview_snapshot or bgpview_freeze, and is rebuilt on its next use after a
+ * bgpview_copy into the view.
+ */
+int bgpview_enable_origin_index(bgpview_t *view);
+
+/** Disable (and discard) the origin index of a view
+ *
+ * @param view          view to disable the origin index for
+ */
+void bgpview_disable_origin_index(bgpview_t *view);
+
+/** Enable the longest-prefix-match index of a view
+ *
+ * @param view          view to enable the LPM index for
+ * @return 0 if the index was enabled (and built) successfully, -1 otherwise
+ *
+ * The LPM index allows the active prefixes that cover an address to be found
+ * (bgpview_lookup_addr, bgpview_iter_first_covering_pfx) without scanning the
+ * view. It is kept up to date as prefixes are activated and deactivated. IPv4
+ * lookups use a 16 MiB table indexed by the first 24 bits of the address (plus
+ * a small table for each /24 that holds a longer prefix), while IPv6 lookups
+ * probe the view once for each prefix length in use. The index is not copied
+ * by bgpview_dup, bgpview_snapshot or bgpview_freeze, and is rebuilt on its
+ * next use after a bgpview_copy into the view.
+ */
+int bgpview_enable_lpm_index(bgpview_t *view);
+
+/** Disable (and discard) the longest-prefix-match index of a view
+ *
+ * @param view          view to disable the LPM index for
+ */
+void bgpview_disable_lpm_index(bgpview_t *view);
+
+/** Enable the per-peer prefix index of a view
+ *
+ * @param view          view to enable the peer index for
+ * @return 0 if the index was enabled (and built) successfully, -1 otherwise
+ *
+ * The peer index keeps, for each peer, the prefix table buckets that hold a
+ * prefix the peer has a (valid) pfx-peer on. This makes iterating over the
+ * prefixes of a peer (bgpview_iter_peer_first_pfx), and thus deactivating or
+ * removing a peer, proportional to the number of prefixes of the peer rather
+ * than to the number of pfx-peers of the view. The buckets of a peer are
+ * listed (4 bytes per prefix) until the list would be larger than a bitmap
+ * with one bit per bucket of the prefix table (i.e., for peers with prefixes
+ * in more than 1/32 of the buckets), which is used from then on. The index is
+ * rebuilt on its next use whenever a prefix table is rehashed (i.e., while the
+ * view grows), and after a bgpview_copy into the view. It is not copied by
+ * bgpview_dup, bgpview_snapshot or bgpview_freeze.
+ */
+int bgpview_enable_peer_index(bgpview_t *view);
+
+/** Disable (and discard) the per-peer prefix index of a view
+ *
+ * @param view          view to disable the peer index for
+ */
+void bgpview_disable_peer_index(bgpview_t *view);
+
+/** Get statistics about the memory used by the prefix records of a view
+ *
+ * @param view          view to get the statistics for
+ * @param stats         pointer to a stats structure to fill
+ */
+void bgpview_get_alloc_stats(bgpview_t *view, bgpview_alloc_stats_t *stats);
+
+/** Get statistics about the memory used by a view and its stores
+ *
+ * @param view          view to get the statistics for
+ * @param stats         pointer to a stats structure to fill
+ *
+ * This walks every prefix and pfx-peer of the view, and every path of the AS
+ * path store, so it should not be called for every view processed by a
+ * latency-sensitive consumer.
+ */
+void bgpview_get_mem_stats(bgpview_t *view, bgpview_mem_stats_t *stats);
+
+/** Compute the differences between the active parts of two views
+ *
+ * @param old_view      pointer to the old view
+ * @param new_view      pointer to the new view
+ * @param cbs           callbacks to invoke for each difference
+ * @param filter        callback to filter prefixes and pfx-peers (may be NULL)
+ * @param user          user pointer passed to the callbacks and the filter
+ * @return 0 if the diff completed successfully, -1 if a callback or the filter
+ * failed
+ *
+ * Both views must share the same peer signature map (e.g., one was created
+ * from the other using bgpview_dup or bgpview_snapshot). A prefix or pfx-peer
+ * that is excluded by the filter in one of the views is treated as if it were
+ * not in that view, so that the diff describes the changes between what was
+ * accepted by the filter in the old view and in the new view.
+ *
+ * The prefixes of the new view are visited once. The prefixes of the old view
+ * are only visited (in a second pass) if some of them are not in the new
+ * view. Prefixes whose records are shared between the views (see
+ * bgpview_snapshot) are skipped without comparing their pfx-peers (unless a
+ * filter is given), and when the views share an AS path store, AS paths are
+ * compared by path ID.
+ */
+int bgpview_diff(bgpview_t *old_view, bgpview_t *new_view,
+                 bgpview_diff_cbs_t *cbs, bgpview_io_filter_cb_t *filter,
+                 void *user);
+
 /**
  * @name Simple Accessor Functions
  *
@@ -279,6 +858,37 @@ uint32_t bgpview_pfx_cnt(bgpview_t *view, uint8_t state_mask);
  */
 uint32_t bgpview_peer_cnt(bgpview_t *view, uint8_t state_mask);
 
+/** Get the number of prefixes originated by an AS
+ *
+ * @param view          pointer to a view structure
+ * @param origin_asn    origin AS number
+ * @return the number of prefixes that have at least one active pfx-peer whose
+ *         AS path is originated by the given AS, 0 if the origin index is
+ *         disabled (see bgpview_enable_origin_index)
+ */
+uint32_t bgpview_origin_pfx_cnt(bgpview_t *view, uint32_t origin_asn);
+
+/** Get the number of prefixes with more than one origin AS
+ *
+ * @param view          pointer to a view structure
+ * @return the number of prefixes whose active pfx-peers have more than one
+ *         distinct origin AS, 0 if the origin index is disabled (see
+ *         bgpview_enable_origin_index)
+ */
+uint32_t bgpview_moas_pfx_cnt(bgpview_t *view);
+
+/** Find the longest active prefix that covers an address
+ *
+ * @param view          pointer to a view structure
+ * @param addr          pointer to the address to look up
+ * @param[out] pfx      pointer to a prefix structure to fill with the longest
+ *                      covering prefix (may be NULL)
+ * @return 1 if an active prefix covers the address, 0 if none does (or the LPM
+ *         index is disabled, see bgpview_enable_lpm_index)
+ */
+int bgpview_lookup_addr(bgpview_t *view, bgpstream_ip_addr_t *addr,
+                        bgpstream_pfx_t *pfx);
+
 /** Get the BGP time that the view represents
  *
  * @param view          pointer to a view structure
@@ -396,6 +1006,56 @@ bgpstream_peer_id_t bgpview_get_peer_id(bgpview_t *view,
  */
 bgpview_iter_t *bgpview_iter_create(bgpview_t *view);
 
+/** Create a new view iterator that covers one partition of the prefixes
+ *
+ * @param view          pointer to the view to create iterator for
+ * @param part          index of the partition to cover (0..parts_cnt-1)
+ * @param parts_cnt     number of partitions to split the prefixes into
+ * @return pointer to an iterator if successful, NULL otherwise
+ *
+ * The v4 and v6 prefix tables of the view are each split into parts_cnt
+ * disjoint ranges of hash buckets, and the prefix (and pfx-peer) iterator
+ * functions of the returned iterator only visit (or seek to) prefixes in the
+ * ranges of the given partition. The union of all parts_cnt partitions covers
+ * every prefix exactly once. Peer iteration is not partitioned.
+ *
+ * The partition boundaries are computed when the iterator is created, so the
+ * view must not be modified (nor garbage collected) while partitioned
+ * iterators exist, and partitioned iterators must not be used to add or
+ * remove prefixes.
+ *
+ * @note Thread safety: iterator functions that do not modify the view (the
+ * first/next/has_more/seek functions and the getters) only read the view and
+ * the path store, so any number of iterators (partitioned or not) may be used
+ * to traverse the same view concurrently, one iterator per thread, as long as
+ * no thread modifies the view, its peer sig map or its path store, or takes a
+ * snapshot of it, at the same time. A typical use is to create parts_cnt
+ * partitioned iterators and hand one to each thread of a pool. Sorted
+ * iterators build the sorted prefix index lazily, so bgpview_build_pfx_index
+ * must be called before they are used concurrently.
+ */
+bgpview_iter_t *bgpview_iter_create_partition(bgpview_t *view, int part,
+                                              int parts_cnt);
+
+/** Set the order in which the iterator visits prefixes
+ *
+ * @param iter          pointer to the iterator to set the order for
+ * @param order         order to use
+ * @return 0 if the order was set successfully, -1 otherwise
+ *
+ * The order takes effect at the next call to bgpview_iter_first_pfx,
+ * bgpview_iter_first_pfx_peer, or one of the seek functions. In sorted order,
+ * two views can be compared with a linear merge of their prefixes, and a
+ * seek followed by bgpview_iter_next_pfx continues in address order.
+ *
+ * A sorted iteration ends early if prefixes are added to the view (or
+ * garbage collected from it) while it is in progress. Re-adding a prefix that
+ * is already in the view can also end it, if the prefix table has to be
+ * rehashed to make room. Sorted order is not supported by partitioned
+ * iterators.
+ */
+int bgpview_iter_set_pfx_order(bgpview_iter_t *iter, bgpview_pfx_order_t order);
+
 /** Destroy the given iterator
  *
  * @param               Pointer to the iterator to destroy
@@ -445,6 +1105,40 @@ int bgpview_iter_has_more_peer(bgpview_iter_t *iter);
 int bgpview_iter_seek_peer(bgpview_iter_t *iter, bgpstream_peer_id_t peerid,
                            uint8_t state_mask);
 
+/** Seek the prefix and pfx-peer iterators to the first pfx-peer of the
+ *  current peer that matches the given IP version and mask
+ *
+ * @param iter          Pointer to an iterator structure
+ * @param version       0 if the pfx-peers of all versions are to be iterated,
+ *                      BGPSTREAM_ADDR_VERSION_IPV4 or
+ *                      BGPSTREAM_ADDR_VERSION_IPV6 otherwise
+ * @param state_mask    mask of pfx-peer states to match
+ * @return 0 if the peer has no such pfx-peers, 1 otherwise
+ *
+ * The pfx-peers are visited in no particular order. Use
+ * bgpview_iter_peer_next_pfx to move to the next one, and the usual prefix
+ * and pfx-peer functions to access the current one. The current pfx-peer may
+ * be deactivated or removed during the iteration, but no prefixes or
+ * pfx-peers may be added. This scans the prefix tables unless the peer index
+ * is enabled (see bgpview_enable_peer_index).
+ */
+int bgpview_iter_peer_first_pfx(bgpview_iter_t *iter, int version,
+                                uint8_t state_mask);
+
+/** Advance the prefix and pfx-peer iterators to the next pfx-peer of the peer
+ *
+ * @param iter          Pointer to an iterator structure
+ * @return 0 if the end has been reached, 1 otherwise
+ */
+int bgpview_iter_peer_next_pfx(bgpview_iter_t *iter);
+
+/** Check if the iterator points to a pfx-peer of the peer
+ *
+ * @param iter          Pointer to an iterator structure
+ * @return 0 if the end has been reached, 1 otherwise
+ */
+int bgpview_iter_peer_has_more_pfx(bgpview_iter_t *iter);
+
 /** Reset the prefix iterator to the first item for the given
  *  IP version that also matches the mask
  *
@@ -611,6 +1305,155 @@ int bgpview_iter_seek_pfx_peer(bgpview_iter_t *iter, bgpstream_pfx_t *pfx,
                                bgpstream_peer_id_t peerid, uint8_t pfx_mask,
                                uint8_t peer_mask);
 
+/** Reset the journal iterator to the first changed prefix
+ *
+ * @param iter          Pointer to an iterator structure
+ * @param version       0 if all the changed prefixes are considered,
+ *                      otherwise only the changed prefixes of the given
+ *                      version
+ * @return 0 if there are no changed prefixes (or the journal is disabled), 1
+ *         otherwise
+ *
+ * The journal iterator is independent of the prefix and peer iterators, so
+ * the current state of a changed prefix (which may have been removed from the
+ * view) can be looked up using bgpview_iter_seek_pfx while iterating over the
+ * journal. The view must not be modified while the journal is iterated over.
+ */
+int bgpview_iter_first_changed_pfx(bgpview_iter_t *iter, int version);
+
+/** Advance the journal iterator to the next changed prefix
+ *
+ * @param iter          Pointer to an iterator structure
+ * @return 0 if the end has been reached, 1 otherwise
+ */
+int bgpview_iter_next_changed_pfx(bgpview_iter_t *iter);
+
+/** Check if the journal iterator points to a valid changed prefix
+ *
+ * @param iter          Pointer to an iterator structure
+ * @return 0 if the end has been reached, 1 otherwise
+ */
+int bgpview_iter_has_more_changed_pfx(bgpview_iter_t *iter);
+
+/** Get the changed prefix that the journal iterator points to
+ *
+ * @param iter          Pointer to an iterator structure
+ * @return a pointer to the prefix (owned by the journal)
+ */
+bgpstream_pfx_t *bgpview_iter_changed_pfx_get_pfx(bgpview_iter_t *iter);
+
+/** Get the peers whose pfx-peers changed for the current changed prefix
+ *
+ * @param iter          Pointer to an iterator structure
+ * @param[out] peer_ids set to point to an array of peer IDs, sorted (owned by
+ *                      the journal)
+ * @return the number of peer IDs in the array
+ */
+int bgpview_iter_changed_pfx_get_peers(bgpview_iter_t *iter,
+                                       bgpstream_peer_id_t **peer_ids);
+
+/** Reset the journal iterator to the first changed peer
+ *
+ * @param iter          Pointer to an iterator structure
+ * @return 0 if there are no changed peers (or the journal is disabled), 1
+ *         otherwise
+ */
+int bgpview_iter_first_changed_peer(bgpview_iter_t *iter);
+
+/** Advance the journal iterator to the next changed peer
+ *
+ * @param iter          Pointer to an iterator structure
+ * @return 0 if the end has been reached, 1 otherwise
+ */
+int bgpview_iter_next_changed_peer(bgpview_iter_t *iter);
+
+/** Check if the journal iterator points to a valid changed peer
+ *
+ * @param iter          Pointer to an iterator structure
+ * @return 0 if the end has been reached, 1 otherwise
+ */
+int bgpview_iter_has_more_changed_peer(bgpview_iter_t *iter);
+
+/** Get the ID of the changed peer that the journal iterator points to
+ *
+ * @param iter          Pointer to an iterator structure
+ * @return the ID of the peer
+ */
+bgpstream_peer_id_t bgpview_iter_changed_peer_get_peer_id(bgpview_iter_t *iter);
+
+/** Reset the index iterator to the first prefix originated by an AS, and seek
+ *  the prefix iterator to it
+ *
+ * @param iter          Pointer to an iterator structure
+ * @param origin_asn    origin AS number
+ * @return 0 if the AS originates no prefixes (or the origin index is
+ *         disabled), 1 otherwise
+ *
+ * The prefixes are those that have at least one active pfx-peer with the given
+ * origin (in no particular order). Use bgpview_iter_next_indexed_pfx to move
+ * to the next prefix, and the usual prefix and pfx-peer functions to access
+ * the current prefix. The view must not be modified while the index is
+ * iterated over.
+ */
+int bgpview_iter_first_origin_pfx(bgpview_iter_t *iter, uint32_t origin_asn);
+
+/** Reset the index iterator to the first prefix with more than one origin AS,
+ *  and seek the prefix iterator to it
+ *
+ * @param iter          Pointer to an iterator structure
+ * @return 0 if there are no such prefixes (or the origin index is disabled),
+ *         1 otherwise
+ *
+ * See bgpview_iter_first_origin_pfx.
+ */
+int bgpview_iter_first_moas_pfx(bgpview_iter_t *iter);
+
+/** Advance the index iterator to the next prefix, and seek the prefix iterator
+ *  to it
+ *
+ * @param iter          Pointer to an iterator structure
+ * @return 0 if the end has been reached, 1 otherwise
+ */
+int bgpview_iter_next_indexed_pfx(bgpview_iter_t *iter);
+
+/** Check if the index iterator points to a valid prefix
+ *
+ * @param iter          Pointer to an iterator structure
+ * @return 0 if the end has been reached, 1 otherwise
+ */
+int bgpview_iter_has_more_indexed_pfx(bgpview_iter_t *iter);
+
+/** Seek the prefix iterator to the longest active prefix that covers an
+ *  address
+ *
+ * @param iter          Pointer to an iterator structure
+ * @param addr          pointer to the address to look up
+ * @return 0 if no active prefix covers the address (or the LPM index is
+ *         disabled, see bgpview_enable_lpm_index), 1 otherwise
+ *
+ * Use bgpview_iter_next_covering_pfx to move to the next shorter covering
+ * prefix, and the usual prefix and pfx-peer functions to access the current
+ * prefix. The view must not be modified while the covering prefixes are
+ * iterated over.
+ */
+int bgpview_iter_first_covering_pfx(bgpview_iter_t *iter,
+                                    bgpstream_ip_addr_t *addr);
+
+/** Seek the prefix iterator to the next (shorter) active prefix that covers
+ *  the address given to bgpview_iter_first_covering_pfx
+ *
+ * @param iter          Pointer to an iterator structure
+ * @return 0 if the end has been reached, 1 otherwise
+ */
+int bgpview_iter_next_covering_pfx(bgpview_iter_t *iter);
+
+/** Check if the prefix iterator points to a covering prefix
+ *
+ * @param iter          Pointer to an iterator structure
+ * @return 0 if the end has been reached, 1 otherwise
+ */
+int bgpview_iter_has_more_covering_pfx(bgpview_iter_t *iter);
+
 /** @} */
 
 /**
@@ -696,6 +1539,34 @@ int bgpview_iter_add_pfx_peer_by_id(bgpview_iter_t *iter, bgpstream_pfx_t *pfx,
                                     bgpstream_peer_id_t peer_id,
                                     bgpstream_as_path_store_path_id_t path_id);
 
+/** Insert a row of pfx-peers for a prefix in the BGP Watcher view (with
+ * already known existing AS Path IDs)
+ *
+ * @param iter          pointer to a view iterator
+ * @param pfx           pointer to the prefix
+ * @param peer_ids      array of cnt peer identifiers
+ * @param path_ids      array of cnt AS Path Store IDs, one for each peer
+ * @param states        array of cnt states (BGPVIEW_FIELD_ACTIVE or
+ *                      BGPVIEW_FIELD_INACTIVE), one for each peer, or NULL
+ *                      if all the pfx-peers are to be active
+ * @return 0 if the insertion was successful, <0 otherwise
+ *
+ * This is equivalent to calling bgpview_iter_add_pfx_peer_by_id for the
+ * first peer and bgpview_iter_pfx_add_peer_by_id for the others, and then
+ * activating (or deactivating) each pfx-peer to match its state, but the
+ * prefix is looked up (and, if needed, created and activated) only once and
+ * its pfx-peer table is grown only once. Pfx-peers are added fastest in
+ * increasing peer ID order.
+ *
+ * All the peers must exist, and those of active pfx-peers must be active.
+ * When this function returns successfully, the provided iterator will be
+ * pointing to the last pfx-peer of the row.
+ */
+int bgpview_iter_add_pfx_peers(bgpview_iter_t *iter, bgpstream_pfx_t *pfx,
+                               bgpstream_peer_id_t *peer_ids,
+                               bgpstream_as_path_store_path_id_t *path_ids,
+                               uint8_t *states, int cnt);
+
 /** Remove the current pfx currently referenced by the given iterator
  *
  * @param iter             pointer to a view iterator
@@ -790,6 +1661,10 @@ bgpview_t *bgpview_iter_get_view(bgpview_iter_t *iter);
  * @return the prefix the pfx_iterator is currently pointing at,
  *         NULL if the iterator is not initialized, or has reached the end of
  *         the prefixes.
+ *
+ * The returned prefix is owned by the view (or by the iterator, when IPv4
+ * prefixes are stored as packed keys) and is only valid until the iterator is
+ * moved to another prefix.
  */
 bgpstream_pfx_t *bgpview_iter_pfx_get_pfx(bgpview_iter_t *iter);
 
@@ -805,6 +1680,37 @@ bgpstream_pfx_t *bgpview_iter_pfx_get_pfx(bgpview_iter_t *iter);
  */
 int bgpview_iter_pfx_get_peer_cnt(bgpview_iter_t *iter, uint8_t state_mask);
 
+/** Get the number of peers providing information for the current prefix
+ *  pointed by the given iterator that are also set in the given peer bitset
+ *
+ * @param iter          Pointer to an iterator structure
+ * @param state_mask    mask of pfx-peer states to include in the count
+ * @param peer_bits     dense peer bitset of BGPVIEW_PEER_BITSET_WORDS words
+ *                      (e.g. the set of full-feed peers)
+ * @return the number of matching pfx-peers
+ *
+ * This scans the pfx-peers of the prefix directly and tests each peer id
+ * against the bitset, so it is much cheaper than iterating over the pfx-peers
+ * and probing a peer id set for each of them. The iterator's pfx-peer
+ * position is not changed.
+ */
+int bgpview_iter_pfx_get_peer_bitset_cnt(bgpview_iter_t *iter,
+                                         uint8_t state_mask,
+                                         const uint64_t *peer_bits);
+
+/** Get the distinct origin ASes of the current prefix pointed by the given
+ *  iterator
+ *
+ * @param iter          Pointer to an iterator structure
+ * @param[out] asns     array to fill with (up to len) origin AS numbers
+ * @param len           number of elements in the asns array
+ * @return the number of distinct origin ASes of the active pfx-peers of the
+ *         prefix (which may be more than len), -1 if the origin index is
+ *         disabled (see bgpview_enable_origin_index)
+ */
+int bgpview_iter_pfx_get_origins(bgpview_iter_t *iter, uint32_t *asns,
+                                 int len);
+
 /** Get the state of the current prefix pointed by the given iterator
  *
  * @param iter          Pointer to an iterator structure
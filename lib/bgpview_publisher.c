@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "config.h"
+
+#include "bgpview_publisher.h"
+#include "utils.h"
+
+/* all shared state that readers access without holding the mutex is accessed
+   using sequentially consistent atomics */
+#define ATOMIC_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_SEQ_CST)
+#define ATOMIC_STORE(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_SEQ_CST)
+
+/** A published view */
+typedef struct publication {
+
+  /** The (immutable) view */
+  bgpview_t *view;
+
+  /** Version of the view */
+  uint64_t version;
+
+  /** Value of the publisher epoch after the view was replaced. Readers that
+      entered at this epoch or later cannot be using the view */
+  uint64_t retire_epoch;
+
+  /** Next replaced view */
+  struct publication *next;
+
+} publication_t;
+
+struct bgpview_reader {
+
+  /** Publisher that the reader is registered with */
+  bgpview_publisher_t *pub;
+
+  /** Epoch at which the reader entered its current critical section (0 if it
+      is not in one) */
+  uint64_t epoch;
+
+  /** Version of the view returned by the last enter */
+  uint64_t version;
+
+  /** Next reader registered with the publisher */
+  struct bgpview_reader *next;
+};
+
+struct bgpview_publisher {
+
+  /** Most recent publication (NULL if nothing has been published) */
+  publication_t *current;
+
+  /** Global epoch, incremented every time a view is replaced */
+  uint64_t epoch;
+
+  /** Version of the most recent publication */
+  uint64_t version;
+
+  /** Replaced views that may still be in use */
+  publication_t *retired;
+
+  /** Registered readers */
+  bgpview_reader_t *readers;
+
+  /** Protects everything except the read side of current, epoch and the
+      reader epochs */
+  pthread_mutex_t mutex;
+};
+
+/* destroy the retired views that no reader can be using. the mutex must be
+   held */
+static int reclaim(bgpview_publisher_t *pub)
+{
+  bgpview_reader_t *reader;
+  publication_t **pp, *p;
+  uint64_t min_epoch = UINT64_MAX;
+  uint64_t e;
+  int cnt = 0;
+
+  /* a reader that entered before a view was replaced announced an epoch lower
+     than its retire epoch */
+  for (reader = pub->readers; reader != NULL; reader = reader->next) {
+    if ((e = ATOMIC_LOAD(&reader->epoch)) != 0 && e < min_epoch) {
+      min_epoch = e;
+    }
+  }
+
+  pp = &pub->retired;
+  while ((p = *pp) != NULL) {
+    if (p->retire_epoch <= min_epoch) {
+      *pp = p->next;
+      bgpview_destroy(p->view);
+      free(p);
+    } else {
+      pp = &p->next;
+      cnt++;
+    }
+  }
+
+  return cnt;
+}
+
+bgpview_publisher_t *bgpview_publisher_create(void)
+{
+  bgpview_publisher_t *pub;
+
+  if ((pub = malloc_zero(sizeof(bgpview_publisher_t))) == NULL) {
+    fprintf(stderr, "ERROR: Could not create view publisher\n");
+    return NULL;
+  }
+
+  /* epoch 0 means "not in a critical section" */
+  pub->epoch = 1;
+
+  pthread_mutex_init(&pub->mutex, NULL);
+
+  return pub;
+}
+
+void bgpview_publisher_destroy(bgpview_publisher_t *pub)
+{
+  publication_t *p;
+
+  if (pub == NULL) {
+    return;
+  }
+
+  assert(pub->readers == NULL);
+
+  while ((p = pub->retired) != NULL) {
+    pub->retired = p->next;
+    bgpview_destroy(p->view);
+    free(p);
+  }
+
+  if (pub->current != NULL) {
+    bgpview_destroy(pub->current->view);
+    free(pub->current);
+    pub->current = NULL;
+  }
+
+  pthread_mutex_destroy(&pub->mutex);
+
+  free(pub);
+}
+
+int bgpview_publisher_publish(bgpview_publisher_t *pub, bgpview_t *view)
+{
+  bgpview_t *frozen;
+
+  if ((frozen = bgpview_freeze_detached(view)) == NULL) {
+    return -1;
+  }
+
+  if (bgpview_publisher_publish_view(pub, frozen) != 0) {
+    bgpview_destroy(frozen);
+    return -1;
+  }
+
+  return 0;
+}
+
+int bgpview_publisher_publish_view(bgpview_publisher_t *pub, bgpview_t *view)
+{
+  publication_t *p, *old;
+
+  if ((p = malloc_zero(sizeof(publication_t))) == NULL) {
+    fprintf(stderr, "ERROR: Could not publish view\n");
+    return -1;
+  }
+  p->view = view;
+
+  pthread_mutex_lock(&pub->mutex);
+
+  p->version = ++pub->version;
+
+  /* new readers see the new view from now on... */
+  old = __atomic_exchange_n(&pub->current, p, __ATOMIC_SEQ_CST);
+
+  /* ...so only those that entered before the epoch is incremented may still
+     be using the old one */
+  if (old != NULL) {
+    old->retire_epoch = __atomic_add_fetch(&pub->epoch, 1, __ATOMIC_SEQ_CST);
+    old->next = pub->retired;
+    pub->retired = old;
+  }
+
+  reclaim(pub);
+
+  pthread_mutex_unlock(&pub->mutex);
+
+  return 0;
+}
+
+int bgpview_publisher_reclaim(bgpview_publisher_t *pub)
+{
+  int cnt;
+
+  pthread_mutex_lock(&pub->mutex);
+  cnt = reclaim(pub);
+  pthread_mutex_unlock(&pub->mutex);
+
+  return cnt;
+}
+
+bgpview_reader_t *bgpview_publisher_add_reader(bgpview_publisher_t *pub)
+{
+  bgpview_reader_t *reader;
+
+  if ((reader = malloc_zero(sizeof(bgpview_reader_t))) == NULL) {
+    fprintf(stderr, "ERROR: Could not create view reader\n");
+    return NULL;
+  }
+  reader->pub = pub;
+
+  pthread_mutex_lock(&pub->mutex);
+  reader->next = pub->readers;
+  pub->readers = reader;
+  pthread_mutex_unlock(&pub->mutex);
+
+  return reader;
+}
+
+void bgpview_publisher_remove_reader(bgpview_reader_t *reader)
+{
+  bgpview_publisher_t *pub;
+  bgpview_reader_t **rp;
+
+  if (reader == NULL) {
+    return;
+  }
+  pub = reader->pub;
+
+  assert(reader->epoch == 0);
+
+  pthread_mutex_lock(&pub->mutex);
+  for (rp = &pub->readers; *rp != NULL; rp = &(*rp)->next) {
+    if (*rp == reader) {
+      *rp = reader->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&pub->mutex);
+
+  free(reader);
+}
+
+bgpview_t *bgpview_reader_enter(bgpview_reader_t *reader)
+{
+  publication_t *p;
+
+  assert(reader->epoch == 0);
+
+  /* announce the epoch before loading the view, so that a publisher that
+     replaces the view after we load it sees that we may be using it */
+  ATOMIC_STORE(&reader->epoch, ATOMIC_LOAD(&reader->pub->epoch));
+  if ((p = ATOMIC_LOAD(&reader->pub->current)) == NULL) {
+    reader->version = 0;
+    return NULL;
+  }
+
+  reader->version = p->version;
+  return p->view;
+}
+
+uint64_t bgpview_reader_get_version(bgpview_reader_t *reader)
+{
+  return reader->version;
+}
+
+void bgpview_reader_exit(bgpview_reader_t *reader)
+{
+  ATOMIC_STORE(&reader->epoch, 0);
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPVIEW_PUBLISHER_H
+#define __BGPVIEW_PUBLISHER_H
+
+#include <stdint.h>
+
+#include "bgpview.h"
+
+/** @file
+ *
+ * @brief Header file that exposes the public interface of the bgpview
+ * publisher
+ *
+ * A publisher hands immutable views from a writer thread to any number of
+ * reader threads without the writer ever waiting for the readers. The writer
+ * keeps modifying its own view, and periodically publishes a frozen copy of it
+ * (see bgpview_freeze_detached). Readers pick up the most recently published
+ * view in a short critical section that takes no locks, and iterate over it
+ * for as long as they like. Views that have been replaced by a newer one are
+ * destroyed once no reader can still be using them (i.e., using epoch-based
+ * reclamation).
+ *
+ * Each reader must be used by a single thread, but the publisher may be
+ * shared by any number of readers and writers.
+ */
+
+/**
+ * @name Public Opaque Data Structures
+ *
+ * @{ */
+
+/** Opaque structure representing a view publisher */
+typedef struct bgpview_publisher bgpview_publisher_t;
+
+/** Opaque structure representing a reader of a view publisher */
+typedef struct bgpview_reader bgpview_reader_t;
+
+/** @} */
+
+/**
+ * @name Public API Functions
+ *
+ * @{ */
+
+/** Create a new view publisher
+ *
+ * @return pointer to the publisher created, NULL if an error occurred
+ */
+bgpview_publisher_t *bgpview_publisher_create(void);
+
+/** Destroy the given publisher, along with all the views it holds
+ *
+ * @param pub           pointer to the publisher to destroy
+ *
+ * All readers must have been removed before the publisher is destroyed.
+ */
+void bgpview_publisher_destroy(bgpview_publisher_t *pub);
+
+/** Publish a frozen copy of a view
+ *
+ * @param pub           pointer to the publisher
+ * @param view          pointer to the view to publish a copy of
+ * @return 0 if the view was published successfully, -1 otherwise
+ *
+ * The copy is created using bgpview_freeze_detached, so the caller may go on
+ * modifying (or destroy) the view as soon as this function returns.
+ */
+int bgpview_publisher_publish(bgpview_publisher_t *pub, bgpview_t *view);
+
+/** Publish a view, handing it over to the publisher
+ *
+ * @param pub           pointer to the publisher
+ * @param view          pointer to the view to publish
+ * @return 0 if the view was published successfully, -1 otherwise
+ *
+ * The publisher takes ownership of the view, and destroys it once it has been
+ * replaced and no reader can be using it any more. The view must never be
+ * modified again, and must not share tables with any view that is (e.g., it
+ * was created using bgpview_freeze_detached).
+ */
+int bgpview_publisher_publish_view(bgpview_publisher_t *pub, bgpview_t *view);
+
+/** Destroy the replaced views that no reader can be using any more
+ *
+ * @param pub           pointer to the publisher
+ * @return the number of replaced views that are still (possibly) in use
+ *
+ * This is done by every publication, so it only needs to be called to release
+ * memory sooner when views are published infrequently.
+ */
+int bgpview_publisher_reclaim(bgpview_publisher_t *pub);
+
+/** Register a new reader with the publisher
+ *
+ * @param pub           pointer to the publisher
+ * @return pointer to the reader created, NULL if an error occurred
+ */
+bgpview_reader_t *bgpview_publisher_add_reader(bgpview_publisher_t *pub);
+
+/** Unregister (and destroy) a reader
+ *
+ * @param reader        pointer to the reader to remove
+ *
+ * The reader must not be inside a critical section (see bgpview_reader_enter).
+ */
+void bgpview_publisher_remove_reader(bgpview_reader_t *reader);
+
+/** Enter a read-side critical section and get the current view
+ *
+ * @param reader        pointer to the reader
+ * @return pointer to the most recently published view, NULL if no view has
+ *         been published yet
+ *
+ * The returned view remains valid until bgpview_reader_exit is called, even
+ * if a newer view is published in the meantime. It must not be modified (it
+ * may be iterated over using any number of iterators). Critical sections do
+ * not nest. A reader that stays in a critical section delays the destruction
+ * of all views published after the one it holds, so readers should exit as
+ * soon as they are done with a view.
+ */
+bgpview_t *bgpview_reader_enter(bgpview_reader_t *reader);
+
+/** Get the version of the view returned by the last bgpview_reader_enter
+ *
+ * @param reader        pointer to the reader
+ * @return the version of the view (versions start at 1, and are incremented by
+ *         every publication), 0 if no view has been published
+ */
+uint64_t bgpview_reader_get_version(bgpview_reader_t *reader);
+
+/** Exit a read-side critical section
+ *
+ * @param reader        pointer to the reader
+ *
+ * The view returned by bgpview_reader_enter must not be used afterwards.
+ */
+void bgpview_reader_exit(bgpview_reader_t *reader);
+
+/** @} */
+
+#endif /* __BGPVIEW_PUBLISHER_H */
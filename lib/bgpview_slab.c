@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "config.h"
+
+#include "bgpview_slab.h"
+
+/* objects are aligned to this many bytes so that the free list pointer that is
+   stored in a free object can be accessed safely */
+#define SLAB_ALIGN 8
+
+/** A chunk of memory that objects are carved from */
+typedef struct slab_chunk {
+
+  /** Next chunk in the list of chunks owned by the slab */
+  struct slab_chunk *next;
+
+  /* objects follow the header (which is SLAB_ALIGN aligned) */
+
+} slab_chunk_t;
+
+struct bgpview_slab {
+
+  /** Size of each object (rounded up to SLAB_ALIGN) */
+  size_t obj_size;
+
+  /** Number of objects in each chunk */
+  uint32_t chunk_objs;
+
+  /** List of chunks allocated from the system */
+  slab_chunk_t *chunks;
+
+  /** Next never-used object in the most recent chunk */
+  uint8_t *bump;
+
+  /** Number of never-used objects left in the most recent chunk */
+  uint32_t bump_left;
+
+  /** List of freed objects (linked through the first word of each object) */
+  void *free_list;
+
+  /** Usage statistics */
+  bgpview_slab_stats_t stats;
+};
+
+#define CHUNK_HDR_SIZE                                                         \
+  ((sizeof(slab_chunk_t) + SLAB_ALIGN - 1) & ~((size_t)SLAB_ALIGN - 1))
+
+static int slab_grow(bgpview_slab_t *slab)
+{
+  slab_chunk_t *chunk;
+  size_t size = CHUNK_HDR_SIZE + (slab->obj_size * slab->chunk_objs);
+
+  if ((chunk = malloc(size)) == NULL) {
+    return -1;
+  }
+  chunk->next = slab->chunks;
+  slab->chunks = chunk;
+
+  slab->bump = (uint8_t *)chunk + CHUNK_HDR_SIZE;
+  slab->bump_left = slab->chunk_objs;
+
+  slab->stats.chunk_cnt++;
+  slab->stats.chunk_bytes += size;
+  return 0;
+}
+
+bgpview_slab_t *bgpview_slab_create(size_t obj_size, uint32_t chunk_objs)
+{
+  bgpview_slab_t *slab;
+
+  assert(obj_size > 0 && chunk_objs > 0);
+
+  if ((slab = calloc(1, sizeof(bgpview_slab_t))) == NULL) {
+    return NULL;
+  }
+
+  if (obj_size < sizeof(void *)) {
+    obj_size = sizeof(void *);
+  }
+  slab->obj_size = (obj_size + SLAB_ALIGN - 1) & ~((size_t)SLAB_ALIGN - 1);
+  slab->chunk_objs = chunk_objs;
+  slab->stats.obj_size = slab->obj_size;
+
+  return slab;
+}
+
+void bgpview_slab_destroy(bgpview_slab_t *slab)
+{
+  slab_chunk_t *chunk;
+
+  if (slab == NULL) {
+    return;
+  }
+
+  while ((chunk = slab->chunks) != NULL) {
+    slab->chunks = chunk->next;
+    free(chunk);
+  }
+
+  free(slab);
+}
+
+void *bgpview_slab_alloc(bgpview_slab_t *slab)
+{
+  void *obj;
+
+  if (slab->free_list != NULL) {
+    obj = slab->free_list;
+    slab->free_list = *(void **)obj;
+    slab->stats.free_cnt--;
+  } else {
+    if (slab->bump_left == 0 && slab_grow(slab) != 0) {
+      return NULL;
+    }
+    obj = slab->bump;
+    slab->bump += slab->obj_size;
+    slab->bump_left--;
+  }
+
+  if (++slab->stats.used_cnt > slab->stats.high_water_cnt) {
+    slab->stats.high_water_cnt = slab->stats.used_cnt;
+  }
+  return obj;
+}
+
+void bgpview_slab_free(bgpview_slab_t *slab, void *obj)
+{
+  if (obj == NULL) {
+    return;
+  }
+  assert(slab->stats.used_cnt > 0);
+
+  *(void **)obj = slab->free_list;
+  slab->free_list = obj;
+
+  slab->stats.used_cnt--;
+  slab->stats.free_cnt++;
+}
+
+void bgpview_slab_get_stats(bgpview_slab_t *slab, bgpview_slab_stats_t *stats)
+{
+  *stats = slab->stats;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2014 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPVIEW_SLAB_H
+#define __BGPVIEW_SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Internal fixed-size object allocator used by bgpview
+ *
+ * A slab hands out objects of a single size carved from large chunks, and
+ * recycles freed objects through an intrusive free list. Memory is only
+ * returned to the system when the slab is destroyed, at which point all
+ * outstanding objects are released in bulk.
+ *
+ * A slab is NOT thread safe.
+ */
+
+/** Opaque structure representing a slab */
+typedef struct bgpview_slab bgpview_slab_t;
+
+/** Usage statistics for a slab */
+typedef struct bgpview_slab_stats {
+
+  /** Size (in bytes) of each object handed out by the slab (including
+      alignment padding) */
+  size_t obj_size;
+
+  /** Number of chunks allocated from the system */
+  uint64_t chunk_cnt;
+
+  /** Number of bytes allocated from the system */
+  uint64_t chunk_bytes;
+
+  /** Number of objects currently handed out */
+  uint64_t used_cnt;
+
+  /** Number of freed objects waiting in the free list */
+  uint64_t free_cnt;
+
+  /** Maximum number of objects that have been handed out at once */
+  uint64_t high_water_cnt;
+
+} bgpview_slab_stats_t;
+
+/** Create a new slab
+ *
+ * @param obj_size      size of the objects the slab will hand out
+ * @param chunk_objs    number of objects to allocate in each chunk
+ * @return pointer to the slab created, NULL if an error occurred
+ */
+bgpview_slab_t *bgpview_slab_create(size_t obj_size, uint32_t chunk_objs);
+
+/** Destroy the given slab, releasing all objects allocated from it
+ *
+ * @param slab          pointer to the slab to destroy
+ */
+void bgpview_slab_destroy(bgpview_slab_t *slab);
+
+/** Allocate an (uninitialized) object from the slab
+ *
+ * @param slab          pointer to the slab to allocate from
+ * @return pointer to the object, NULL if an error occurred
+ */
+void *bgpview_slab_alloc(bgpview_slab_t *slab);
+
+/** Return an object to the slab
+ *
+ * @param slab          pointer to the slab the object was allocated from
+ * @param obj           pointer to the object to free
+ */
+void bgpview_slab_free(bgpview_slab_t *slab, void *obj);
+
+/** Get usage statistics for the given slab
+ *
+ * @param slab          pointer to the slab
+ * @param stats         pointer to a stats structure to fill
+ */
+void bgpview_slab_get_stats(bgpview_slab_t *slab, bgpview_slab_stats_t *stats);
+
+#endif /* __BGPVIEW_SLAB_H */
@@ -57,6 +57,12 @@
 
 #define BVC_GET_CHAIN_STATE(consumer) ((consumer)->chain_state)
 
+/** Convenience macro to check whether a peer is a full-feed peer for the IP
+ *  version with the given index (requires the visibility consumer) */
+#define BVC_IS_FULL_FEED_PEER(consumer, ipv_idx, peerid)                       \
+  BGPVIEW_PEER_BITSET_TEST(                                                    \
+    BVC_GET_CHAIN_STATE(consumer)->full_feed_peer_bits[ipv_idx], peerid)
+
 /** Convenience macro that defines all the function prototypes for the
  * timeseries
  * consumer API
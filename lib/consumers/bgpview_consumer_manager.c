@@ -272,6 +272,8 @@ static int init_bvc_chain_state(bgpview_consumer_manager_t *mgr)
 
   for (i = 0; i < BGPSTREAM_MAX_IP_VERSION_IDX; i++) {
     mgr->chain_state.full_feed_peer_ids[i] = bgpstream_id_set_create();
+    memset(mgr->chain_state.full_feed_peer_bits[i], 0,
+           sizeof(mgr->chain_state.full_feed_peer_bits[i]));
     mgr->chain_state.peer_ids_cnt[i] = 0;
     mgr->chain_state.full_feed_peer_asns_cnt[i] = 0;
     mgr->chain_state.usable_table_flag[i] = 0;
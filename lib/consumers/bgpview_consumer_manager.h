@@ -89,6 +89,11 @@ typedef struct bvc_chain_state {
   /* Set of full feed peers */
   bgpstream_id_set_t *full_feed_peer_ids[BGPSTREAM_MAX_IP_VERSION_IDX];
 
+  /** Dense bitsets of the full feed peers (same content as
+   *  full_feed_peer_ids, use BVC_IS_FULL_FEED_PEER for per-cell checks) */
+  uint64_t full_feed_peer_bits[BGPSTREAM_MAX_IP_VERSION_IDX]
+                              [BGPVIEW_PEER_BITSET_WORDS];
+
   /** Total number of full feed peer ASns in the view */
   uint32_t full_feed_peer_asns_cnt[BGPSTREAM_MAX_IP_VERSION_IDX];
 
@@ -323,7 +323,6 @@ int bvc_announcedpfxs_process_view(bvc_t *consumer, bgpview_t *view)
   bgpview_iter_t *it;
   bgpstream_pfx_t *pfx;
 
-  bgpstream_peer_id_t peerid;
   int ipv4_idx = bgpstream_ipv2idx(BGPSTREAM_ADDR_VERSION_IPV4);
 
   if ((it = bgpview_iter_create(view)) == NULL) {
@@ -356,17 +355,12 @@ int bvc_announcedpfxs_process_view(bvc_t *consumer, bgpview_t *view)
       kh_value(state->v4pfx_ts, k) = 0;
     }
 
-    for (bgpview_iter_pfx_first_peer(it, BGPVIEW_FIELD_ACTIVE);
-         bgpview_iter_pfx_has_more_peer(it); bgpview_iter_pfx_next_peer(it)) {
-      /* only consider peers that are full-feed */
-      peerid = bgpview_iter_peer_get_peer_id(it);
-      if (bgpstream_id_set_exists(
-            BVC_GET_CHAIN_STATE(consumer)->full_feed_peer_ids[ipv4_idx],
-            peerid)) {
-        /* update the prefix timestamp */
-        kh_value(state->v4pfx_ts, k) = current_view_ts;
-        break;
-      }
+    /* only consider prefixes observed by at least one full-feed peer */
+    if (bgpview_iter_pfx_get_peer_bitset_cnt(
+          it, BGPVIEW_FIELD_ACTIVE,
+          BVC_GET_CHAIN_STATE(consumer)->full_feed_peer_bits[ipv4_idx]) > 0) {
+      /* update the prefix timestamp */
+      kh_value(state->v4pfx_ts, k) = current_view_ts;
     }
   }
 
@@ -56,7 +56,7 @@
 static bvc_t bvc_archiver = {BVC_ID_ARCHIVER, NAME,
                              BVC_GENERATE_PTRS(archiver)};
 
-enum format { BINARY, ASCII };
+enum format { BINARY, ASCII, BINARY_V1 };
 
 typedef struct bvc_archiver_state {
 
@@ -72,9 +72,18 @@ typedef struct bvc_archiver_state {
   /** Current output file */
   iow_t *outfile;
 
-  /** Output format (binary or ascii) */
+  /** Output format (binary, ascii or v1 binary) */
   enum format output_format;
 
+  /** Write an index alongside each (binary) output file */
+  int write_index;
+
+  /** Index of the current output file */
+  iow_t *idxfile;
+
+  /** Offset of the next view in the (uncompressed) current output file */
+  uint64_t outfile_offset;
+
   /** Filename to use for the 'latest file' file */
   char *latest_filename;
 
@@ -87,6 +96,16 @@ typedef struct bvc_archiver_state {
   /** First view written to the current output file */
   uint32_t next_rotate_time;
 
+  /** Write a full ("sync") view every sync_interval views, and diff views in
+      between (0 to only write full views) */
+  int sync_interval;
+
+  /** Number of views written since the last sync view */
+  int views_since_sync;
+
+  /** Snapshot of the last view written (that the next diff view is against) */
+  bgpview_t *parent_view;
+
 } bvc_archiver_state_t;
 
 #define SHOULD_ROTATE(state, time)                                             \
@@ -108,8 +127,13 @@ static void usage(bvc_t *consumer)
     "       -l <filename> file to write the filename of the latest complete "
     "output file to\n"
     "       -c <level>    output compression level to use (default: %d)\n"
-    "       -m <mode>     output mode: 'ascii' or 'binary' (default: "
-    "binary)\n",
+    "       -m <mode>     output mode: 'ascii', 'binary' or 'binary-v1' "
+    "(default: binary)\n"
+    "       -i            write an index alongside each binary output file "
+    "(<file>" BGPVIEW_IO_FILE_INDEX_SUFFIX ")\n"
+    "       -s <n>        write a full view every n views, and only the "
+    "changes since the previous view in between (implies -i, default: full "
+    "views)\n",
     consumer->name, BVCU_DEFAULT_COMPRESS_LEVEL);
 }
 
@@ -151,6 +175,15 @@ static int complete_file(bvc_t *consumer)
   wandio_wdestroy(state->outfile);
   state->outfile = NULL;
 
+  /* each file starts with a sync view */
+  bgpview_destroy(state->parent_view);
+  state->parent_view = NULL;
+
+  if (state->idxfile != NULL) {
+    wandio_wdestroy(state->idxfile);
+    state->idxfile = NULL;
+  }
+
   /* now write the name of that file to the latest file */
   if (state->latest_filename == NULL) {
     return 0;
@@ -243,7 +276,7 @@ static int parse_args(bvc_t *consumer, int argc, char **argv)
   optind = 1;
 
   /* remember the argv strings DO NOT belong to us */
-  while ((opt = getopt(argc, argv, ":c:f:l:m:r:?a")) >= 0) {
+  while ((opt = getopt(argc, argv, ":c:f:l:m:r:s:?ai")) >= 0) {
     switch (opt) {
     case 'a':
       state->rotate_noalign = 1;
@@ -253,6 +286,10 @@ static int parse_args(bvc_t *consumer, int argc, char **argv)
       state->outfile_compress_level = atoi(optarg);
       break;
 
+    case 'i':
+      state->write_index = 1;
+      break;
+
     case 'f':
       if ((state->outfile_pattern = strdup(optarg)) == NULL) {
         return -1;
@@ -270,9 +307,11 @@ static int parse_args(bvc_t *consumer, int argc, char **argv)
         state->output_format = ASCII;
       } else if (strcmp(optarg, "binary") == 0) {
         state->output_format = BINARY;
+      } else if (strcmp(optarg, "binary-v1") == 0) {
+        state->output_format = BINARY_V1;
       } else {
-        fprintf(stderr,
-                "ERROR: Output mode must be either 'ascii' or 'binary'\n");
+        fprintf(stderr, "ERROR: Output mode must be one of 'ascii', 'binary' "
+                        "or 'binary-v1'\n");
         usage(consumer);
         return -1;
       }
@@ -282,6 +321,10 @@ static int parse_args(bvc_t *consumer, int argc, char **argv)
       state->rotation_interval = atoi(optarg);
       break;
 
+    case 's':
+      state->sync_interval = atoi(optarg);
+      break;
+
     case '?':
     case ':':
     default:
@@ -340,6 +383,24 @@ int bvc_archiver_init(bvc_t *consumer, int argc, char **argv)
     state->rotation_interval = 0;
   }
 
+  if (state->sync_interval > 0 && state->output_format != BINARY) {
+    fprintf(stderr, "WARN: Diff views are only written to binary (v2) output "
+                    "files\n");
+    state->sync_interval = 0;
+  }
+
+  /* files of diff views can only be seeked in using their index */
+  if (state->sync_interval > 0) {
+    state->write_index = 1;
+  }
+
+  if (state->write_index != 0 && (state->output_format != BINARY ||
+                                  strcmp("-", state->outfile_pattern) == 0)) {
+    fprintf(stderr, "WARN: Indexes are only written for binary (v2) output "
+                    "files\n");
+    state->write_index = 0;
+  }
+
   /* outfile is opened when first view is processed */
 
   return 0;
@@ -367,6 +428,9 @@ void bvc_archiver_destroy(bvc_t *consumer)
   free(state->latest_filename);
   state->latest_filename = NULL;
 
+  bgpview_destroy(state->parent_view);
+  state->parent_view = NULL;
+
   free(state);
 
   BVC_SET_STATE(consumer, NULL);
@@ -379,6 +443,8 @@ int bvc_archiver_process_view(bvc_t *consumer, bgpview_t *view)
   uint32_t view_time = bgpview_get_time(view);
   uint32_t file_time = view_time;
   int compress_type;
+  char idxname[BUFFER_LEN];
+  bgpview_t *parent_view = NULL;
 
   if (state->outfile == NULL || SHOULD_ROTATE(state, view_time)) {
     if (state->rotation_interval > 0) {
@@ -408,6 +474,18 @@ int bvc_archiver_process_view(bvc_t *consumer, bgpview_t *view)
               state->outfile_name);
       goto err;
     }
+    state->outfile_offset = 0;
+
+    if (state->write_index != 0) {
+      snprintf(idxname, sizeof(idxname), "%s" BGPVIEW_IO_FILE_INDEX_SUFFIX,
+               state->outfile_name);
+      /* force no compression, ignore the extension */
+      if ((state->idxfile = wandio_wcreate(idxname, WANDIO_COMPRESS_NONE, 0,
+                                           O_CREAT)) == NULL) {
+        fprintf(stderr, "ERROR: Could not open %s for writing\n", idxname);
+        goto err;
+      }
+    }
   }
 
   switch (state->output_format) {
@@ -419,8 +497,38 @@ int bvc_archiver_process_view(bvc_t *consumer, bgpview_t *view)
     break;
 
   case BINARY:
+    /* write a diff against the last view, unless a sync view is due */
+    if (state->parent_view != NULL &&
+        state->views_since_sync < state->sync_interval) {
+      parent_view = state->parent_view;
+      state->views_since_sync++;
+    } else {
+      state->views_since_sync = 1;
+    }
     /* simply ask the IO library to dump the view to a file */
-    if (bgpview_io_file_write(state->outfile, view, NULL, NULL) != 0) {
+    if (state->idxfile != NULL) {
+      if (bgpview_io_file_write_indexed(state->outfile, state->idxfile,
+                                        &state->outfile_offset, view,
+                                        parent_view, NULL, NULL) != 0) {
+        fprintf(stderr, "ERROR: Failed to write view to file\n");
+        goto err;
+      }
+    } else if (bgpview_io_file_write_diff(state->outfile, view, parent_view,
+                                          NULL, NULL) != 0) {
+      fprintf(stderr, "ERROR: Failed to write view to file\n");
+      goto err;
+    }
+    if (state->sync_interval > 0) {
+      bgpview_destroy(state->parent_view);
+      if ((state->parent_view = bgpview_snapshot(view)) == NULL) {
+        fprintf(stderr, "ERROR: Could not snapshot view\n");
+        goto err;
+      }
+    }
+    break;
+
+  case BINARY_V1:
+    if (bgpview_io_file_write_v1(state->outfile, view, NULL, NULL) != 0) {
       fprintf(stderr, "ERROR: Failed to write view to file\n");
       goto err;
     }
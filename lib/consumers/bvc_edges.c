@@ -507,9 +507,7 @@ static int print_new_newrec(bvc_t *consumer, bgpstream_pfx_t *pfx,
 
         // printing a path for each peer
         peerid = bgpview_iter_peer_get_peer_id(it);
-        if (bgpstream_id_set_exists(
-              BVC_GET_CHAIN_STATE(consumer)->full_feed_peer_ids[ipv_idx],
-              peerid)) {
+        if (BVC_IS_FULL_FEED_PEER(consumer, ipv_idx, peerid)) {
 
           if (bvcu_print_pfx_peer_as_path(state->file_newedges, it, "", " ") < 0)
             return -1;
@@ -555,9 +553,7 @@ static int print_new_newrec(bvc_t *consumer, bgpstream_pfx_t *pfx,
 
         // printing a path for each peer
         peerid = bgpview_iter_peer_get_peer_id(it);
-        if (bgpstream_id_set_exists(
-              BVC_GET_CHAIN_STATE(consumer)->full_feed_peer_ids[ipv_idx],
-              peerid)) {
+        if (BVC_IS_FULL_FEED_PEER(consumer, ipv_idx, peerid)) {
 
           if (bvcu_print_pfx_peer_as_path(state->file_newedges, it, "", " ") < 0)
             return -1;
@@ -843,9 +839,7 @@ int bvc_edges_process_view(bvc_t *consumer, bgpview_t *view)
       /* only consider peers that are full-feed */
       peerid = bgpview_iter_peer_get_peer_id(it);
 
-      if (bgpstream_id_set_exists(
-            BVC_GET_CHAIN_STATE(consumer)->full_feed_peer_ids[ipv_idx],
-            peerid)) {
+      if (BVC_IS_FULL_FEED_PEER(consumer, ipv_idx, peerid)) {
         /* get origin asn */
         if ((origin_seg = bgpview_iter_pfx_peer_get_origin_seg(it)) == NULL) {
           return -1;
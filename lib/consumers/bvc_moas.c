@@ -385,9 +385,7 @@ static int log_moas(bvc_t *consumer, bgpview_t *view, bgpview_iter_t *it,
 
       // printing a path for each peer
       peerid = bgpview_iter_peer_get_peer_id(it);
-      if (bgpstream_id_set_exists(
-            BVC_GET_CHAIN_STATE(consumer)->full_feed_peer_ids[ipv_idx],
-            peerid)) {
+      if (BVC_IS_FULL_FEED_PEER(consumer, ipv_idx, peerid)) {
 
         // if it's not the first path, print ":" at the beginning of the path
         if (first_path != 1 && wandio_printf(state->wandio_fh, ":") == -1) {
@@ -820,9 +818,7 @@ int bvc_moas_process_view(bvc_t *consumer, bgpview_t *view)
 
       /* only consider peers that are full-feed */
 
-      if (bgpstream_id_set_exists(
-            BVC_GET_CHAIN_STATE(consumer)->full_feed_peer_ids[ipv_idx],
-            peerid)) {
+      if (BVC_IS_FULL_FEED_PEER(consumer, ipv_idx, peerid)) {
 
         /* get origin asn */
         if ((origin_seg = bgpview_iter_pfx_peer_get_origin_seg(it)) == NULL) {
@@ -244,28 +244,10 @@ static int create_ts_metrics(bvc_t *consumer)
   return 0;
 }
 
-/* returns 0 if they are the same */
-static int diff_cells(bgpview_iter_t *parent_view_it, bgpview_iter_t *itC)
+static int path_changed(bgpview_iter_t *parent_view_it, bgpview_iter_t *it,
+                        void *user)
 {
-  bgpstream_as_path_store_path_id_t idxH =
-    bgpview_iter_pfx_peer_get_as_path_store_path_id(parent_view_it);
-  bgpstream_as_path_store_path_id_t idxC =
-    bgpview_iter_pfx_peer_get_as_path_store_path_id(itC);
-
-  return bcmp(&idxH, &idxC, sizeof(bgpstream_as_path_store_path_id_t)) != 0;
-}
-
-static int diff_paths(bvc_t *consumer, bgpview_t *view)
-{
-  if (STATE->parent_view == NULL) {
-    /* nothing to compare with */
-    return 0;
-  }
-
-  bgpview_iter_t *it;
-  bgpview_iter_t *parent_view_it;
-  bgpstream_pfx_t *pfx;
-  bgpstream_peer_id_t peer_id;
+  bvc_t *consumer = (bvc_t *)user;
 
   char pfx_str[INET6_ADDRSTRLEN + 3] = "";
   bgpstream_peer_sig_t *ps;
@@ -275,74 +257,50 @@ static int diff_paths(bvc_t *consumer, bgpview_t *view)
   char new_path_str[4096] = "";
   bgpstream_as_path_t *new_path = NULL;
 
-  if ((it = bgpview_iter_create(view)) == NULL) {
-    return -1;
-  }
-
-  if ((parent_view_it = bgpview_iter_create(STATE->parent_view)) == NULL) {
-    return -1;
+  /* there is currently a bug somewhere that causes us to use different path
+   * store IDs for the same effective path, so we need to do a full check of
+   * the paths */
+  old_path = bgpview_iter_pfx_peer_get_as_path(parent_view_it);
+  new_path = bgpview_iter_pfx_peer_get_as_path(it);
+  if (bgpstream_as_path_equal(old_path, new_path) == 0) {
+    bgpstream_pfx_snprintf(pfx_str, INET6_ADDRSTRLEN + 3,
+                           bgpview_iter_pfx_get_pfx(it));
+    ps = bgpview_iter_peer_get_sig(it);
+    bgpstream_addr_ntop(peer_str, INET6_ADDRSTRLEN, &ps->peer_ip_addr);
+    bgpstream_as_path_snprintf(old_path_str, 4096, old_path);
+    bgpstream_as_path_snprintf(new_path_str, 4096, new_path);
+
+    wandio_printf(STATE->outfile, "%" PRIu32 "|" /* time */
+                                  "%s|"          /* prefix */
+                                  "%s|"          /* collector */
+                                  "%" PRIu32 "|" /* peer ASN */
+                                  "%s|"          /* peer IP */
+                                  "%s|"          /* old-path */
+                                  "%s"           /* new-path */
+                                  "\n",
+                  bgpview_get_time(bgpview_iter_get_view(it)), pfx_str,
+                  ps->collector_str, ps->peer_asnumber, peer_str,
+                  old_path_str, new_path_str);
   }
+  bgpstream_as_path_destroy(old_path);
+  bgpstream_as_path_destroy(new_path);
 
-  /* for each prefix in view */
-  for (bgpview_iter_first_pfx(it, 0, BGPVIEW_FIELD_ACTIVE); //
-       bgpview_iter_has_more_pfx(it);                       //
-       bgpview_iter_next_pfx(it)) {
-
-    pfx = bgpview_iter_pfx_get_pfx(it);
-
-    if (bgpview_iter_seek_pfx(parent_view_it, pfx, BGPVIEW_FIELD_ACTIVE) == 0) {
-      // this is a new prefix, skip it...
-      continue;
-    }
-
-    for (bgpview_iter_pfx_first_peer(it, BGPVIEW_FIELD_ACTIVE); //
-         bgpview_iter_pfx_has_more_peer(it);                    //
-         bgpview_iter_pfx_next_peer(it)) {
-
-      peer_id = bgpview_iter_peer_get_peer_id(it);
+  return 0;
+}
 
-      /* is it in parent view? */
-      if (bgpview_iter_pfx_seek_peer(parent_view_it, peer_id,
-                                     BGPVIEW_FIELD_ACTIVE) == 0) {
-        // new peer, skip it...
-        continue;
-      }
+static int diff_paths(bvc_t *consumer, bgpview_t *view)
+{
+  /* new prefixes and new pfx-peers are skipped, we only want the pfx-peers
+     whose path changed */
+  bgpview_diff_cbs_t cbs = {0};
+  cbs.pfx_peer_changed = path_changed;
 
-      /* is the path different? */
-      if (diff_cells(parent_view_it, it) != 0) {
-        /* there is currently a bug somewhere that causes us to use different
-         * path store IDs for the same effective path, so we need to do a full
-         * check of the paths */
-        old_path = bgpview_iter_pfx_peer_get_as_path(parent_view_it);
-        new_path = bgpview_iter_pfx_peer_get_as_path(it);
-        if (bgpstream_as_path_equal(old_path, new_path) == 0) {
-          bgpstream_pfx_snprintf(pfx_str, INET6_ADDRSTRLEN + 3, pfx);
-          ps = bgpview_iter_peer_get_sig(it);
-          bgpstream_addr_ntop(peer_str, INET6_ADDRSTRLEN, &ps->peer_ip_addr);
-          bgpstream_as_path_snprintf(old_path_str, 4096, old_path);
-          bgpstream_as_path_snprintf(new_path_str, 4096, new_path);
-
-          wandio_printf(STATE->outfile, "%" PRIu32 "|" /* time */
-                                        "%s|"          /* prefix */
-                                        "%s|"          /* collector */
-                                        "%" PRIu32 "|" /* peer ASN */
-                                        "%s|"          /* peer IP */
-                                        "%s|"          /* old-path */
-                                        "%s"           /* new-path */
-                                        "\n",
-                        bgpview_get_time(view), pfx_str, ps->collector_str,
-                        ps->peer_asnumber, peer_str, old_path_str,
-                        new_path_str);
-        }
-        bgpstream_as_path_destroy(old_path);
-        bgpstream_as_path_destroy(new_path);
-      }
-    }
+  if (STATE->parent_view == NULL) {
+    /* nothing to compare with */
+    return 0;
   }
 
-  bgpview_iter_destroy(it);
-  bgpview_iter_destroy(parent_view_it);
-  return 0;
+  return bgpview_diff(STATE->parent_view, view, &cbs, NULL, consumer);
 }
 
 /* ==================== CONSUMER INTERFACE FUNCTIONS ==================== */
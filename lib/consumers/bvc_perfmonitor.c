@@ -91,6 +91,47 @@ static char *graphite_safe(char *p)
   return r;
 }
 
+static void dump_mem_table(bvc_t *consumer, uint32_t time, const char *name,
+                           bgpview_mem_table_stats_t *ts)
+{
+  DUMP_METRIC(ts->bytes, time, "mem.%s.bytes", CHAIN_STATE->metric_prefix,
+              name);
+  DUMP_METRIC(ts->entries, time, "mem.%s.entries", CHAIN_STATE->metric_prefix,
+              name);
+  DUMP_METRIC(ts->slots, time, "mem.%s.slots", CHAIN_STATE->metric_prefix,
+              name);
+  DUMP_METRIC((uint64_t)(ts->load_factor * 100), time,
+              "mem.%s.load_factor_pct", CHAIN_STATE->metric_prefix, name);
+}
+
+static void dump_mem_stats(bvc_t *consumer, bgpview_t *view)
+{
+  bgpview_mem_stats_t stats;
+  uint32_t time = bgpview_get_time(view);
+
+  bgpview_get_mem_stats(view, &stats);
+
+  dump_mem_table(consumer, time, "v4pfxs", &stats.v4pfxs);
+  dump_mem_table(consumer, time, "v6pfxs", &stats.v6pfxs);
+  dump_mem_table(consumer, time, "pfx_peers", &stats.pfx_peers);
+  dump_mem_table(consumer, time, "peers", &stats.peers);
+  dump_mem_table(consumer, time, "pathstore", &stats.pathstore);
+  dump_mem_table(consumer, time, "peersigns", &stats.peersigns);
+
+  DUMP_METRIC(stats.pfxs_shared_cnt, time, "%s", CHAIN_STATE->metric_prefix,
+              "mem.pfxs_shared_cnt");
+  DUMP_METRIC(stats.pfx_user_cnt, time, "%s", CHAIN_STATE->metric_prefix,
+              "mem.pfx_user_cnt");
+  DUMP_METRIC(stats.peer_user_cnt, time, "%s", CHAIN_STATE->metric_prefix,
+              "mem.peer_user_cnt");
+  DUMP_METRIC(stats.pfx_peer_user_cnt, time, "%s", CHAIN_STATE->metric_prefix,
+              "mem.pfx_peer_user_cnt");
+  DUMP_METRIC(stats.peer_index_bytes, time, "%s", CHAIN_STATE->metric_prefix,
+              "mem.peer_index_bytes");
+  DUMP_METRIC(stats.view_bytes, time, "%s", CHAIN_STATE->metric_prefix,
+              "mem.view_bytes");
+}
+
 /** Parse the arguments given to the consumer */
 static int parse_args(bvc_t *consumer, int argc, char **argv)
 {
@@ -197,6 +238,8 @@ int bvc_perfmonitor_process_view(bvc_t *consumer, bgpview_t *view)
   /* destroy the view iterator */
   bgpview_iter_destroy(it);
 
+  dump_mem_stats(consumer, view);
+
   STATE->view_cnt++;
 
   uint32_t time_end = epoch_sec();
@@ -760,8 +760,7 @@ int bvc_pfx2as_process_view(bvc_t *consumer, bgpview_t *view)
       bgpstream_as_path_store_path_id_t path_id =
         bgpview_iter_pfx_peer_get_as_path_store_path_id(vit);
       bgpstream_as_path_seg_t *origin = NULL;
-      int is_full =
-        bgpstream_id_set_exists(CHAIN_STATE->full_feed_peer_ids[vidx], peer_id);
+      int is_full = BVC_IS_FULL_FEED_PEER(consumer, vidx, peer_id);
 
       // Most prefixes have one origin, so a linear search is efficient
       int oi; // origin index
@@ -545,9 +545,7 @@ int bvc_pfxorigins_process_view(bvc_t *consumer, bgpview_t *view)
       /* only consider peers that are full-feed */
       peerid = bgpview_iter_peer_get_peer_id(it);
 
-      if (bgpstream_id_set_exists(
-            BVC_GET_CHAIN_STATE(consumer)->full_feed_peer_ids[ipv_idx],
-            peerid)) {
+      if (BVC_IS_FULL_FEED_PEER(consumer, ipv_idx, peerid)) {
         /* get origin segment  */
         if ((origin_seg = bgpview_iter_pfx_peer_get_origin_seg(it)) == NULL) {
           return -1;
@@ -667,9 +667,8 @@ int bvc_subpfx_process_view(bvc_t *consumer, bgpview_t *view)
     for (bgpview_iter_pfx_first_peer(it, BGPVIEW_FIELD_ACTIVE); //
          bgpview_iter_pfx_has_more_peer(it);                    //
          bgpview_iter_pfx_next_peer(it)) {
-      if (bgpstream_id_set_exists(
-            BVC_GET_CHAIN_STATE(consumer)->full_feed_peer_ids[ipv_idx],
-            bgpview_iter_peer_get_peer_id(it)) == 0) {
+      if (BVC_IS_FULL_FEED_PEER(consumer, ipv_idx,
+                                bgpview_iter_peer_get_peer_id(it)) == 0) {
         continue;
       }
       /* get origin asn */
@@ -24,8 +24,10 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <arpa/inet.h>
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "utils.h"
@@ -42,6 +44,12 @@
 
 #define MAX_DUMP_SIZE 100
 
+/** Number of prefixes used by the sorted iteration self-test */
+#define TEST_PFX_CNT 1024
+
+/** Number of prefixes used by the garbage collector self-test */
+#define TEST_GC_PFX_CNT 3100
+
 #define STATE (BVC_GET_STATE(consumer, test))
 
 static bvc_t bvc_test = {BVC_ID_TEST, NAME, BVC_GENERATE_PTRS(test)};
@@ -100,6 +108,210 @@ static int parse_args(bvc_t *consumer, int argc, char **argv)
   return 0;
 }
 
+/** Add (or re-add) the active peer used by the self-tests */
+static int test_add_peer(bgpview_iter_t *it, bgpstream_peer_id_t *peer_id)
+{
+  bgpstream_ip_addr_t peer_ip;
+
+  memset(&peer_ip, 0, sizeof(peer_ip));
+  peer_ip.version = BGPSTREAM_ADDR_VERSION_IPV4;
+  peer_ip.bs_ipv4.addr.s_addr = htonl(0xC0000201); /* 192.0.2.1 */
+  if ((*peer_id = bgpview_iter_add_peer(it, "test", &peer_ip, 64496)) == 0 ||
+      bgpview_iter_activate_peer(it) < 0) {
+    return -1;
+  }
+  return 0;
+}
+
+/** Create a view with a single active peer for the self-tests */
+static bgpview_t *test_view_create(bgpview_iter_t **it,
+                                   bgpstream_peer_id_t *peer_id,
+                                   bgpstream_as_path_t **path)
+{
+  bgpview_t *view;
+
+  if ((view = bgpview_create(NULL, NULL, NULL, NULL)) == NULL) {
+    return NULL;
+  }
+  if ((*it = bgpview_iter_create(view)) == NULL ||
+      (*path = bgpstream_as_path_create()) == NULL ||
+      test_add_peer(*it, peer_id) != 0) {
+    bgpview_destroy(view);
+    return NULL;
+  }
+
+  return view;
+}
+
+/** Get the i'th /24 of 10.0.0.0/8 */
+static void test_pfx(bgpstream_pfx_t *pfx, int i)
+{
+  memset(pfx, 0, sizeof(*pfx));
+  pfx->address.version = BGPSTREAM_ADDR_VERSION_IPV4;
+  pfx->bs_ipv4.address.addr.s_addr = htonl(0x0A000000 | (i << 8));
+  pfx->mask_len = 24;
+}
+
+/** Add the i'th test prefix (or re-add it) with an active pfx-peer */
+static int test_add_pfx(bgpview_iter_t *it, bgpstream_peer_id_t peer_id,
+                        bgpstream_as_path_t *path, int i)
+{
+  bgpstream_pfx_t pfx;
+
+  test_pfx(&pfx, i);
+  if (bgpview_iter_add_pfx_peer(it, &pfx, peer_id, path) != 0 ||
+      bgpview_iter_pfx_activate_peer(it) < 0) {
+    return -1;
+  }
+  return 0;
+}
+
+/** Check that a sorted iteration visits exactly the first cnt test prefixes,
+    in order */
+static int test_check_sorted(bgpview_iter_t *sit, int cnt)
+{
+  bgpstream_pfx_t pfx;
+  int i = 0;
+
+  for (bgpview_iter_first_pfx(sit, BGPSTREAM_ADDR_VERSION_IPV4,
+                              BGPVIEW_FIELD_ACTIVE);
+       bgpview_iter_has_more_pfx(sit); bgpview_iter_next_pfx(sit)) {
+    test_pfx(&pfx, i++);
+    if (i > cnt ||
+        bgpstream_pfx_equal(bgpview_iter_pfx_get_pfx(sit), &pfx) == 0) {
+      return -1;
+    }
+  }
+  return (i == cnt) ? 0 : -1;
+}
+
+/** Re-add prefixes that are still in the prefix table after the view was
+    cleared, while the table fills up (so that re-adding a prefix rehashes
+    it), and check that sorted iteration still visits the prefixes in order */
+static int test_sorted_rehash(void)
+{
+  bgpview_t *view = NULL;
+  bgpview_iter_t *it = NULL, *sit = NULL;
+  bgpstream_peer_id_t peer_id;
+  bgpstream_as_path_t *path = NULL;
+  int i, j;
+  int ret = -1;
+
+  if ((view = test_view_create(&it, &peer_id, &path)) == NULL ||
+      (sit = bgpview_iter_create(view)) == NULL ||
+      bgpview_iter_set_pfx_order(sit, BGPVIEW_PFX_ORDER_SORTED) != 0) {
+    goto done;
+  }
+
+  for (i = 0; i < TEST_PFX_CNT; i++) {
+    if (test_add_pfx(it, peer_id, path, i) != 0 ||
+        test_check_sorted(sit, i + 1) != 0) {
+      goto done;
+    }
+
+    /* clear the view, and index the (now empty) table */
+    bgpview_clear(view);
+    if (test_add_peer(it, &peer_id) != 0 || test_check_sorted(sit, 0) != 0) {
+      goto done;
+    }
+
+    /* re-adding an existing key rehashes the table if it is full */
+    for (j = 0; j <= i; j++) {
+      if (test_add_pfx(it, peer_id, path, j) != 0 ||
+          (j == 0 && test_check_sorted(sit, 1) != 0)) {
+        goto done;
+      }
+    }
+  }
+  ret = 0;
+
+done:
+  if (ret != 0) {
+    fprintf(stderr, "ERROR: Sorted iteration failed after re-adding "
+                    "prefixes\n");
+  }
+  bgpstream_as_path_destroy(path);
+  if (sit != NULL) {
+    bgpview_iter_destroy(sit);
+  }
+  if (it != NULL) {
+    bgpview_iter_destroy(it);
+  }
+  if (view != NULL) {
+    bgpview_destroy(view);
+  }
+  return ret;
+}
+
+/** Remove most prefixes, and add a few new ones between garbage collector
+    steps (which rehashes the prefix table at the same size to drop the
+    deleted buckets), and check that every removed prefix is collected */
+static int test_gc_rehash(void)
+{
+  bgpview_t *view = NULL;
+  bgpview_iter_t *it = NULL;
+  bgpstream_peer_id_t peer_id;
+  bgpstream_as_path_t *path = NULL;
+  bgpview_mem_stats_t stats;
+  bgpview_gc_stats_t gc_stats;
+  bgpstream_pfx_t pfx;
+  int i, j;
+  int ret = -1;
+
+  if ((view = test_view_create(&it, &peer_id, &path)) == NULL) {
+    goto done;
+  }
+
+  /* fill the table to just below the upper bound (77%) of its 4096 buckets,
+     and then remove all but every fourth prefix */
+  for (i = 0; i < TEST_GC_PFX_CNT; i++) {
+    if (test_add_pfx(it, peer_id, path, i) != 0) {
+      goto done;
+    }
+  }
+  for (i = 0; i < TEST_GC_PFX_CNT; i++) {
+    test_pfx(&pfx, i);
+    if ((i % 4) != 0 &&
+        (bgpview_iter_seek_pfx(it, &pfx, BGPVIEW_FIELD_ALL_VALID) != 1 ||
+         bgpview_iter_remove_pfx(it) != 0)) {
+      goto done;
+    }
+  }
+
+  /* collect in short steps. once half of the table is collected (so that
+     rehashing it keeps its size), add a few new prefixes between steps until
+     the table has to be rehashed */
+  while (bgpview_gc_step(view, 16) == 0) {
+    bgpview_get_gc_stats(view, &gc_stats);
+    for (j = 0; gc_stats.pfxs_reclaimed >= TEST_GC_PFX_CNT / 2 && j < 4;
+         j++) {
+      if (test_add_pfx(it, peer_id, path, i++) != 0) {
+        goto done;
+      }
+    }
+  }
+
+  bgpview_get_mem_stats(view, &stats);
+  if (stats.v4pfxs.entries !=
+      bgpview_v4pfx_cnt(view, BGPVIEW_FIELD_ALL_VALID)) {
+    goto done;
+  }
+  ret = 0;
+
+done:
+  if (ret != 0) {
+    fprintf(stderr, "ERROR: Garbage collector missed removed prefixes\n");
+  }
+  bgpstream_as_path_destroy(path);
+  if (it != NULL) {
+    bgpview_iter_destroy(it);
+  }
+  if (view != NULL) {
+    bgpview_destroy(view);
+  }
+  return ret;
+}
+
 bvc_t *bvc_test_alloc()
 {
   return &bvc_test;
@@ -123,6 +335,11 @@ int bvc_test_init(bvc_t *consumer, int argc, char **argv)
 
   /* react to args here */
 
+  /* self-tests of view internals that real views rarely exercise */
+  if (test_sorted_rehash() != 0 || test_gc_rehash() != 0) {
+    return -1;
+  }
+
   return 0;
 }
 
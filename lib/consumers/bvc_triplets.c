@@ -569,9 +569,7 @@ int bvc_triplets_process_view(bvc_t *consumer, bgpview_t *view)
          bgpview_iter_pfx_has_more_peer(it); bgpview_iter_pfx_next_peer(it)) {
       /* only consider peers that are full-feed */
       peerid = bgpview_iter_peer_get_peer_id(it);
-      if (bgpstream_id_set_exists(
-            BVC_GET_CHAIN_STATE(consumer)->full_feed_peer_ids[ipv_idx],
-            peerid)) {
+      if (BVC_IS_FULL_FEED_PEER(consumer, ipv_idx, peerid)) {
 
         // initializing asns for each view
         i = 0;
@@ -559,18 +559,11 @@ int bvc_viewsender_process_view(bvc_t *consumer, bgpview_t *view)
     uint64_t send_end = epoch_sec();
     uint64_t send_time = send_end - start_time;
 
-    // do the create/copy
-    if (state->parent_view == NULL) {
-      if ((state->parent_view = bgpview_dup(view)) == NULL) {
-        return -1;
-      }
-    } else {
-      /* we have a parent view, just copy into it */
-      /* first, clear the destination */
-      bgpview_clear(state->parent_view);
-      if (bgpview_copy(state->parent_view, view) != 0) {
-        return -1;
-      }
+    // keep a copy-on-write snapshot of the view to diff the next one against
+    // (the old snapshot only holds records that have changed since)
+    bgpview_destroy(state->parent_view);
+    if ((state->parent_view = bgpview_snapshot(view)) == NULL) {
+      return -1;
     }
     assert(state->parent_view != NULL);
     assert(bgpview_get_time(view) == bgpview_get_time(state->parent_view));
@@ -34,6 +34,7 @@
 #include <libipmeta.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #define NAME "visibility"
@@ -232,6 +233,7 @@ static void find_ff_peers(bvc_t *consumer, bgpview_iter_t *it)
       if (pfx_cnt >= STATE->full_feed_size[i]) {
         /* add to the  full_feed set */
         bgpstream_id_set_insert(CHAIN_STATE->full_feed_peer_ids[i], peerid);
+        BGPVIEW_PEER_BITSET_SET(CHAIN_STATE->full_feed_peer_bits[i], peerid);
         bgpstream_id_set_insert(STATE->full_feed_asns[i], sg->peer_asnumber);
       }
     }
@@ -280,6 +282,8 @@ static void reset_chain_state(bvc_t *consumer)
   for (i = 0; i < BGPSTREAM_MAX_IP_VERSION_IDX; i++) {
     CHAIN_STATE->peer_ids_cnt[i] = 0;
     bgpstream_id_set_clear(CHAIN_STATE->full_feed_peer_ids[i]);
+    memset(CHAIN_STATE->full_feed_peer_bits[i], 0,
+           sizeof(CHAIN_STATE->full_feed_peer_bits[i]));
     CHAIN_STATE->full_feed_peer_asns_cnt[i] = 0;
     CHAIN_STATE->usable_table_flag[i] = 0;
   }
@@ -443,6 +443,10 @@ int bgpview_io_deserialize_pfx_row(
   bgpstream_as_path_store_path_t *store_path = NULL;
   bgpstream_as_path_store_path_id_t pathid;
 
+  bgpstream_peer_id_t batch_ids[BGPVIEW_IO_PFX_PEERS_BATCH];
+  bgpstream_as_path_store_path_id_t batch_paths[BGPVIEW_IO_PFX_PEERS_BATCH];
+  int batch_cnt = 0;
+
   uint16_t peer_cnt;
 
   if (it != NULL) {
@@ -518,24 +522,16 @@ int bgpview_io_deserialize_pfx_row(
     }
 
     if (state == BGPVIEW_FIELD_ACTIVE) {
-      if (pfx_peers_added == 0) {
-        /* we have to use add_pfx_peer */
-        if (bgpview_iter_add_pfx_peer_by_id(it, &pfx,
-                                            peerid_map[peerid], pathid) != 0) {
-          fprintf(stderr, "Could not add prefix\n");
-          goto err;
-        }
-      } else {
-        /* we can use pfx_add_peer for efficiency */
-        if (bgpview_iter_pfx_add_peer_by_id(it, peerid_map[peerid], pathid) !=
-            0) {
+      /* active pfx-peers are added (and activated) in bulk */
+      batch_ids[batch_cnt] = peerid_map[peerid];
+      batch_paths[batch_cnt] = pathid;
+      if (++batch_cnt == BGPVIEW_IO_PFX_PEERS_BATCH) {
+        if (bgpview_iter_add_pfx_peers(it, &pfx, batch_ids, batch_paths, NULL,
+                                       batch_cnt) != 0) {
           fprintf(stderr, "Could not add prefix\n");
           goto err;
         }
-      }
-      if (bgpview_iter_pfx_activate_peer(it) < 0) {
-        fprintf(stderr, "Could not activate prefix\n");
-        goto err;
+        batch_cnt = 0;
       }
     } else {
       if (pfx_peers_added == 0) {
@@ -557,6 +553,13 @@ int bgpview_io_deserialize_pfx_row(
     pfx_peers_added++;
   }
 
+  if (batch_cnt > 0 && bgpview_iter_add_pfx_peers(it, &pfx, batch_ids,
+                                                  batch_paths, NULL,
+                                                  batch_cnt) != 0) {
+    fprintf(stderr, "Could not add prefix\n");
+    goto err;
+  }
+
   /* peer cnt */
   BGPVIEW_IO_DESERIALIZE_VAL(buf, len, read, peer_cnt);
   peer_cnt = ntohs(peer_cnt);
@@ -30,23 +30,13 @@
 #include "bgpstream_utils.h"
 #include "bgpview.h"
 
-/** Possible entry types that can be passed to the filter callback */
-typedef enum {
-
-  /** The iterator refers to a peer */
-  BGPVIEW_IO_FILTER_PEER = 0,
-
-  /** The iterator refers to a prefix */
-  BGPVIEW_IO_FILTER_PFX = 1,
-
-  /** The iterator refers to a prefix-peer */
-  BGPVIEW_IO_FILTER_PFX_PEER = 2,
-
-} bgpview_io_filter_type_t;
-
 /** Magic number that denotes the end of the peers array */
 #define BGPVIEW_IO_END_OF_PEERS 0xffff
 
+/** Number of pfx-peers of a prefix row that deserializers buffer before
+    adding them to the view with bgpview_iter_add_pfx_peers */
+#define BGPVIEW_IO_PFX_PEERS_BATCH 256
+
 /** Convenience macro to serialize a simple variable into a byte array.
  *
  * @param buf           pointer to the buffer (will be updated)
@@ -78,20 +68,8 @@ typedef enum {
     buf += sizeof(to);                                                         \
   } while (0)
 
-/** Callback for filtering entries in a view when sending from
- * bgpview_io_client.
- *
- * @param iter          iterator to check
- * @param type          enum indicating the type of entry to filter
- * @param user          user-provided pointer
- * @return 1 to include the entry, 0 to exclude the entry, and -1 if an error
- * occured.
- *
- * @note This callback will be called for every prefix/peer combination, so it
- * should be efficient at determining if an entry is to be included.
- */
-typedef int(bgpview_io_filter_cb_t)(bgpview_iter_t *iter,
-                                    bgpview_io_filter_type_t type, void *user);
+/* The filter callback used when sending a view (bgpview_io_filter_cb_t) is
+ * defined in bgpview.h, since it is shared with bgpview_diff */
 
 /** Callback for filtering peers when reading or receiving a view
  *
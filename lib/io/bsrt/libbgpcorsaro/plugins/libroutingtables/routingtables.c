@@ -309,12 +309,10 @@ static void reset_peerpfxdata(routingtables_t *rt, bgpstream_peer_id_t peer_id,
         BGPVIEW_FIELD_ALL_VALID) <= 0) {
       continue; // optimization: loop below will find nothing, so skip it
     }
-    for (bgpview_iter_first_pfx(rt->iter, ipv[i], BGPVIEW_FIELD_ALL_VALID);
-         bgpview_iter_has_more_pfx(rt->iter); bgpview_iter_next_pfx(rt->iter)) {
-      if (bgpview_iter_pfx_seek_peer(rt->iter, peer_id,
-          BGPVIEW_FIELD_ALL_VALID) == 0) {
-        continue;
-      }
+    for (bgpview_iter_peer_first_pfx(rt->iter, ipv[i],
+                                     BGPVIEW_FIELD_ALL_VALID);
+         bgpview_iter_peer_has_more_pfx(rt->iter);
+         bgpview_iter_peer_next_pfx(rt->iter)) {
       perpfx_perpeer_info_t *pp = bgpview_iter_pfx_peer_get_user(rt->iter);
       pp->pfx_status &= ~RT_ANNOUNCED_PFXSTATUS;
       pp->bgp_time_last_ts = 0;
@@ -1109,6 +1107,10 @@ routingtables_t *routingtables_create(char *plugin_name,
     goto err;
   }
 
+  /* peers going down are reset one by one, look up their prefixes directly */
+  if (bgpview_enable_peer_index(rt->view) != 0)
+    goto err;
+
   if ((rt->iter = bgpview_iter_create(rt->view)) == NULL)
     goto err;
 
@@ -26,30 +26,252 @@
 #include "bgpview_io.h"
 #include "bgpview_io_file.h"
 #include "config.h"
+#include "khash.h"
 #include "utils.h"
 #include <arpa/inet.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <wandio.h>
 
 #define VIEW_MAGIC 0x42475056 /* BGPV */
 
 #define VIEW_START_MAGIC 0x53545254    /* STRT */
+#define VIEW_START_V2_MAGIC 0x53545232 /* STR2 */
+#define VIEW_DIFF_MAGIC 0x44494632     /* DIF2 */
 #define VIEW_END_MAGIC 0x56454E44      /* VEND */
 #define VIEW_PEER_END_MAGIC 0x50454E44 /* PEND */
 #define VIEW_PATH_END_MAGIC 0x50415448 /* PATH */
 #define VIEW_PFX_END_MAGIC 0x58454E44  /* XEND */
 
-#define BUFFER_LEN 1024
+#define VIEW_INDEX_MAGIC 0x494E4458      /* INDX */
+#define VIEW_INDEX_DIFF_MAGIC 0x494E4444 /* INDD */
+
+/** Size of the in-memory blocks that views are serialized into before being
+    handed to wandio */
+#define WRITE_BLOCK_LEN (1024 * 1024)
+
+/** Size of the in-memory blocks that views are parsed from */
+#define READ_BLOCK_LEN (1024 * 1024)
+
+/** Maximum number of prefixes in a chunk of a v2 view */
+#define V2_CHUNK_PFX_CNT (64 * 1024)
+
+/** Number of pfx-peers after which a chunk of a v2 view is completed */
+#define V2_CHUNK_CELL_CNT (1024 * 1024)
+
+/** Largest (encoded) chunk of a v2 view that will be read */
+#define V2_CHUNK_MAX_LEN (256 * 1024 * 1024)
+
+/** Largest encoded size of a (32-bit) varint */
+#define VARINT_MAX_LEN 5
+
+/** Length of the header of a chunk of a v2 view */
+#define V2_CHUNK_HDR_LEN (sizeof(uint8_t) + sizeof(uint32_t) * (2 + V2_COL_CNT))
+
+/** Columns of a chunk of a v2 view */
+enum {
+
+  /** Delta-encoded prefix addresses and mask lengths */
+  V2_COL_PFXS = 0,
+
+  /** Number of pfx-peers of each prefix */
+  V2_COL_CNTS = 1,
+
+  /** Delta-encoded peer IDs of the pfx-peers of each prefix */
+  V2_COL_PEERS = 2,
+
+  /** Path indexes of the pfx-peers of each prefix */
+  V2_COL_PATHS = 3,
+
+  V2_COL_CNT = 4,
+};
+
+/** Serialized size of a prefix-peer cell (peer id and path index) */
+#define PFX_PEER_LEN (sizeof(uint16_t) + sizeof(uint32_t))
+
+/** Largest serialized size of a prefix row, excluding its cells (address
+    length, address, mask length, end-of-peers magic and peer count) */
+#define PFX_ROW_LEN (18 + sizeof(uint32_t) * 2 + sizeof(uint16_t))
+
+/** In-memory block that a view is serialized into */
+typedef struct write_block {
+
+  /** File that full blocks are flushed to (if NULL, the block grows instead,
+      and holds everything written to it) */
+  iow_t *outfile;
+
+  /** Block buffer */
+  uint8_t *buf;
+
+  /** Allocated length of the buffer */
+  size_t len;
+
+  /** Number of bytes of the buffer currently in use */
+  size_t written;
+
+  /** Number of bytes flushed to the file so far */
+  uint64_t flushed;
+
+} write_block_t;
+
+/** In-memory block of a file that a view is parsed from.
+ *
+ * The first (valid - peeked) bytes of the buffer have been read from the file,
+ * while the last peeked bytes have only been peeked at, so that the bytes
+ * after the end of the view can be left in the file for the next read.
+ */
+typedef struct read_block {
+
+  /** File that blocks are read from */
+  io_t *infile;
+
+  /** Block buffer */
+  uint8_t *buf;
+
+  /** Allocated length of the buffer */
+  size_t len;
+
+  /** Number of bytes of the buffer that hold file data */
+  size_t valid;
+
+  /** Number of bytes at the end of the valid data that were only peeked */
+  size_t peeked;
+
+  /** Parse position in the buffer */
+  size_t pos;
+
+} read_block_t;
+
+/** Entry of the index that is written alongside a file (all fields are in
+    network byte order) */
+typedef struct index_entry {
+
+  /** VIEW_INDEX_MAGIC, or VIEW_INDEX_DIFF_MAGIC for a diff view */
+  uint32_t magic;
+
+  /** Time of the view */
+  uint32_t time;
+
+  /** Offset of the view in the (uncompressed) file */
+  uint64_t offset;
+
+  /** Length of the view in the (uncompressed) file */
+  uint64_t len;
+
+  /** Number of peers written */
+  uint32_t peer_cnt;
+
+  /** Number of prefixes written (for a diff view, the number of prefix rows
+      that it updates or removes) */
+  uint32_t pfx_cnt;
+
+} index_entry_t;
+
+/** Column of a chunk of a v2 view, either being built (in which case buf is
+    owned by the column) or being parsed (in which case it points into a
+    read block) */
+typedef struct column {
+
+  /** Column data */
+  uint8_t *buf;
+
+  /** Allocated (or, when parsing, total) length of the column */
+  size_t len;
+
+  /** Number of bytes written to (or parsed from) the column */
+  size_t used;
+
+} column_t;
+
+/** Pfx-peer of a v2 view, before it is encoded */
+typedef struct v2_cell {
+
+  /** Peer ID */
+  uint16_t peer_id;
+
+  /** Path index */
+  uint32_t path_idx;
+
+} v2_cell_t;
+
+/** State of the pfxs (of a v2 view) that are being encoded */
+typedef struct v2_encoder {
+
+  /** Block that completed chunks are written to */
+  write_block_t *blk;
+
+  /** Columns of the current chunk */
+  column_t cols[V2_COL_CNT];
+
+  /** Address length of the pfxs of the current chunk */
+  uint8_t addr_len;
+
+  /** Number of pfxs in the current chunk */
+  uint32_t chunk_pfx_cnt;
+
+  /** Number of pfx-peers in the current chunk */
+  uint32_t chunk_cell_cnt;
+
+  /** Previous IPv4 address of the current chunk (in host byte order) */
+  uint32_t addr_prev;
+
+  /** Previous IPv6 address of the current chunk */
+  uint8_t addr6_prev[16];
+
+  /** Number of pfxs encoded */
+  int pfx_cnt;
+
+} v2_encoder_t;
+
+/** Map from the index of a path in the store to its index in a diff view */
+KHASH_INIT(path_idx, uint32_t, uint32_t, 1, kh_int_hash_func,
+           kh_int_hash_equal);
+
+/** State of a diff view that is being written */
+typedef struct diff_state {
+
+  /** User filter callback (may be NULL) */
+  bgpview_io_filter_cb_t *cb;
+
+  /** User pointer for the filter callback */
+  void *cb_user;
+
+  /** Encoder of the rows of pfx-peers that are added or changed */
+  v2_encoder_t upd;
+
+  /** Encoder of the rows of pfx-peers that are removed */
+  v2_encoder_t rem;
+
+  /** Added or changed pfx-peers of the current pfx */
+  v2_cell_t *upd_cells;
+  int upd_cells_cnt;
+  int upd_cells_alloc;
+
+  /** Removed pfx-peers of the current pfx */
+  v2_cell_t *rem_cells;
+  int rem_cells_cnt;
+  int rem_cells_alloc;
+
+  /** Paths used by the diff, indexed by their index in the diff */
+  bgpstream_as_path_store_path_t **paths;
+  int paths_cnt;
+  int paths_alloc;
+
+  /** Index in the diff of each path used */
+  khash_t(path_idx) *path_idx;
+
+} diff_state_t;
 
 /* ========== UTILITIES ========== */
 
 #define WRITE_VAL(from)                                                        \
   do {                                                                         \
-    if (wandio_wwrite(outfile, &from, sizeof(from)) != sizeof(from)) {         \
+    if (block_write(blk, &(from), sizeof(from)) != 0) {                        \
       fprintf(stderr, "%s: Could not write %s to file\n", __func__,            \
               STR(from));                                                      \
+      goto err;                                                                \
     }                                                                          \
   } while (0)
 
@@ -63,72 +285,278 @@
 
 #define READ_VAL(to)                                                           \
   do {                                                                         \
-    if (wandio_read(infile, &to, sizeof(to)) != sizeof(to)) {                  \
+    if ((blk->valid - blk->pos) < sizeof(to) &&                                \
+        block_fill(blk, sizeof(to)) != 0) {                                    \
       fprintf(stderr, "%s: Could not read %s from file\n", __func__, STR(to)); \
+      goto err;                                                                \
     }                                                                          \
+    memcpy(&(to), blk->buf + blk->pos, sizeof(to));                            \
+    blk->pos += sizeof(to);                                                    \
   } while (0)
 
-/** Checks if the given magic number is present in the file. If it is, the magic
-    is consumed, otherwise the stream is left untouched */
-static int check_magic(io_t *infile, uint32_t magic)
+/** Ensure that at least len unparsed bytes are available in the block,
+    reading the next block of the file if needed */
+static int block_fill(read_block_t *blk, size_t len)
 {
-  uint64_t buf;
-  uint32_t mgc;
-  off_t read;
-  if (wandio_peek(infile, &buf, sizeof(uint64_t)) != sizeof(uint64_t)) {
-    fprintf(stderr, "Could not peek at bytes\n");
+  uint8_t *buf;
+  int64_t peeked;
+
+  if ((blk->valid - blk->pos) >= len) {
     return 0;
   }
 
-  buf = ntohll(buf);
+  /* everything peeked so far is about to be parsed, so consume it (into the
+     buffer that already holds a copy of it) */
+  if (blk->peeked > 0 &&
+      wandio_read(blk->infile, blk->buf + (blk->valid - blk->peeked),
+                  blk->peeked) != (int64_t)blk->peeked) {
+    return -1;
+  }
+
+  /* move the unparsed tail to the front of the buffer */
+  memmove(blk->buf, blk->buf + blk->pos, blk->valid - blk->pos);
+  blk->valid -= blk->pos;
+  blk->pos = 0;
+  blk->peeked = 0;
+
+  if (blk->len < len) {
+    if ((buf = realloc(blk->buf, len)) == NULL) {
+      return -1;
+    }
+    blk->buf = buf;
+    blk->len = len;
+  }
+
+  /* peek at the next block (repeatedly, in case of a short peek) */
+  while ((blk->valid + blk->peeked) < blk->len) {
+    if ((peeked = wandio_peek(blk->infile, blk->buf + blk->valid,
+                              blk->len - blk->valid)) < 0) {
+      return -1;
+    }
+    if ((size_t)peeked <= blk->peeked) {
+      /* end of file */
+      break;
+    }
+    blk->peeked = peeked;
+  }
+  blk->valid += blk->peeked;
+
+  if (blk->valid < len) {
+    fprintf(stderr, "ERROR: Unexpected end of file\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+/** Consume the parsed part of the block from the file, leaving anything after
+    it to be read by the next call */
+static int block_consume(read_block_t *blk)
+{
+  size_t parsed = blk->valid - blk->peeked;
+
+  if (blk->pos > parsed &&
+      wandio_read(blk->infile, blk->buf + parsed, blk->pos - parsed) !=
+        (int64_t)(blk->pos - parsed)) {
+    return -1;
+  }
+
+  blk->peeked = blk->valid - blk->pos;
+  return 0;
+}
+
+/** Checks if the given magic number is next in the block. If it is, the magic
+    is consumed, otherwise the block is left untouched */
+static int check_magic(read_block_t *blk, uint32_t magic)
+{
+  uint32_t mgc[2];
 
-  /* check the generic magic */
-  mgc = (uint32_t)(buf >> 32);
-  if (mgc != VIEW_MAGIC) {
+  if ((blk->valid - blk->pos) < sizeof(mgc) &&
+      block_fill(blk, sizeof(mgc)) != 0) {
     return 0;
   }
+  memcpy(mgc, blk->buf + blk->pos, sizeof(mgc));
 
-  /* now, check the specific magic */
-  mgc = (buf & 0xffffffff);
-  if (mgc != magic) {
+  /* check the generic and the specific magic */
+  if (ntohl(mgc[0]) != VIEW_MAGIC || ntohl(mgc[1]) != magic) {
     return 0;
   }
 
   /* now consume the magic! */
-  read = wandio_read(infile, &buf, sizeof(uint64_t));
-  assert(read == sizeof(uint64_t));
+  blk->pos += sizeof(mgc);
 
   return 1;
 }
 
-static int write_ip(iow_t *outfile, bgpstream_ip_addr_t *ip)
+/** Hand the contents of the block to wandio and empty it */
+static int block_flush(write_block_t *blk)
+{
+  if (blk->written == 0) {
+    return 0;
+  }
+
+  if (wandio_wwrite(blk->outfile, blk->buf, blk->written) !=
+      (int64_t)blk->written) {
+    fprintf(stderr, "ERROR: Could not write %zu bytes to file\n",
+            blk->written);
+    return -1;
+  }
+  blk->flushed += blk->written;
+  blk->written = 0;
+
+  return 0;
+}
+
+/** Ensure that the block has room for len more bytes, flushing it first if
+    needed (and growing it for records larger than a block) */
+static int block_reserve(write_block_t *blk, size_t len)
+{
+  uint8_t *buf;
+  size_t new_len;
+
+  if ((blk->len - blk->written) >= len) {
+    return 0;
+  }
+
+  if (blk->outfile != NULL && block_flush(blk) != 0) {
+    return -1;
+  }
+
+  if ((blk->len - blk->written) < len) {
+    new_len = blk->len == 0 ? WRITE_BLOCK_LEN : blk->len;
+    while ((new_len - blk->written) < len) {
+      new_len *= 2;
+    }
+    if ((buf = realloc(blk->buf, new_len)) == NULL) {
+      return -1;
+    }
+    blk->buf = buf;
+    blk->len = new_len;
+  }
+
+  return 0;
+}
+
+static int block_write(write_block_t *blk, const void *data, size_t len)
+{
+  if (len == 0) {
+    return 0;
+  }
+  if (block_reserve(blk, len) != 0) {
+    return -1;
+  }
+  memcpy(blk->buf + blk->written, data, len);
+  blk->written += len;
+  return 0;
+}
+
+/** Ensure that the column has room for len more bytes */
+static int column_reserve(column_t *col, size_t len)
+{
+  uint8_t *buf;
+  size_t new_len;
+
+  if ((col->len - col->used) >= len) {
+    return 0;
+  }
+
+  new_len = col->len == 0 ? 4096 : col->len;
+  while ((new_len - col->used) < len) {
+    new_len *= 2;
+  }
+  if ((buf = realloc(col->buf, new_len)) == NULL) {
+    return -1;
+  }
+  col->buf = buf;
+  col->len = new_len;
+
+  return 0;
+}
+
+static int column_write(column_t *col, const void *data, size_t len)
+{
+  if (column_reserve(col, len) != 0) {
+    return -1;
+  }
+  memcpy(col->buf + col->used, data, len);
+  col->used += len;
+  return 0;
+}
+
+static int column_read(column_t *col, void *data, size_t len)
+{
+  if ((col->len - col->used) < len) {
+    return -1;
+  }
+  memcpy(data, col->buf + col->used, len);
+  col->used += len;
+  return 0;
+}
+
+/** Append val to the column as a varint (7 bits per byte, least significant
+    group first, with the high bit set on all but the last byte) */
+static int varint_put(column_t *col, uint32_t val)
+{
+  if (column_reserve(col, VARINT_MAX_LEN) != 0) {
+    return -1;
+  }
+  while (val >= 0x80) {
+    col->buf[col->used++] = (val & 0x7F) | 0x80;
+    val >>= 7;
+  }
+  col->buf[col->used++] = val;
+  return 0;
+}
+
+static int varint_get(column_t *col, uint32_t *val)
+{
+  uint32_t v = 0;
+  int shift = 0;
+  uint8_t b;
+
+  do {
+    if (col->used == col->len || shift >= (VARINT_MAX_LEN * 7)) {
+      return -1;
+    }
+    b = col->buf[col->used++];
+    v |= (uint32_t)(b & 0x7F) << shift;
+    shift += 7;
+  } while ((b & 0x80) != 0);
+
+  *val = v;
+  return 0;
+}
+
+static int v2_cell_cmp(const void *a, const void *b)
+{
+  const v2_cell_t *ca = a;
+  const v2_cell_t *cb = b;
+  return (ca->peer_id > cb->peer_id) - (ca->peer_id < cb->peer_id);
+}
+
+static int write_ip(write_block_t *blk, bgpstream_ip_addr_t *ip)
 {
   uint8_t len;
   switch (ip->version) {
   case BGPSTREAM_ADDR_VERSION_IPV4:
     len = sizeof(uint32_t);
     WRITE_VAL(len);
-    if (wandio_wwrite(outfile, &ip->bs_ipv4.addr.s_addr, len) == len) {
-      return 0;
-    }
-    break;
+    return block_write(blk, &ip->bs_ipv4.addr.s_addr, len);
 
   case BGPSTREAM_ADDR_VERSION_IPV6:
     len = sizeof(uint8_t) * 16;
     WRITE_VAL(len);
-    if (wandio_wwrite(outfile, &ip->bs_ipv6.addr.s6_addr, len) == len) {
-      return 0;
-    }
-    break;
+    return block_write(blk, &ip->bs_ipv6.addr.s6_addr, len);
 
   case BGPSTREAM_ADDR_VERSION_UNKNOWN:
     return -1;
   }
 
+err:
   return -1;
 }
 
-static int read_ip(io_t *infile, bgpstream_ip_addr_t *ip)
+static int read_ip(read_block_t *blk, bgpstream_ip_addr_t *ip)
 {
   assert(ip != NULL);
 
@@ -139,15 +567,11 @@ static int read_ip(io_t *infile, bgpstream_ip_addr_t *ip)
   if (len == sizeof(uint32_t)) {
     /* v4 */
     ip->version = BGPSTREAM_ADDR_VERSION_IPV4;
-    if (wandio_read(infile, &ip->bs_ipv4.addr.s_addr, len) != len) {
-      goto err;
-    }
+    READ_VAL(ip->bs_ipv4.addr.s_addr);
   } else if (len == sizeof(uint8_t) * 16) {
     /* v6 */
     ip->version = BGPSTREAM_ADDR_VERSION_IPV6;
-    if (wandio_read(infile, &ip->bs_ipv6.addr.s6_addr, len) != len) {
-      goto err;
-    }
+    READ_VAL(ip->bs_ipv6.addr.s6_addr);
   } else {
     /* invalid ip address */
     fprintf(stderr, "Invalid IP address (len: %d)\n", len);
@@ -160,7 +584,7 @@ err:
   return -1;
 }
 
-static int write_peers(iow_t *outfile, bgpview_iter_t *it,
+static int write_peers(write_block_t *blk, bgpview_iter_t *it,
                        bgpview_io_filter_cb_t *cb, void *cb_user)
 {
   uint8_t u8;
@@ -205,12 +629,12 @@ static int write_peers(iow_t *outfile, bgpview_iter_t *it,
     assert(siglen <= UINT8_MAX);
     u8 = siglen;
     WRITE_VAL(u8);
-    if (wandio_wwrite(outfile, &ps->collector_str, u8) != u8) {
+    if (block_write(blk, ps->collector_str, u8) != 0) {
       goto err;
     }
 
     /* peer IP address */
-    if (write_ip(outfile, &ps->peer_ip_addr) != 0) {
+    if (write_ip(blk, &ps->peer_ip_addr) != 0) {
       goto err;
     }
 
@@ -228,13 +652,49 @@ static int write_peers(iow_t *outfile, bgpview_iter_t *it,
   u16 = htons(peers_tx);
   WRITE_VAL(u16);
 
+  return peers_tx;
+
+err:
+  return -1;
+}
+
+/** Write a path of the path table, under the given index */
+static int write_path(write_block_t *blk, bgpstream_as_path_store_path_t *spath,
+                      uint32_t idx)
+{
+  bgpstream_as_path_t *path;
+
+  uint8_t *path_data;
+  uint8_t is_core;
+  uint16_t path_len;
+
+  is_core = bgpstream_as_path_store_path_is_core(spath);
+
+  path = bgpstream_as_path_store_path_get_int_path(spath);
+  assert(path != NULL);
+  path_len = bgpstream_as_path_get_data(path, &path_data);
+
+  /* add the path index */
+  WRITE_VAL(idx);
+
+  /* is this a core path? */
+  WRITE_VAL(is_core);
+
+  /* add the path len */
+  WRITE_VAL(path_len);
+
+  /** @todo make platform independent (paths are in host byte order) */
+  if (block_write(blk, path_data, path_len) != 0) {
+    goto err;
+  }
+
   return 0;
 
 err:
   return -1;
 }
 
-static int write_paths(iow_t *outfile, bgpview_iter_t *it)
+static int write_paths(write_block_t *blk, bgpview_iter_t *it)
 {
   bgpview_t *view = bgpview_iter_get_view(it);
   assert(view != NULL);
@@ -242,12 +702,6 @@ static int write_paths(iow_t *outfile, bgpview_iter_t *it)
   assert(ps != NULL);
 
   bgpstream_as_path_store_path_t *spath;
-  bgpstream_as_path_t *path;
-  uint32_t idx;
-
-  uint8_t *path_data;
-  uint8_t is_core;
-  uint16_t path_len;
 
   unsigned paths_tx = 0;
   uint32_t u32;
@@ -260,25 +714,8 @@ static int write_paths(iow_t *outfile, bgpview_iter_t *it)
     spath = bgpstream_as_path_store_iter_get_path(ps);
     assert(spath != NULL);
 
-    idx = bgpstream_as_path_store_path_get_idx(spath);
-
-    is_core = bgpstream_as_path_store_path_is_core(spath);
-
-    path = bgpstream_as_path_store_path_get_int_path(spath);
-    assert(path != NULL);
-    path_len = bgpstream_as_path_get_data(path, &path_data);
-
-    /* add the path index */
-    WRITE_VAL(idx);
-
-    /* is this a core path? */
-    WRITE_VAL(is_core);
-
-    /* add the path len */
-    WRITE_VAL(path_len);
-
-    /** @todo make platform independent (paths are in host byte order) */
-    if (wandio_wwrite(outfile, path_data, path_len) != path_len) {
+    if (write_path(blk, spath, bgpstream_as_path_store_path_get_idx(spath)) !=
+        0) {
       goto err;
     }
   }
@@ -297,49 +734,7 @@ err:
   return -1;
 }
 
-static int write_pfx_peers(iow_t *outfile, bgpview_iter_t *it, int *peers_cnt,
-                           bgpview_io_filter_cb_t *cb, void *cb_user)
-{
-  uint16_t peerid;
-  bgpstream_as_path_store_path_t *spath;
-  uint32_t idx;
-
-  int filter;
-
-  assert(peers_cnt != NULL);
-  *peers_cnt = 0;
-
-  for (bgpview_iter_pfx_first_peer(it, BGPVIEW_FIELD_ACTIVE);
-       bgpview_iter_pfx_has_more_peer(it); bgpview_iter_pfx_next_peer(it)) {
-    if (cb != NULL) {
-      /* ask the caller if they want this peer */
-      if ((filter = cb(it, BGPVIEW_IO_FILTER_PFX_PEER, cb_user)) < 0) {
-        return -1;
-      }
-      if (filter == 0) {
-        continue;
-      }
-    }
-
-    peerid = bgpview_iter_peer_get_peer_id(it);
-
-    /* peer id */
-    assert(peerid > 0);
-    peerid = htons(peerid);
-    WRITE_VAL(peerid);
-
-    /* AS Path Index */
-    spath = bgpview_iter_pfx_peer_get_as_path_store_path(it);
-    idx = bgpstream_as_path_store_path_get_idx(spath);
-    WRITE_VAL(idx);
-
-    (*peers_cnt)++;
-  }
-
-  return 0;
-}
-
-static int write_pfxs(iow_t *outfile, bgpview_iter_t *it,
+static int write_pfxs(write_block_t *blk, bgpview_iter_t *it,
                       bgpview_io_filter_cb_t *cb, void *cb_user)
 {
   int filter;
@@ -353,6 +748,9 @@ static int write_pfxs(iow_t *outfile, bgpview_iter_t *it,
   bgpstream_pfx_t *pfx;
   int peers_cnt = 0;
 
+  size_t row_start;
+  ssize_t s;
+
   for (bgpview_iter_first_pfx(it, 0, /* all pfx versions */
                               BGPVIEW_FIELD_ACTIVE);
        bgpview_iter_has_more_pfx(it); bgpview_iter_next_pfx(it)) {
@@ -369,22 +767,33 @@ static int write_pfxs(iow_t *outfile, bgpview_iter_t *it,
     pfx = bgpview_iter_pfx_get_pfx(it);
     assert(pfx != NULL);
 
+    /* make room for the whole row so that the cells can be serialized in
+       place, and the row dropped if the filter rejects all of them */
+    peers_cnt = bgpview_iter_pfx_get_peer_cnt(it, BGPVIEW_FIELD_ACTIVE);
+    if (block_reserve(blk, PFX_ROW_LEN + PFX_PEER_LEN * peers_cnt) != 0) {
+      goto err;
+    }
+    row_start = blk->written;
+
     /* pfx address */
-    if (write_ip(outfile, &pfx->address) != 0) {
+    if (write_ip(blk, &pfx->address) != 0) {
       goto err;
     }
 
     /* pfx len */
     WRITE_VAL(pfx->mask_len);
 
-    /* send the peers */
-    peers_cnt = 0;
-    if (write_pfx_peers(outfile, it, &peers_cnt, cb, cb_user) != 0) {
+    /* send the peers (peer id and path index, as in the stream format) */
+    if ((s = bgpview_io_serialize_pfx_peers(
+           blk->buf + blk->written, blk->len - blk->written, it, &peers_cnt,
+           cb, cb_user, 1)) == -1) {
       goto err;
     }
+    blk->written += s;
 
     /* for a pfx to be sent it must have active peers */
     if (peers_cnt == 0) {
+      blk->written = row_start;
       continue;
     }
 
@@ -406,21 +815,524 @@ static int write_pfxs(iow_t *outfile, bgpview_iter_t *it,
   u32 = htonl(pfx_cnt);
   WRITE_VAL(u32);
 
-  return 0;
+  return pfx_cnt;
 
 err:
   return -1;
 }
 
-static int read_peers(io_t *infile, bgpview_iter_t *iter,
-                      bgpview_io_filter_peer_cb_t *peer_cb,
-                      bgpstream_peer_id_t **peerid_mapping)
+/** Write the current chunk of the encoder (a header followed by each of its
+    columns) and empty the columns */
+static int write_chunk(v2_encoder_t *enc)
 {
-  uint16_t pc;
-  int i, j;
+  write_block_t *blk = enc->blk;
+  uint32_t u32;
+  int i;
 
-  bgpstream_peer_id_t peerid_orig;
-  bgpstream_peer_id_t peerid_new;
+  /* address length of all pfxs in the chunk (as for write_ip) */
+  WRITE_VAL(enc->addr_len);
+
+  u32 = htonl(enc->chunk_pfx_cnt);
+  WRITE_VAL(u32);
+
+  u32 = htonl(enc->chunk_cell_cnt);
+  WRITE_VAL(u32);
+
+  for (i = 0; i < V2_COL_CNT; i++) {
+    u32 = htonl(enc->cols[i].used);
+    WRITE_VAL(u32);
+  }
+
+  for (i = 0; i < V2_COL_CNT; i++) {
+    if (block_write(blk, enc->cols[i].buf, enc->cols[i].used) != 0) {
+      goto err;
+    }
+    enc->cols[i].used = 0;
+  }
+
+  enc->chunk_pfx_cnt = 0;
+  enc->chunk_cell_cnt = 0;
+
+  return 0;
+
+err:
+  return -1;
+}
+
+/** Encode a row of pfx-peers of the given pfx into the encoder, completing
+    the current chunk first if it is full, or if the IP version changes. The
+    path indexes of the cells are only encoded if with_paths is set */
+static int v2_encode_row(v2_encoder_t *enc, bgpstream_pfx_t *pfx,
+                         v2_cell_t *cells, int cells_cnt, int with_paths)
+{
+  column_t *cols = enc->cols;
+  uint8_t pfx_len;
+  uint32_t addr;
+  uint8_t shared;
+  uint16_t peer_prev;
+  int i;
+
+  assert(cells_cnt > 0);
+
+  pfx_len = pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4
+              ? sizeof(uint32_t)
+              : sizeof(uint8_t) * 16;
+
+  if (enc->chunk_pfx_cnt > 0 &&
+      (pfx_len != enc->addr_len || enc->chunk_pfx_cnt == V2_CHUNK_PFX_CNT ||
+       enc->chunk_cell_cnt >= V2_CHUNK_CELL_CNT) &&
+      write_chunk(enc) != 0) {
+    return -1;
+  }
+
+  /* deltas are relative to the previous pfx of the chunk */
+  if (enc->chunk_pfx_cnt == 0) {
+    enc->addr_len = pfx_len;
+    enc->addr_prev = 0;
+    memset(enc->addr6_prev, 0, sizeof(enc->addr6_prev));
+  }
+
+  /* pfx address */
+  if (enc->addr_len == sizeof(uint32_t)) {
+    addr = ntohl(pfx->address.bs_ipv4.addr.s_addr);
+    if (varint_put(&cols[V2_COL_PFXS], addr - enc->addr_prev) != 0) {
+      return -1;
+    }
+    enc->addr_prev = addr;
+  } else {
+    /* only the bytes not shared with the previous address are written */
+    shared = 0;
+    while (shared < sizeof(enc->addr6_prev) &&
+           pfx->address.bs_ipv6.addr.s6_addr[shared] ==
+             enc->addr6_prev[shared]) {
+      shared++;
+    }
+    if (column_write(&cols[V2_COL_PFXS], &shared, sizeof(shared)) != 0 ||
+        column_write(&cols[V2_COL_PFXS],
+                     pfx->address.bs_ipv6.addr.s6_addr + shared,
+                     sizeof(enc->addr6_prev) - shared) != 0) {
+      return -1;
+    }
+    memcpy(enc->addr6_prev, pfx->address.bs_ipv6.addr.s6_addr,
+           sizeof(enc->addr6_prev));
+  }
+
+  /* pfx len */
+  if (column_write(&cols[V2_COL_PFXS], &pfx->mask_len,
+                   sizeof(pfx->mask_len)) != 0) {
+    return -1;
+  }
+
+  /* pfx-peers, in peer ID order */
+  if (varint_put(&cols[V2_COL_CNTS], cells_cnt) != 0) {
+    return -1;
+  }
+  qsort(cells, cells_cnt, sizeof(v2_cell_t), v2_cell_cmp);
+  peer_prev = 0;
+  for (i = 0; i < cells_cnt; i++) {
+    assert(cells[i].peer_id > 0);
+    if (varint_put(&cols[V2_COL_PEERS], cells[i].peer_id - peer_prev) != 0 ||
+        (with_paths != 0 &&
+         varint_put(&cols[V2_COL_PATHS], cells[i].path_idx) != 0)) {
+      return -1;
+    }
+    peer_prev = cells[i].peer_id;
+  }
+
+  enc->chunk_pfx_cnt++;
+  enc->chunk_cell_cnt += cells_cnt;
+  enc->pfx_cnt++;
+
+  return 0;
+}
+
+/** Write the last chunk of the encoder, followed by the end-of-pfxs magic and
+    the number of pfxs */
+static int v2_encode_end(v2_encoder_t *enc)
+{
+  write_block_t *blk = enc->blk;
+  uint32_t u32;
+
+  if (enc->chunk_pfx_cnt > 0 && write_chunk(enc) != 0) {
+    goto err;
+  }
+
+  /* write end-of-pfxs magic */
+  WRITE_MAGIC(VIEW_PFX_END_MAGIC);
+
+  /* send pfx cnt for cross-validation */
+  u32 = htonl(enc->pfx_cnt);
+  WRITE_VAL(u32);
+
+  return 0;
+
+err:
+  return -1;
+}
+
+static void v2_encoder_free(v2_encoder_t *enc)
+{
+  int i;
+  for (i = 0; i < V2_COL_CNT; i++) {
+    free(enc->cols[i].buf);
+    enc->cols[i].buf = NULL;
+  }
+}
+
+/** Append a cell to a growable array of cells */
+static int cells_append(v2_cell_t **cells, int *cnt, int *alloc,
+                        uint16_t peer_id, uint32_t path_idx)
+{
+  v2_cell_t *tmp;
+
+  if (*cnt == *alloc) {
+    if ((tmp = realloc(*cells, sizeof(v2_cell_t) *
+                                 (*alloc == 0 ? 64 : *alloc * 2))) == NULL) {
+      return -1;
+    }
+    *cells = tmp;
+    *alloc = (*alloc == 0 ? 64 : *alloc * 2);
+  }
+
+  (*cells)[*cnt].peer_id = peer_id;
+  (*cells)[*cnt].path_idx = path_idx;
+  (*cnt)++;
+  return 0;
+}
+
+/** Write the pfxs of a v2 view: the pfxs are visited in sorted order and
+    written in chunks of pfxs of one IP version. Each chunk stores its pfxs,
+    per-pfx cell counts, peer IDs and path indexes as separate columns, with
+    addresses and peer IDs delta-encoded, which makes each column much more
+    compressible than the interleaved rows of a v1 view. */
+static int write_pfxs_v2(write_block_t *blk, bgpview_iter_t *it,
+                         bgpview_io_filter_cb_t *cb, void *cb_user)
+{
+  int filter;
+
+  v2_encoder_t enc;
+
+  /* the pfx-peers of the current pfx */
+  v2_cell_t *cells = NULL;
+  int cells_cnt;
+  int cells_alloc = 0;
+
+  bgpstream_as_path_store_path_t *spath;
+
+  memset(&enc, 0, sizeof(enc));
+  enc.blk = blk;
+
+  /* sorted pfxs give small address deltas, but any order can be encoded, so
+     fall back to hash order if the sorted index cannot be built (a sorted
+     iterator would silently find no pfxs) */
+  if (bgpview_build_pfx_index(bgpview_iter_get_view(it)) == 0) {
+    bgpview_iter_set_pfx_order(it, BGPVIEW_PFX_ORDER_SORTED);
+  }
+
+  for (bgpview_iter_first_pfx(it, 0, /* all pfx versions */
+                              BGPVIEW_FIELD_ACTIVE);
+       bgpview_iter_has_more_pfx(it); bgpview_iter_next_pfx(it)) {
+    if (cb != NULL) {
+      /* ask the caller if they want this pfx */
+      if ((filter = cb(it, BGPVIEW_IO_FILTER_PFX, cb_user)) < 0) {
+        goto err;
+      }
+      if (filter == 0) {
+        continue;
+      }
+    }
+
+    /* collect the pfx-peers that pass the filter */
+    cells_cnt = 0;
+    for (bgpview_iter_pfx_first_peer(it, BGPVIEW_FIELD_ACTIVE);
+         bgpview_iter_pfx_has_more_peer(it); bgpview_iter_pfx_next_peer(it)) {
+      if (cb != NULL) {
+        /* ask the caller if they want this pfx-peer */
+        if ((filter = cb(it, BGPVIEW_IO_FILTER_PFX_PEER, cb_user)) < 0) {
+          goto err;
+        }
+        if (filter == 0) {
+          continue;
+        }
+      }
+      spath = bgpview_iter_pfx_peer_get_as_path_store_path(it);
+      if (cells_append(&cells, &cells_cnt, &cells_alloc,
+                       bgpview_iter_peer_get_peer_id(it),
+                       bgpstream_as_path_store_path_get_idx(spath)) != 0) {
+        goto err;
+      }
+    }
+
+    /* for a pfx to be sent it must have active peers */
+    if (cells_cnt > 0 &&
+        v2_encode_row(&enc, bgpview_iter_pfx_get_pfx(it), cells, cells_cnt,
+                      1) != 0) {
+      goto err;
+    }
+  }
+
+  if (v2_encode_end(&enc) != 0) {
+    goto err;
+  }
+
+  free(cells);
+  v2_encoder_free(&enc);
+  return enc.pfx_cnt;
+
+err:
+  free(cells);
+  v2_encoder_free(&enc);
+  return -1;
+}
+
+static int diff_filter(bgpview_iter_t *it, bgpview_io_filter_type_t type,
+                       void *user)
+{
+  diff_state_t *state = (diff_state_t *)user;
+  return state->cb(it, type, state->cb_user);
+}
+
+/** Get the index in the diff of the path of the current pfx-peer, adding the
+    path to the diff if it is not already used by it */
+static int diff_path_idx(diff_state_t *state, bgpview_iter_t *it,
+                         uint32_t *idx)
+{
+  bgpstream_as_path_store_path_t *spath;
+  bgpstream_as_path_store_path_t **paths;
+  khiter_t k;
+  int khret;
+
+  spath = bgpview_iter_pfx_peer_get_as_path_store_path(it);
+  k = kh_put(path_idx, state->path_idx,
+             bgpstream_as_path_store_path_get_idx(spath), &khret);
+  if (khret < 0) {
+    return -1;
+  }
+  if (khret > 0) {
+    if (state->paths_cnt == state->paths_alloc) {
+      if ((paths = realloc(state->paths,
+                           sizeof(bgpstream_as_path_store_path_t *) *
+                             (state->paths_alloc == 0
+                                ? 1024
+                                : state->paths_alloc * 2))) == NULL) {
+        return -1;
+      }
+      state->paths = paths;
+      state->paths_alloc =
+        state->paths_alloc == 0 ? 1024 : state->paths_alloc * 2;
+    }
+    state->paths[state->paths_cnt] = spath;
+    kh_val(state->path_idx, k) = state->paths_cnt++;
+  }
+
+  *idx = kh_val(state->path_idx, k);
+  return 0;
+}
+
+/** Encode all the (accepted) pfx-peers of the current pfx of the iterator as
+    a row of the given encoder */
+static int diff_pfx_row(diff_state_t *state, bgpview_iter_t *it,
+                        v2_encoder_t *enc, v2_cell_t **cells, int *cells_cnt,
+                        int *cells_alloc)
+{
+  int with_paths = (enc == &state->upd);
+  uint32_t idx = 0;
+  int filter;
+
+  *cells_cnt = 0;
+  for (bgpview_iter_pfx_first_peer(it, BGPVIEW_FIELD_ACTIVE);
+       bgpview_iter_pfx_has_more_peer(it); bgpview_iter_pfx_next_peer(it)) {
+    if (state->cb != NULL) {
+      /* ask the caller if they want this pfx-peer */
+      if ((filter = state->cb(it, BGPVIEW_IO_FILTER_PFX_PEER,
+                              state->cb_user)) < 0) {
+        return -1;
+      }
+      if (filter == 0) {
+        continue;
+      }
+    }
+    if ((with_paths != 0 && diff_path_idx(state, it, &idx) != 0) ||
+        cells_append(cells, cells_cnt, cells_alloc,
+                     bgpview_iter_peer_get_peer_id(it), idx) != 0) {
+      return -1;
+    }
+  }
+
+  if (*cells_cnt > 0 &&
+      v2_encode_row(enc, bgpview_iter_pfx_get_pfx(it), *cells, *cells_cnt,
+                    with_paths) != 0) {
+    return -1;
+  }
+  *cells_cnt = 0;
+
+  return 0;
+}
+
+static int diff_pfx_added(bgpview_iter_t *parent_view_it, bgpview_iter_t *it,
+                          void *user)
+{
+  diff_state_t *state = (diff_state_t *)user;
+
+  /* update row with all the pfx-peers */
+  return diff_pfx_row(state, it, &state->upd, &state->upd_cells,
+                      &state->upd_cells_cnt, &state->upd_cells_alloc);
+}
+
+static int diff_pfx_removed(bgpview_iter_t *parent_view_it, bgpview_iter_t *it,
+                            void *user)
+{
+  diff_state_t *state = (diff_state_t *)user;
+
+  /* remove row with all the pfx-peers of the parent */
+  return diff_pfx_row(state, parent_view_it, &state->rem, &state->rem_cells,
+                      &state->rem_cells_cnt, &state->rem_cells_alloc);
+}
+
+/* add the current pfx-peer of it to the update row */
+static int diff_pfx_peer_update(bgpview_iter_t *parent_view_it,
+                                bgpview_iter_t *it, void *user)
+{
+  diff_state_t *state = (diff_state_t *)user;
+  uint32_t idx;
+
+  if (diff_path_idx(state, it, &idx) != 0) {
+    return -1;
+  }
+  return cells_append(&state->upd_cells, &state->upd_cells_cnt,
+                      &state->upd_cells_alloc,
+                      bgpview_iter_peer_get_peer_id(it), idx);
+}
+
+/* add the current pfx-peer of parent_view_it to the remove row */
+static int diff_pfx_peer_removed(bgpview_iter_t *parent_view_it,
+                                 bgpview_iter_t *it, void *user)
+{
+  diff_state_t *state = (diff_state_t *)user;
+
+  return cells_append(&state->rem_cells, &state->rem_cells_cnt,
+                      &state->rem_cells_alloc,
+                      bgpview_iter_peer_get_peer_id(parent_view_it), 0);
+}
+
+/* all the cells of a common prefix have been diffed, encode its rows */
+static int diff_pfx_changed(bgpview_iter_t *parent_view_it, bgpview_iter_t *it,
+                            void *user)
+{
+  diff_state_t *state = (diff_state_t *)user;
+  bgpstream_pfx_t *pfx = bgpview_iter_pfx_get_pfx(it);
+
+  if (state->upd_cells_cnt > 0 &&
+      v2_encode_row(&state->upd, pfx, state->upd_cells, state->upd_cells_cnt,
+                    1) != 0) {
+    return -1;
+  }
+  state->upd_cells_cnt = 0;
+
+  if (state->rem_cells_cnt > 0 &&
+      v2_encode_row(&state->rem, pfx, state->rem_cells, state->rem_cells_cnt,
+                    0) != 0) {
+    return -1;
+  }
+  state->rem_cells_cnt = 0;
+
+  return 0;
+}
+
+static void diff_state_free(diff_state_t *state)
+{
+  v2_encoder_free(&state->upd);
+  free(state->upd.blk->buf);
+  v2_encoder_free(&state->rem);
+  free(state->rem.blk->buf);
+  free(state->upd_cells);
+  free(state->rem_cells);
+  free(state->paths);
+  if (state->path_idx != NULL) {
+    kh_destroy(path_idx, state->path_idx);
+  }
+}
+
+/** Write the paths and pfxs of a diff view: the table of the paths used by
+    the diff, followed by the (v2-encoded) rows of pfx-peers that were added
+    to or changed in the view, and then by the rows of pfx-peers that were
+    removed from it, since the parent view. Returns the number of rows
+    written, or -1 on error */
+static int write_pfxs_diff(write_block_t *blk, bgpview_t *view,
+                           bgpview_t *parent_view, bgpview_io_filter_cb_t *cb,
+                           void *cb_user)
+{
+  bgpview_diff_cbs_t cbs = {
+    diff_pfx_added,       diff_pfx_removed,      diff_pfx_changed,
+    diff_pfx_peer_update, diff_pfx_peer_removed, diff_pfx_peer_update,
+  };
+  diff_state_t state;
+
+  /* the rows are only written once the path table is complete */
+  write_block_t upd_blk = {NULL, NULL, 0, 0, 0};
+  write_block_t rem_blk = {NULL, NULL, 0, 0, 0};
+
+  uint32_t u32;
+  int i;
+  int ret;
+
+  memset(&state, 0, sizeof(state));
+  state.cb = cb;
+  state.cb_user = cb_user;
+  state.upd.blk = &upd_blk;
+  state.rem.blk = &rem_blk;
+  if ((state.path_idx = kh_init(path_idx)) == NULL) {
+    goto err;
+  }
+
+  /* without a filter, bgpview_diff can skip the prefixes that are shared
+     with the parent */
+  if (bgpview_diff(parent_view, view, &cbs, cb == NULL ? NULL : diff_filter,
+                   &state) != 0) {
+    goto err;
+  }
+
+  if (v2_encode_end(&state.upd) != 0 || v2_encode_end(&state.rem) != 0) {
+    goto err;
+  }
+
+  /* paths used by the diff */
+  for (i = 0; i < state.paths_cnt; i++) {
+    if (write_path(blk, state.paths[i], i) != 0) {
+      goto err;
+    }
+  }
+
+  /* write end-of-paths magic number */
+  WRITE_MAGIC(VIEW_PATH_END_MAGIC);
+
+  /* now send the number of paths for cross validation */
+  u32 = htonl(state.paths_cnt);
+  WRITE_VAL(u32);
+
+  if (block_write(blk, upd_blk.buf, upd_blk.written) != 0 ||
+      block_write(blk, rem_blk.buf, rem_blk.written) != 0) {
+    goto err;
+  }
+
+  ret = state.upd.pfx_cnt + state.rem.pfx_cnt;
+  diff_state_free(&state);
+  return ret;
+
+err:
+  diff_state_free(&state);
+  return -1;
+}
+
+static int read_peers(read_block_t *blk, bgpview_iter_t *iter,
+                      bgpview_io_filter_peer_cb_t *peer_cb,
+                      bgpstream_peer_id_t **peerid_mapping)
+{
+  uint16_t pc;
+  int i, j;
+
+  bgpstream_peer_id_t peerid_orig;
+  bgpstream_peer_id_t peerid_new;
 
   bgpstream_peer_sig_t ps;
   uint8_t len;
@@ -436,7 +1348,7 @@ static int read_peers(io_t *infile, bgpview_iter_t *iter,
      peer asn */
   for (i = 0; i < UINT16_MAX; i++) {
     /* peerid (or end-of-peers)*/
-    if (check_magic(infile, VIEW_PEER_END_MAGIC) != 0) {
+    if (check_magic(blk, VIEW_PEER_END_MAGIC) != 0) {
       /* end of peers */
       break;
     }
@@ -449,14 +1361,17 @@ static int read_peers(io_t *infile, bgpview_iter_t *iter,
 
     /* collector name */
     READ_VAL(len);
-    if (wandio_read(infile, ps.collector_str, len) != len) {
+    if (len >= sizeof(ps.collector_str) ||
+        ((blk->valid - blk->pos) < len && block_fill(blk, len) != 0)) {
       fprintf(stderr, "ERROR: Could not read collector name\n");
       goto err;
     }
+    memcpy(ps.collector_str, blk->buf + blk->pos, len);
     ps.collector_str[len] = '\0';
+    blk->pos += len;
 
     /* peer ip */
-    if (read_ip(infile, &ps.peer_ip_addr) != 0) {
+    if (read_ip(blk, &ps.peer_ip_addr) != 0) {
       fprintf(stderr, "ERROR: Could not read peer ip\n");
       goto err;
     }
@@ -513,10 +1428,11 @@ static int read_peers(io_t *infile, bgpview_iter_t *iter,
   return idmap_cnt;
 
 err:
+  free(idmap);
   return -1;
 }
 
-static int read_paths(io_t *infile, bgpview_iter_t *iter,
+static int read_paths(read_block_t *blk, bgpview_iter_t *iter,
                       bgpstream_as_path_store_path_id_t **pathid_mapping)
 {
   uint32_t pc;
@@ -524,7 +1440,6 @@ static int read_paths(io_t *infile, bgpview_iter_t *iter,
   uint32_t pathidx;
   uint16_t pathlen;
   uint8_t is_core;
-  uint8_t pathdata[BUFFER_LEN];
 
   bgpstream_as_path_store_path_id_t *idmap = NULL;
   int idmap_cnt = 0;
@@ -533,23 +1448,17 @@ static int read_paths(io_t *infile, bgpview_iter_t *iter,
 
   bgpview_t *view = NULL;
   bgpstream_as_path_store_t *store = NULL;
-  bgpstream_as_path_t *path = NULL;
 
   /* only if we have a valid iterator */
   if (iter != NULL) {
     view = bgpview_iter_get_view(iter);
     store = bgpview_get_as_path_store(view);
-
-    /* create a path */
-    if ((path = bgpstream_as_path_create()) == NULL) {
-      return -1;
-    }
   }
 
   /* loop until we find the path end magic number */
   while (paths_rx < UINT32_MAX) {
     /* pathid (or end-of-paths)*/
-    if (check_magic(infile, VIEW_PATH_END_MAGIC) != 0) {
+    if (check_magic(blk, VIEW_PATH_END_MAGIC) != 0) {
       /* end of peers */
       break;
     }
@@ -566,9 +1475,8 @@ static int read_paths(io_t *infile, bgpview_iter_t *iter,
     /* path len */
     READ_VAL(pathlen);
 
-    /* path data */
-    assert(pathlen <= BUFFER_LEN);
-    if (wandio_read(infile, pathdata, pathlen) != pathlen) {
+    /* path data (inserted straight from the block) */
+    if ((blk->valid - blk->pos) < pathlen && block_fill(blk, pathlen) != 0) {
       fprintf(stderr, "ERROR: Could not read path data\n");
       goto err;
     }
@@ -587,11 +1495,13 @@ static int read_paths(io_t *infile, bgpview_iter_t *iter,
       }
 
       /* now add this path to the store */
-      if (bgpstream_as_path_store_insert_path(store, pathdata, pathlen, is_core,
+      if (bgpstream_as_path_store_insert_path(store, blk->buf + blk->pos,
+                                              pathlen, is_core,
                                               &idmap[pathidx]) != 0) {
         goto err;
       }
     }
+    blk->pos += pathlen;
   }
 
   /* receive the number of paths */
@@ -603,10 +1513,11 @@ static int read_paths(io_t *infile, bgpview_iter_t *iter,
   return idmap_cnt;
 
 err:
+  free(idmap);
   return -1;
 }
 
-static int read_pfxs(io_t *infile, bgpview_iter_t *iter,
+static int read_pfxs(read_block_t *blk, bgpview_iter_t *iter,
                      bgpview_io_filter_pfx_cb_t *pfx_cb,
                      bgpview_io_filter_pfx_peer_cb_t *pfx_peer_cb,
                      bgpstream_peer_id_t *peerid_map, int peerid_map_cnt,
@@ -623,7 +1534,9 @@ static int read_pfxs(io_t *infile, bgpview_iter_t *iter,
 
   uint32_t pathidx;
 
-  int pfx_peers_added = 0;
+  bgpstream_peer_id_t batch_ids[BGPVIEW_IO_PFX_PEERS_BATCH];
+  bgpstream_as_path_store_path_id_t batch_paths[BGPVIEW_IO_PFX_PEERS_BATCH];
+  int batch_cnt = 0;
 
   unsigned pfx_rx = 0;
   unsigned pfx_peer_rx = 0;
@@ -641,7 +1554,7 @@ static int read_pfxs(io_t *infile, bgpview_iter_t *iter,
 
   /* foreach pfx, read pfx.ip, pfx.len, [peers_cnt, peer_info] */
   for (i = 0; i < UINT32_MAX; i++) {
-    if (check_magic(infile, VIEW_PFX_END_MAGIC) != 0) {
+    if (check_magic(blk, VIEW_PFX_END_MAGIC) != 0) {
       /* end of pfxs */
       break;
     }
@@ -649,7 +1562,7 @@ static int read_pfxs(io_t *infile, bgpview_iter_t *iter,
     skip_pfx = 0;
 
     /* pfx_ip */
-    if (read_ip(infile, &pfx.address) != 0) {
+    if (read_ip(blk, &pfx.address) != 0) {
       fprintf(stderr, "ERROR: Could not read pfx ip\n");
       goto err;
     }
@@ -667,11 +1580,10 @@ static int read_pfxs(io_t *infile, bgpview_iter_t *iter,
       }
     }
 
-    pfx_peers_added = 0;
     pfx_peer_rx = 0;
 
     for (j = 0; j < UINT16_MAX; j++) {
-      if (check_magic(infile, VIEW_PEER_END_MAGIC) != 0) {
+      if (check_magic(blk, VIEW_PEER_END_MAGIC) != 0) {
         /* end of peers */
         break;
       }
@@ -690,7 +1602,15 @@ static int read_pfxs(io_t *infile, bgpview_iter_t *iter,
       }
       /* all code below here has a valid iter */
 
-      assert(peerid < peerid_map_cnt);
+      /* skip cells of peers that were filtered out */
+      if (peerid >= peerid_map_cnt || peerid_map[peerid] == 0) {
+        continue;
+      }
+
+      if (pathidx >= (uint32_t)pathid_map_cnt) {
+        fprintf(stderr, "ERROR: Invalid path index %" PRIu32 "\n", pathidx);
+        goto err;
+      }
 
       if (pfx_peer_cb != NULL) {
         /* get the store path using the id */
@@ -705,30 +1625,26 @@ static int read_pfxs(io_t *infile, bgpview_iter_t *iter,
         }
       }
 
-      if (pfx_peers_added == 0) {
-        /* we have to use add_pfx_peer */
-        if (bgpview_iter_add_pfx_peer_by_id(iter, &pfx,
-                                            peerid_map[peerid],
-                                            pathid_map[pathidx]) != 0) {
-          fprintf(stderr, "Could not add prefix\n");
-          goto err;
-        }
-      } else {
-        /* we can use pfx_add_peer for efficiency */
-        if (bgpview_iter_pfx_add_peer_by_id(iter, peerid_map[peerid],
-                                            pathid_map[pathidx]) != 0) {
+      /* pfx-peers are added (and activated) in bulk */
+      batch_ids[batch_cnt] = peerid_map[peerid];
+      batch_paths[batch_cnt] = pathid_map[pathidx];
+      if (++batch_cnt == BGPVIEW_IO_PFX_PEERS_BATCH) {
+        if (bgpview_iter_add_pfx_peers(iter, &pfx, batch_ids, batch_paths,
+                                       NULL, batch_cnt) != 0) {
           fprintf(stderr, "Could not add prefix\n");
           goto err;
         }
+        batch_cnt = 0;
       }
+    }
 
-      pfx_peers_added++;
-
-      /* now we have to activate it */
-      if (bgpview_iter_pfx_activate_peer(iter) < 0) {
-        fprintf(stderr, "Could not activate prefix\n");
+    if (batch_cnt > 0) {
+      if (bgpview_iter_add_pfx_peers(iter, &pfx, batch_ids, batch_paths, NULL,
+                                     batch_cnt) != 0) {
+        fprintf(stderr, "Could not add prefix\n");
         goto err;
       }
+      batch_cnt = 0;
     }
 
     /* peer cnt */
@@ -748,19 +1664,278 @@ err:
   return -1;
 }
 
-/* ========== PUBLIC FUNCTIONS ========== */
-
-int bgpview_io_file_write(iow_t *outfile, bgpview_t *view,
-                          bgpview_io_filter_cb_t *cb, void *cb_user)
+/** Read the pfxs of a v2 view (see write_pfxs_v2). Each chunk is parsed
+    straight from the block, so a chunk must fit in memory. If state is
+    BGPVIEW_FIELD_INACTIVE, the rows are the (path-less) rows of pfx-peers
+    removed by a diff view, and those pfx-peers are deactivated */
+static int read_pfxs_v2(read_block_t *blk, bgpview_iter_t *iter,
+                        bgpview_io_filter_pfx_cb_t *pfx_cb,
+                        bgpview_io_filter_pfx_peer_cb_t *pfx_peer_cb,
+                        bgpstream_peer_id_t *peerid_map, int peerid_map_cnt,
+                        bgpstream_as_path_store_path_id_t *pathid_map,
+                        int pathid_map_cnt, bgpview_field_state_t state)
 {
-  uint32_t u32;
-  bgpview_iter_t *it = NULL;
+  uint32_t pfx_cnt;
+  uint32_t chunk_pfx_cnt;
+  uint32_t chunk_cell_cnt;
+  uint32_t col_len[V2_COL_CNT];
+  uint8_t addr_len;
+  size_t chunk_len;
+  uint32_t i;
+  uint32_t j;
+  int k;
+
+  column_t cols[V2_COL_CNT];
+
+  bgpstream_pfx_t pfx;
+  uint32_t addr = 0;
+  uint8_t shared;
+
+  uint32_t peer_cnt;
+  uint32_t peerid;
+  uint32_t delta;
+  uint32_t pathidx;
+
+  bgpstream_peer_id_t batch_ids[BGPVIEW_IO_PFX_PEERS_BATCH];
+  bgpstream_as_path_store_path_id_t batch_paths[BGPVIEW_IO_PFX_PEERS_BATCH];
+  int batch_cnt = 0;
+
+  unsigned pfx_rx = 0;
+  uint32_t cell_rx;
+
+  int skip_pfx = 0;
+  int filter;
+
+  bgpview_t *view = NULL;
+  bgpstream_as_path_store_t *store = NULL;
+  bgpstream_as_path_store_path_t *store_path = NULL;
+  if (iter != NULL) {
+    view = bgpview_iter_get_view(iter);
+    store = bgpview_get_as_path_store(view);
+  }
+
+  /* foreach chunk, read the header and then parse the columns */
+  while (1) {
+    if (check_magic(blk, VIEW_PFX_END_MAGIC) != 0) {
+      /* end of pfxs */
+      break;
+    }
+
+    READ_VAL(addr_len);
+    READ_VAL(chunk_pfx_cnt);
+    chunk_pfx_cnt = ntohl(chunk_pfx_cnt);
+    READ_VAL(chunk_cell_cnt);
+    chunk_cell_cnt = ntohl(chunk_cell_cnt);
+    chunk_len = 0;
+    for (k = 0; k < V2_COL_CNT; k++) {
+      READ_VAL(col_len[k]);
+      col_len[k] = ntohl(col_len[k]);
+      chunk_len += col_len[k];
+    }
+
+    if ((addr_len != sizeof(uint32_t) && addr_len != sizeof(uint8_t) * 16) ||
+        chunk_len > V2_CHUNK_MAX_LEN) {
+      fprintf(stderr, "ERROR: Invalid pfx chunk (addr len: %d, len: %zu)\n",
+              addr_len, chunk_len);
+      goto err;
+    }
+
+    if ((blk->valid - blk->pos) < chunk_len &&
+        block_fill(blk, chunk_len) != 0) {
+      fprintf(stderr, "ERROR: Could not read pfx chunk\n");
+      goto err;
+    }
+
+    pfx_rx += chunk_pfx_cnt;
+
+    if (iter == NULL) {
+      blk->pos += chunk_len;
+      continue;
+    }
+    /* all code below here has a valid iter */
+
+    /* point the columns into the block */
+    for (k = 0; k < V2_COL_CNT; k++) {
+      cols[k].buf = blk->buf + blk->pos;
+      cols[k].len = col_len[k];
+      cols[k].used = 0;
+      blk->pos += col_len[k];
+    }
+
+    if (addr_len == sizeof(uint32_t)) {
+      pfx.address.version = BGPSTREAM_ADDR_VERSION_IPV4;
+      addr = 0;
+    } else {
+      pfx.address.version = BGPSTREAM_ADDR_VERSION_IPV6;
+      memset(pfx.address.bs_ipv6.addr.s6_addr, 0,
+             sizeof(pfx.address.bs_ipv6.addr.s6_addr));
+    }
+    cell_rx = 0;
+
+    for (i = 0; i < chunk_pfx_cnt; i++) {
+      skip_pfx = 0;
+
+      /* pfx address */
+      if (addr_len == sizeof(uint32_t)) {
+        if (varint_get(&cols[V2_COL_PFXS], &delta) != 0) {
+          goto corrupt;
+        }
+        addr += delta;
+        pfx.address.bs_ipv4.addr.s_addr = htonl(addr);
+      } else {
+        if (column_read(&cols[V2_COL_PFXS], &shared, sizeof(shared)) != 0 ||
+            shared > addr_len ||
+            column_read(&cols[V2_COL_PFXS],
+                        pfx.address.bs_ipv6.addr.s6_addr + shared,
+                        addr_len - shared) != 0) {
+          goto corrupt;
+        }
+      }
+
+      /* pfx len */
+      if (column_read(&cols[V2_COL_PFXS], &pfx.mask_len,
+                      sizeof(pfx.mask_len)) != 0) {
+        goto corrupt;
+      }
+
+      if (varint_get(&cols[V2_COL_CNTS], &peer_cnt) != 0) {
+        goto corrupt;
+      }
+
+      if (pfx_cb != NULL && state == BGPVIEW_FIELD_ACTIVE) {
+        /* ask the caller if they want this pfx */
+        if ((filter = pfx_cb(&pfx)) < 0) {
+          goto err;
+        }
+        if (filter == 0) {
+          skip_pfx = 1;
+        }
+      }
+
+      peerid = 0;
+      for (j = 0; j < peer_cnt; j++) {
+        /* peer id (delta-encoded) */
+        if (varint_get(&cols[V2_COL_PEERS], &delta) != 0 ||
+            (peerid += delta) > UINT16_MAX) {
+          goto corrupt;
+        }
+
+        /* AS Path Index (removed pfx-peers have none) */
+        if (state != BGPVIEW_FIELD_ACTIVE) {
+          pathidx = 0;
+        } else if (varint_get(&cols[V2_COL_PATHS], &pathidx) != 0) {
+          goto corrupt;
+        }
+
+        if (skip_pfx != 0) {
+          continue;
+        }
+
+        /* skip cells of peers that were filtered out */
+        if (peerid >= (uint32_t)peerid_map_cnt || peerid_map[peerid] == 0) {
+          continue;
+        }
+
+        if (state != BGPVIEW_FIELD_ACTIVE) {
+          /* removed pfx-peer (which may have been filtered out already) */
+          if (bgpview_iter_seek_pfx_peer(iter, &pfx, peerid_map[peerid],
+                                         BGPVIEW_FIELD_ALL_VALID,
+                                         BGPVIEW_FIELD_ALL_VALID) == 1 &&
+              bgpview_iter_pfx_deactivate_peer(iter) < 0) {
+            goto err;
+          }
+          continue;
+        }
+
+        if (pathidx >= (uint32_t)pathid_map_cnt) {
+          fprintf(stderr, "ERROR: Invalid path index %" PRIu32 "\n",
+                  pathidx);
+          goto err;
+        }
+
+        if (pfx_peer_cb != NULL) {
+          /* get the store path using the id */
+          store_path =
+            bgpstream_as_path_store_get_store_path(store, pathid_map[pathidx]);
+          /* ask the caller if they want this pfx-peer */
+          if ((filter = pfx_peer_cb(store_path)) < 0) {
+            goto err;
+          }
+          if (filter == 0) {
+            continue;
+          }
+        }
+
+        /* pfx-peers are added (and activated) in bulk */
+        batch_ids[batch_cnt] = peerid_map[peerid];
+        batch_paths[batch_cnt] = pathid_map[pathidx];
+        if (++batch_cnt == BGPVIEW_IO_PFX_PEERS_BATCH) {
+          if (bgpview_iter_add_pfx_peers(iter, &pfx, batch_ids, batch_paths,
+                                         NULL, batch_cnt) != 0) {
+            fprintf(stderr, "Could not add prefix\n");
+            goto err;
+          }
+          batch_cnt = 0;
+        }
+      }
+      cell_rx += peer_cnt;
+
+      if (batch_cnt > 0) {
+        if (bgpview_iter_add_pfx_peers(iter, &pfx, batch_ids, batch_paths,
+                                       NULL, batch_cnt) != 0) {
+          fprintf(stderr, "Could not add prefix\n");
+          goto err;
+        }
+        batch_cnt = 0;
+      }
+    }
+
+    /* every column must have been parsed exactly */
+    if (cell_rx != chunk_cell_cnt) {
+      goto corrupt;
+    }
+    for (k = 0; k < V2_COL_CNT; k++) {
+      if (cols[k].used != cols[k].len) {
+        goto corrupt;
+      }
+    }
+  }
+
+  /* pfx cnt */
+  READ_VAL(pfx_cnt);
+  pfx_cnt = ntohl(pfx_cnt);
+  assert(pfx_rx == pfx_cnt);
+
+  return 0;
+
+corrupt:
+  fprintf(stderr, "ERROR: Corrupt pfx chunk\n");
+err:
+  return -1;
+}
+
+static int write_view(iow_t *outfile, iow_t *idxfile, uint64_t *offset,
+                      bgpview_t *view, bgpview_t *parent_view,
+                      bgpview_io_filter_cb_t *cb, void *cb_user, int version)
+{
+  uint32_t u32;
+  bgpview_iter_t *it = NULL;
+
+  write_block_t block = {outfile, NULL, WRITE_BLOCK_LEN, 0, 0};
+  write_block_t *blk = &block;
+
+  index_entry_t entry;
+  int peer_cnt;
+  int pfx_cnt;
 
   if (view == NULL) {
     /* no-op */
     return 0;
   }
 
+  /* diff views are only written in the v2 format */
+  assert(parent_view == NULL || version == 2);
+
 #ifdef DEBUG
   fprintf(stderr, "DEBUG: Writing view...\n");
 #endif
@@ -769,42 +1944,237 @@ int bgpview_io_file_write(iow_t *outfile, bgpview_t *view,
     goto err;
   }
 
-  /* start magic */
-  WRITE_MAGIC(VIEW_START_MAGIC);
+  if ((block.buf = malloc(block.len)) == NULL) {
+    goto err;
+  }
+
+  /* start magic (which also gives the format version, or marks a diff) */
+  if (parent_view != NULL) {
+    WRITE_MAGIC(VIEW_DIFF_MAGIC);
+  } else {
+    WRITE_MAGIC(version == 1 ? VIEW_START_MAGIC : VIEW_START_V2_MAGIC);
+  }
 
   /* time */
   u32 = htonl(bgpview_get_time(view));
   WRITE_VAL(u32);
 
-  if (write_peers(outfile, it, cb, cb_user) != 0) {
-    goto err;
+  /* time of the view that the diff applies to */
+  if (parent_view != NULL) {
+    u32 = htonl(bgpview_get_time(parent_view));
+    WRITE_VAL(u32);
   }
 
-  if (write_paths(outfile, it) != 0) {
+  /* diffs have the complete peer table too (peers that are not in it are
+     removed from the view) */
+  if ((peer_cnt = write_peers(blk, it, cb, cb_user)) < 0) {
     goto err;
   }
 
-  if (write_pfxs(outfile, it, cb, cb_user) != 0) {
+  if (parent_view != NULL) {
+    pfx_cnt = write_pfxs_diff(blk, view, parent_view, cb, cb_user);
+  } else {
+    if (write_paths(blk, it) != 0) {
+      goto err;
+    }
+    if (version == 1) {
+      pfx_cnt = write_pfxs(blk, it, cb, cb_user);
+    } else {
+      pfx_cnt = write_pfxs_v2(blk, it, cb, cb_user);
+    }
+  }
+  if (pfx_cnt < 0) {
     goto err;
   }
 
   /* write end-of-view magic number */
   WRITE_MAGIC(VIEW_END_MAGIC);
 
+  if (block_flush(blk) != 0) {
+    goto err;
+  }
+
+  if (idxfile != NULL) {
+    entry.magic =
+      htonl(parent_view != NULL ? VIEW_INDEX_DIFF_MAGIC : VIEW_INDEX_MAGIC);
+    entry.time = htonl(bgpview_get_time(view));
+    entry.offset = htonll(*offset);
+    entry.len = htonll(block.flushed);
+    entry.peer_cnt = htonl(peer_cnt);
+    entry.pfx_cnt = htonl(pfx_cnt);
+    if (wandio_wwrite(idxfile, &entry, sizeof(entry)) != sizeof(entry)) {
+      fprintf(stderr, "ERROR: Could not write index entry\n");
+      goto err;
+    }
+    *offset += block.flushed;
+  }
+
   bgpview_iter_destroy(it);
+  free(block.buf);
 
   return 0;
 
 err:
+  if (it != NULL) {
+    bgpview_iter_destroy(it);
+  }
+  free(block.buf);
   return -1;
 }
 
-int bgpview_io_file_read(io_t *infile, bgpview_t *view,
-                         bgpview_io_filter_peer_cb_t *peer_cb,
-                         bgpview_io_filter_pfx_cb_t *pfx_cb,
-                         bgpview_io_filter_pfx_peer_cb_t *pfx_peer_cb)
+/** Read the index of a file to find how far to skip from the view at cur_time
+    to reach the first view at or after the given time or, if that is a diff
+    view, the last sync view before it (from which it can be reconstructed).
+    Returns 1 if the distance was found, 2 if every indexed view is before the
+    given time, 0 if the index does not cover cur_time, and -1 on error */
+static int index_find(io_t *idxfile, uint32_t cur_time, uint32_t time,
+                      uint64_t *skip)
+{
+  index_entry_t entry;
+  int64_t read;
+  int found = 0;
+  uint32_t magic;
+  uint64_t offset;
+  uint64_t cur_offset = 0;
+  uint64_t sync_offset = 0;
+  int sync_found = 0;
+  uint64_t end = 0;
+
+  while ((read = wandio_read(idxfile, &entry, sizeof(entry))) ==
+         sizeof(entry)) {
+    magic = ntohl(entry.magic);
+    if (magic != VIEW_INDEX_MAGIC && magic != VIEW_INDEX_DIFF_MAGIC) {
+      fprintf(stderr, "ERROR: Invalid index entry\n");
+      return -1;
+    }
+    offset = ntohll(entry.offset);
+    end = offset + ntohll(entry.len);
+
+    if (found == 0) {
+      if (ntohl(entry.time) == cur_time) {
+        cur_offset = offset;
+        found = 1;
+      } else {
+        continue;
+      }
+    }
+
+    if (ntohl(entry.time) >= time) {
+      if (magic == VIEW_INDEX_DIFF_MAGIC && sync_found != 0) {
+        offset = sync_offset;
+      }
+      *skip = offset - cur_offset;
+      return 1;
+    }
+
+    if (magic == VIEW_INDEX_MAGIC) {
+      sync_offset = offset;
+      sync_found = 1;
+    }
+  }
+
+  if (read < 0) {
+    return -1;
+  }
+
+  /* every indexed view is before the given time, so skip them all */
+  if (found != 0) {
+    *skip = end - cur_offset;
+    return 2;
+  }
+  return 0;
+}
+
+/** Skip len bytes of the given file. Compressed files cannot seek, so the
+    bytes are read through (which still avoids parsing the views in them) */
+static int skip_bytes(io_t *infile, uint64_t len)
+{
+  uint8_t *buf = NULL;
+  int64_t read;
+
+  if ((buf = malloc(READ_BLOCK_LEN)) == NULL) {
+    return -1;
+  }
+
+  while (len > 0) {
+    if ((read = wandio_read(infile, buf,
+                            len < READ_BLOCK_LEN ? len : READ_BLOCK_LEN)) <=
+        0) {
+      free(buf);
+      return -1;
+    }
+    len -= read;
+  }
+
+  free(buf);
+  return 0;
+}
+
+/** Peek at the time of the next view in the file, and whether it is a diff
+    view. Returns 1 if there is a view, 0 at EOF and -1 on error */
+static int peek_time(io_t *infile, uint32_t *time, int *diff)
+{
+  uint32_t hdr[3];
+  int64_t peeked;
+
+  if ((peeked = wandio_peek(infile, hdr, sizeof(hdr))) == 0) {
+    return 0;
+  }
+  if (peeked != sizeof(hdr) || ntohl(hdr[0]) != VIEW_MAGIC ||
+      (ntohl(hdr[1]) != VIEW_START_MAGIC &&
+       ntohl(hdr[1]) != VIEW_START_V2_MAGIC &&
+       ntohl(hdr[1]) != VIEW_DIFF_MAGIC)) {
+    fprintf(stderr, "ERROR: Missing view-start magic number\n");
+    return -1;
+  }
+
+  *time = ntohl(hdr[2]);
+  *diff = (ntohl(hdr[1]) == VIEW_DIFF_MAGIC);
+  return 1;
+}
+
+
+/** Deactivate the active peers of the view that are not in the peer table of
+    a diff view (i.e., that are not in the new view) */
+static int deactivate_peers(bgpview_iter_t *it, bgpstream_peer_id_t *peerid_map,
+                            int peerid_map_cnt)
+{
+  uint64_t *peers;
+  int i;
+
+  if ((peers = calloc(BGPVIEW_PEER_BITSET_WORDS, sizeof(uint64_t))) == NULL) {
+    return -1;
+  }
+  for (i = 0; i < peerid_map_cnt; i++) {
+    if (peerid_map[i] != 0) {
+      BGPVIEW_PEER_BITSET_SET(peers, peerid_map[i]);
+    }
+  }
+
+  for (bgpview_iter_first_peer(it, BGPVIEW_FIELD_ACTIVE);
+       bgpview_iter_has_more_peer(it); bgpview_iter_next_peer(it)) {
+    if (BGPVIEW_PEER_BITSET_TEST(peers, bgpview_iter_peer_get_peer_id(it)) ==
+          0 &&
+        bgpview_iter_deactivate_peer(it) < 0) {
+      free(peers);
+      return -1;
+    }
+  }
+
+  free(peers);
+  return 0;
+}
+
+/** Read the next view of the file. Returns 1 if a view was read, 0 at EOF,
+    -1 on error, and 2 if the next view was a diff view that could not be
+    applied to the given view (and so was skipped) */
+static int read_view(io_t *infile, bgpview_t *view,
+                     bgpview_io_filter_peer_cb_t *peer_cb,
+                     bgpview_io_filter_pfx_cb_t *pfx_cb,
+                     bgpview_io_filter_pfx_peer_cb_t *pfx_peer_cb)
 {
   uint32_t u32;
+  uint32_t parent_time;
 
   bgpstream_peer_id_t *peerid_map = NULL;
   int peerid_map_cnt = 0;
@@ -813,64 +2183,242 @@ int bgpview_io_file_read(io_t *infile, bgpview_t *view,
   int pathid_map_cnt;
 
   bgpview_iter_t *it = NULL;
-  if (view != NULL && (it = bgpview_iter_create(view)) == NULL) {
-    goto err;
-  }
+  int version;
+  int diff = 0;
+  int skipped = 0;
+  int ret;
+
+  read_block_t block = {infile, NULL, READ_BLOCK_LEN, 0, 0, 0};
+  read_block_t *blk = &block;
 
   /* check for eof */
   if (wandio_peek(infile, &u32, sizeof(u32)) == 0) {
     return 0;
   }
 
-  if (check_magic(infile, VIEW_START_MAGIC) == 0) {
+  if ((block.buf = malloc(block.len)) == NULL) {
+    goto err;
+  }
+
+  if (check_magic(blk, VIEW_START_MAGIC) != 0) {
+    version = 1;
+  } else if (check_magic(blk, VIEW_START_V2_MAGIC) != 0) {
+    version = 2;
+  } else if (check_magic(blk, VIEW_DIFF_MAGIC) != 0) {
+    version = 2;
+    diff = 1;
+  } else {
     fprintf(stderr, "ERROR: Missing view-start magic number\n");
     goto err;
   }
 
   /* time */
   READ_VAL(u32);
-  if (view != NULL) {
+
+  if (diff != 0) {
+    READ_VAL(parent_time);
+    parent_time = ntohl(parent_time);
+    if (view != NULL && parent_time != bgpview_get_time(view)) {
+      fprintf(stderr, "WARN: Skipping diff view at %" PRIu32
+                      " (parent time: %" PRIu32 ", expecting %" PRIu32 ")\n",
+              ntohl(u32), parent_time, bgpview_get_time(view));
+      skipped = 1;
+    }
+  } else if (view != NULL) {
+    /* a sync view replaces the contents of the view */
+    bgpview_clear(view);
+  }
+
+  if (view != NULL && skipped == 0) {
     bgpview_set_time(view, ntohl(u32));
+    if ((it = bgpview_iter_create(view)) == NULL) {
+      goto err;
+    }
   }
 
-  if ((peerid_map_cnt = read_peers(infile, it, peer_cb, &peerid_map)) < 0) {
+  if ((peerid_map_cnt = read_peers(blk, it, peer_cb, &peerid_map)) < 0) {
     fprintf(stderr, "ERROR: Could not read peer table\n");
     goto err;
   }
 
-  if ((pathid_map_cnt = read_paths(infile, it, &pathid_map)) < 0) {
+  if (diff != 0 && it != NULL &&
+      deactivate_peers(it, peerid_map, peerid_map_cnt) != 0) {
+    goto err;
+  }
+
+  if ((pathid_map_cnt = read_paths(blk, it, &pathid_map)) < 0) {
     fprintf(stderr, "ERROR: Could not read path table\n");
     goto err;
   }
 
-  /* pfxs */
-  if (read_pfxs(infile, it, pfx_cb, pfx_peer_cb, peerid_map, peerid_map_cnt,
-                pathid_map, pathid_map_cnt) != 0) {
+  /* pfxs (and, for a diff, the pfx-peers that were removed) */
+  if (version == 1) {
+    ret = read_pfxs(blk, it, pfx_cb, pfx_peer_cb, peerid_map, peerid_map_cnt,
+                    pathid_map, pathid_map_cnt);
+  } else {
+    ret = read_pfxs_v2(blk, it, pfx_cb, pfx_peer_cb, peerid_map,
+                       peerid_map_cnt, pathid_map, pathid_map_cnt,
+                       BGPVIEW_FIELD_ACTIVE);
+    if (ret == 0 && diff != 0) {
+      ret = read_pfxs_v2(blk, it, pfx_cb, pfx_peer_cb, peerid_map,
+                         peerid_map_cnt, pathid_map, pathid_map_cnt,
+                         BGPVIEW_FIELD_INACTIVE);
+    }
+  }
+  if (ret != 0) {
     fprintf(stderr, "ERROR: Could not read prefixes\n");
     goto err;
   }
 
-  if (check_magic(infile, VIEW_END_MAGIC) == 0) {
+  if (check_magic(blk, VIEW_END_MAGIC) == 0) {
     fprintf(stderr, "ERROR: Missing end-of-view magic number\n");
   }
 
+  /* leave the following view in the file */
+  if (block_consume(blk) != 0) {
+    goto err;
+  }
+
   if (it != NULL) {
     bgpview_iter_destroy(it);
   }
 
   free(peerid_map);
+  free(pathid_map);
+  free(block.buf);
 
   /* valid view */
-  return 1;
+  return skipped != 0 ? 2 : 1;
 
 err:
   if (it != NULL) {
     bgpview_iter_destroy(it);
   }
   free(peerid_map);
+  free(pathid_map);
+  free(block.buf);
   return -1;
 }
 
+/* ========== PUBLIC FUNCTIONS ========== */
+
+int bgpview_io_file_write(iow_t *outfile, bgpview_t *view,
+                          bgpview_io_filter_cb_t *cb, void *cb_user)
+{
+  return write_view(outfile, NULL, NULL, view, NULL, cb, cb_user, 2);
+}
+
+int bgpview_io_file_write_v1(iow_t *outfile, bgpview_t *view,
+                             bgpview_io_filter_cb_t *cb, void *cb_user)
+{
+  return write_view(outfile, NULL, NULL, view, NULL, cb, cb_user, 1);
+}
+
+int bgpview_io_file_write_diff(iow_t *outfile, bgpview_t *view,
+                               bgpview_t *parent_view,
+                               bgpview_io_filter_cb_t *cb, void *cb_user)
+{
+  return write_view(outfile, NULL, NULL, view, parent_view, cb, cb_user, 2);
+}
+
+int bgpview_io_file_write_indexed(iow_t *outfile, iow_t *idxfile,
+                                  uint64_t *offset, bgpview_t *view,
+                                  bgpview_t *parent_view,
+                                  bgpview_io_filter_cb_t *cb, void *cb_user)
+{
+  assert(idxfile != NULL && offset != NULL);
+  return write_view(outfile, idxfile, offset, view, parent_view, cb, cb_user,
+                    2);
+}
+
+io_t *bgpview_io_file_index_open(const char *filename)
+{
+  char *idxname = NULL;
+  io_t *idxfile = NULL;
+
+  if (strcmp(filename, "-") == 0) {
+    return NULL;
+  }
+
+  if ((idxname = malloc(strlen(filename) +
+                        sizeof(BGPVIEW_IO_FILE_INDEX_SUFFIX))) == NULL) {
+    return NULL;
+  }
+  strcpy(idxname, filename);
+  strcat(idxname, BGPVIEW_IO_FILE_INDEX_SUFFIX);
+
+  if (access(idxname, R_OK) == 0) {
+    idxfile = wandio_create(idxname);
+  }
+
+  free(idxname);
+  return idxfile;
+}
+
+int bgpview_io_file_seek_time(io_t *infile, io_t *idxfile, uint32_t time)
+{
+  uint32_t cur_time;
+  uint64_t skip = 0;
+  int diff;
+  int skipped = 0;
+  int ret;
+
+  while ((ret = peek_time(infile, &cur_time, &diff)) > 0 && cur_time < time) {
+    /* use the index (once) to jump straight to the view (or to the sync view
+       that it is a diff of) */
+    if (idxfile != NULL) {
+      if ((ret = index_find(idxfile, cur_time, time, &skip)) < 0) {
+        return -1;
+      }
+      idxfile = NULL;
+      if (ret != 0) {
+        if (skip_bytes(infile, skip) != 0) {
+          fprintf(stderr, "ERROR: Could not skip to the indexed view\n");
+          return -1;
+        }
+        if (ret == 1) {
+          return peek_time(infile, &cur_time, &diff);
+        }
+        continue;
+      }
+    }
+
+    /* otherwise, skip one view without loading it. diff views can't be
+       skipped this way, since the full view that the following views are
+       based on would be lost too */
+    if (diff != 0) {
+      break;
+    }
+    if (bgpview_io_file_read(infile, NULL, NULL, NULL, NULL) < 0) {
+      return -1;
+    }
+    skipped = 1;
+  }
+
+  if (ret > 0 && diff != 0 && (skipped != 0 || cur_time < time)) {
+    fprintf(stderr, "ERROR: Cannot seek in a file of diff views without its "
+                    "index\n");
+    return -1;
+  }
+
+  return ret;
+}
+
+int bgpview_io_file_read(io_t *infile, bgpview_t *view,
+                         bgpview_io_filter_peer_cb_t *peer_cb,
+                         bgpview_io_filter_pfx_cb_t *pfx_cb,
+                         bgpview_io_filter_pfx_peer_cb_t *pfx_peer_cb)
+{
+  int ret;
+
+  /* skip diff views until one applies to the view (e.g., the next sync view) */
+  do {
+    ret = read_view(infile, view, peer_cb, pfx_cb, pfx_peer_cb);
+  } while (ret == 2);
+
+  return ret;
+}
+
 int bgpview_io_file_print(iow_t *outfile, bgpview_t *view)
 {
   bgpview_iter_t *it = NULL;
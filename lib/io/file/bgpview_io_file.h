@@ -31,6 +31,9 @@
 #include "bgpview_io.h"
 #include <wandio.h>
 
+/** Suffix appended to the name of a file to get the name of its index */
+#define BGPVIEW_IO_FILE_INDEX_SUFFIX ".idx"
+
 /** Write the given view to the given file (in binary format)
  *
  * @param outfile       wandio file handle to write to
@@ -38,23 +41,119 @@
  * @param cb            callback function to use to filter entries (may be NULL)
  * @param cb_user       user pointer provided to callback function
  * @return 0 if the view was written successfully, -1 otherwise
+ *
+ * Views are written in the v2 format, which stores prefixes in sorted order
+ * as separate columns of delta-encoded prefixes, cell counts, peer IDs and
+ * path indexes, and so compresses much better than v1.
  */
 int bgpview_io_file_write(iow_t *outfile, bgpview_t *view,
                           bgpview_io_filter_cb_t *cb, void *cb_user);
 
+/** Write the given view to the given file (in the v1 binary format)
+ *
+ * @param outfile       wandio file handle to write to
+ * @param view          pointer to the view to send
+ * @param cb            callback function to use to filter entries (may be NULL)
+ * @param cb_user       user pointer provided to callback function
+ * @return 0 if the view was written successfully, -1 otherwise
+ *
+ * This is only needed to produce files for readers that predate the v2
+ * format. bgpview_io_file_read reads both formats.
+ */
+int bgpview_io_file_write_v1(iow_t *outfile, bgpview_t *view,
+                             bgpview_io_filter_cb_t *cb, void *cb_user);
+
+/** Write the difference between the given view and a view previously written
+ * to the same file
+ *
+ * @param outfile       wandio file handle to write to
+ * @param view          pointer to the view to send
+ * @param parent_view   pointer to (a copy of) the view written before this one
+ *                      (or NULL to write a full, "sync", view)
+ * @param cb            callback function to use to filter entries (may be NULL)
+ * @param cb_user       user pointer provided to callback function
+ * @return 0 if the view was written successfully, -1 otherwise
+ *
+ * A diff view holds the peer table of the view, and only the pfx-peers that
+ * were added, removed or whose path changed since parent_view, so a stream of
+ * occasional sync views with diff views in between is much smaller than one
+ * of full views. The same filter should be used for every view of a stream.
+ */
+int bgpview_io_file_write_diff(iow_t *outfile, bgpview_t *view,
+                               bgpview_t *parent_view,
+                               bgpview_io_filter_cb_t *cb, void *cb_user);
+
+/** Write the given view to the given file (in binary format), and append an
+ * entry for it to the given index
+ *
+ * @param outfile       wandio file handle to write to
+ * @param idxfile       wandio file handle of the index of outfile
+ * @param offset[in,out] offset of the view in (uncompressed) outfile, which
+ *                      will be advanced past the view. Must be 0 for the
+ *                      first view of the file.
+ * @param view          pointer to the view to send
+ * @param parent_view   pointer to the previous view of the file to write a
+ *                      diff against (or NULL to write a full view)
+ * @param cb            callback function to use to filter entries (may be NULL)
+ * @param cb_user       user pointer provided to callback function
+ * @return 0 if the view was written successfully, -1 otherwise
+ *
+ * The index records the time, offset, length, and peer and prefix counts of
+ * each view, and is conventionally written to a file named after outfile with
+ * BGPVIEW_IO_FILE_INDEX_SUFFIX appended. It also marks which views are diffs
+ * (see bgpview_io_file_write_diff).
+ */
+int bgpview_io_file_write_indexed(iow_t *outfile, iow_t *idxfile,
+                                  uint64_t *offset, bgpview_t *view,
+                                  bgpview_t *parent_view,
+                                  bgpview_io_filter_cb_t *cb, void *cb_user);
+
 /** Receive a view from the given file
  *
  * @param infile        wandio file handle to read from
- * @param view          pointer to the clear/new view to receive into
+ * @param view          pointer to the view to receive into
  * @param cb            callback function to use to filter entries (may be NULL)
  * @return 1 if a view was successfully read, 0 if EOF was reached, -1 if an
  * error occurred
+ *
+ * Views in either the v1 or v2 format are read. A full view replaces the
+ * contents of the given view, and a diff view is applied to it, so the view
+ * must not be cleared between reads. Diff views that do not apply to the given
+ * view (e.g., after seeking) are skipped up to the next full view.
  */
 int bgpview_io_file_read(io_t *infile, bgpview_t *view,
                          bgpview_io_filter_peer_cb_t *peer_cb,
                          bgpview_io_filter_pfx_cb_t *pfx_cb,
                          bgpview_io_filter_pfx_peer_cb_t *pfx_peer_cb);
 
+/** Open the index written alongside the given file, if there is one
+ *
+ * @param filename      name of the view file (not of the index)
+ * @return wandio file handle of the index, or NULL if the file has no index
+ */
+io_t *bgpview_io_file_index_open(const char *filename);
+
+/** Skip ahead in the given file to the first view at or after the given time
+ *
+ * @param infile        wandio file handle to read from, positioned at the start
+ *                      of a view
+ * @param idxfile       wandio file handle of the index of infile (may be NULL)
+ * @param time          time of the view to skip to
+ * @return 1 if the file is now positioned at a view at or after the given
+ * time, 0 if EOF was reached, -1 if an error occurred
+ *
+ * With an index, the views before the given time are skipped without being
+ * parsed (compressed files are still decompressed up to the view). The index
+ * is consumed by this call. Without one, each view is parsed but not loaded.
+ *
+ * If the view at the given time is a diff, an index positions the file at the
+ * full view that it is based on, so callers should also skip any views read
+ * before the given time. Files of diff views can't be seeked in without an
+ * index (an error is returned rather than skipping the full views that later
+ * diff views need).
+ */
+int bgpview_io_file_seek_time(io_t *infile, io_t *idxfile, uint32_t time);
+
 /** Print the given view to the given file (in ASCII format)
  *
  * @param outfile       wandio file handle to print to
@@ -180,17 +180,6 @@ static int pfx_row_end(uint8_t *buf, size_t len, uint16_t peer_cnt)
   return written;
 }
 
-/* returns 0 if they are the same */
-static int diff_cells(bgpview_iter_t *parent_view_it, bgpview_iter_t *itC)
-{
-  bgpstream_as_path_store_path_id_t idxH =
-    bgpview_iter_pfx_peer_get_as_path_store_path_id(parent_view_it);
-  bgpstream_as_path_store_path_id_t idxC =
-    bgpview_iter_pfx_peer_get_as_path_store_path_id(itC);
-
-  return bcmp(&idxH, &idxC, sizeof(bgpstream_as_path_store_path_id_t)) != 0;
-}
-
 /* ==========END SUPPORT FUNCTIONS ========== */
 
 /* ==========START SEND/RECEIVE FUNCTIONS ========== */
@@ -373,172 +362,244 @@ err:
   return -1;
 }
 
-static int send_cells(bgpview_io_kafka_t *client, bgpview_iter_t *it,
-                      bgpview_iter_t *parent_view_it,
-                      bgpview_io_filter_cb_t *cb, void *cb_user)
-{
+/** State of a prefix diff that is being sent */
+typedef struct pfx_diff_state {
+
+  /** Client that is sending the diff */
+  bgpview_io_kafka_t *client;
+
+  /** View that is being sent */
+  bgpview_t *view;
+
+  /** User filter callback (may be NULL) */
+  bgpview_io_filter_cb_t *cb;
+
+  /** User pointer for the filter callback */
+  void *cb_user;
+
+  /** Buffer of prefix rows */
+  uint8_t buf[BUFFER_LEN];
+  uint8_t *ptr;
+  size_t written;
+
+  /** Update row of the current prefix */
   uint8_t upd_buf[BUFFER_LEN];
-  uint8_t *upd_ptr = upd_buf;
-  size_t upd_written = 0;
-  int upd_cells = 0;
+  uint8_t *upd_ptr;
+  size_t upd_written;
+  int upd_cells;
 
+  /** Remove row of the current prefix */
   uint8_t rem_buf[BUFFER_LEN];
-  uint8_t *rem_ptr = rem_buf;
-  size_t rem_written = 0;
-  int rem_cells = 0;
+  uint8_t *rem_ptr;
+  size_t rem_written;
+  int rem_cells;
+
+  /** Number of prefixes of the view that passed the filter */
+  int pfxs_cnt;
+
+  /** Number of those prefixes that were not in the parent view */
+  int added_cnt;
+
+} pfx_diff_state_t;
+
+static int diff_filter(bgpview_iter_t *it, bgpview_io_filter_type_t type,
+                       void *user)
+{
+  pfx_diff_state_t *state = (pfx_diff_state_t *)user;
+  int filter = 1;
+
+  if (state->cb != NULL &&
+      (filter = state->cb(it, type, state->cb_user)) < 0) {
+    return -1;
+  }
+  if (filter == 1 && type == BGPVIEW_IO_FILTER_PFX &&
+      bgpview_iter_get_view(it) == state->view) {
+    state->pfxs_cnt++;
+  }
+  return filter;
+}
+
+/* a row of s bytes was serialized into the prefix buffer */
+static int diff_row_serialized(pfx_diff_state_t *state, ssize_t s)
+{
+  bgpview_io_kafka_t *client = state->client;
+  size_t len = BUFFER_LEN;
 
+  state->written += s;
+  state->ptr += s;
+  SEND_IF_FULL(BGPVIEW_IO_KAFKA_TOPIC_ID_PFXS,
+               BGPVIEW_IO_KAFKA_PFXS_PARTITION_DEFAULT, state->buf,
+               state->written, state->ptr, len);
+  STAT(pfx_cnt)++;
+
+  return 0;
+
+err:
+  return -1;
+}
+
+static int diff_pfx_added(bgpview_iter_t *parent_view_it, bgpview_iter_t *it,
+                          void *user)
+{
+  pfx_diff_state_t *state = (pfx_diff_state_t *)user;
+  bgpview_io_kafka_t *client = state->client;
   ssize_t s;
 
-  /* both iterators refer to a prefix to do a cellular diff on */
-
-  /* for each pfx-peer in the new view */
-  for (bgpview_iter_pfx_first_peer(it, BGPVIEW_FIELD_ACTIVE);
-       bgpview_iter_pfx_has_more_peer(it); bgpview_iter_pfx_next_peer(it)) {
-    bgpstream_peer_id_t peerid = bgpview_iter_peer_get_peer_id(it);
-    int parent_exists =
-      bgpview_iter_pfx_seek_peer(parent_view_it, peerid, BGPVIEW_FIELD_ACTIVE);
-    /* and did we send this cell last time? */
-    int parent_exists_sent =
-      parent_exists && cb(parent_view_it, BGPVIEW_IO_FILTER_PFX_PEER, cb_user);
-
-    int send_this = cb(it, BGPVIEW_IO_FILTER_PFX_PEER, cb_user);
-
-    int upd_cell = 0;
-    int rem_cell = 0;
-    if (parent_exists_sent && send_this) {
-      if (diff_cells(parent_view_it, it) != 0) {
-        /* the cell has changed, send it */
-        upd_cell = 1;
-        STAT(changed_pfx_peer_cnt)++;
-      }
-    } else if (parent_exists_sent && !send_this) {
-      /* cell has been removed */
-      rem_cell = 1;
-      STAT(removed_pfx_peer_cnt)++;
-    } else if (!parent_exists_sent && send_this) {
-      /* cell has been added */
-      upd_cell = 1;
-      STAT(added_pfx_peer_cnt)++;
-    } else {
-      /* nothing to send */
-      continue;
-    }
+  state->added_cnt++;
 
-    if (upd_cell == 1) {
-      assert(rem_cell == 0);
-      if (upd_written == 0) {
-        /* start the row */
-        if ((s = pfx_row_start(upd_ptr, (BUFFER_LEN - upd_written), 'U',
-                               bgpview_iter_pfx_get_pfx(it))) == -1) {
-          goto err;
-        }
-        upd_written += s;
-        upd_ptr += s;
-      }
+  /* update row (current cb) */
+  if ((s = pfx_row_serialize(client, state->ptr, BUFFER_LEN, 'U', it,
+                             state->cb, state->cb_user)) < 0) {
+    return -1;
+  }
+  if (s > 0) {
+    STAT(added_pfxs_cnt)++;
+    return diff_row_serialized(state, s);
+  }
+  return 0;
+}
 
-      /* add this cell */
-      if ((s = bgpview_io_serialize_pfx_peer(
-             upd_ptr, (BUFFER_LEN - upd_written), it, NULL, NULL, 0)) == -1) {
-        goto err;
-      }
-      if (s > 0) {
-        upd_cells++;
-        upd_written += s;
-        upd_ptr += s;
-      }
-    } else if (rem_cell == 1) {
-      assert(upd_cell == 0);
-      if (rem_written == 0) {
-        /* start the row */
-        if ((s = pfx_row_start(rem_ptr, (BUFFER_LEN - rem_written), 'R',
-                               bgpview_iter_pfx_get_pfx(parent_view_it))) ==
-            -1) {
-          goto err;
-        }
-        rem_written += s;
-        rem_ptr += s;
-      }
+static int diff_pfx_removed(bgpview_iter_t *parent_view_it, bgpview_iter_t *it,
+                            void *user)
+{
+  pfx_diff_state_t *state = (pfx_diff_state_t *)user;
+  bgpview_io_kafka_t *client = state->client;
+  ssize_t s;
 
-      /* add this cell */
-      if ((s = bgpview_io_serialize_pfx_peer(
-             rem_ptr, (BUFFER_LEN - rem_written), parent_view_it, NULL, NULL,
-             -1)) == -1) {
-        goto err;
-      }
-      if (s > 0) {
-        rem_cells++;
-        rem_written += s;
-        rem_ptr += s;
-      }
-    }
+  /* remove row (parent cb) */
+  if ((s = pfx_row_serialize(client, state->ptr, BUFFER_LEN, 'R',
+                             parent_view_it, state->cb, state->cb_user)) < 0) {
+    return -1;
+  }
+  if (s > 0) {
+    STAT(removed_pfxs_cnt)++;
+    return diff_row_serialized(state, s);
   }
+  return 0;
+}
 
-  /* for each pfx-peer in the parent view */
-  for (bgpview_iter_pfx_first_peer(parent_view_it, BGPVIEW_FIELD_ACTIVE);
-       bgpview_iter_pfx_has_more_peer(parent_view_it);
-       bgpview_iter_pfx_next_peer(parent_view_it)) {
-    /* was this cell actually sent? */
-    if (cb(parent_view_it, BGPVIEW_IO_FILTER_PFX_PEER, cb_user) == 0) {
-      /* no need to do anything */
-      continue;
+/* add the current pfx-peer of it to the update row */
+static int diff_cell_update(pfx_diff_state_t *state, bgpview_iter_t *it)
+{
+  ssize_t s;
+
+  if (state->upd_written == 0) {
+    /* start the row */
+    if ((s = pfx_row_start(state->upd_ptr, (BUFFER_LEN - state->upd_written),
+                           'U', bgpview_iter_pfx_get_pfx(it))) == -1) {
+      return -1;
     }
+    state->upd_written += s;
+    state->upd_ptr += s;
+  }
 
-    bgpstream_peer_id_t peerid = bgpview_iter_peer_get_peer_id(parent_view_it);
-    if (bgpview_iter_pfx_seek_peer(it, peerid, BGPVIEW_FIELD_ACTIVE) != 1) {
-      /* pfx-peer has been removed in new view, send removal (parent iter) */
-
-      if (rem_written == 0) {
-        /* start the row */
-        if ((s = pfx_row_start(rem_ptr, (BUFFER_LEN - rem_written), 'R',
-                               bgpview_iter_pfx_get_pfx(parent_view_it))) ==
-            -1) {
-          goto err;
-        }
-        rem_written += s;
-        rem_ptr += s;
-      }
+  /* add this cell */
+  if ((s = bgpview_io_serialize_pfx_peer(state->upd_ptr,
+                                         (BUFFER_LEN - state->upd_written), it,
+                                         NULL, NULL, 0)) == -1) {
+    return -1;
+  }
+  if (s > 0) {
+    state->upd_cells++;
+    state->upd_written += s;
+    state->upd_ptr += s;
+  }
+  return 0;
+}
 
-      /* add this cell */
-      if ((s = bgpview_io_serialize_pfx_peer(
-             rem_ptr, (BUFFER_LEN - rem_written), parent_view_it, cb, cb_user,
-             -1)) == -1) {
-        goto err;
-      }
-      if (s > 0) {
-        rem_cells++;
-        rem_written += s;
-        rem_ptr += s;
-      }
+static int diff_pfx_peer_added(bgpview_iter_t *parent_view_it,
+                               bgpview_iter_t *it, void *user)
+{
+  pfx_diff_state_t *state = (pfx_diff_state_t *)user;
+  bgpview_io_kafka_t *client = state->client;
+
+  STAT(added_pfx_peer_cnt)++;
+  return diff_cell_update(state, it);
+}
+
+static int diff_pfx_peer_changed(bgpview_iter_t *parent_view_it,
+                                 bgpview_iter_t *it, void *user)
+{
+  pfx_diff_state_t *state = (pfx_diff_state_t *)user;
+  bgpview_io_kafka_t *client = state->client;
+
+  STAT(changed_pfx_peer_cnt)++;
+  return diff_cell_update(state, it);
+}
+
+static int diff_pfx_peer_removed(bgpview_iter_t *parent_view_it,
+                                 bgpview_iter_t *it, void *user)
+{
+  pfx_diff_state_t *state = (pfx_diff_state_t *)user;
+  bgpview_io_kafka_t *client = state->client;
+  ssize_t s;
+
+  STAT(removed_pfx_peer_cnt)++;
+
+  if (state->rem_written == 0) {
+    /* start the row */
+    if ((s = pfx_row_start(state->rem_ptr, (BUFFER_LEN - state->rem_written),
+                           'R', bgpview_iter_pfx_get_pfx(parent_view_it))) ==
+        -1) {
+      return -1;
     }
+    state->rem_written += s;
+    state->rem_ptr += s;
+  }
+
+  /* add this cell */
+  if ((s = bgpview_io_serialize_pfx_peer(
+         state->rem_ptr, (BUFFER_LEN - state->rem_written), parent_view_it,
+         NULL, NULL, -1)) == -1) {
+    return -1;
+  }
+  if (s > 0) {
+    state->rem_cells++;
+    state->rem_written += s;
+    state->rem_ptr += s;
   }
+  return 0;
+}
+
+/* all the cells of a common prefix have been diffed, send its rows */
+static int diff_pfx_changed(bgpview_iter_t *parent_view_it, bgpview_iter_t *it,
+                            void *user)
+{
+  pfx_diff_state_t *state = (pfx_diff_state_t *)user;
+  bgpview_io_kafka_t *client = state->client;
+  ssize_t s;
 
-  if (upd_cells > 0) {
+  if (state->upd_cells > 0) {
     /* send the update row */
-    if ((s = pfx_row_end(upd_ptr, (BUFFER_LEN - upd_written), upd_cells)) ==
-        -1) {
+    if ((s = pfx_row_end(state->upd_ptr, (BUFFER_LEN - state->upd_written),
+                         state->upd_cells)) == -1) {
       goto err;
     }
-    upd_written += s;
-    upd_ptr += s;
+    state->upd_written += s;
     SEND_MSG(BGPVIEW_IO_KAFKA_TOPIC_ID_PFXS,
-             BGPVIEW_IO_KAFKA_PFXS_PARTITION_DEFAULT, upd_buf, upd_written);
+             BGPVIEW_IO_KAFKA_PFXS_PARTITION_DEFAULT, state->upd_buf,
+             state->upd_written);
   }
 
-  if (rem_cells > 0) {
+  if (state->rem_cells > 0) {
     /* send the remove row */
-    if ((s = pfx_row_end(rem_ptr, (BUFFER_LEN - rem_written), rem_cells)) ==
-        -1) {
+    if ((s = pfx_row_end(state->rem_ptr, (BUFFER_LEN - state->rem_written),
+                         state->rem_cells)) == -1) {
       goto err;
     }
-    rem_written += s;
-    rem_ptr += s;
+    state->rem_written += s;
     SEND_MSG(BGPVIEW_IO_KAFKA_TOPIC_ID_PFXS,
-             BGPVIEW_IO_KAFKA_PFXS_PARTITION_DEFAULT, rem_buf, rem_written);
+             BGPVIEW_IO_KAFKA_PFXS_PARTITION_DEFAULT, state->rem_buf,
+             state->rem_written);
   }
 
-  STAT(changed_pfxs_cnt) += (upd_cells > 0 || rem_cells > 0);
-  STAT(pfx_cnt) += (upd_cells > 0) + (rem_cells > 0);
-  STAT(common_pfxs_cnt)++;
+  STAT(changed_pfxs_cnt) += (state->upd_cells > 0 || state->rem_cells > 0);
+  STAT(pfx_cnt) += (state->upd_cells > 0) + (state->rem_cells > 0);
+
+  RESET_BUF(state->upd_buf, state->upd_ptr, state->upd_written);
+  state->upd_cells = 0;
+  RESET_BUF(state->rem_buf, state->rem_ptr, state->rem_written);
+  state->rem_cells = 0;
 
   return 0;
 
@@ -546,19 +607,51 @@ err:
   return -1;
 }
 
+static int send_diff_pfxs(bgpview_io_kafka_t *client, bgpview_t *view,
+                          bgpview_t *parent_view, pfx_diff_state_t *state)
+{
+  bgpview_diff_cbs_t cbs = {
+    diff_pfx_added,      diff_pfx_removed,      diff_pfx_changed,
+    diff_pfx_peer_added, diff_pfx_peer_removed, diff_pfx_peer_changed,
+  };
+
+  RESET_BUF(state->upd_buf, state->upd_ptr, state->upd_written);
+  state->upd_cells = 0;
+  RESET_BUF(state->rem_buf, state->rem_ptr, state->rem_written);
+  state->rem_cells = 0;
+  state->pfxs_cnt = 0;
+  state->added_cnt = 0;
+
+  if (state->cb == NULL) {
+    /* let bgpview_diff skip the prefixes that are shared with the parent */
+    state->pfxs_cnt = bgpview_pfx_cnt(view, BGPVIEW_FIELD_ACTIVE);
+    if (bgpview_diff(parent_view, view, &cbs, NULL, state) != 0) {
+      return -1;
+    }
+  } else if (bgpview_diff(parent_view, view, &cbs, diff_filter, state) != 0) {
+    return -1;
+  }
+
+  STAT(common_pfxs_cnt) += state->pfxs_cnt - state->added_cnt;
+  return 0;
+}
+
 static int send_pfxs(bgpview_io_kafka_t *client, bgpview_io_kafka_md_t *meta,
-                     bgpview_iter_t *it, bgpview_t *parent_view,
-                     bgpview_iter_t *parent_view_it, bgpview_io_filter_cb_t *cb,
+                     bgpview_t *view, bgpview_iter_t *it,
+                     bgpview_t *parent_view, bgpview_io_filter_cb_t *cb,
                      void *cb_user)
 {
-  /* serialization buffer and state */
-  uint8_t buf[BUFFER_LEN];
-  uint8_t *ptr = buf;
-  ;
+  /* serialization buffers and state */
+  pfx_diff_state_t state;
   size_t len = BUFFER_LEN;
-  size_t written = 0;
   ssize_t s = 0;
 
+  state.client = client;
+  state.view = view;
+  state.cb = cb;
+  state.cb_user = cb_user;
+  RESET_BUF(state.buf, state.ptr, state.written);
+
 again:
   /* find our current offset and update the metadata */
   if ((meta->pfxs_offset =
@@ -568,134 +661,51 @@ again:
     goto again;
   }
 
-  /* for each prefix in new view */
-  for (bgpview_iter_first_pfx(it, 0, BGPVIEW_FIELD_ACTIVE);
-       bgpview_iter_has_more_pfx(it); bgpview_iter_next_pfx(it)) {
-
-    /* if we are sending a sync frame, just send the row */
-    if (meta->type == 'S') {
-      if ((s = pfx_row_serialize(client, ptr, len, 'S', it, cb, cb_user)) < 0) {
+  if (meta->type == 'S') {
+    /* we are sending a sync frame, just send the rows */
+    for (bgpview_iter_first_pfx(it, 0, BGPVIEW_FIELD_ACTIVE);
+         bgpview_iter_has_more_pfx(it); bgpview_iter_next_pfx(it)) {
+      if ((s = pfx_row_serialize(client, state.ptr, len, 'S', it, cb,
+                                 cb_user)) < 0) {
         goto err;
       }
       if (s > 0) {
         STAT(pfx_cnt)++;
         STAT(sync_pfx_cnt)++;
-        written += s;
-        ptr += s;
+        state.written += s;
+        state.ptr += s;
         SEND_IF_FULL(BGPVIEW_IO_KAFKA_TOPIC_ID_PFXS,
-                     BGPVIEW_IO_KAFKA_PFXS_PARTITION_DEFAULT, buf, written, ptr,
-                     len);
-        s = 0;
+                     BGPVIEW_IO_KAFKA_PFXS_PARTITION_DEFAULT, state.buf,
+                     state.written, state.ptr, len);
       }
-      continue;
     }
-
+  } else {
     /* we are sending a diff */
     assert(meta->type == 'D');
-
-    bgpstream_pfx_t *pfx = bgpview_iter_pfx_get_pfx(it);
-    int parent_exists =
-      bgpview_iter_seek_pfx(parent_view_it, pfx, BGPVIEW_FIELD_ACTIVE);
-    /* did we send this prefix last time? */
-    int parent_exists_sent =
-      parent_exists && cb(parent_view_it, BGPVIEW_IO_FILTER_PFX, cb_user);
-
-    /* does the user want this prefix sent? */
-    int send_this = cb(it, BGPVIEW_IO_FILTER_PFX, cb_user);
-
-    if (parent_exists_sent && send_this) {
-      /* cellular diff */
-      if (send_cells(client, it, parent_view_it, cb, cb_user) != 0) {
-        goto err;
-      }
-    } else if (parent_exists_sent && !send_this) {
-      /* remove row (parent cb) */
-      if ((s = pfx_row_serialize(client, ptr, len, 'R', parent_view_it, cb,
-                                 cb_user)) < 0) {
-        goto err;
-      }
-
-      if (s > 0) {
-        STAT(removed_pfxs_cnt)++;
-      }
-    } else if (!parent_exists_sent && send_this) {
-      /* update row (current cb) */
-      if ((s = pfx_row_serialize(client, ptr, len, 'U', it, cb, cb_user)) < 0) {
-        goto err;
-      }
-
-      if (s > 0) {
-        STAT(added_pfxs_cnt)++;
-      }
-    } else {
-      /* nothing to send */
-      continue;
-    }
-
-    /* if one of the above cases serialized something, send the message now */
-    if (s > 0) {
-      written += s;
-      ptr += s;
-      SEND_IF_FULL(BGPVIEW_IO_KAFKA_TOPIC_ID_PFXS,
-                   BGPVIEW_IO_KAFKA_PFXS_PARTITION_DEFAULT, buf, written, ptr,
-                   len);
-      s = 0;
-      STAT(pfx_cnt)++;
-    }
-  }
-
-  /* if this is a diff, we need to send prefix-removal info */
-  if (meta->type == 'D') {
-    /* for each prefix in the parent view */
-    for (bgpview_iter_first_pfx(parent_view_it, 0, BGPVIEW_FIELD_ACTIVE);
-         bgpview_iter_has_more_pfx(parent_view_it);
-         bgpview_iter_next_pfx(parent_view_it)) {
-      /* was this prefix actually sent? */
-      if (cb(parent_view_it, BGPVIEW_IO_FILTER_PFX, cb_user) == 0) {
-        /* no need to do anything */
-        continue;
-      }
-
-      bgpstream_pfx_t *pfx = bgpview_iter_pfx_get_pfx(parent_view_it);
-      /* does this prefix exist in the new view? */
-      if (bgpview_iter_seek_pfx(it, pfx, BGPVIEW_FIELD_ACTIVE) != 1) {
-        /* does not exist, send a removal (parent iter) */
-        if ((s = pfx_row_serialize(client, ptr, len, 'R', parent_view_it, cb,
-                                   cb_user)) < 0) {
-          goto err;
-        }
-        if (s > 0) {
-          written += s;
-          ptr += s;
-          SEND_IF_FULL(BGPVIEW_IO_KAFKA_TOPIC_ID_PFXS,
-                       BGPVIEW_IO_KAFKA_PFXS_PARTITION_DEFAULT, buf, written,
-                       ptr, len);
-          s = 0;
-          STAT(removed_pfxs_cnt)++;
-          STAT(pfx_cnt)++;
-        }
-      }
+    if (send_diff_pfxs(client, view, parent_view, &state) != 0) {
+      goto err;
     }
   }
 
   /* send whatever is left in the buffer */
-  if (written > 0) {
+  if (state.written > 0) {
     SEND_MSG(BGPVIEW_IO_KAFKA_TOPIC_ID_PFXS,
-             BGPVIEW_IO_KAFKA_PFXS_PARTITION_DEFAULT, buf, written);
-    RESET_BUF(buf, ptr, written);
+             BGPVIEW_IO_KAFKA_PFXS_PARTITION_DEFAULT, state.buf,
+             state.written);
+    RESET_BUF(state.buf, state.ptr, state.written);
   }
 
   /* send the end-of-prefixes message */
-  assert(ptr == buf);
+  assert(state.ptr == state.buf);
   char type = 'E';
-  BGPVIEW_IO_SERIALIZE_VAL(ptr, len, written, type);
+  BGPVIEW_IO_SERIALIZE_VAL(state.ptr, len, state.written, type);
   /* Time */
-  BGPVIEW_IO_SERIALIZE_VAL(ptr, len, written, meta->time);
+  BGPVIEW_IO_SERIALIZE_VAL(state.ptr, len, state.written, meta->time);
   /* Prefix count */
-  BGPVIEW_IO_SERIALIZE_VAL(ptr, len, written, STAT(pfx_cnt));
+  BGPVIEW_IO_SERIALIZE_VAL(state.ptr, len, state.written, STAT(pfx_cnt));
 
   SEND_MSG(BGPVIEW_IO_KAFKA_TOPIC_ID_PFXS,
-           BGPVIEW_IO_KAFKA_PFXS_PARTITION_DEFAULT, buf, written);
+           BGPVIEW_IO_KAFKA_PFXS_PARTITION_DEFAULT, state.buf, state.written);
 
   return 0;
 
@@ -719,7 +729,7 @@ static int send_sync_view(bgpview_io_kafka_t *client, bgpview_t *view,
   if (send_peers(client, &meta, view, it, NULL, cb, cb_user) != 0) {
     goto err;
   }
-  if (send_pfxs(client, &meta, it, NULL, NULL, cb, cb_user) != 0) {
+  if (send_pfxs(client, &meta, view, it, NULL, cb, cb_user) != 0) {
     goto err;
   }
 
@@ -771,8 +781,7 @@ static int send_diff_view(bgpview_io_kafka_t *client, bgpview_t *view,
     goto err;
   }
 
-  if (send_pfxs(client, &meta, it, parent_view, parent_view_it, cb, cb_user) ==
-      -1) {
+  if (send_pfxs(client, &meta, view, it, parent_view, cb, cb_user) == -1) {
     goto err;
   }
 
@@ -89,6 +89,9 @@ static bgpview_t *view = NULL;
 
 #ifdef WITH_BGPVIEW_IO_FILE
 static io_t *file_handle = NULL;
+/* time range of views to read from the file (0 for unbounded) */
+static uint32_t file_start_time = 0;
+static uint32_t file_end_time = 0;
 #endif
 #ifdef WITH_BGPVIEW_IO_KAFKA
 static bgpview_io_kafka_t *kafka_client = NULL;
@@ -356,7 +359,8 @@ static void usage(const char *name)
           "       -i\"<module> <opts>\"     IO module to use for obtaining views.\n"
           "                               Available modules:\n");
 #ifdef WITH_BGPVIEW_IO_FILE
-  fprintf(stderr, "                                - file\n");
+  fprintf(stderr, "                                - file "
+                  "(<file> [<start-time> [<end-time>]])\n");
 #endif
 #ifdef WITH_BGPVIEW_IO_TEST
   fprintf(stderr, "                                - test\n");
@@ -396,6 +400,11 @@ static void usage(const char *name)
 static int configure_io(char *io_module)
 {
   char *io_options = NULL;
+#ifdef WITH_BGPVIEW_IO_FILE
+  char *time_str = NULL;
+  io_t *idx_handle = NULL;
+  int ret;
+#endif
 
   /* the string at io_module will contain the name of the IO module
    optionally followed by a space and then the arguments to pass
@@ -418,10 +427,29 @@ static int configure_io(char *io_module)
               "ERROR: filename must be provided when using the file module\n");
       goto err;
     }
+    /* the filename may be followed by a start and an end time */
+    if ((time_str = strchr(io_options, ' ')) != NULL) {
+      *time_str = '\0';
+      file_start_time = strtoul(time_str + 1, &time_str, 10);
+      file_end_time = strtoul(time_str, NULL, 10);
+    }
     if ((file_handle = wandio_create(io_options)) == NULL) {
       fprintf(stderr, "ERROR: Could not open BGPView file '%s'\n", io_options);
       goto err;
     }
+    if (file_start_time != 0) {
+      /* jump to the first view in range (using the index, if any) */
+      idx_handle = bgpview_io_file_index_open(io_options);
+      ret = bgpview_io_file_seek_time(file_handle, idx_handle, file_start_time);
+      if (idx_handle != NULL) {
+        wandio_destroy(idx_handle);
+      }
+      if (ret < 0) {
+        fprintf(stderr, "ERROR: Could not seek to time %" PRIu32 "\n",
+                file_start_time);
+        goto err;
+      }
+    }
   }
 #endif
 #ifdef WITH_BGPVIEW_IO_KAFKA
@@ -521,15 +549,28 @@ static void shutdown_io(void)
 
 static int recv_view(char *io_module)
 {
+#ifdef WITH_BGPVIEW_IO_FILE
+  int ret;
+#endif
+
   if (0) { /* just to simplify the if/else with macros */
   }
 #ifdef WITH_BGPVIEW_IO_FILE
   else if (strcmp(io_module, "file") == 0) {
-    bgpview_clear(view);
-    return bgpview_io_file_read(
-      file_handle, view, (peer_filters_cnt != 0) ? filter_peer : NULL,
-      (pfx_filters_cnt != 0) ? filter_pfx : NULL,
-      (pfx_peer_filters_cnt != 0) ? filter_pfx_peer : NULL);
+    /* the view is not cleared, since diff views are applied to it. after
+       seeking, views before the start time may still need to be read */
+    do {
+      ret = bgpview_io_file_read(
+        file_handle, view, (peer_filters_cnt != 0) ? filter_peer : NULL,
+        (pfx_filters_cnt != 0) ? filter_pfx : NULL,
+        (pfx_peer_filters_cnt != 0) ? filter_pfx_peer : NULL);
+    } while (ret > 0 && bgpview_get_time(view) < file_start_time);
+    if (ret > 0 && file_end_time != 0 &&
+        bgpview_get_time(view) > file_end_time) {
+      /* past the end of the requested range */
+      return 0;
+    }
+    return ret;
   }
 #endif
 #ifdef WITH_BGPVIEW_IO_KAFKA
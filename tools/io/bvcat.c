@@ -29,25 +29,61 @@
 #include "config.h"
 #include "utils.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include <wandio.h>
 
 static bgpview_t *view = NULL;
 static iow_t *wstdout = NULL;
 
+/* time range of views to output (0 for unbounded) */
+static uint32_t start_time = 0;
+static uint32_t end_time = 0;
+
+static void usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [<options>] [<file> ...]\n"
+          "       -s <time>     output views at or after the given time\n"
+          "       -e <time>     output views at or before the given time\n",
+          name);
+}
+
 static int cat_file(const char *file)
 {
   io_t *infile = NULL;
+  io_t *idxfile = NULL;
   int ret;
 
   if ((infile = wandio_create(file)) == NULL) {
     goto err;
   }
 
+  if (start_time != 0) {
+    /* jump to the first view in range (using the index, if any) */
+    idxfile = bgpview_io_file_index_open(file);
+    ret = bgpview_io_file_seek_time(infile, idxfile, start_time);
+    if (idxfile != NULL) {
+      wandio_destroy(idxfile);
+    }
+    if (ret < 0) {
+      goto err;
+    }
+  }
+
+  /* the view is not cleared between reads, since diff views are applied to
+     it */
   while ((ret = bgpview_io_file_read(infile, view, NULL, NULL, NULL)) > 0) {
+    if (bgpview_get_time(view) < start_time) {
+      /* seeking may stop at the full view that a diff view is based on */
+      continue;
+    }
+    if (end_time != 0 && bgpview_get_time(view) > end_time) {
+      break;
+    }
     if (bgpview_io_file_print(wstdout, view) != 0) {
       goto err;
     }
-    bgpview_clear(view);
   }
 
   if (ret < 0) {
@@ -69,6 +105,24 @@ err:
 int main(int argc, char **argv)
 {
   int i;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "e:s:?")) >= 0) {
+    switch (opt) {
+    case 'e':
+      end_time = strtoul(optarg, NULL, 10);
+      break;
+
+    case 's':
+      start_time = strtoul(optarg, NULL, 10);
+      break;
+
+    case '?':
+    default:
+      usage(argv[0]);
+      return -1;
+    }
+  }
 
   if ((view = bgpview_create(NULL, NULL, NULL, NULL)) == NULL) {
     goto err;
@@ -78,12 +132,12 @@ int main(int argc, char **argv)
     goto err;
   }
 
-  if (argc == 1) {
+  if (optind == argc) {
     if (cat_file("-") != 0) {
       goto err;
     }
   } else {
-    for (i = 1; i < argc; i++) {
+    for (i = optind; i < argc; i++) {
       if (cat_file(argv[i]) != 0) {
         goto err;
       }